@@ -0,0 +1,199 @@
+#!/usr/bin/env python3
+"""ROM/RAM and average-current budget check for a firmware build.
+
+Reads zephyr.elf and .config from a (sys)build directory, prints how much
+flash and RAM the image takes and a duty-cycle estimate of the average
+battery current, and exits non-zero if any of them is over budget.
+
+The current model adds up charge per second from each activity, using
+typical datasheet figures for the Feather nRF52840 Express (DC/DC on,
+0 dBm, 1M PHY) and the VL53L0X. It is an estimate: calibrate the
+constants below against a Power Profiler Kit trace of the real board and
+keep them in sync when the hardware changes. The runtime target comes
+from wearable-design.md (500 mAh LiPo, ~15 hours).
+
+Usage:
+  budget.py BUILD_DIR [--rom-kb N] [--ram-kb N] [--runtime-h H]
+            [--battery-mah N] [--conn-interval-ms N]
+"""
+
+import argparse
+import glob
+import os
+import struct
+import sys
+
+# Always-on board draw, mA: regulator quiescent current, NeoPixel idle,
+# nRF52840 System ON idle with RTC, VL53L0X and QSPI flash standby
+BOARD_IDLE_MA = 0.055 + 0.6 + 0.003 + 0.005 + 0.002
+
+# VL53L0X single-shot ranging: ~19 mA for the timing budget (33 ms default)
+SENSOR_RANGING_MA = 19.0
+SENSOR_RANGING_MS = 33.0
+
+# nRF52840 CPU and TWIM active per sample, mA and ms. The blocking read
+# path keeps the CPU awake polling the sensor for longer.
+CPU_ACTIVE_MA = 3.3
+CPU_MS_PER_SAMPLE_ASYNC = 0.6
+CPU_MS_PER_SAMPLE_SYNC = 1.5
+
+# BLE connection event without data, and the extra charge per payload
+# byte (8 us/byte at 1M PHY, ~5 mA TX), in uC
+RADIO_EVENT_UC = 6.0
+RADIO_BYTE_UC = 0.04
+# L2CAP + ATT headers and the link-layer overhead of one notification
+RADIO_NOTIFY_OVERHEAD_BYTES = 14
+
+# Usable fraction of the rated capacity (3.5 V cutoff, ageing)
+BATTERY_USABLE = 0.85
+
+# Range batches: 10-byte header, deltas are 1 byte for typical motion
+BATCH_HEADER_BYTES = 10
+BATCH_BYTES_PER_SAMPLE = 1.2
+
+SHF_WRITE = 0x1
+SHF_ALLOC = 0x2
+SHT_NOBITS = 8
+
+
+def find_app_dir(build_dir):
+    """Return the directory holding the application's zephyr/ output.
+
+    Under sysbuild the application is one level down, next to the
+    bootloader and other images, so pick the one built from this app.
+    """
+    for config in sorted(glob.glob(os.path.join(build_dir, "**", "zephyr", ".config"),
+                              recursive=True)):
+        with open(config) as f:
+            if "CONFIG_RANGE_SAMPLE_INTERVAL_MS=" in f.read():
+                return os.path.dirname(config)
+    raise SystemExit(f"error: no application build found under {build_dir}")
+
+
+def read_config(path):
+    """Parse a Kconfig .config into a dict of strings ("y" for booleans)."""
+    config = {}
+    with open(path) as f:
+        for line in f:
+            line = line.strip()
+            if line.startswith("CONFIG_") and "=" in line:
+                key, value = line.split("=", 1)
+                config[key[len("CONFIG_"):]] = value.strip('"')
+    return config
+
+
+def section_sizes(elf_path):
+    """Return (rom, ram) bytes from the ELF section headers.
+
+    ROM is every allocated section with contents in the image (code,
+    read-only data and the initial values of .data). RAM is every
+    allocated writable section (.data, .bss, noinit, stacks).
+    """
+    with open(elf_path, "rb") as f:
+        data = f.read()
+
+    if data[:4] != b"\x7fELF":
+        raise SystemExit(f"error: {elf_path} is not an ELF file")
+    is64 = data[4] == 2
+    endian = "<" if data[5] == 1 else ">"
+
+    if is64:
+        shoff, = struct.unpack_from(endian + "Q", data, 0x28)
+        shentsize, shnum = struct.unpack_from(endian + "HH", data, 0x3A)
+        fmt = endian + "IIQQQQ"
+    else:
+        shoff, = struct.unpack_from(endian + "I", data, 0x20)
+        shentsize, shnum = struct.unpack_from(endian + "HH", data, 0x2E)
+        fmt = endian + "IIIIII"
+
+    rom = ram = 0
+    for i in range(shnum):
+        _, sh_type, flags, _, _, size = struct.unpack_from(fmt, data, shoff + i * shentsize)
+        if not flags & SHF_ALLOC:
+            continue
+        if sh_type != SHT_NOBITS:
+            rom += size
+        if flags & SHF_WRITE:
+            ram += size
+    return rom, ram
+
+
+def estimate_current(config, conn_interval_ms):
+    """Return a list of (activity, mA) for the average battery current."""
+    sample_ms = int(config.get("RANGE_SAMPLE_INTERVAL_MS", "50"))
+    notify_ms = int(config.get("RANGE_NOTIFY_INTERVAL_MS", "50"))
+    cpu_ms = (CPU_MS_PER_SAMPLE_ASYNC if config.get("RANGE_SENSOR_ASYNC") == "y"
+              else CPU_MS_PER_SAMPLE_SYNC)
+
+    samples_per_batch = max(notify_ms / sample_ms, 1)
+    batch_bytes = (BATCH_HEADER_BYTES + samples_per_batch * BATCH_BYTES_PER_SAMPLE +
+                   RADIO_NOTIFY_OVERHEAD_BYTES)
+
+    return [
+        ("board idle", BOARD_IDLE_MA),
+        ("sensor ranging", SENSOR_RANGING_MA * min(SENSOR_RANGING_MS / sample_ms, 1)),
+        ("cpu per sample", CPU_ACTIVE_MA * cpu_ms / sample_ms),
+        ("ble connection events", RADIO_EVENT_UC / conn_interval_ms),
+        ("ble batch notifications", RADIO_BYTE_UC * batch_bytes / notify_ms),
+    ]
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("build_dir")
+    parser.add_argument("--rom-kb", type=float, default=256,
+                        help="flash budget in KiB (default: %(default)s)")
+    parser.add_argument("--ram-kb", type=float, default=64,
+                        help="RAM budget in KiB (default: %(default)s)")
+    parser.add_argument("--runtime-h", type=float, default=15,
+                        help="battery runtime target in hours (default: %(default)s)")
+    parser.add_argument("--battery-mah", type=float, default=500,
+                        help="rated battery capacity (default: %(default)s)")
+    parser.add_argument("--conn-interval-ms", type=float, default=None,
+                        help="connection interval to assume (default: the "
+                             "peripheral's preferred maximum)")
+    args = parser.parse_args()
+
+    app_dir = find_app_dir(args.build_dir)
+    config = read_config(os.path.join(app_dir, ".config"))
+    rom, ram = section_sizes(os.path.join(app_dir, "zephyr.elf"))
+
+    conn_interval_ms = args.conn_interval_ms
+    if conn_interval_ms is None:
+        conn_interval_ms = int(config.get("BT_PERIPHERAL_PREF_MAX_INT", "40")) * 1.25
+
+    activities = estimate_current(config, conn_interval_ms)
+    avg_ma = sum(ma for _, ma in activities)
+    usable_mah = args.battery_mah * BATTERY_USABLE
+    budget_ma = usable_mah / args.runtime_h
+
+    failed = []
+
+    def check(name, value, budget, unit):
+        ok = value <= budget
+        print(f"  {name:<8}{value:10.1f} {unit:<3} of {budget:.1f} {unit} "
+              f"({100 * value / budget:.0f}%){'' if ok else '  OVER BUDGET'}")
+        if not ok:
+            failed.append(name)
+
+    print(f"Budget report for {app_dir}")
+    check("ROM", rom / 1024, args.rom_kb, "KiB")
+    check("RAM", ram / 1024, args.ram_kb, "KiB")
+    print()
+    print(f"  Current estimate (sample {config.get('RANGE_SAMPLE_INTERVAL_MS')} ms, "
+          f"notify {config.get('RANGE_NOTIFY_INTERVAL_MS')} ms, "
+          f"connection interval {conn_interval_ms:g} ms):")
+    for name, ma in activities:
+        print(f"    {name:<26}{ma:7.2f} mA")
+    check("Current", avg_ma, budget_ma, "mA")
+    print(f"  {'Runtime':<8}{usable_mah / avg_ma:10.1f} h   on {args.battery_mah:g} mAh "
+          f"({BATTERY_USABLE:.0%} usable), target {args.runtime_h:g} h")
+
+    if failed:
+        print(f"error: over budget: {', '.join(failed)}", file=sys.stderr)
+        return 1
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -3,6 +3,7 @@
 #include <zephyr/drivers/adc.h>
 #include <zephyr/kernel.h>
 #include <zephyr/logging/log.h>
+#include <zephyr/pm/device_runtime.h>
 
 LOG_MODULE_REGISTER(battery, LOG_LEVEL_INF);
 
@@ -51,7 +52,15 @@ int battery_init(void)
 		return -ENODEV;
 	}
 
-	int ret = adc_channel_setup(adc_dev, &channel_cfg);
+	/* The SAADC is only resumed while in use (production builds) */
+	int ret = pm_device_runtime_get(adc_dev);
+	if (ret < 0) {
+		LOG_ERR("ADC resume failed: %d", ret);
+		return ret;
+	}
+
+	ret = adc_channel_setup(adc_dev, &channel_cfg);
+	pm_device_runtime_put(adc_dev);
 	if (ret < 0) {
 		LOG_ERR("ADC channel setup failed: %d", ret);
 		return ret;
@@ -63,7 +72,14 @@ int battery_init(void)
 
 int battery_read_mv(void)
 {
-	int ret = adc_read(adc_dev, &sequence);
+	int ret = pm_device_runtime_get(adc_dev);
+	if (ret < 0) {
+		LOG_ERR("ADC resume failed: %d", ret);
+		return ret;
+	}
+
+	ret = adc_read(adc_dev, &sequence);
+	pm_device_runtime_put(adc_dev);
 	if (ret < 0) {
 		LOG_ERR("ADC read failed: %d", ret);
 		return ret;
@@ -0,0 +1,230 @@
+#include "diagnostics.h"
+
+#include <zephyr/kernel.h>
+#include <zephyr/spinlock.h>
+#include <zephyr/sys/byteorder.h>
+#include <zephyr/sys/util.h>
+
+/*
+ * Counters are written from the sensor thread and read from the BT RX
+ * thread, so everything goes through one spinlock to keep snapshots
+ * consistent. Sums are 64-bit so averages don't wrap in long sessions.
+ */
+static struct k_spinlock lock;
+
+static struct {
+	uint32_t samples;
+	uint32_t read_errors;
+	uint64_t busy_us_sum;
+	uint64_t wall_us_sum;
+	/* wall time of successful reads only, for energy */
+	uint64_t ranging_us_sum;
+	uint32_t busy_us_max;
+	uint32_t wall_us_max;
+	uint16_t jitter_hist[DIAGNOSTICS_JITTER_BINS];
+	uint32_t jitter_us_max;
+	uint32_t deadline_misses;
+	uint32_t boot_ms[DIAGNOSTICS_BOOT_MILESTONES];
+	uint16_t sensor_init_attempts;
+	uint8_t sensor_state;
+	uint16_t consecutive_failures;
+	uint32_t sensor_recoveries;
+	/* zero-initialized it is an idle meter started at boot */
+	struct energy_meter meter;
+} stats;
+
+static const uint32_t jitter_edges_us[] = DIAGNOSTICS_JITTER_EDGES_US;
+
+BUILD_ASSERT(ARRAY_SIZE(jitter_edges_us) == DIAGNOSTICS_JITTER_BINS - 1,
+	     "jitter histogram needs one more bin than edges");
+
+void diagnostics_record_read(bool ok, uint32_t busy_us, uint32_t wall_us)
+{
+	k_spinlock_key_t key = k_spin_lock(&lock);
+
+	if (ok) {
+		stats.samples++;
+		stats.ranging_us_sum += wall_us;
+	} else {
+		stats.read_errors++;
+	}
+
+	stats.busy_us_sum += busy_us;
+	stats.wall_us_sum += wall_us;
+	stats.busy_us_max = MAX(stats.busy_us_max, busy_us);
+	stats.wall_us_max = MAX(stats.wall_us_max, wall_us);
+
+	k_spin_unlock(&lock, key);
+}
+
+void diagnostics_record_wakeup(uint32_t late_us)
+{
+	size_t bin = 0;
+
+	while (bin < ARRAY_SIZE(jitter_edges_us) && late_us > jitter_edges_us[bin]) {
+		bin++;
+	}
+
+	k_spinlock_key_t key = k_spin_lock(&lock);
+
+	if (stats.jitter_hist[bin] < UINT16_MAX) {
+		stats.jitter_hist[bin]++;
+	}
+	stats.jitter_us_max = MAX(stats.jitter_us_max, late_us);
+
+	k_spin_unlock(&lock, key);
+}
+
+void diagnostics_record_missed(uint32_t missed)
+{
+	k_spinlock_key_t key = k_spin_lock(&lock);
+
+	stats.deadline_misses += missed;
+
+	k_spin_unlock(&lock, key);
+}
+
+void diagnostics_record_boot(enum diagnostics_boot_milestone milestone)
+{
+	/* Uptime 0 would read as "not reached", so start at 1 ms */
+	uint32_t now = MAX(k_uptime_get_32(), 1);
+	k_spinlock_key_t key = k_spin_lock(&lock);
+
+	if (milestone < DIAGNOSTICS_BOOT_MILESTONES && stats.boot_ms[milestone] == 0) {
+		stats.boot_ms[milestone] = now;
+	}
+
+	k_spin_unlock(&lock, key);
+}
+
+void diagnostics_record_sensor_init(void)
+{
+	k_spinlock_key_t key = k_spin_lock(&lock);
+
+	if (stats.sensor_init_attempts < UINT16_MAX) {
+		stats.sensor_init_attempts++;
+	}
+
+	k_spin_unlock(&lock, key);
+}
+
+void diagnostics_record_sensor_health(uint8_t state, uint16_t consecutive_failures,
+				      uint32_t recoveries)
+{
+	k_spinlock_key_t key = k_spin_lock(&lock);
+
+	stats.sensor_state = state;
+	stats.consecutive_failures = consecutive_failures;
+	stats.sensor_recoveries = recoveries;
+
+	k_spin_unlock(&lock, key);
+}
+
+void diagnostics_record_link(enum energy_link link, uint32_t interval_us, uint8_t phy)
+{
+	uint64_t now_us = k_ticks_to_us_floor64(k_uptime_ticks());
+	k_spinlock_key_t key = k_spin_lock(&lock);
+
+	energy_meter_set_link(&stats.meter, link, interval_us, phy, now_us);
+
+	k_spin_unlock(&lock, key);
+}
+
+void diagnostics_record_notify(size_t len)
+{
+	k_spinlock_key_t key = k_spin_lock(&lock);
+
+	energy_meter_notify(&stats.meter, len);
+
+	k_spin_unlock(&lock, key);
+}
+
+/* Non-idle CPU time since boot, summed over all threads and ISRs */
+static uint64_t cpu_active_us(void)
+{
+#if defined(CONFIG_SCHED_THREAD_USAGE_ALL)
+	k_thread_runtime_stats_t all;
+
+	if (k_thread_runtime_stats_all_get(&all) == 0) {
+		return k_cyc_to_us_floor64(all.total_cycles);
+	}
+#endif
+	return 0;
+}
+
+/* Caller holds the lock */
+static void energy_usage(struct energy_usage *usage, uint64_t now_us, uint64_t cpu_us)
+{
+	energy_meter_update(&stats.meter, now_us);
+
+	usage->elapsed_us = now_us;
+	usage->ranging_us = stats.ranging_us_sum;
+	usage->cpu_active_us = cpu_us;
+	usage->radio_tx_us = stats.meter.tx_us;
+	usage->radio_rx_us = stats.meter.rx_us;
+}
+
+void diagnostics_energy(struct energy_usage *usage)
+{
+	/* Kernel usage stats take their own lock, so read them first */
+	uint64_t cpu_us = cpu_active_us();
+	uint64_t now_us = k_ticks_to_us_floor64(k_uptime_ticks());
+	k_spinlock_key_t key = k_spin_lock(&lock);
+
+	energy_usage(usage, now_us, cpu_us);
+
+	k_spin_unlock(&lock, key);
+}
+
+static uint16_t sat_u16(uint64_t v)
+{
+	return (uint16_t)MIN(v, UINT16_MAX);
+}
+
+static uint32_t us_to_ms(uint64_t us)
+{
+	return (uint32_t)MIN(us / USEC_PER_MSEC, UINT32_MAX);
+}
+
+void diagnostics_snapshot(struct diagnostics_payload *out)
+{
+	struct energy_usage usage;
+	uint64_t cpu_us = cpu_active_us();
+	uint64_t now_us = k_ticks_to_us_floor64(k_uptime_ticks());
+	k_spinlock_key_t key = k_spin_lock(&lock);
+	uint32_t reads = stats.samples + stats.read_errors;
+
+	out->version = DIAGNOSTICS_VERSION;
+	out->read_path = IS_ENABLED(CONFIG_RANGE_SENSOR_ASYNC) ? DIAGNOSTICS_READ_PATH_ASYNC
+							       : DIAGNOSTICS_READ_PATH_SYNC;
+	out->samples = sys_cpu_to_le32(stats.samples);
+	out->read_errors = sys_cpu_to_le32(stats.read_errors);
+	out->read_busy_us_avg = sys_cpu_to_le16(sat_u16(reads ? stats.busy_us_sum / reads : 0));
+	out->read_busy_us_max = sys_cpu_to_le16(sat_u16(stats.busy_us_max));
+	out->read_wall_us_avg = sys_cpu_to_le16(sat_u16(reads ? stats.wall_us_sum / reads : 0));
+	out->read_wall_us_max = sys_cpu_to_le16(sat_u16(stats.wall_us_max));
+
+	for (size_t i = 0; i < DIAGNOSTICS_JITTER_BINS; i++) {
+		out->jitter_hist[i] = sys_cpu_to_le16(stats.jitter_hist[i]);
+	}
+	out->jitter_us_max = sys_cpu_to_le16(sat_u16(stats.jitter_us_max));
+	out->deadline_misses = sys_cpu_to_le32(stats.deadline_misses);
+
+	for (size_t i = 0; i < DIAGNOSTICS_BOOT_MILESTONES; i++) {
+		out->boot_ms[i] = sys_cpu_to_le32(stats.boot_ms[i]);
+	}
+	out->sensor_init_attempts = sys_cpu_to_le16(stats.sensor_init_attempts);
+	out->sensor_state = stats.sensor_state;
+	out->consecutive_failures = sys_cpu_to_le16(stats.consecutive_failures);
+	out->sensor_recoveries = sys_cpu_to_le32(stats.sensor_recoveries);
+
+	energy_usage(&usage, now_us, cpu_us);
+	out->uptime_ms = sys_cpu_to_le32(us_to_ms(usage.elapsed_us));
+	out->ranging_ms = sys_cpu_to_le32(us_to_ms(usage.ranging_us));
+	out->cpu_active_ms = sys_cpu_to_le32(us_to_ms(usage.cpu_active_us));
+	out->radio_tx_ms = sys_cpu_to_le32(us_to_ms(usage.radio_tx_us));
+	out->radio_rx_ms = sys_cpu_to_le32(us_to_ms(usage.radio_rx_us));
+	out->avg_current_ua = sys_cpu_to_le32(energy_average_ua(&usage));
+
+	k_spin_unlock(&lock, key);
+}
@@ -0,0 +1,147 @@
+#ifndef DIAGNOSTICS_H
+#define DIAGNOSTICS_H
+
+#include <stdbool.h>
+#include <zephyr/types.h>
+
+#include "energy.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Bumped whenever fields are appended to struct diagnostics_payload */
+#define DIAGNOSTICS_VERSION 5
+
+/* Which sensor read path the firmware was built with */
+#define DIAGNOSTICS_READ_PATH_SYNC 0
+#define DIAGNOSTICS_READ_PATH_ASYNC 1
+
+/*
+ * Sampling jitter histogram: bin i counts wakeups that were at most
+ * DIAGNOSTICS_JITTER_EDGES_US[i] late; the last bin catches the rest.
+ */
+#define DIAGNOSTICS_JITTER_EDGES_US {50, 100, 250, 500, 1000, 2500, 5000}
+#define DIAGNOSTICS_JITTER_BINS 8
+
+/* Boot milestones, stamped with uptime in ms the first time each is reached */
+enum diagnostics_boot_milestone {
+	DIAGNOSTICS_BOOT_BT_READY,     /* bt_enable() returned */
+	DIAGNOSTICS_BOOT_ADVERTISING,  /* connectable advertising started */
+	DIAGNOSTICS_BOOT_SENSOR_READY, /* VL53L0X answered a probe read */
+	DIAGNOSTICS_BOOT_FIRST_SAMPLE, /* first successful read */
+	DIAGNOSTICS_BOOT_MILESTONES,
+};
+
+/*
+ * Diagnostics characteristic payload (little-endian). Fields are only
+ * ever appended; hosts should check version and ignore trailing bytes.
+ */
+struct diagnostics_payload {
+	uint8_t version;	   /* DIAGNOSTICS_VERSION */
+	uint8_t read_path;	   /* DIAGNOSTICS_READ_PATH_* */
+	uint32_t samples;	   /* successful sensor reads */
+	uint32_t read_errors;	   /* failed sensor reads */
+	uint16_t read_busy_us_avg; /* sensor thread CPU time per read */
+	uint16_t read_busy_us_max;
+	uint16_t read_wall_us_avg; /* start to result, wall clock */
+	uint16_t read_wall_us_max;
+	/* version 2 */
+	uint16_t jitter_hist[DIAGNOSTICS_JITTER_BINS]; /* counts, saturating */
+	uint16_t jitter_us_max;			       /* worst wakeup lateness */
+	uint32_t deadline_misses;		       /* sample slots skipped */
+	/* version 3 */
+	uint32_t boot_ms[DIAGNOSTICS_BOOT_MILESTONES]; /* 0 = not reached yet */
+	uint16_t sensor_init_attempts;		       /* sensor bring-up tries */
+	/* version 4 */
+	uint8_t sensor_state;	       /* SENSOR_HEALTH_* */
+	uint16_t consecutive_failures; /* failed reads in a row, saturating */
+	uint32_t sensor_recoveries;    /* bus clears and sensor re-inits */
+	/* version 5: energy accounting since boot (see energy.h) */
+	uint32_t uptime_ms;
+	uint32_t ranging_ms;	 /* VL53L0X ranging (successful reads) */
+	uint32_t cpu_active_ms;	 /* all threads and ISRs except idle */
+	uint32_t radio_tx_ms;	 /* estimated from the link state */
+	uint32_t radio_rx_ms;
+	uint32_t avg_current_ua; /* estimate, uAh per hour */
+} __packed;
+
+/**
+ * @brief Record the cost of one sensor read.
+ * @param ok Whether the read produced a sample.
+ * @param busy_us CPU time the reading thread spent, in microseconds.
+ * @param wall_us Wall-clock time from start to result, in microseconds.
+ */
+void diagnostics_record_read(bool ok, uint32_t busy_us, uint32_t wall_us);
+
+/**
+ * @brief Record how late the sensor thread woke for a sampling deadline.
+ * @param late_us Wakeup time minus the scheduled deadline, in microseconds.
+ */
+void diagnostics_record_wakeup(uint32_t late_us);
+
+/**
+ * @brief Count sample slots skipped because a read overran its period.
+ *
+ * Skipped slots have no wakeup, so they are kept out of the jitter
+ * histogram.
+ *
+ * @param missed Number of whole sample slots skipped.
+ */
+void diagnostics_record_missed(uint32_t missed);
+
+/**
+ * @brief Stamp a boot milestone with the current uptime.
+ *
+ * Only the first call for each milestone counts, so it is safe to call
+ * again on a later re-init.
+ *
+ * @param milestone DIAGNOSTICS_BOOT_*
+ */
+void diagnostics_record_boot(enum diagnostics_boot_milestone milestone);
+
+/**
+ * @brief Count one attempt at bringing up the range sensor.
+ */
+void diagnostics_record_sensor_init(void);
+
+/**
+ * @brief Record the sensor fault state after a read or skipped slot.
+ * @param state SENSOR_HEALTH_*
+ * @param consecutive_failures Failed reads in a row.
+ * @param recoveries Recoveries attempted since boot.
+ */
+void diagnostics_record_sensor_health(uint8_t state, uint16_t consecutive_failures,
+				      uint32_t recoveries);
+
+/**
+ * @brief Record a change of radio link state for energy accounting.
+ * @param link ENERGY_LINK_*
+ * @param interval_us Advertising or connection interval.
+ * @param phy 1 or 2 (Mbit/s).
+ */
+void diagnostics_record_link(enum energy_link link, uint32_t interval_us, uint8_t phy);
+
+/**
+ * @brief Record one notification (or L2CAP SDU) handed to the stack.
+ * @param len Payload length in bytes.
+ */
+void diagnostics_record_notify(size_t len);
+
+/**
+ * @brief Active times since boot for energy accounting.
+ * @param usage Filled in with uptime, ranging, CPU and radio times.
+ */
+void diagnostics_energy(struct energy_usage *usage);
+
+/**
+ * @brief Fill in a consistent snapshot of all diagnostics counters.
+ * @param out Payload to fill, already in wire byte order.
+ */
+void diagnostics_snapshot(struct diagnostics_payload *out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* DIAGNOSTICS_H */
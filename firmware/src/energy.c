@@ -0,0 +1,87 @@
+#include "energy.h"
+
+#include <string.h>
+#include <zephyr/sys/util.h>
+
+/* Airtime of len bytes on the given PHY */
+static uint32_t bytes_us(size_t len, uint8_t phy)
+{
+	return (uint32_t)(len * 8 / (phy == 2 ? 2 : 1));
+}
+
+/* Airtime of one event in the current link state */
+static void event_airtime(const struct energy_meter *meter, uint32_t *tx_us, uint32_t *rx_us)
+{
+	uint32_t empty_us = ENERGY_RADIO_RAMP_US + bytes_us(ENERGY_LL_OVERHEAD_BYTES, meter->phy);
+
+	if (meter->link == ENERGY_LINK_CONNECTED) {
+		/* Central's packet in, our (empty) packet out */
+		*tx_us = empty_us;
+		*rx_us = empty_us;
+	} else {
+		/* ADV_IND on each of the three channels, listening after each */
+		*tx_us = 3 * (ENERGY_RADIO_RAMP_US +
+			      bytes_us(ENERGY_LL_OVERHEAD_BYTES + ENERGY_ADV_PAYLOAD_BYTES, 1));
+		*rx_us = 3 * ENERGY_ADV_RX_WINDOW_US;
+	}
+}
+
+void energy_meter_init(struct energy_meter *meter, uint64_t now_us)
+{
+	memset(meter, 0, sizeof(*meter));
+	meter->phy = 1;
+	meter->since_us = now_us;
+}
+
+void energy_meter_update(struct energy_meter *meter, uint64_t now_us)
+{
+	uint32_t tx_us, rx_us;
+
+	if (meter->link == ENERGY_LINK_IDLE || meter->interval_us == 0 ||
+	    now_us < meter->since_us + meter->interval_us) {
+		return;
+	}
+
+	/* Keep the remainder so frequent updates don't lose partial events */
+	uint64_t events = (now_us - meter->since_us) / meter->interval_us;
+
+	event_airtime(meter, &tx_us, &rx_us);
+	meter->tx_us += events * tx_us;
+	meter->rx_us += events * rx_us;
+	meter->events += events;
+	meter->since_us += events * meter->interval_us;
+}
+
+void energy_meter_set_link(struct energy_meter *meter, enum energy_link link,
+			   uint32_t interval_us, uint8_t phy, uint64_t now_us)
+{
+	energy_meter_update(meter, now_us);
+
+	/* A new state starts its own event timeline */
+	meter->link = link;
+	meter->interval_us = interval_us;
+	meter->phy = phy == 2 ? 2 : 1;
+	meter->since_us = now_us;
+}
+
+void energy_meter_notify(struct energy_meter *meter, size_t len)
+{
+	/* Rides in a connection event that is already counted; the ack comes back empty */
+	meter->tx_us += bytes_us(len + ENERGY_NOTIFY_HEADER_BYTES, meter->phy);
+}
+
+uint32_t energy_average_ua(const struct energy_usage *usage)
+{
+	if (usage->elapsed_us == 0) {
+		return 0;
+	}
+
+	/* Charge in uA*us; the sums stay far below 2^64 for any real uptime */
+	uint64_t charge = (uint64_t)ENERGY_BOARD_IDLE_UA * usage->elapsed_us +
+			  (uint64_t)ENERGY_SENSOR_RANGING_UA * usage->ranging_us +
+			  (uint64_t)ENERGY_CPU_ACTIVE_UA * usage->cpu_active_us +
+			  (uint64_t)ENERGY_RADIO_TX_UA * usage->radio_tx_us +
+			  (uint64_t)ENERGY_RADIO_RX_UA * usage->radio_rx_us;
+
+	return (uint32_t)MIN(charge / usage->elapsed_us, UINT32_MAX);
+}
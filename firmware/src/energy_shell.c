@@ -0,0 +1,44 @@
+/*
+ * "energy" shell command: where the battery is going, measured since boot
+ */
+
+#include <zephyr/shell/shell.h>
+#include <zephyr/sys/util.h>
+
+#include "diagnostics.h"
+#include "energy.h"
+
+/* Whole and tenth seconds of a microsecond count, with its share of uptime */
+static void print_time(const struct shell *sh, const char *name, uint64_t us, uint64_t total_us)
+{
+	uint64_t ds = us / (USEC_PER_SEC / 10);
+
+	shell_print(sh, "%-12s %6u.%u s  %3u%%", name, (uint32_t)(ds / 10), (uint32_t)(ds % 10),
+		    total_us ? (uint32_t)(us * 100 / total_us) : 0);
+}
+
+static int cmd_energy(const struct shell *sh, size_t argc, char **argv)
+{
+	struct energy_usage usage;
+
+	ARG_UNUSED(argc);
+	ARG_UNUSED(argv);
+
+	diagnostics_energy(&usage);
+
+	uint32_t avg_ua = energy_average_ua(&usage);
+
+	print_time(sh, "uptime", usage.elapsed_us, usage.elapsed_us);
+	print_time(sh, "ranging", usage.ranging_us, usage.elapsed_us);
+	print_time(sh, "cpu active", usage.cpu_active_us, usage.elapsed_us);
+	print_time(sh, "cpu idle", usage.elapsed_us - MIN(usage.cpu_active_us, usage.elapsed_us),
+		   usage.elapsed_us);
+	print_time(sh, "radio tx", usage.radio_tx_us, usage.elapsed_us);
+	print_time(sh, "radio rx", usage.radio_rx_us, usage.elapsed_us);
+	shell_print(sh, "%-12s %6u uA (%u.%02u mAh per hour, estimated)", "average", avg_ua,
+		    avg_ua / 1000, avg_ua % 1000 / 10);
+	return 0;
+}
+
+SHELL_CMD_REGISTER(energy, NULL, "Active times and estimated average current since boot",
+		   cmd_energy);
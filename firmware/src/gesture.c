@@ -0,0 +1,208 @@
+#include "gesture.h"
+
+#include <string.h>
+#include <zephyr/sys/util.h>
+
+/* Distances are smoothed in 1/16 mm so slow drifts aren't rounded away */
+#define MM16(mm) ((int32_t)(mm) * 16)
+#define MM(mm16) ((mm16) / 16)
+
+void gesture_init(struct gesture_engine *eng)
+{
+	memset(eng, 0, sizeof(*eng));
+	eng->approach_armed = true;
+	eng->withdraw_armed = true;
+}
+
+bool gesture_params_valid(const struct gesture_params *params)
+{
+	return params->near_mm > 0 && params->tap_max_ms > 0 && params->hold_ms > 0 &&
+	       params->approach_speed_mm_s > 0 && params->withdraw_speed_mm_s > 0 &&
+	       params->stroke_amplitude_mm > 0 && params->stroke_window_ms > 0 &&
+	       params->stroke_min_count > 0;
+}
+
+static struct gesture_event *emit(const struct gesture_engine *eng, struct gesture_event *events,
+				  size_t *count, enum gesture_type type, uint32_t now_ms)
+{
+	struct gesture_event *evt = &events[*count];
+
+	(*count)++;
+	evt->type = type;
+	evt->count = 0;
+	evt->distance_mm = (uint16_t)CLAMP(MM(eng->filtered_mm16), 0, UINT16_MAX);
+	evt->velocity_mm_s = (int16_t)CLAMP(eng->velocity_mm_s, INT16_MIN, INT16_MAX);
+	evt->duration_ms = 0;
+	evt->timestamp_ms = now_ms;
+	return evt;
+}
+
+/* A streak with at least one full stroke is still inside its window */
+static bool stroking(const struct gesture_engine *eng, const struct gesture_params *params,
+		     uint32_t now_ms)
+{
+	return eng->half_strokes >= 2 && now_ms - eng->last_reversal_ms <= params->stroke_window_ms;
+}
+
+/*
+ * Tap and hold: both key off visits to the near zone. Strokes that dip
+ * into the zone are reported as strokes, not as a string of taps.
+ */
+static void update_near(struct gesture_engine *eng, const struct gesture_params *params,
+			uint32_t now_ms, struct gesture_event *events, size_t *count)
+{
+	bool near = MM(eng->filtered_mm16) < params->near_mm;
+
+	if (near && !eng->near) {
+		eng->near_since_ms = now_ms;
+		eng->still_since_ms = now_ms;
+		eng->hold_reported = false;
+	} else if (!near && eng->near) {
+		uint32_t visit_ms = now_ms - eng->near_since_ms;
+
+		if (!eng->hold_reported && visit_ms <= params->tap_max_ms &&
+		    !stroking(eng, params, now_ms)) {
+			struct gesture_event *evt = emit(eng, events, count, GESTURE_TAP, now_ms);
+
+			evt->duration_ms = (uint16_t)visit_ms;
+		}
+	}
+	eng->near = near;
+
+	if (!near || eng->hold_reported) {
+		return;
+	}
+
+	if ((uint32_t)ABS(eng->velocity_mm_s) > params->hold_max_speed_mm_s) {
+		eng->still_since_ms = now_ms;
+	} else if (now_ms - eng->still_since_ms >= params->hold_ms) {
+		struct gesture_event *evt = emit(eng, events, count, GESTURE_HOLD, now_ms);
+
+		evt->duration_ms = (uint16_t)MIN(now_ms - eng->near_since_ms, UINT16_MAX);
+		eng->hold_reported = true;
+	}
+}
+
+/* Fast approach / withdraw: edge-triggered with 50% hysteresis to re-arm */
+static void update_speed(struct gesture_engine *eng, const struct gesture_params *params,
+			 uint32_t now_ms, struct gesture_event *events, size_t *count)
+{
+	int32_t v = eng->velocity_mm_s;
+
+	if (eng->approach_armed && v <= -(int32_t)params->approach_speed_mm_s) {
+		emit(eng, events, count, GESTURE_APPROACH, now_ms);
+		eng->approach_armed = false;
+	} else if (!eng->approach_armed && v > -(int32_t)params->approach_speed_mm_s / 2) {
+		eng->approach_armed = true;
+	}
+
+	if (eng->withdraw_armed && v >= (int32_t)params->withdraw_speed_mm_s) {
+		emit(eng, events, count, GESTURE_WITHDRAW, now_ms);
+		eng->withdraw_armed = false;
+	} else if (!eng->withdraw_armed && v < (int32_t)params->withdraw_speed_mm_s / 2) {
+		eng->withdraw_armed = true;
+	}
+}
+
+/*
+ * Repeated strokes: zig-zag detection on the smoothed distance. A
+ * reversal is a turn after at least stroke_amplitude_mm of travel; two
+ * reversals make one stroke. Reversals further apart than
+ * stroke_window_ms start a new streak.
+ */
+static void update_strokes(struct gesture_engine *eng, const struct gesture_params *params,
+			   uint32_t now_ms, struct gesture_event *events, size_t *count)
+{
+	int32_t mm = MM(eng->filtered_mm16);
+	int32_t amp = params->stroke_amplitude_mm;
+	bool reversed = false;
+
+	if (eng->stroke_dir == 0) {
+		if (ABS(mm - eng->stroke_extreme_mm) >= amp) {
+			eng->stroke_dir = mm > eng->stroke_extreme_mm ? 1 : -1;
+			eng->stroke_extreme_mm = mm;
+		}
+	} else if (eng->stroke_dir > 0) {
+		if (mm > eng->stroke_extreme_mm) {
+			eng->stroke_extreme_mm = mm;
+		} else if (eng->stroke_extreme_mm - mm >= amp) {
+			reversed = true;
+		}
+	} else {
+		if (mm < eng->stroke_extreme_mm) {
+			eng->stroke_extreme_mm = mm;
+		} else if (mm - eng->stroke_extreme_mm >= amp) {
+			reversed = true;
+		}
+	}
+
+	if (!reversed) {
+		return;
+	}
+
+	eng->stroke_dir = -eng->stroke_dir;
+	eng->stroke_extreme_mm = mm;
+
+	if (eng->half_strokes > 0 && now_ms - eng->last_reversal_ms > params->stroke_window_ms) {
+		eng->half_strokes = 0;
+	}
+	if (eng->half_strokes == 0) {
+		eng->last_stroke_ms = now_ms;
+	}
+	eng->half_strokes++;
+	eng->last_reversal_ms = now_ms;
+
+	if (eng->half_strokes % 2 != 0) {
+		return;
+	}
+
+	uint16_t strokes = eng->half_strokes / 2;
+
+	if (strokes >= params->stroke_min_count) {
+		struct gesture_event *evt = emit(eng, events, count, GESTURE_STROKE, now_ms);
+
+		evt->count = (uint8_t)MIN(strokes, UINT8_MAX);
+		evt->duration_ms = (uint16_t)MIN(now_ms - eng->last_stroke_ms, UINT16_MAX);
+	}
+	eng->last_stroke_ms = now_ms;
+}
+
+size_t gesture_update(struct gesture_engine *eng, const struct gesture_params *params,
+		      uint16_t distance_mm, uint32_t timestamp_ms, struct gesture_event *events)
+{
+	size_t count = 0;
+
+	if (!eng->primed) {
+		eng->primed = true;
+		eng->last_ms = timestamp_ms;
+		eng->filtered_mm16 = MM16(distance_mm);
+		eng->stroke_extreme_mm = distance_mm;
+		eng->near = distance_mm < params->near_mm;
+		eng->near_since_ms = timestamp_ms;
+		eng->still_since_ms = timestamp_ms;
+		return 0;
+	}
+
+	uint32_t dt_ms = timestamp_ms - eng->last_ms;
+
+	if (dt_ms == 0) {
+		return 0;
+	}
+	eng->last_ms = timestamp_ms;
+
+	/* Same EMA convention as the middleware: weight on the previous value */
+	int32_t prev_mm16 = eng->filtered_mm16;
+	int32_t s = params->smoothing_q8;
+
+	eng->filtered_mm16 = (prev_mm16 * s + MM16(distance_mm) * (256 - s)) / 256;
+
+	int32_t raw_v = (eng->filtered_mm16 - prev_mm16) * 1000 / (int32_t)dt_ms / 16;
+
+	eng->velocity_mm_s = (eng->velocity_mm_s * s + raw_v * (256 - s)) / 256;
+
+	update_near(eng, params, timestamp_ms, events, &count);
+	update_speed(eng, params, timestamp_ms, events, &count);
+	update_strokes(eng, params, timestamp_ms, events, &count);
+
+	return count;
+}
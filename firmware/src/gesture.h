@@ -0,0 +1,115 @@
+#ifndef GESTURE_H
+#define GESTURE_H
+
+#include <stddef.h>
+#include <zephyr/types.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * On-device gesture recognition
+ *
+ * Runs on the (clamped) range stream, keeps its own smoothed distance and
+ * velocity, and reports discrete gestures the moment they are detected.
+ * Pure logic with no kernel dependencies, so it runs unchanged on
+ * native_sim against recorded traces.
+ */
+
+enum gesture_type {
+	GESTURE_NONE = 0,
+	GESTURE_TAP = 1,      /* quick dip into the near zone and back out */
+	GESTURE_HOLD = 2,     /* stayed still in the near zone for hold_ms */
+	GESTURE_APPROACH = 3, /* moving towards the sensor faster than approach_speed */
+	GESTURE_WITHDRAW = 4, /* moving away faster than withdraw_speed */
+	GESTURE_STROKE = 5,   /* one more back-and-forth in a repeated stroke streak */
+};
+
+/* Tunables, also the wire format of the gesture characteristic (LE) */
+struct gesture_params {
+	uint16_t near_mm;	      /* tap/hold zone: closer than this */
+	uint16_t tap_max_ms;	      /* longest near-zone visit that counts as a tap */
+	uint16_t hold_ms;	      /* time still in the near zone before a hold */
+	uint16_t hold_max_speed_mm_s; /* faster than this restarts the hold timer */
+	uint16_t approach_speed_mm_s;
+	uint16_t withdraw_speed_mm_s;
+	uint16_t stroke_amplitude_mm; /* minimum travel between stroke reversals */
+	uint16_t stroke_window_ms;    /* max gap between reversals in a streak */
+	uint8_t stroke_min_count;     /* strokes in a streak before reporting */
+	uint8_t smoothing_q8;	      /* EMA: 0 = none, 255 = heaviest */
+} __packed;
+
+#define GESTURE_PARAMS_DEFAULT                                                                     \
+	{                                                                                          \
+		.near_mm = 120, .tap_max_ms = 300, .hold_ms = 800, .hold_max_speed_mm_s = 100,     \
+		.approach_speed_mm_s = 600, .withdraw_speed_mm_s = 600,                            \
+		.stroke_amplitude_mm = 40, .stroke_window_ms = 1000, .stroke_min_count = 2,        \
+		.smoothing_q8 = 128,                                                               \
+	}
+
+/* One detected gesture, also the gesture notification payload (LE) */
+struct gesture_event {
+	uint8_t type;	       /* enum gesture_type */
+	uint8_t count;	       /* strokes in the streak (GESTURE_STROKE), else 0 */
+	uint16_t distance_mm;  /* smoothed distance at detection */
+	int16_t velocity_mm_s; /* smoothed velocity, negative = approaching */
+	uint16_t duration_ms;  /* near-zone time (tap/hold) or stroke period */
+	uint32_t timestamp_ms; /* sample timestamp the gesture was detected on */
+} __packed;
+
+/* Most events a single sample can produce */
+#define GESTURE_MAX_EVENTS 4
+
+/* Engine state; treat as opaque */
+struct gesture_engine {
+	bool primed;
+	uint32_t last_ms;
+	int32_t filtered_mm16; /* smoothed distance, mm * 16 */
+	int32_t velocity_mm_s; /* smoothed velocity */
+	/* near zone */
+	bool near;
+	uint32_t near_since_ms;
+	uint32_t still_since_ms;
+	bool hold_reported;
+	/* speed edges */
+	bool approach_armed;
+	bool withdraw_armed;
+	/* strokes */
+	int8_t stroke_dir;
+	int32_t stroke_extreme_mm;
+	uint16_t half_strokes;
+	uint32_t last_reversal_ms;
+	uint32_t last_stroke_ms;
+};
+
+/**
+ * @brief Reset the engine to its initial state.
+ * @param eng Engine to reset.
+ */
+void gesture_init(struct gesture_engine *eng);
+
+/**
+ * @brief Feed one range sample and collect any gestures it completes.
+ * @param eng Engine state.
+ * @param params Tunables; may change between calls.
+ * @param distance_mm Range sample, already clamped to the active window.
+ * @param timestamp_ms Monotonic sample time in milliseconds.
+ * @param events Output array with room for GESTURE_MAX_EVENTS.
+ * @return Number of events written to @p events.
+ */
+size_t gesture_update(struct gesture_engine *eng, const struct gesture_params *params,
+		      uint16_t distance_mm, uint32_t timestamp_ms, struct gesture_event *events);
+
+/**
+ * @brief Check a parameter set for values the engine can't work with.
+ * @param params Parameters to check.
+ * @return true if usable.
+ */
+bool gesture_params_valid(const struct gesture_params *params);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* GESTURE_H */
@@ -0,0 +1,68 @@
+#include "intensity_map.h"
+
+#include <zephyr/sys/util.h>
+
+/* 1.0 in Q16 */
+#define Q16_ONE (1U << 16)
+
+/* 0-255 byte to Q16, rounded */
+static uint32_t byte_to_q16(uint8_t v)
+{
+	return ((uint32_t)v * Q16_ONE + 127) / 255;
+}
+
+void intensity_map_init(struct intensity_map *map)
+{
+	map->initialized = false;
+	map->smoothed_q16 = 0;
+}
+
+bool intensity_map_config_valid(const struct intensity_map_config *cfg)
+{
+	return cfg->min_range_mm < cfg->max_range_mm;
+}
+
+static uint32_t apply_smoothing(struct intensity_map *map, const struct intensity_map_config *cfg,
+				uint32_t raw_q16)
+{
+	if (!map->initialized) {
+		map->smoothed_q16 = raw_q16;
+		map->initialized = true;
+		return raw_q16;
+	}
+
+	uint64_t alpha = byte_to_q16(cfg->smoothing);
+
+	map->smoothed_q16 = (uint32_t)((alpha * map->smoothed_q16 +
+					(Q16_ONE - alpha) * (uint64_t)raw_q16 + Q16_ONE / 2) >>
+				       16);
+	return map->smoothed_q16;
+}
+
+uint8_t intensity_map_apply(struct intensity_map *map, const struct intensity_map_config *cfg,
+			    uint16_t distance_mm)
+{
+	uint32_t raw_q16;
+
+	if (cfg->deadzone_mm > 0 && distance_mm > cfg->deadzone_mm) {
+		raw_q16 = 0;
+	} else {
+		uint16_t clamped = CLAMP(distance_mm, cfg->min_range_mm, cfg->max_range_mm);
+		uint32_t span = cfg->max_range_mm - cfg->min_range_mm;
+		uint32_t normalized =
+			span > 0 ? ((uint32_t)(clamped - cfg->min_range_mm) * Q16_ONE + span / 2) / span
+				 : 0;
+		uint32_t directed = cfg->invert ? Q16_ONE - normalized : normalized;
+
+		/* The intensity window may be inverted (min > max), so work signed */
+		int64_t lo = byte_to_q16(cfg->min_intensity);
+		int64_t hi = byte_to_q16(cfg->max_intensity);
+		int64_t scaled = lo + ((int64_t)directed * (hi - lo)) / (int64_t)Q16_ONE;
+
+		raw_q16 = (uint32_t)CLAMP(scaled, 0, (int64_t)Q16_ONE);
+	}
+
+	uint32_t out_q16 = apply_smoothing(map, cfg, raw_q16);
+
+	return (uint8_t)MIN((out_q16 * 255 + Q16_ONE / 2) >> 16, 255);
+}
@@ -0,0 +1,71 @@
+#ifndef INTENSITY_MAP_H
+#define INTENSITY_MAP_H
+
+#include <zephyr/types.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * On-device intensity mapping
+ *
+ * Fixed-point port of RangeMapper::map in middleware/src/mapper.rs:
+ * range window, invert, intensity window, deadzone and EMA smoothing.
+ * Intensities and smoothing are carried as 0-255 for 0.0-1.0, and the
+ * result is quantized to one byte. Keep the two in step; the parity
+ * vectors in firmware/tests/intensity_map are checked on both sides.
+ */
+
+/* Mapping parameters, also the wire format of the mapping characteristic (LE) */
+struct intensity_map_config {
+	uint8_t invert;	       /* 1 = closer is more intense */
+	uint16_t min_range_mm; /* active zone */
+	uint16_t max_range_mm;
+	uint16_t deadzone_mm;  /* beyond this intensity is 0 (0 = disabled) */
+	uint8_t min_intensity; /* 0-255 = 0.0-1.0 */
+	uint8_t max_intensity;
+	uint8_t smoothing; /* EMA weight on the previous value, 0-255 = 0.0-1.0 */
+} __packed;
+
+/* Matches the middleware's default [mapping] section */
+#define INTENSITY_MAP_CONFIG_DEFAULT                                                               \
+	{                                                                                          \
+		.invert = 1, .min_range_mm = 30, .max_range_mm = 300, .deadzone_mm = 500,          \
+		.min_intensity = 0, .max_intensity = 255, .smoothing = 77,                         \
+	}
+
+/* Mapper state; treat as opaque */
+struct intensity_map {
+	bool initialized;
+	uint32_t smoothed_q16; /* 0..65536 = 0.0..1.0 */
+};
+
+/**
+ * @brief Reset the mapper so the next sample is passed through unsmoothed.
+ * @param map Mapper state.
+ */
+void intensity_map_init(struct intensity_map *map);
+
+/**
+ * @brief Map one distance to a quantized intensity.
+ * @param map Mapper state (smoothing history).
+ * @param cfg Mapping parameters; may change between calls.
+ * @param distance_mm Range sample.
+ * @return Intensity, 0-255 for 0.0-1.0.
+ */
+uint8_t intensity_map_apply(struct intensity_map *map, const struct intensity_map_config *cfg,
+			    uint16_t distance_mm);
+
+/**
+ * @brief Check mapping parameters (same rules as the middleware's Config).
+ * @param cfg Parameters to check.
+ * @return true if usable.
+ */
+bool intensity_map_config_valid(const struct intensity_map_config *cfg);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* INTENSITY_MAP_H */
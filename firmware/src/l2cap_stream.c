@@ -0,0 +1,151 @@
+#include "l2cap_stream.h"
+
+#include <errno.h>
+#include <zephyr/bluetooth/l2cap.h>
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/net/buf.h>
+#include <zephyr/sys/atomic.h>
+#include <zephyr/sys/byteorder.h>
+
+#include "diagnostics.h"
+
+LOG_MODULE_REGISTER(l2cap_stream, LOG_LEVEL_INF);
+
+NET_BUF_POOL_FIXED_DEFINE(sdu_pool, CONFIG_RANGE_L2CAP_STREAM_BUFS,
+			  BT_L2CAP_SDU_BUF_SIZE(L2CAP_STREAM_SDU_LEN), CONFIG_BT_CONN_TX_USER_DATA_SIZE,
+			  NULL);
+
+static struct bt_l2cap_le_chan stream_chan;
+static atomic_t stream_connected;
+
+/* SDU being filled (sensor thread only) */
+static struct net_buf *pending;
+static uint8_t pending_count;
+static uint8_t pending_max;
+static uint32_t pending_t0_ms;
+static uint16_t next_seq;
+
+static void stream_connected_cb(struct bt_l2cap_chan *chan)
+{
+	atomic_set(&stream_connected, 1);
+	LOG_INF("Stream channel connected (tx mtu %u, %u credits)", stream_chan.tx.mtu,
+		(unsigned int)atomic_get(&stream_chan.tx.credits));
+}
+
+static void stream_disconnected_cb(struct bt_l2cap_chan *chan)
+{
+	atomic_set(&stream_connected, 0);
+	LOG_INF("Stream channel disconnected");
+}
+
+static int stream_recv_cb(struct bt_l2cap_chan *chan, struct net_buf *buf)
+{
+	/* One-way channel; anything the host sends is ignored */
+	return 0;
+}
+
+static const struct bt_l2cap_chan_ops stream_ops = {
+    .connected = stream_connected_cb,
+    .disconnected = stream_disconnected_cb,
+    .recv = stream_recv_cb,
+};
+
+static int stream_accept(struct bt_conn *conn, struct bt_l2cap_server *server,
+			 struct bt_l2cap_chan **chan)
+{
+	if (stream_chan.chan.conn) {
+		LOG_WRN("Stream channel already in use");
+		return -ENOMEM;
+	}
+
+	memset(&stream_chan, 0, sizeof(stream_chan));
+	stream_chan.chan.ops = &stream_ops;
+	stream_chan.rx.mtu = L2CAP_STREAM_SDU_LEN;
+	*chan = &stream_chan.chan;
+
+	return 0;
+}
+
+static struct bt_l2cap_server stream_server = {
+    .psm = CONFIG_RANGE_L2CAP_STREAM_PSM,
+    .sec_level = BT_SECURITY_L1,
+    .accept = stream_accept,
+};
+
+int l2cap_stream_init(void)
+{
+	int err = bt_l2cap_server_register(&stream_server);
+
+	if (err) {
+		LOG_ERR("L2CAP server register failed (err %d)", err);
+		return err;
+	}
+
+	LOG_INF("Raw stream on L2CAP PSM 0x%02x", CONFIG_RANGE_L2CAP_STREAM_PSM);
+	return 0;
+}
+
+static void send_pending(void)
+{
+	struct net_buf *buf = pending;
+	size_t len = buf->len;
+
+	pending = NULL;
+	buf->data[1] = pending_count;
+
+	/* Queued by the stack until the host grants credits */
+	int err = bt_l2cap_chan_send(&stream_chan.chan, buf);
+
+	if (err < 0) {
+		LOG_DBG("Stream send failed (err %d)", err);
+		net_buf_unref(buf);
+	} else {
+		diagnostics_record_notify(len);
+	}
+}
+
+void l2cap_stream_push(const struct range_sample *sample)
+{
+	uint16_t seq = next_seq++;
+
+	if (!atomic_get(&stream_connected)) {
+		if (pending) {
+			net_buf_unref(pending);
+			pending = NULL;
+		}
+		return;
+	}
+
+	if (!pending) {
+		/* Every buffer waiting for credits: drop, the host sees the seq gap */
+		pending = net_buf_alloc(&sdu_pool, K_NO_WAIT);
+		if (!pending) {
+			LOG_DBG("Stream backpressure, sample %u dropped", seq);
+			return;
+		}
+
+		net_buf_reserve(pending, BT_L2CAP_SDU_CHAN_SEND_RESERVE);
+		net_buf_add_u8(pending, L2CAP_STREAM_VERSION);
+		net_buf_add_u8(pending, 0);
+		pending_count = 0;
+		pending_max = MIN(L2CAP_STREAM_MAX_RECORDS,
+				  (stream_chan.tx.mtu - 2) / sizeof(struct l2cap_stream_record));
+		pending_t0_ms = sample->timestamp_ms;
+	}
+
+	struct l2cap_stream_record *rec = net_buf_add(pending, sizeof(*rec));
+
+	rec->seq = sys_cpu_to_le16(seq);
+	rec->timestamp_ms = sys_cpu_to_le32(sample->timestamp_ms);
+	rec->distance_mm = sys_cpu_to_le16(sample->distance_mm);
+	rec->range_status = sample->range_status;
+	rec->signal_rate_kcps = sys_cpu_to_le16(sample->signal_rate_kcps);
+	rec->ambient_rate_kcps = sys_cpu_to_le16(sample->ambient_rate_kcps);
+	pending_count++;
+
+	if (pending_count >= pending_max ||
+	    sample->timestamp_ms - pending_t0_ms >= range_service_get_config()->notify_interval_ms) {
+		send_pending();
+	}
+}
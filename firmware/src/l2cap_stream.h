@@ -0,0 +1,64 @@
+#ifndef L2CAP_STREAM_H
+#define L2CAP_STREAM_H
+
+#include <zephyr/types.h>
+
+#include "range_service.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Raw sample stream over an L2CAP connection-oriented channel
+ *
+ * For debug and research recordings: every sample the sensor thread
+ * takes, unclamped and with its quality fields, goes out on an LE CoC
+ * channel (PSM CONFIG_RANGE_L2CAP_STREAM_PSM). GATT stays the control and
+ * low-latency path. Each SDU is
+ *
+ *   [0]   uint8_t version (L2CAP_STREAM_VERSION)
+ *   [1]   uint8_t record count
+ *   [2..] count x struct l2cap_stream_record
+ *
+ * and is sent when full or every notify_interval_ms. Flow control is the
+ * channel's credits: an SDU waiting for credits holds one of
+ * CONFIG_RANGE_L2CAP_STREAM_BUFS buffers, and when none is free the sample
+ * is dropped, which the receiver sees as a gap in seq.
+ */
+
+#define L2CAP_STREAM_VERSION 1
+
+/* One sample on the stream (LE) */
+struct l2cap_stream_record {
+	uint16_t seq; /* per sample, wraps */
+	uint32_t timestamp_ms;
+	uint16_t distance_mm; /* as read, not clamped to the config range */
+	uint8_t range_status;
+	uint16_t signal_rate_kcps;
+	uint16_t ambient_rate_kcps;
+} __packed;
+
+#define L2CAP_STREAM_MAX_RECORDS 18
+#define L2CAP_STREAM_SDU_LEN (2 + L2CAP_STREAM_MAX_RECORDS * sizeof(struct l2cap_stream_record))
+
+/**
+ * @brief Register the stream channel's L2CAP server. Call after bt_enable().
+ * @return 0 on success, negative errno on failure.
+ */
+int l2cap_stream_init(void);
+
+/**
+ * @brief Queue one sample on the stream if a channel is connected.
+ *
+ * Call from the sensor thread only.
+ *
+ * @param sample Reading as returned by the sensor, timestamp filled in.
+ */
+void l2cap_stream_push(const struct range_sample *sample);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* L2CAP_STREAM_H */
@@ -9,27 +9,39 @@
  * Sensor: Adafruit VL53L0X breakout (I2C addr 0x29)
  *
  * BLE Services:
- *   - Custom Range Service (notify distance_mm + config)
+ *   - Custom Range Service (notify distance_mm + config + diagnostics
+ *     + gesture events + on-device intensity mapping)
+ *   - Raw sample stream on an L2CAP CoC channel (optional, via Kconfig)
+ *   - Session recording to QSPI flash, downloaded over BLE (optional)
  *   - Battery Service (BAS, standard)
  *   - Device Information Service (optional, via Kconfig)
+ *
+ * USB: log console on the first CDC ACM interface, framed sample stream
+ * on the second (for tethered use, no connection-interval latency).
  */
 
 #include <zephyr/bluetooth/bluetooth.h>
 #include <zephyr/bluetooth/gap.h>
 #include <zephyr/bluetooth/gatt.h>
 #include <zephyr/bluetooth/services/bas.h>
-#include <zephyr/device.h>
-#include <zephyr/drivers/sensor.h>
 #include <zephyr/kernel.h>
 #include <zephyr/logging/log.h>
 
 #include "battery.h"
+#include "diagnostics.h"
+#include "gesture.h"
+#include "l2cap_stream.h"
+#include "range_sensor.h"
 #include "range_service.h"
+#include "recorder.h"
+#include "sensor_health.h"
+#include "usb_stream.h"
 
 LOG_MODULE_REGISTER(main, LOG_LEVEL_INF);
 
-/* VL53L0X device from devicetree */
-static const struct device *range_sensor;
+/* Advertising and connection interval units */
+#define ADV_INTERVAL_UNIT_US 625
+#define CONN_INTERVAL_UNIT_US 1250
 
 /* Connection state */
 static struct bt_conn *current_conn;
@@ -45,6 +57,33 @@ static const struct bt_data sd[] = {
     BT_DATA(BT_DATA_NAME_COMPLETE, CONFIG_BT_DEVICE_NAME, sizeof(CONFIG_BT_DEVICE_NAME) - 1),
 };
 
+/*
+ * Start connectable advertising and note when it first went up. Energy
+ * accounting assumes the fastest interval BT_LE_ADV_CONN allows.
+ */
+static int start_advertising(void)
+{
+	int err = bt_le_adv_start(BT_LE_ADV_CONN, ad, ARRAY_SIZE(ad), sd, ARRAY_SIZE(sd));
+
+	if (err == 0) {
+		diagnostics_record_boot(DIAGNOSTICS_BOOT_ADVERTISING);
+		diagnostics_record_link(ENERGY_LINK_ADVERTISING,
+					BT_GAP_ADV_FAST_INT_MIN_2 * ADV_INTERVAL_UNIT_US, 1);
+	}
+	return err;
+}
+
+/* Tell energy accounting about the connection's interval (1M PHY assumed) */
+static void record_conn_link(struct bt_conn *conn)
+{
+	struct bt_conn_info info;
+
+	if (bt_conn_get_info(conn, &info) == 0) {
+		diagnostics_record_link(ENERGY_LINK_CONNECTED,
+					info.le.interval * CONN_INTERVAL_UNIT_US, 1);
+	}
+}
+
 /* BLE connection callbacks */
 static void connected(struct bt_conn *conn, uint8_t err)
 {
@@ -55,6 +94,7 @@ static void connected(struct bt_conn *conn, uint8_t err)
 
 	LOG_INF("Connected");
 	current_conn = bt_conn_ref(conn);
+	record_conn_link(conn);
 }
 
 static void disconnected(struct bt_conn *conn, uint8_t reason)
@@ -65,48 +105,161 @@ static void disconnected(struct bt_conn *conn, uint8_t reason)
 		bt_conn_unref(current_conn);
 		current_conn = NULL;
 	}
+	diagnostics_record_link(ENERGY_LINK_IDLE, 0, 1);
 
 	/* Restart advertising */
-	int err = bt_le_adv_start(BT_LE_ADV_CONN, ad, ARRAY_SIZE(ad), sd, ARRAY_SIZE(sd));
+	int err = start_advertising();
 	if (err) {
 		LOG_ERR("Advertising restart failed (err %d)", err);
 	}
 }
 
+static void le_param_updated(struct bt_conn *conn, uint16_t interval, uint16_t latency,
+			     uint16_t timeout)
+{
+	LOG_DBG("Connection interval %u us", interval * CONN_INTERVAL_UNIT_US);
+	record_conn_link(conn);
+}
+
 BT_CONN_CB_DEFINE(conn_callbacks) = {
     .connected = connected,
     .disconnected = disconnected,
+    .le_param_updated = le_param_updated,
 };
 
-/* Read VL53L0X and return distance in mm, or negative on error */
-static int read_range_mm(void)
+/* Gesture engine and fault tracker, only touched from the sensor thread */
+static struct gesture_engine gestures;
+static struct sensor_health health;
+
+static const struct sensor_health_params health_params = {
+    .fail_threshold = CONFIG_RANGE_SENSOR_FAULT_THRESHOLD,
+    .backoff_min_ms = CONFIG_RANGE_SAMPLE_INTERVAL_MS,
+    .backoff_max_ms = CONFIG_RANGE_SENSOR_RETRY_MAX_MS,
+    .log_interval_ms = MSEC_PER_SEC,
+};
+
+/* Run the gesture engine on one sample and send whatever it detects */
+static void feed_gestures(const struct range_sample *sample, const struct range_config *cfg)
 {
-	struct sensor_value val;
-	int ret;
+	struct gesture_event events[GESTURE_MAX_EVENTS];
+	uint16_t distance_mm = sample->distance_mm;
+
+	/* A failed range (usually "no target") means nothing is in front */
+	if (sample->range_status != RANGE_STATUS_VALID &&
+	    sample->range_status != RANGE_STATUS_NONE) {
+		distance_mm = cfg->max_range_mm;
+	}
+
+	size_t count = gesture_update(&gestures, range_service_get_gesture_params(), distance_mm,
+				      sample->timestamp_ms, events);
 
-	ret = sensor_sample_fetch(range_sensor);
-	if (ret < 0) {
-		LOG_WRN("Sensor fetch failed: %d", ret);
-		return ret;
+	for (size_t i = 0; i < count; i++) {
+		LOG_DBG("Gesture %u at %umm", events[i].type, events[i].distance_mm);
+		range_service_notify_gesture(&events[i]);
 	}
+}
+
+/*
+ * Bring the VL53L0X up, retrying with exponential backoff. Runs on the
+ * sensor thread so BLE is already advertising while this waits, and a
+ * missing or unplugged sensor never keeps the device from being reachable.
+ * Each failed probe is followed by a bus clear and driver reset, so a
+ * sensor plugged in later gets programmed on the next try. Returns
+ * -ENODEV if the driver itself failed at boot, which no retry can fix.
+ */
+static int sensor_bring_up(void)
+{
+	uint32_t backoff_ms = CONFIG_RANGE_SAMPLE_INTERVAL_MS;
+
+	while (1) {
+		diagnostics_record_sensor_init();
+		int ret = range_sensor_init();
+
+		if (ret == 0) {
+			diagnostics_record_boot(DIAGNOSTICS_BOOT_SENSOR_READY);
+			LOG_INF("Sensor up %u ms after boot", k_uptime_get_32());
+			return 0;
+		}
+		if (ret == -ENODEV) {
+			return ret;
+		}
 
-	ret = sensor_channel_get(range_sensor, SENSOR_CHAN_DISTANCE, &val);
-	if (ret < 0) {
-		LOG_WRN("Sensor channel get failed: %d", ret);
-		return ret;
+		LOG_WRN("Sensor not answering (err %d), retrying in %u ms", ret, backoff_ms);
+		range_sensor_recover();
+		k_sleep(K_MSEC(backoff_ms));
+		backoff_ms = MIN(backoff_ms * 2, CONFIG_RANGE_SENSOR_RETRY_MAX_MS);
 	}
+}
 
-	/*
-	 * Zephyr's VL53L0X driver returns distance in meters as
-	 * a sensor_value (val1 = integer meters, val2 = fractional in
-	 * millionths). Convert to mm.
-	 */
-	int distance_mm = val.val1 * 1000 + val.val2 / 1000;
+/*
+ * Track the result of one read (or a slot skipped during recovery
+ * backoff) and recover the sensor once enough reads in a row have
+ * failed. Fault log lines are rate limited; the backoff already keeps
+ * recoveries themselves rare.
+ */
+static void handle_read_result(int ret, uint32_t now_ms)
+{
+	enum sensor_health_action action = sensor_health_report(&health, ret == 0, now_ms);
+	uint32_t suppressed;
+
+	switch (action) {
+	case SENSOR_HEALTH_RECOVER:
+		if (sensor_health_log_allowed(&health, now_ms, &suppressed)) {
+			LOG_WRN("Sensor fault: %u failed reads (err %d), recovery #%u, "
+				"next read in %u ms (%u lines suppressed)",
+				health.consecutive_failures, ret, health.recoveries,
+				health.retry_at_ms - now_ms, suppressed);
+		}
+		ret = range_sensor_recover();
+		if (ret < 0) {
+			LOG_DBG("Sensor re-init failed: %d", ret);
+		}
+		break;
+	case SENSOR_HEALTH_RECOVERED:
+		if (sensor_health_log_allowed(&health, now_ms, &suppressed)) {
+			LOG_INF("Sensor back after %u ms", now_ms - health.fault_since_ms);
+		}
+		break;
+	default:
+		break;
+	}
 
-	return distance_mm;
+	diagnostics_record_sensor_health(health.state, health.consecutive_failures,
+					 health.recoveries);
 }
 
-/* Sensor polling thread */
+/*
+ * Stand-in sample for a slot with no reading. The notify paths treat the
+ * failed status like any other (dropped by the host, sent as invalid in
+ * batches), so a fault shows up in the stream instead of as silence. The
+ * one exception is the range characteristic without quality fields, which
+ * has no status to carry it and skips the slot.
+ *
+ * The gesture engine doesn't get it: a bus fault says nothing about where
+ * the hand is, and reading it as "hand gone" would fake a withdraw (or a
+ * tap). The engine is reset instead, so nothing in progress completes
+ * across the gap and tracking starts over once readings are back.
+ */
+static void publish_fault(uint32_t timestamp_ms, const struct range_config *cfg)
+{
+	struct range_sample sample = {
+	    .distance_mm = cfg->max_range_mm,
+	    .range_status = RANGE_STATUS_SENSOR_FAULT,
+	    .timestamp_ms = timestamp_ms,
+	};
+
+	range_service_update(&sample);
+	gesture_init(&gestures);
+}
+
+/*
+ * Sensor polling thread
+ *
+ * Samples on absolute deadlines so the period stays at
+ * sample_interval_ms no matter how long each read takes. If a read
+ * overruns one or more slots, the missed slots are skipped (not replayed
+ * back-to-back) so the phase stays aligned to the original schedule.
+ */
 static void sensor_thread_fn(void *p1, void *p2, void *p3)
 {
 	ARG_UNUSED(p1);
@@ -115,24 +268,74 @@ static void sensor_thread_fn(void *p1, void *p2, void *p3)
 
 	LOG_INF("Sensor thread started");
 
+	if (sensor_bring_up() < 0) {
+		LOG_ERR("No VL53L0X driver, not sampling until reset");
+		return;
+	}
+	gesture_init(&gestures);
+	sensor_health_init(&health, &health_params);
+
+	int64_t deadline = k_uptime_ticks();
+
 	while (1) {
 		const struct range_config *cfg = range_service_get_config();
+		int64_t woke = k_uptime_ticks();
+		uint32_t woke_ms = (uint32_t)k_ticks_to_ms_floor64(woke);
+		struct range_sample sample;
+		int ret = -EAGAIN;
+
+		diagnostics_record_wakeup((uint32_t)k_ticks_to_us_floor64(MAX(woke - deadline, 0)));
+
+		if (sensor_health_should_read(&health, woke_ms)) {
+			ret = range_sensor_read(&sample);
+			handle_read_result(ret, woke_ms);
+		}
+
+		if (ret == 0) {
+			sample.timestamp_ms = woke_ms;
+			diagnostics_record_boot(DIAGNOSTICS_BOOT_FIRST_SAMPLE);
+
+			/* Raw streams and recording get the reading before clamping */
+#if defined(CONFIG_RANGE_USB_STREAM)
+			usb_stream_push(&sample);
+#endif
+#if defined(CONFIG_RANGE_L2CAP_STREAM)
+			l2cap_stream_push(&sample);
+#endif
+#if defined(CONFIG_RANGE_RECORDER)
+			recorder_push(&sample);
+#endif
 
-		int distance = read_range_mm();
-		if (distance >= 0) {
 			/* Clamp to configured range */
-			uint16_t clamped = (uint16_t)distance;
-			if (clamped < cfg->min_range_mm) {
-				clamped = cfg->min_range_mm;
+			if (sample.distance_mm < cfg->min_range_mm) {
+				sample.distance_mm = cfg->min_range_mm;
 			}
-			if (clamped > cfg->max_range_mm) {
-				clamped = cfg->max_range_mm;
+			if (sample.distance_mm > cfg->max_range_mm) {
+				sample.distance_mm = cfg->max_range_mm;
 			}
 
-			range_service_update(clamped);
+			range_service_update(&sample);
+			feed_gestures(&sample, cfg);
+		} else {
+			publish_fault(woke_ms, cfg);
 		}
 
-		k_msleep(cfg->sample_interval_ms);
+		/* Re-read the interval: a config write may have changed it */
+		cfg = range_service_get_config();
+		int64_t period = k_ms_to_ticks_ceil64(cfg->sample_interval_ms);
+		int64_t now = k_uptime_ticks();
+		uint32_t missed = 0;
+
+		deadline += period;
+		while (deadline <= now) {
+			deadline += period;
+			missed++;
+		}
+		if (missed > 0) {
+			diagnostics_record_missed(missed);
+		}
+
+		k_sleep(K_TIMEOUT_ABS_TICKS(deadline));
 	}
 }
 
@@ -145,6 +348,13 @@ static void battery_thread_fn(void *p1, void *p2, void *p3)
 
 	LOG_INF("Battery thread started");
 
+	/* Off the boot path; BAS just keeps its default level without it */
+	int err = battery_init();
+	if (err) {
+		LOG_WRN("Battery init failed: %d (continuing without battery)", err);
+		return;
+	}
+
 	while (1) {
 		int mv = battery_read_mv();
 		if (mv > 0) {
@@ -170,42 +380,56 @@ int main(void)
 
 	LOG_INF("Rangefinder BLE starting...");
 
-	/* Get VL53L0X device */
-	range_sensor = DEVICE_DT_GET_ONE(st_vl53l0x);
-	if (!device_is_ready(range_sensor)) {
-		LOG_ERR("VL53L0X sensor not ready");
-		return -ENODEV;
-	}
-	LOG_INF("VL53L0X sensor ready");
-
-	/* Initialize battery ADC */
-	err = battery_init();
-	if (err) {
-		LOG_WRN("Battery init failed: %d (continuing without battery)", err);
-	}
-
-	/* Initialize custom range service */
+	/*
+	 * Radio first: everything BLE needs is static GATT, so the device is
+	 * connectable before any sensor or battery hardware is touched. The
+	 * sensor is brought up (and retried) on its own thread.
+	 */
 	err = range_service_init();
 	if (err) {
 		LOG_ERR("Range service init failed: %d", err);
 		return err;
 	}
 
-	/* Enable Bluetooth */
 	err = bt_enable(NULL);
 	if (err) {
 		LOG_ERR("Bluetooth init failed: %d", err);
 		return err;
 	}
+	diagnostics_record_boot(DIAGNOSTICS_BOOT_BT_READY);
 	LOG_INF("Bluetooth initialized");
 
-	/* Start advertising */
-	err = bt_le_adv_start(BT_LE_ADV_CONN, ad, ARRAY_SIZE(ad), sd, ARRAY_SIZE(sd));
+	err = start_advertising();
 	if (err) {
 		LOG_ERR("Advertising failed to start: %d", err);
 		return err;
 	}
-	LOG_INF("Advertising as \"%s\"", CONFIG_BT_DEVICE_NAME);
+	LOG_INF("Advertising as \"%s\" (%u ms after boot)", CONFIG_BT_DEVICE_NAME,
+		k_uptime_get_32());
+
+#if defined(CONFIG_RANGE_L2CAP_STREAM)
+	/* Optional bulk channel; GATT keeps working without it */
+	err = l2cap_stream_init();
+	if (err) {
+		LOG_WRN("Raw stream unavailable: %d", err);
+	}
+#endif
+
+#if defined(CONFIG_RANGE_USB_STREAM)
+	/* Wired stream; BLE works without it */
+	err = usb_stream_init();
+	if (err) {
+		LOG_WRN("Wired stream unavailable: %d", err);
+	}
+#endif
+
+#if defined(CONFIG_RANGE_RECORDER)
+	/* Mounts the flash ring in the background */
+	err = recorder_init();
+	if (err) {
+		LOG_WRN("Recorder unavailable: %d", err);
+	}
+#endif
 
 	/* Spawn worker threads */
 	k_thread_create(&sensor_thread, sensor_stack, K_THREAD_STACK_SIZEOF(sensor_stack),
@@ -0,0 +1,85 @@
+#include "range_batch.h"
+
+#include <string.h>
+#include <zephyr/sys/byteorder.h>
+#include <zephyr/sys/util.h>
+
+/* Zig-zag LEB128 of a 17-bit signed delta needs at most three bytes */
+#define DELTA_MAX_LEN 3
+
+void range_batch_reset(struct range_batch *batch, size_t limit)
+{
+	batch->len = 0;
+	batch->limit = CLAMP(limit, RANGE_BATCH_HEADER_LEN, RANGE_BATCH_BUF_LEN);
+	batch->count = 0;
+}
+
+static size_t encode_delta(int32_t delta, uint8_t *out)
+{
+	uint32_t zz = ((uint32_t)delta << 1) ^ (uint32_t)(delta >> 31);
+	size_t n = 0;
+
+	do {
+		uint8_t byte = zz & 0x7f;
+
+		zz >>= 7;
+		out[n++] = byte | (zz ? 0x80 : 0);
+	} while (zz);
+
+	return n;
+}
+
+static void start(struct range_batch *batch, uint16_t distance_mm, uint32_t timestamp_ms,
+		  uint16_t interval_ms)
+{
+	batch->buf[0] = RANGE_BATCH_VERSION;
+	batch->buf[1] = 1;
+	sys_put_le32(timestamp_ms, &batch->buf[2]);
+	sys_put_le16(interval_ms, &batch->buf[6]);
+	sys_put_le16(distance_mm, &batch->buf[8]);
+
+	batch->len = RANGE_BATCH_HEADER_LEN;
+	batch->count = 1;
+	batch->last_mm = distance_mm;
+	batch->t0_ms = timestamp_ms;
+	batch->interval_ms = interval_ms;
+}
+
+bool range_batch_add(struct range_batch *batch, uint16_t distance_mm, uint32_t timestamp_ms,
+		     uint16_t interval_ms)
+{
+	if (batch->count == 0) {
+		start(batch, distance_mm, timestamp_ms, interval_ms);
+		return true;
+	}
+
+	if (batch->count == UINT8_MAX || interval_ms != batch->interval_ms) {
+		return false;
+	}
+
+	/* Timestamps are implied, so the sample must land on the next slot */
+	uint32_t expected = batch->t0_ms + (uint32_t)batch->count * batch->interval_ms;
+	int32_t skew = (int32_t)(timestamp_ms - expected);
+
+	if (skew > batch->interval_ms / 2 || skew < -(int32_t)(batch->interval_ms / 2)) {
+		return false;
+	}
+
+	uint8_t delta[DELTA_MAX_LEN];
+	size_t n = encode_delta((int32_t)distance_mm - batch->last_mm, delta);
+
+	if (batch->len + n > batch->limit) {
+		return false;
+	}
+
+	memcpy(&batch->buf[batch->len], delta, n);
+	batch->len += n;
+	batch->buf[1] = ++batch->count;
+	batch->last_mm = distance_mm;
+	return true;
+}
+
+uint32_t range_batch_span_ms(const struct range_batch *batch)
+{
+	return (uint32_t)batch->count * batch->interval_ms;
+}
@@ -0,0 +1,84 @@
+#ifndef RANGE_BATCH_H
+#define RANGE_BATCH_H
+
+#include <stddef.h>
+#include <zephyr/types.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Delta-encoded range batches
+ *
+ * Packs a run of evenly spaced samples into one notification:
+ *
+ *   [0]    uint8_t  version (RANGE_BATCH_VERSION)
+ *   [1]    uint8_t  sample count
+ *   [2]    uint32_t timestamp of the first sample, ms uptime (LE)
+ *   [6]    uint16_t sample interval, ms (LE)
+ *   [8]    uint16_t first distance, mm (LE)
+ *   [10..] count - 1 deltas from the previous sample, zig-zag LEB128
+ *
+ * Sample i was taken at timestamp + i * interval. Hand movement between
+ * samples is small, so most deltas take one byte. A sample whose range
+ * status failed is sent as RANGE_BATCH_INVALID to keep the timeline.
+ */
+
+#define RANGE_BATCH_VERSION 1
+#define RANGE_BATCH_HEADER_LEN 10
+
+/* Largest payload the encoder will build (ATT MTU 247 minus 3) */
+#define RANGE_BATCH_BUF_LEN 244
+
+/* Distance sent for a sample with a failed range status */
+#define RANGE_BATCH_INVALID 0xFFFF
+
+/* A batch being filled; treat as opaque */
+struct range_batch {
+	uint8_t buf[RANGE_BATCH_BUF_LEN];
+	size_t len;
+	size_t limit; /* payload size cap for this batch */
+	uint8_t count;
+	uint16_t last_mm;
+	uint32_t t0_ms;
+	uint16_t interval_ms;
+};
+
+/**
+ * @brief Empty the batch and set the payload size cap for the next one.
+ * @param batch Batch to reset.
+ * @param limit Largest payload to build, clamped to
+ *              [RANGE_BATCH_HEADER_LEN, RANGE_BATCH_BUF_LEN].
+ */
+void range_batch_reset(struct range_batch *batch, size_t limit);
+
+/**
+ * @brief Append one sample.
+ *
+ * Fails when the sample does not continue the batch: it would not fit,
+ * the interval changed, or its timestamp is off the batch's timeline by
+ * more than half an interval (a skipped slot). Send the batch, reset it
+ * and add the sample again; an empty batch always accepts it.
+ *
+ * @param batch Batch to extend.
+ * @param distance_mm Distance, or RANGE_BATCH_INVALID.
+ * @param timestamp_ms Uptime the sample was taken.
+ * @param interval_ms Current sample interval.
+ * @return true if the sample was added.
+ */
+bool range_batch_add(struct range_batch *batch, uint16_t distance_mm, uint32_t timestamp_ms,
+		     uint16_t interval_ms);
+
+/**
+ * @brief Time covered by the samples in the batch.
+ * @param batch Batch to inspect.
+ * @return count * interval in ms (0 when empty).
+ */
+uint32_t range_batch_span_ms(const struct range_batch *batch);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* RANGE_BATCH_H */
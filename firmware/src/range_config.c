@@ -0,0 +1,180 @@
+#include "range_config.h"
+
+#include <errno.h>
+#include <stddef.h>
+#include <string.h>
+#include <zephyr/sys/byteorder.h>
+#include <zephyr/sys/util.h>
+
+/* Every field so far is a uint16_t in struct range_config */
+struct field_desc {
+	uint8_t field;
+	uint8_t offset;
+	uint16_t min;
+	uint16_t max;
+};
+
+static const struct field_desc fields[] = {
+    {RANGE_CONFIG_FIELD_SAMPLE_INTERVAL_MS, offsetof(struct range_config, sample_interval_ms), 10,
+     5000},
+    {RANGE_CONFIG_FIELD_NOTIFY_INTERVAL_MS, offsetof(struct range_config, notify_interval_ms), 10,
+     5000},
+    {RANGE_CONFIG_FIELD_MAX_RANGE_MM, offsetof(struct range_config, max_range_mm), 1, UINT16_MAX},
+    {RANGE_CONFIG_FIELD_MIN_RANGE_MM, offsetof(struct range_config, min_range_mm), 0,
+     UINT16_MAX - 1},
+};
+
+/* The struct is packed, so fields are copied rather than dereferenced */
+static uint16_t get_field(const struct range_config *cfg, const struct field_desc *desc)
+{
+	uint16_t value;
+
+	memcpy(&value, (const uint8_t *)cfg + desc->offset, sizeof(value));
+	return value;
+}
+
+static void set_field(struct range_config *cfg, const struct field_desc *desc, uint16_t value)
+{
+	memcpy((uint8_t *)cfg + desc->offset, &value, sizeof(value));
+}
+
+static const struct field_desc *find_field(uint8_t field)
+{
+	for (size_t i = 0; i < ARRAY_SIZE(fields); i++) {
+		if (fields[i].field == field) {
+			return &fields[i];
+		}
+	}
+	return NULL;
+}
+
+static bool written(uint32_t seen, uint8_t field)
+{
+	return seen & BIT(find_field(field) - fields);
+}
+
+static void add_error(struct range_config_status *status, uint8_t field, uint8_t error)
+{
+	if (status->count < RANGE_CONFIG_MAX_ERRORS) {
+		status->errors[status->count].field = field;
+		status->errors[status->count].error = error;
+		status->count++;
+	}
+}
+
+bool range_config_valid(const struct range_config *cfg, struct range_config_status *status)
+{
+	status->count = 0;
+
+	for (size_t i = 0; i < ARRAY_SIZE(fields); i++) {
+		uint16_t value = get_field(cfg, &fields[i]);
+
+		if (value < fields[i].min || value > fields[i].max) {
+			add_error(status, fields[i].field, RANGE_CONFIG_ERR_RANGE);
+		}
+	}
+
+	if (status->count == 0 && cfg->min_range_mm >= cfg->max_range_mm) {
+		add_error(status, RANGE_CONFIG_FIELD_MIN_RANGE_MM, RANGE_CONFIG_ERR_CONFLICT);
+	}
+
+	return status->count == 0;
+}
+
+int range_config_apply_tlv(struct range_config *cfg, const uint8_t *buf, size_t len,
+			   struct range_config_status *status)
+{
+	struct range_config next = *cfg;
+	uint32_t seen = 0;
+	size_t pos = 1;
+
+	status->count = 0;
+
+	if (len < 1 || buf[0] != RANGE_CONFIG_TLV_VERSION) {
+		return -ENOTSUP;
+	}
+
+	/* Check the framing first so a truncated write reports nothing */
+	while (pos < len) {
+		if (len - pos < 2 || len - pos - 2 < buf[pos + 1]) {
+			return -EBADMSG;
+		}
+		pos += 2 + buf[pos + 1];
+	}
+
+	for (pos = 1; pos < len; pos += 2 + buf[pos + 1]) {
+		uint8_t field = buf[pos];
+		uint8_t value_len = buf[pos + 1];
+		const struct field_desc *desc = find_field(field);
+
+		if (desc == NULL) {
+			add_error(status, field, RANGE_CONFIG_ERR_UNKNOWN_FIELD);
+			continue;
+		}
+
+		if (written(seen, field)) {
+			add_error(status, field, RANGE_CONFIG_ERR_DUPLICATE);
+			continue;
+		}
+		seen |= BIT(desc - fields);
+
+		if (value_len != sizeof(uint16_t)) {
+			add_error(status, field, RANGE_CONFIG_ERR_LENGTH);
+			continue;
+		}
+
+		uint16_t value = sys_get_le16(&buf[pos + 2]);
+
+		if (value < desc->min || value > desc->max) {
+			add_error(status, field, RANGE_CONFIG_ERR_RANGE);
+			continue;
+		}
+
+		set_field(&next, desc, value);
+	}
+
+	/* The window is checked on the result, and blamed on whichever end was written */
+	if (status->count == 0 && next.min_range_mm >= next.max_range_mm) {
+		if (written(seen, RANGE_CONFIG_FIELD_MIN_RANGE_MM)) {
+			add_error(status, RANGE_CONFIG_FIELD_MIN_RANGE_MM, RANGE_CONFIG_ERR_CONFLICT);
+		}
+		if (written(seen, RANGE_CONFIG_FIELD_MAX_RANGE_MM)) {
+			add_error(status, RANGE_CONFIG_FIELD_MAX_RANGE_MM, RANGE_CONFIG_ERR_CONFLICT);
+		}
+	}
+
+	if (status->count > 0) {
+		return -EINVAL;
+	}
+
+	*cfg = next;
+	return 0;
+}
+
+size_t range_config_encode_tlv(const struct range_config *cfg,
+			       const struct range_config_status *status, uint8_t *buf)
+{
+	size_t pos = 0;
+
+	buf[pos++] = RANGE_CONFIG_TLV_VERSION;
+
+	for (size_t i = 0; i < ARRAY_SIZE(fields); i++) {
+		buf[pos++] = fields[i].field;
+		buf[pos++] = 3 * sizeof(uint16_t);
+		sys_put_le16(get_field(cfg, &fields[i]), &buf[pos]);
+		sys_put_le16(fields[i].min, &buf[pos + 2]);
+		sys_put_le16(fields[i].max, &buf[pos + 4]);
+		pos += 3 * sizeof(uint16_t);
+	}
+
+	if (status->count > 0) {
+		buf[pos++] = RANGE_CONFIG_FIELD_STATUS;
+		buf[pos++] = 2 * status->count;
+		for (uint8_t i = 0; i < status->count; i++) {
+			buf[pos++] = status->errors[i].field;
+			buf[pos++] = status->errors[i].error;
+		}
+	}
+
+	return pos;
+}
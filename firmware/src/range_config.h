@@ -0,0 +1,113 @@
+#ifndef RANGE_CONFIG_H
+#define RANGE_CONFIG_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <zephyr/types.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Sampling configuration and its two wire formats
+ *
+ * struct range_config is the original fixed 8-byte format of the config
+ * characteristic. It stays as a legacy alias: every write must carry all
+ * four fields, so it can never grow.
+ *
+ * The config TLV characteristic carries the same settings as a version
+ * byte followed by records:
+ *
+ *   uint8_t field (RANGE_CONFIG_FIELD_*), uint8_t len, len bytes of value (LE)
+ *
+ * A write may set any subset of the fields; the rest keep their values. It
+ * is checked as a whole and either fully applied or rejected with a list
+ * of per-field errors, which the next read returns. A read lists every
+ * field the firmware supports as a record of len 6 holding the current
+ * value, the minimum and the maximum (uint16_t each), then a
+ * RANGE_CONFIG_FIELD_STATUS record with one {field, error} byte pair per
+ * error of the last rejected write (omitted after a good write).
+ *
+ * Field numbers are never reused. New tunables get a new number, so hosts
+ * only ever send fields they have seen in a read.
+ */
+
+/* Legacy wire format, written/read via the config characteristic */
+struct range_config {
+	uint16_t sample_interval_ms; /* sensor polling rate */
+	uint16_t notify_interval_ms; /* BLE notification rate (batch flush interval) */
+	uint16_t max_range_mm;	     /* clamp: ignore readings above this */
+	uint16_t min_range_mm;	     /* clamp: ignore readings below this */
+} __packed;
+
+#define RANGE_CONFIG_TLV_VERSION 1
+
+enum range_config_field {
+	RANGE_CONFIG_FIELD_SAMPLE_INTERVAL_MS = 1,
+	RANGE_CONFIG_FIELD_NOTIFY_INTERVAL_MS = 2,
+	RANGE_CONFIG_FIELD_MAX_RANGE_MM = 3,
+	RANGE_CONFIG_FIELD_MIN_RANGE_MM = 4,
+	RANGE_CONFIG_FIELD_STATUS = 0xff, /* read only: errors of the last write */
+};
+
+enum range_config_error {
+	RANGE_CONFIG_OK = 0,
+	RANGE_CONFIG_ERR_UNKNOWN_FIELD = 1, /* not supported by this firmware */
+	RANGE_CONFIG_ERR_LENGTH = 2,	    /* value has the wrong size */
+	RANGE_CONFIG_ERR_RANGE = 3,	    /* outside the field's min/max */
+	RANGE_CONFIG_ERR_CONFLICT = 4,	    /* min_range_mm >= max_range_mm */
+	RANGE_CONFIG_ERR_DUPLICATE = 5,	    /* field given twice in one write */
+};
+
+/* Errors kept per write; further errors are dropped from the list */
+#define RANGE_CONFIG_MAX_ERRORS 8
+
+/* Largest read: header, one record per field and a full status record */
+#define RANGE_CONFIG_TLV_MAX_LEN (1 + 4 * (2 + 6) + 2 + 2 * RANGE_CONFIG_MAX_ERRORS)
+
+/* Outcome of the last write */
+struct range_config_status {
+	uint8_t count;
+	struct {
+		uint8_t field; /* enum range_config_field */
+		uint8_t error; /* enum range_config_error */
+	} errors[RANGE_CONFIG_MAX_ERRORS];
+};
+
+/**
+ * @brief Check a complete configuration against the per-field limits.
+ * @param cfg Configuration to check.
+ * @param status Filled with one entry per bad field (cleared if all good).
+ * @return true if usable.
+ */
+bool range_config_valid(const struct range_config *cfg, struct range_config_status *status);
+
+/**
+ * @brief Apply a TLV write on top of the current configuration.
+ *
+ * @param cfg Active configuration; only changed if the whole write is good.
+ * @param buf Write payload, starting with the version byte.
+ * @param len Payload length.
+ * @param status Filled with the per-field errors (cleared on success).
+ * @return 0 if applied, -ENOTSUP for an unknown version, -EBADMSG if the
+ *         records are truncated, -EINVAL if any field was rejected.
+ */
+int range_config_apply_tlv(struct range_config *cfg, const uint8_t *buf, size_t len,
+			   struct range_config_status *status);
+
+/**
+ * @brief Encode the supported fields and the last write's errors.
+ * @param cfg Active configuration.
+ * @param status Outcome of the last write.
+ * @param buf Output, at least RANGE_CONFIG_TLV_MAX_LEN bytes.
+ * @return Encoded length.
+ */
+size_t range_config_encode_tlv(const struct range_config *cfg,
+			       const struct range_config_status *status, uint8_t *buf);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* RANGE_CONFIG_H */
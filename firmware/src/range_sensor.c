@@ -0,0 +1,318 @@
+#include "range_sensor.h"
+
+#include <zephyr/device.h>
+#include <zephyr/drivers/sensor.h>
+#include <zephyr/drivers/i2c.h>
+#include <zephyr/drivers/sensor/vl53l0x.h>
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/pm/device.h>
+#include <zephyr/pm/device_runtime.h>
+#include <zephyr/sys/util.h>
+
+#if defined(CONFIG_RANGE_SENSOR_ASYNC)
+#include <zephyr/rtio/rtio.h>
+#endif
+
+#include "diagnostics.h"
+
+LOG_MODULE_REGISTER(range_sensor, LOG_LEVEL_INF);
+
+#define VL53L0X_NODE DT_COMPAT_GET_ANY_STATUS_OKAY(st_vl53l0x)
+
+static const struct device *const range_dev = DEVICE_DT_GET(VL53L0X_NODE);
+static const struct device *const range_bus = DEVICE_DT_GET(DT_BUS(VL53L0X_NODE));
+
+#if defined(CONFIG_RANGE_SENSOR_ASYNC)
+/*
+ * One read request covering distance and the quality channels. The
+ * VL53L0X driver has no native submit, so Zephyr runs the fetch on the
+ * RTIO work queue and we only pay for the decode on this thread.
+ */
+SENSOR_DT_READ_IODEV(range_iodev, VL53L0X_NODE, {SENSOR_CHAN_DISTANCE, 0},
+		     {(enum sensor_channel)SENSOR_CHAN_VL53L0X_RANGE_STATUS, 0},
+		     {(enum sensor_channel)SENSOR_CHAN_VL53L0X_SIGNAL_RATE_RTN_CPS, 0},
+		     {(enum sensor_channel)SENSOR_CHAN_VL53L0X_AMBIENT_RATE_RTN_CPS, 0});
+
+/* Single in-flight read: 1 SQE, 1 CQE, a few small blocks for the result */
+RTIO_DEFINE_WITH_MEMPOOL(range_rtio, 1, 1, 4, 64, sizeof(void *));
+#endif
+
+int range_sensor_recover(void)
+{
+	int ret;
+
+	ret = pm_device_runtime_get(range_bus);
+	if (ret < 0) {
+		return ret;
+	}
+
+	/* Clock out whatever transfer a glitch left the VL53L0X stuck in */
+	ret = i2c_recover_bus(range_bus);
+	pm_device_runtime_put(range_bus);
+	if (ret < 0 && ret != -ENOSYS) {
+		LOG_DBG("I2C bus recovery failed: %d", ret);
+	}
+
+#if defined(CONFIG_PM_DEVICE)
+	/*
+	 * The driver programs the sensor once, on the first fetch after
+	 * resume. A sensor that lost power (loose cable) comes back with
+	 * default registers, so force that bring-up to run again.
+	 */
+	ret = pm_device_action_run(range_dev, PM_DEVICE_ACTION_SUSPEND);
+	if (ret < 0 && ret != -EALREADY && ret != -ENOSYS && ret != -ENOTSUP) {
+		return ret;
+	}
+	ret = pm_device_action_run(range_dev, PM_DEVICE_ACTION_RESUME);
+	if (ret < 0 && ret != -EALREADY && ret != -ENOSYS && ret != -ENOTSUP) {
+		return ret;
+	}
+#endif
+
+	return 0;
+}
+
+#if defined(CONFIG_RANGE_SENSOR_ASYNC)
+
+/* Scale a q31 reading by 1000 (m -> mm, MCPS -> kcps, or int -> milli) */
+static int64_t q31_to_milli(q31_t value, int8_t shift)
+{
+	int64_t milli = (int64_t)value * 1000;
+
+	return shift >= 31 ? milli << (shift - 31) : milli >> (31 - shift);
+}
+
+/* Decode one channel from an RTIO result buffer, scaled by 1000 */
+static int decode_milli(const struct sensor_decoder_api *decoder, const uint8_t *buf,
+			enum sensor_channel chan, int64_t *out)
+{
+	struct sensor_q31_data data = {0};
+	uint32_t fit = 0;
+	int ret;
+
+	ret = decoder->decode(buf, (struct sensor_chan_spec){chan, 0}, &fit, 1, &data);
+	if (ret <= 0) {
+		return ret < 0 ? ret : -ENODATA;
+	}
+
+	*out = q31_to_milli(data.readings[0].value, data.shift);
+	return 0;
+}
+
+static int read_sample(struct range_sample *sample)
+{
+	const struct sensor_decoder_api *decoder;
+	struct rtio_cqe *cqe;
+	uint8_t *buf;
+	uint32_t buf_len;
+	int64_t milli;
+	int ret;
+
+	ret = sensor_read_async_mempool(&range_iodev, &range_rtio, NULL);
+	if (ret < 0) {
+		LOG_DBG("Sensor read submit failed: %d", ret);
+		return ret;
+	}
+
+	/* Sleeps on the RTIO completion semaphore until the read is done */
+	cqe = rtio_cqe_consume_block(&range_rtio);
+	ret = cqe->result;
+	if (rtio_cqe_get_mempool_buffer(&range_rtio, cqe, &buf, &buf_len) < 0) {
+		buf = NULL;
+	}
+	rtio_cqe_release(&range_rtio, cqe);
+
+	if (ret < 0 || buf == NULL) {
+		LOG_DBG("Sensor read failed: %d", ret);
+		ret = ret < 0 ? ret : -EIO;
+		goto release;
+	}
+
+	ret = sensor_get_decoder(range_dev, &decoder);
+	if (ret < 0) {
+		goto release;
+	}
+
+	ret = decode_milli(decoder, buf, SENSOR_CHAN_DISTANCE, &milli);
+	if (ret < 0) {
+		LOG_DBG("Sensor distance decode failed: %d", ret);
+		goto release;
+	}
+	/* Distance is reported in meters */
+	sample->distance_mm = (uint16_t)CLAMP(milli, 0, UINT16_MAX);
+
+	/* Quality channels are best-effort, like on the sync path */
+	sample->range_status = RANGE_STATUS_NONE;
+	sample->signal_rate_kcps = 0;
+	sample->ambient_rate_kcps = 0;
+
+	if (decode_milli(decoder, buf, (enum sensor_channel)SENSOR_CHAN_VL53L0X_RANGE_STATUS,
+			 &milli) == 0) {
+		sample->range_status = (uint8_t)(milli / 1000);
+
+		if (decode_milli(decoder, buf,
+				 (enum sensor_channel)SENSOR_CHAN_VL53L0X_SIGNAL_RATE_RTN_CPS,
+				 &milli) == 0) {
+			sample->signal_rate_kcps = (uint16_t)CLAMP(milli, 0, UINT16_MAX);
+		}
+		if (decode_milli(decoder, buf,
+				 (enum sensor_channel)SENSOR_CHAN_VL53L0X_AMBIENT_RATE_RTN_CPS,
+				 &milli) == 0) {
+			sample->ambient_rate_kcps = (uint16_t)CLAMP(milli, 0, UINT16_MAX);
+		}
+	}
+
+release:
+	if (buf != NULL) {
+		rtio_release_buffer(&range_rtio, buf, buf_len);
+	}
+	return ret;
+}
+
+#else /* !CONFIG_RANGE_SENSOR_ASYNC */
+
+/* Convert a sensor_value rate in MCPS to kcps, saturating at UINT16_MAX */
+static uint16_t rate_to_kcps(const struct sensor_value *val)
+{
+	int64_t kcps = (int64_t)val->val1 * 1000 + val->val2 / 1000;
+
+	return (uint16_t)CLAMP(kcps, 0, UINT16_MAX);
+}
+
+/*
+ * Read VL53L0X quality channels into the sample. These are best-effort:
+ * if the driver doesn't expose them, the sample is marked RANGE_STATUS_NONE
+ * so the host falls back to trusting the distance alone.
+ */
+static void read_quality(struct range_sample *sample)
+{
+	struct sensor_value val;
+
+	sample->range_status = RANGE_STATUS_NONE;
+	sample->signal_rate_kcps = 0;
+	sample->ambient_rate_kcps = 0;
+
+	if (sensor_channel_get(range_dev, (enum sensor_channel)SENSOR_CHAN_VL53L0X_RANGE_STATUS,
+			       &val) < 0) {
+		return;
+	}
+	sample->range_status = (uint8_t)val.val1;
+
+	if (sensor_channel_get(range_dev,
+			       (enum sensor_channel)SENSOR_CHAN_VL53L0X_SIGNAL_RATE_RTN_CPS,
+			       &val) == 0) {
+		sample->signal_rate_kcps = rate_to_kcps(&val);
+	}
+
+	if (sensor_channel_get(range_dev,
+			       (enum sensor_channel)SENSOR_CHAN_VL53L0X_AMBIENT_RATE_RTN_CPS,
+			       &val) == 0) {
+		sample->ambient_rate_kcps = rate_to_kcps(&val);
+	}
+}
+
+static int read_sample(struct range_sample *sample)
+{
+	struct sensor_value val;
+	int ret;
+
+	/* Blocks this thread for the whole I2C transaction and ranging time */
+	ret = sensor_sample_fetch(range_dev);
+	if (ret < 0) {
+		LOG_DBG("Sensor fetch failed: %d", ret);
+		return ret;
+	}
+
+	ret = sensor_channel_get(range_dev, SENSOR_CHAN_DISTANCE, &val);
+	if (ret < 0) {
+		LOG_DBG("Sensor channel get failed: %d", ret);
+		return ret;
+	}
+
+	/*
+	 * Zephyr's VL53L0X driver returns distance in meters as
+	 * a sensor_value (val1 = integer meters, val2 = fractional in
+	 * millionths). Convert to mm.
+	 */
+	int distance_mm = val.val1 * 1000 + val.val2 / 1000;
+
+	sample->distance_mm = (uint16_t)CLAMP(distance_mm, 0, UINT16_MAX);
+	read_quality(sample);
+
+	return 0;
+}
+
+#endif /* CONFIG_RANGE_SENSOR_ASYNC */
+
+/*
+ * Hold the I2C bus resumed for one read. Without device runtime PM (or
+ * in builds that don't mark the bus for it) get and put do nothing.
+ */
+static int read_powered(struct range_sample *sample)
+{
+	int ret = pm_device_runtime_get(range_bus);
+
+	if (ret < 0) {
+		LOG_DBG("I2C bus resume failed: %d", ret);
+		return ret;
+	}
+
+	ret = read_sample(sample);
+	pm_device_runtime_put(range_bus);
+	return ret;
+}
+
+int range_sensor_init(void)
+{
+	struct range_sample sample;
+	int ret;
+
+	/* Driver init ran once at boot; if it failed, nothing here redoes it */
+	if (!device_is_ready(range_dev)) {
+		LOG_ERR("VL53L0X driver failed to initialize");
+		return -ENODEV;
+	}
+
+	/*
+	 * The driver only talks to the sensor on the first fetch, so a ready
+	 * driver says nothing about whether a VL53L0X is on the bus. A read
+	 * does.
+	 */
+	ret = read_powered(&sample);
+	if (ret < 0) {
+		LOG_DBG("VL53L0X probe read failed: %d", ret);
+		return ret;
+	}
+
+	LOG_INF("VL53L0X sensor ready (%s read path)",
+		IS_ENABLED(CONFIG_RANGE_SENSOR_ASYNC) ? "async" : "sync");
+	return 0;
+}
+
+/* CPU time consumed so far by the calling thread, in cycles */
+static uint64_t thread_cycles(void)
+{
+#if defined(CONFIG_SCHED_THREAD_USAGE)
+	k_thread_runtime_stats_t stats;
+
+	if (k_thread_runtime_stats_get(k_current_get(), &stats) == 0) {
+		return stats.execution_cycles;
+	}
+#endif
+	return 0;
+}
+
+int range_sensor_read(struct range_sample *sample)
+{
+	uint32_t start = k_cycle_get_32();
+	uint64_t busy_start = thread_cycles();
+
+	int ret = read_powered(sample);
+
+	uint32_t wall_us = k_cyc_to_us_floor32(k_cycle_get_32() - start);
+	uint32_t busy_us = (uint32_t)k_cyc_to_us_floor64(thread_cycles() - busy_start);
+
+	diagnostics_record_read(ret == 0, busy_us, wall_us);
+	return ret;
+}
@@ -0,0 +1,52 @@
+#ifndef RANGE_SENSOR_H
+#define RANGE_SENSOR_H
+
+#include <zephyr/types.h>
+
+#include "range_service.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Check that the VL53L0X driver is ready and the sensor answers.
+ *
+ * Takes one probe reading, which is also when the driver programs the
+ * sensor. A failed probe is worth retrying after range_sensor_recover();
+ * a driver that failed its boot-time init is not.
+ *
+ * @return 0 on success, -ENODEV if the driver failed to initialize at
+ *         boot, other negative errno if the probe read failed.
+ */
+int range_sensor_init(void);
+
+/**
+ * @brief Try to get a failing sensor working again.
+ *
+ * Clears the I2C bus (9 clock pulses and a STOP, for a slave holding SDA
+ * low) and, with CONFIG_PM_DEVICE, suspends and resumes the VL53L0X so
+ * the driver re-runs its sensor initialization on the next read.
+ *
+ * @return 0 on success, negative errno if the sensor could not be reset.
+ */
+int range_sensor_recover(void);
+
+/**
+ * @brief Take one reading (distance + quality fields) from the VL53L0X.
+ *
+ * With CONFIG_RANGE_SENSOR_ASYNC the read is submitted through RTIO and
+ * the calling thread sleeps until the completion arrives; otherwise it
+ * uses the blocking sensor_sample_fetch() path. Either way, the CPU time
+ * the calling thread spent on the read is reported to diagnostics.
+ *
+ * @param sample Filled in on success. distance_mm is not clamped.
+ * @return 0 on success, negative errno on failure.
+ */
+int range_sensor_read(struct range_sample *sample);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* RANGE_SENSOR_H */
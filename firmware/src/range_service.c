@@ -4,11 +4,23 @@
 #include <zephyr/bluetooth/gatt.h>
 #include <zephyr/kernel.h>
 #include <zephyr/logging/log.h>
+#include <zephyr/sys/atomic.h>
+#include <zephyr/sys/byteorder.h>
+
+#include "diagnostics.h"
 
 LOG_MODULE_REGISTER(range_svc, LOG_LEVEL_INF);
 
 /* Current range reading */
-static uint16_t current_range_mm;
+static struct range_payload current_range = {
+    .range_status = RANGE_STATUS_NONE,
+};
+
+#if defined(CONFIG_RANGE_NOTIFY_QUALITY)
+#define RANGE_PAYLOAD_LEN sizeof(struct range_payload)
+#else
+#define RANGE_PAYLOAD_LEN sizeof(current_range.distance_mm)
+#endif
 
 /* Active configuration - defaults match prj.conf */
 static struct range_config active_config = {
@@ -18,8 +30,36 @@ static struct range_config active_config = {
     .min_range_mm = 30,	  /* VL53L0X min range */
 };
 
+/* Errors of the last config write, read back from the TLV characteristic */
+static struct range_config_status config_status;
+
+/* Active gesture parameters */
+static struct gesture_params gesture_params = GESTURE_PARAMS_DEFAULT;
+
+/* Active intensity mapping and the mapper state (sensor thread only) */
+static struct intensity_map_config map_config = INTENSITY_MAP_CONFIG_DEFAULT;
+static struct intensity_map mapper;
+
+/* Set from the BT thread to restart smoothing on the next sample */
+static atomic_t mapper_reset = ATOMIC_INIT(1);
+
+/* Batch being filled (sensor thread only) */
+static struct range_batch batch;
+
+/* Set from the BT thread to drop any partial batch on the next sample */
+static atomic_t batch_reset = ATOMIC_INIT(1);
+
 /* Track CCC subscription state */
 static bool range_notify_enabled;
+static bool gesture_notify_enabled;
+static bool mapping_notify_enabled;
+static bool batch_notify_enabled;
+static bool time_sync_notify_enabled;
+
+/* Last time sync write, echoed from the system workqueue */
+static struct time_sync_echo time_sync;
+static void time_sync_echo_fn(struct k_work *work);
+static K_WORK_DEFINE(time_sync_work, time_sync_echo_fn);
 
 /* CCC changed callback */
 static void range_ccc_changed(const struct bt_gatt_attr *attr, uint16_t value)
@@ -28,12 +68,37 @@ static void range_ccc_changed(const struct bt_gatt_attr *attr, uint16_t value)
 	LOG_INF("Range notifications %s", range_notify_enabled ? "enabled" : "disabled");
 }
 
+static void gesture_ccc_changed(const struct bt_gatt_attr *attr, uint16_t value)
+{
+	gesture_notify_enabled = (value == BT_GATT_CCC_NOTIFY);
+	LOG_INF("Gesture notifications %s", gesture_notify_enabled ? "enabled" : "disabled");
+}
+
+static void mapping_ccc_changed(const struct bt_gatt_attr *attr, uint16_t value)
+{
+	mapping_notify_enabled = (value == BT_GATT_CCC_NOTIFY);
+	atomic_set(&mapper_reset, 1);
+	LOG_INF("Intensity notifications %s", mapping_notify_enabled ? "enabled" : "disabled");
+}
+
+static void batch_ccc_changed(const struct bt_gatt_attr *attr, uint16_t value)
+{
+	batch_notify_enabled = (value == BT_GATT_CCC_NOTIFY);
+	atomic_set(&batch_reset, 1);
+	LOG_INF("Batch notifications %s", batch_notify_enabled ? "enabled" : "disabled");
+}
+
+static void time_sync_ccc_changed(const struct bt_gatt_attr *attr, uint16_t value)
+{
+	time_sync_notify_enabled = (value == BT_GATT_CCC_NOTIFY);
+	LOG_INF("Time sync notifications %s", time_sync_notify_enabled ? "enabled" : "disabled");
+}
+
 /* Read handler for range characteristic */
 static ssize_t read_range(struct bt_conn *conn, const struct bt_gatt_attr *attr, void *buf,
 			  uint16_t len, uint16_t offset)
 {
-	return bt_gatt_attr_read(conn, attr, buf, len, offset, &current_range_mm,
-				 sizeof(current_range_mm));
+	return bt_gatt_attr_read(conn, attr, buf, len, offset, &current_range, RANGE_PAYLOAD_LEN);
 }
 
 /* Read handler for config characteristic */
@@ -44,6 +109,89 @@ static ssize_t read_config(struct bt_conn *conn, const struct bt_gatt_attr *attr
 				 sizeof(active_config));
 }
 
+/*
+ * Diagnostics snapshot being read. The payload is longer than one read at
+ * the default ATT MTU, so hosts use a long read; the snapshot taken for
+ * offset 0 serves the later offsets too, so every field comes from the
+ * same moment. GATT reads run one at a time on the BT RX thread.
+ */
+static struct diagnostics_payload diag_read;
+
+/* Read handler for diagnostics characteristic */
+static ssize_t read_diagnostics(struct bt_conn *conn, const struct bt_gatt_attr *attr, void *buf,
+				uint16_t len, uint16_t offset)
+{
+	if (offset == 0) {
+		diagnostics_snapshot(&diag_read);
+	}
+	return bt_gatt_attr_read(conn, attr, buf, len, offset, &diag_read, sizeof(diag_read));
+}
+
+/* Read handler for gesture characteristic: current parameters */
+static ssize_t read_gesture_params(struct bt_conn *conn, const struct bt_gatt_attr *attr,
+				   void *buf, uint16_t len, uint16_t offset)
+{
+	return bt_gatt_attr_read(conn, attr, buf, len, offset, &gesture_params,
+				 sizeof(gesture_params));
+}
+
+/* Write handler for gesture characteristic: replace parameters */
+static ssize_t write_gesture_params(struct bt_conn *conn, const struct bt_gatt_attr *attr,
+				    const void *buf, uint16_t len, uint16_t offset, uint8_t flags)
+{
+	if (offset + len > sizeof(gesture_params)) {
+		return BT_GATT_ERR(BT_ATT_ERR_INVALID_OFFSET);
+	}
+
+	if (len != sizeof(gesture_params)) {
+		return BT_GATT_ERR(BT_ATT_ERR_INVALID_ATTRIBUTE_LEN);
+	}
+
+	if (!gesture_params_valid(buf)) {
+		LOG_WRN("Rejected gesture params: zero threshold");
+		return BT_GATT_ERR(BT_ATT_ERR_VALUE_NOT_ALLOWED);
+	}
+
+	memcpy(&gesture_params, buf, sizeof(gesture_params));
+	LOG_INF("Gesture params updated: near=%umm tap<=%ums hold>=%ums",
+		gesture_params.near_mm, gesture_params.tap_max_ms, gesture_params.hold_ms);
+
+	return len;
+}
+
+/* Read handler for mapping characteristic: current parameters */
+static ssize_t read_mapping(struct bt_conn *conn, const struct bt_gatt_attr *attr, void *buf,
+			    uint16_t len, uint16_t offset)
+{
+	return bt_gatt_attr_read(conn, attr, buf, len, offset, &map_config, sizeof(map_config));
+}
+
+/* Write handler for mapping characteristic: replace parameters */
+static ssize_t write_mapping(struct bt_conn *conn, const struct bt_gatt_attr *attr,
+			     const void *buf, uint16_t len, uint16_t offset, uint8_t flags)
+{
+	if (offset + len > sizeof(map_config)) {
+		return BT_GATT_ERR(BT_ATT_ERR_INVALID_OFFSET);
+	}
+
+	if (len != sizeof(map_config)) {
+		return BT_GATT_ERR(BT_ATT_ERR_INVALID_ATTRIBUTE_LEN);
+	}
+
+	if (!intensity_map_config_valid(buf)) {
+		LOG_WRN("Rejected mapping: min_range >= max_range");
+		return BT_GATT_ERR(BT_ATT_ERR_VALUE_NOT_ALLOWED);
+	}
+
+	memcpy(&map_config, buf, sizeof(map_config));
+	atomic_set(&mapper_reset, 1);
+	LOG_INF("Mapping updated: range=[%u-%u]mm invert=%u deadzone=%umm",
+		map_config.min_range_mm, map_config.max_range_mm, map_config.invert,
+		map_config.deadzone_mm);
+
+	return len;
+}
+
 /* Write handler for config characteristic */
 static ssize_t write_config(struct bt_conn *conn, const struct bt_gatt_attr *attr, const void *buf,
 			    uint16_t len, uint16_t offset, uint8_t flags)
@@ -58,25 +206,52 @@ static ssize_t write_config(struct bt_conn *conn, const struct bt_gatt_attr *att
 
 	const struct range_config *new_config = buf;
 
-	/* Validate ranges */
-	if (new_config->sample_interval_ms < 10 || new_config->sample_interval_ms > 5000) {
-		LOG_WRN("Rejected config: sample_interval_ms=%u out of range",
-			new_config->sample_interval_ms);
+	if (!range_config_valid(new_config, &config_status)) {
+		LOG_WRN("Rejected config: field %u error %u", config_status.errors[0].field,
+			config_status.errors[0].error);
 		return BT_GATT_ERR(BT_ATT_ERR_VALUE_NOT_ALLOWED);
 	}
 
-	if (new_config->notify_interval_ms < 10 || new_config->notify_interval_ms > 5000) {
-		LOG_WRN("Rejected config: notify_interval_ms=%u out of range",
-			new_config->notify_interval_ms);
-		return BT_GATT_ERR(BT_ATT_ERR_VALUE_NOT_ALLOWED);
+	memcpy(&active_config, new_config, sizeof(active_config));
+	LOG_INF("Config updated: sample=%ums notify=%ums range=[%u-%u]mm",
+		active_config.sample_interval_ms, active_config.notify_interval_ms,
+		active_config.min_range_mm, active_config.max_range_mm);
+
+	return len;
+}
+
+/* Read handler for TLV config characteristic: supported fields and last errors */
+static ssize_t read_config_tlv(struct bt_conn *conn, const struct bt_gatt_attr *attr, void *buf,
+			       uint16_t len, uint16_t offset)
+{
+	uint8_t tlv[RANGE_CONFIG_TLV_MAX_LEN];
+	size_t tlv_len = range_config_encode_tlv(&active_config, &config_status, tlv);
+
+	return bt_gatt_attr_read(conn, attr, buf, len, offset, tlv, tlv_len);
+}
+
+/* Write handler for TLV config characteristic: update any subset of fields */
+static ssize_t write_config_tlv(struct bt_conn *conn, const struct bt_gatt_attr *attr,
+				const void *buf, uint16_t len, uint16_t offset, uint8_t flags)
+{
+	if (offset != 0) {
+		return BT_GATT_ERR(BT_ATT_ERR_INVALID_OFFSET);
 	}
 
-	if (new_config->min_range_mm >= new_config->max_range_mm) {
-		LOG_WRN("Rejected config: min_range >= max_range");
+	int err = range_config_apply_tlv(&active_config, buf, len, &config_status);
+
+	if (err == -ENOTSUP) {
+		LOG_WRN("Rejected config: TLV version %u", len ? ((const uint8_t *)buf)[0] : 0);
+		return BT_GATT_ERR(BT_ATT_ERR_NOT_SUPPORTED);
+	} else if (err == -EBADMSG) {
+		LOG_WRN("Rejected config: truncated TLV record");
+		return BT_GATT_ERR(BT_ATT_ERR_INVALID_ATTRIBUTE_LEN);
+	} else if (err) {
+		LOG_WRN("Rejected config: %u bad fields, first %u error %u", config_status.count,
+			config_status.errors[0].field, config_status.errors[0].error);
 		return BT_GATT_ERR(BT_ATT_ERR_VALUE_NOT_ALLOWED);
 	}
 
-	memcpy(&active_config, new_config, sizeof(active_config));
 	LOG_INF("Config updated: sample=%ums notify=%ums range=[%u-%u]mm",
 		active_config.sample_interval_ms, active_config.notify_interval_ms,
 		active_config.min_range_mm, active_config.max_range_mm);
@@ -84,19 +259,79 @@ static ssize_t write_config(struct bt_conn *conn, const struct bt_gatt_attr *att
 	return len;
 }
 
+/* Write handler for time sync characteristic: stamp the arrival, echo it */
+static ssize_t write_time_sync(struct bt_conn *conn, const struct bt_gatt_attr *attr,
+			       const void *buf, uint16_t len, uint16_t offset, uint8_t flags)
+{
+	/* Stamp first, so nothing below adds to the measured delay */
+	uint64_t now_us = k_ticks_to_us_floor64(k_uptime_ticks());
+
+	if (offset != 0) {
+		return BT_GATT_ERR(BT_ATT_ERR_INVALID_OFFSET);
+	}
+
+	if (len != sizeof(time_sync.host_time)) {
+		return BT_GATT_ERR(BT_ATT_ERR_INVALID_ATTRIBUTE_LEN);
+	}
+
+	if (time_sync_notify_enabled) {
+		/* The host waits for one echo at a time, so a single slot is enough */
+		memcpy(&time_sync.host_time, buf, sizeof(time_sync.host_time));
+		time_sync.device_uptime_us = sys_cpu_to_le64(now_us);
+		k_work_submit(&time_sync_work);
+	}
+
+	return len;
+}
+
 /* GATT Service Declaration */
 BT_GATT_SERVICE_DEFINE(
     range_svc, BT_GATT_PRIMARY_SERVICE(RANGE_SERVICE_UUID),
 
     /* Range measurement: read + notify */
     BT_GATT_CHARACTERISTIC(RANGE_CHAR_UUID, BT_GATT_CHRC_READ | BT_GATT_CHRC_NOTIFY,
-			   BT_GATT_PERM_READ, read_range, NULL, &current_range_mm),
+			   BT_GATT_PERM_READ, read_range, NULL, &current_range),
     BT_GATT_CCC(range_ccc_changed, BT_GATT_PERM_READ | BT_GATT_PERM_WRITE),
 
     /* Configuration: read + write */
     BT_GATT_CHARACTERISTIC(RANGE_CONFIG_CHAR_UUID, BT_GATT_CHRC_READ | BT_GATT_CHRC_WRITE,
 			   BT_GATT_PERM_READ | BT_GATT_PERM_WRITE, read_config, write_config,
-			   &active_config), );
+			   &active_config),
+
+    /* Diagnostics: read */
+    BT_GATT_CHARACTERISTIC(RANGE_DIAG_CHAR_UUID, BT_GATT_CHRC_READ, BT_GATT_PERM_READ,
+			   read_diagnostics, NULL, NULL),
+
+    /* Gestures: notify events, read/write parameters */
+    BT_GATT_CHARACTERISTIC(RANGE_GESTURE_CHAR_UUID,
+			   BT_GATT_CHRC_READ | BT_GATT_CHRC_WRITE | BT_GATT_CHRC_NOTIFY,
+			   BT_GATT_PERM_READ | BT_GATT_PERM_WRITE, read_gesture_params,
+			   write_gesture_params, &gesture_params),
+    BT_GATT_CCC(gesture_ccc_changed, BT_GATT_PERM_READ | BT_GATT_PERM_WRITE),
+
+    /* Intensity mapping: notify intensity, read/write parameters */
+    BT_GATT_CHARACTERISTIC(RANGE_MAPPING_CHAR_UUID,
+			   BT_GATT_CHRC_READ | BT_GATT_CHRC_WRITE | BT_GATT_CHRC_NOTIFY,
+			   BT_GATT_PERM_READ | BT_GATT_PERM_WRITE, read_mapping, write_mapping,
+			   &map_config),
+    BT_GATT_CCC(mapping_ccc_changed, BT_GATT_PERM_READ | BT_GATT_PERM_WRITE),
+
+    /* Batched range: notify only */
+    BT_GATT_CHARACTERISTIC(RANGE_BATCH_CHAR_UUID, BT_GATT_CHRC_NOTIFY, BT_GATT_PERM_NONE, NULL,
+			   NULL, NULL),
+    BT_GATT_CCC(batch_ccc_changed, BT_GATT_PERM_READ | BT_GATT_PERM_WRITE),
+
+    /* TLV configuration: read supported fields, write any subset */
+    BT_GATT_CHARACTERISTIC(RANGE_CONFIG_TLV_CHAR_UUID, BT_GATT_CHRC_READ | BT_GATT_CHRC_WRITE,
+			   BT_GATT_PERM_READ | BT_GATT_PERM_WRITE, read_config_tlv,
+			   write_config_tlv, NULL),
+
+    /* Time sync: write a host timestamp, notify the echo */
+    BT_GATT_CHARACTERISTIC(RANGE_TIME_SYNC_CHAR_UUID,
+			   BT_GATT_CHRC_WRITE | BT_GATT_CHRC_WRITE_WITHOUT_RESP |
+			       BT_GATT_CHRC_NOTIFY,
+			   BT_GATT_PERM_WRITE, NULL, write_time_sync, NULL),
+    BT_GATT_CCC(time_sync_ccc_changed, BT_GATT_PERM_READ | BT_GATT_PERM_WRITE), );
 
 int range_service_init(void)
 {
@@ -104,19 +339,175 @@ int range_service_init(void)
 	return 0;
 }
 
-int range_service_update(uint16_t distance_mm)
+/* Notify all subscribers and count the bytes for energy accounting */
+static int notify(const struct bt_gatt_attr *attr, const void *data, uint16_t len)
+{
+	int err = bt_gatt_notify(NULL, attr, data, len);
+
+	if (err == 0) {
+		diagnostics_record_notify(len);
+	}
+	return err;
+}
+
+/* Notify from the workqueue, never from the BT RX thread that took the write */
+static void time_sync_echo_fn(struct k_work *work)
+{
+	ARG_UNUSED(work);
+
+	notify(&range_svc.attrs[19], &time_sync, sizeof(time_sync));
+}
+
+/* Map a sample on-device and notify the intensity byte */
+static int notify_intensity(const struct range_sample *sample)
 {
-	current_range_mm = distance_mm;
+	if (!mapping_notify_enabled) {
+		return 0;
+	}
+
+	/* Same rule as the middleware: samples with a failed status are dropped */
+	if (sample->range_status != RANGE_STATUS_VALID &&
+	    sample->range_status != RANGE_STATUS_NONE) {
+		return 0;
+	}
+
+	if (atomic_cas(&mapper_reset, 1, 0)) {
+		intensity_map_init(&mapper);
+	}
+
+	uint8_t intensity = intensity_map_apply(&mapper, &map_config, sample->distance_mm);
+
+	return notify(&range_svc.attrs[11], &intensity, sizeof(intensity));
+}
+
+static void min_mtu_cb(struct bt_conn *conn, void *data)
+{
+	uint16_t *mtu = data;
+
+	*mtu = MIN(*mtu, bt_gatt_get_mtu(conn));
+}
+
+/* Largest notification every connection can take */
+static size_t batch_limit(void)
+{
+	uint16_t mtu = UINT16_MAX;
+
+	bt_conn_foreach(BT_CONN_TYPE_LE, min_mtu_cb, &mtu);
+	return mtu > 3 ? mtu - 3 : 0;
+}
+
+static int flush_batch(void)
+{
+	int err = 0;
+
+	if (batch.count > 0) {
+		err = notify(&range_svc.attrs[14], batch.buf, batch.len);
+	}
+
+	range_batch_reset(&batch, batch_limit());
+	return err;
+}
+
+/* Add a sample to the batch, sending it when full or due */
+static int notify_batch(const struct range_sample *sample)
+{
+	if (!batch_notify_enabled) {
+		return 0;
+	}
+
+	if (atomic_cas(&batch_reset, 1, 0)) {
+		range_batch_reset(&batch, batch_limit());
+	}
+
+	/* Failed samples keep their slot so the timeline stays implicit */
+	uint16_t distance_mm = sample->distance_mm;
+	int err = 0;
+
+	if (sample->range_status != RANGE_STATUS_VALID &&
+	    sample->range_status != RANGE_STATUS_NONE) {
+		distance_mm = RANGE_BATCH_INVALID;
+	}
+
+	if (!range_batch_add(&batch, distance_mm, sample->timestamp_ms,
+			     active_config.sample_interval_ms)) {
+		err = flush_batch();
+		range_batch_add(&batch, distance_mm, sample->timestamp_ms,
+				active_config.sample_interval_ms);
+	}
+
+	if (range_batch_span_ms(&batch) >= active_config.notify_interval_ms) {
+		int ret = flush_batch();
+
+		err = err ? err : ret;
+	}
+
+	return err;
+}
+
+/* Update the range characteristic and notify it */
+static int notify_range(const struct range_sample *sample)
+{
+	/*
+	 * Without the quality fields a fault slot would go out as a bare
+	 * max_range_mm, which reads as a real "nothing in range". Keep the
+	 * last reading instead; the batch path still marks the slot invalid.
+	 */
+	if (!IS_ENABLED(CONFIG_RANGE_NOTIFY_QUALITY) &&
+	    sample->range_status == RANGE_STATUS_SENSOR_FAULT) {
+		return 0;
+	}
+
+	current_range.distance_mm = sys_cpu_to_le16(sample->distance_mm);
+	current_range.range_status = sample->range_status;
+	current_range.signal_rate_kcps = sys_cpu_to_le16(sample->signal_rate_kcps);
+	current_range.ambient_rate_kcps = sys_cpu_to_le16(sample->ambient_rate_kcps);
+	current_range.timestamp_ms = sys_cpu_to_le32(sample->timestamp_ms);
 
 	if (!range_notify_enabled) {
 		return 0;
 	}
 
-	return bt_gatt_notify(NULL, &range_svc.attrs[1], &current_range_mm,
-			      sizeof(current_range_mm));
+	return notify(&range_svc.attrs[1], &current_range, RANGE_PAYLOAD_LEN);
+}
+
+int range_service_update(const struct range_sample *sample)
+{
+	int err = notify_range(sample);
+	int ret = notify_intensity(sample);
+
+	err = err ? err : ret;
+	ret = notify_batch(sample);
+
+	return err ? err : ret;
 }
 
 const struct range_config *range_service_get_config(void)
 {
 	return &active_config;
 }
+
+int range_service_notify_gesture(const struct gesture_event *event)
+{
+	struct gesture_event payload = {
+	    .type = event->type,
+	    .count = event->count,
+	    .distance_mm = sys_cpu_to_le16(event->distance_mm),
+	    .velocity_mm_s = (int16_t)sys_cpu_to_le16(event->velocity_mm_s),
+	    .duration_ms = sys_cpu_to_le16(event->duration_ms),
+	    .timestamp_ms = sys_cpu_to_le32(event->timestamp_ms),
+	};
+
+	if (!gesture_notify_enabled) {
+		return 0;
+	}
+
+	/* attrs: 0 svc, 1-3 range, 4-5 config, 6-7 diagnostics, 8-10 gesture, 11-13 mapping,
+	 * 14-16 batch, 17-18 config TLV, 19-21 time sync
+	 */
+	return notify(&range_svc.attrs[8], &payload, sizeof(payload));
+}
+
+const struct gesture_params *range_service_get_gesture_params(void)
+{
+	return &gesture_params;
+}
@@ -6,6 +6,11 @@
 #include <zephyr/bluetooth/uuid.h>
 #include <zephyr/types.h>
 
+#include "gesture.h"
+#include "intensity_map.h"
+#include "range_batch.h"
+#include "range_config.h"
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -18,10 +23,29 @@ extern "C" {
  *
  * Service UUID:       00000001-7272-6e67-6669-6e6465720000
  * Range Char UUID:    00000002-7272-6e67-6669-6e6465720000
- *   - Notify: uint16_t distance in mm (little-endian)
- *   - Read:   last known distance in mm
+ *   - Notify: struct range_payload (little-endian), distance first
+ *   - Read:   last known struct range_payload
  * Config Char UUID:   00000003-7272-6e67-6669-6e6465720000
- *   - Read/Write: configuration struct
+ *   - Read/Write: struct range_config (legacy, all fields at once)
+ * Diagnostics UUID:   00000004-7272-6e67-6669-6e6465720000
+ *   - Read: struct diagnostics_payload
+ * Gesture Char UUID:  00000005-7272-6e67-6669-6e6465720000
+ *   - Notify:     struct gesture_event, sent as gestures are detected
+ *   - Read/Write: struct gesture_params
+ * Mapping Char UUID:  00000006-7272-6e67-6669-6e6465720000
+ *   - Notify:     uint8_t intensity (0-255), mapped on-device from each
+ *                 valid range sample while subscribed
+ *   - Read/Write: struct intensity_map_config
+ * Batch Char UUID:    00000007-7272-6e67-6669-6e6465720000
+ *   - Notify: delta-encoded run of samples (see range_batch.h), sent every
+ *             notify_interval_ms or when the ATT MTU is full
+ * Config TLV UUID:    0000000a-7272-6e67-6669-6e6465720000
+ *   - Write: versioned TLV records, any subset of fields (see range_config.h)
+ *   - Read:  supported fields with value and limits, last write's errors
+ * Time Sync UUID:     0000000b-7272-6e67-6669-6e6465720000
+ *   - Write:  uint64_t host timestamp, any epoch and unit
+ *   - Notify: struct time_sync_echo, the host timestamp with the device
+ *             uptime at which the write arrived
  */
 
 /* Service UUID */
@@ -38,12 +62,79 @@ extern "C" {
 	BT_UUID_128_ENCODE(0x00000003, 0x7272, 0x6e67, 0x6669, 0x6e6465720000)
 #define RANGE_CONFIG_CHAR_UUID BT_UUID_DECLARE_128(RANGE_CONFIG_CHAR_UUID_VAL)
 
-/* Configuration struct written/read via BLE */
-struct range_config {
-	uint16_t sample_interval_ms; /* sensor polling rate */
-	uint16_t notify_interval_ms; /* BLE notification rate */
-	uint16_t max_range_mm;	     /* clamp: ignore readings above this */
-	uint16_t min_range_mm;	     /* clamp: ignore readings below this */
+/* Diagnostics characteristic */
+#define RANGE_DIAG_CHAR_UUID_VAL                                                                   \
+	BT_UUID_128_ENCODE(0x00000004, 0x7272, 0x6e67, 0x6669, 0x6e6465720000)
+#define RANGE_DIAG_CHAR_UUID BT_UUID_DECLARE_128(RANGE_DIAG_CHAR_UUID_VAL)
+
+/* Gesture characteristic */
+#define RANGE_GESTURE_CHAR_UUID_VAL                                                                \
+	BT_UUID_128_ENCODE(0x00000005, 0x7272, 0x6e67, 0x6669, 0x6e6465720000)
+#define RANGE_GESTURE_CHAR_UUID BT_UUID_DECLARE_128(RANGE_GESTURE_CHAR_UUID_VAL)
+
+/* Intensity mapping characteristic */
+#define RANGE_MAPPING_CHAR_UUID_VAL                                                                \
+	BT_UUID_128_ENCODE(0x00000006, 0x7272, 0x6e67, 0x6669, 0x6e6465720000)
+#define RANGE_MAPPING_CHAR_UUID BT_UUID_DECLARE_128(RANGE_MAPPING_CHAR_UUID_VAL)
+
+/* Batched range characteristic */
+#define RANGE_BATCH_CHAR_UUID_VAL                                                                  \
+	BT_UUID_128_ENCODE(0x00000007, 0x7272, 0x6e67, 0x6669, 0x6e6465720000)
+#define RANGE_BATCH_CHAR_UUID BT_UUID_DECLARE_128(RANGE_BATCH_CHAR_UUID_VAL)
+
+/* TLV configuration characteristic */
+#define RANGE_CONFIG_TLV_CHAR_UUID_VAL                                                             \
+	BT_UUID_128_ENCODE(0x0000000a, 0x7272, 0x6e67, 0x6669, 0x6e6465720000)
+#define RANGE_CONFIG_TLV_CHAR_UUID BT_UUID_DECLARE_128(RANGE_CONFIG_TLV_CHAR_UUID_VAL)
+
+/* Time sync characteristic */
+#define RANGE_TIME_SYNC_CHAR_UUID_VAL                                                              \
+	BT_UUID_128_ENCODE(0x0000000b, 0x7272, 0x6e67, 0x6669, 0x6e6465720000)
+#define RANGE_TIME_SYNC_CHAR_UUID BT_UUID_DECLARE_128(RANGE_TIME_SYNC_CHAR_UUID_VAL)
+
+/*
+ * VL53L0X range status codes (ST API RangeStatus). Anything other than
+ * RANGE_STATUS_VALID means distance_mm should not be trusted.
+ */
+#define RANGE_STATUS_VALID 0
+#define RANGE_STATUS_SIGMA_FAIL 1
+#define RANGE_STATUS_SIGNAL_FAIL 2
+#define RANGE_STATUS_MIN_RANGE_FAIL 3
+#define RANGE_STATUS_PHASE_FAIL 4 /* wrap-around, reading is aliased */
+#define RANGE_STATUS_HW_FAIL 5
+#define RANGE_STATUS_SENSOR_FAULT 254 /* no reading: read failed or sensor recovering */
+#define RANGE_STATUS_NONE 255 /* no quality data available */
+
+/* One sensor reading with its quality fields */
+struct range_sample {
+	uint16_t distance_mm;
+	uint8_t range_status;	    /* RANGE_STATUS_* */
+	uint16_t signal_rate_kcps;  /* return signal rate, saturated */
+	uint16_t ambient_rate_kcps; /* ambient rate, saturated */
+	uint32_t timestamp_ms;	    /* uptime when the read started */
+};
+
+/*
+ * Range notification payload. The first two bytes are always the
+ * distance, so hosts that only read a uint16_t keep working. The quality
+ * fields and timestamp are only sent with CONFIG_RANGE_NOTIFY_QUALITY.
+ */
+struct range_payload {
+	uint16_t distance_mm;
+	uint8_t range_status;
+	uint16_t signal_rate_kcps;
+	uint16_t ambient_rate_kcps;
+	uint32_t timestamp_ms; /* uptime when the read started */
+} __packed;
+
+/*
+ * Time sync notification (LE). The host maps device uptime to its own
+ * clock from the round trip: host_time was sent at that host time, the
+ * echo arrives some time later, and device_uptime_us lies in between.
+ */
+struct time_sync_echo {
+	uint64_t host_time;	   /* as written by the host */
+	uint64_t device_uptime_us; /* when the write was received */
 } __packed;
 
 /**
@@ -54,10 +145,15 @@ int range_service_init(void);
 
 /**
  * @brief Update the range measurement and send notification if subscribed.
- * @param distance_mm Distance in millimeters from the VL53L0X.
+ *
+ * Also maps the sample to an intensity and notifies it when the mapping
+ * characteristic is subscribed, and adds it to the current batch when the
+ * batch characteristic is. Call from the sensor thread only.
+ *
+ * @param sample Latest reading from the VL53L0X (distance already clamped).
  * @return 0 on success, negative errno on failure.
  */
-int range_service_update(uint16_t distance_mm);
+int range_service_update(const struct range_sample *sample);
 
 /**
  * @brief Get the current configuration.
@@ -65,6 +161,19 @@ int range_service_update(uint16_t distance_mm);
  */
 const struct range_config *range_service_get_config(void);
 
+/**
+ * @brief Send a gesture notification if subscribed.
+ * @param event Gesture reported by the gesture engine.
+ * @return 0 on success, negative errno on failure.
+ */
+int range_service_notify_gesture(const struct gesture_event *event);
+
+/**
+ * @brief Get the current gesture engine parameters.
+ * @return Pointer to the active parameters.
+ */
+const struct gesture_params *range_service_get_gesture_params(void);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,462 @@
+#include "recorder.h"
+
+#include <errno.h>
+#include <zephyr/bluetooth/gatt.h>
+#include <zephyr/fs/fcb.h>
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/pm/device_runtime.h>
+#include <zephyr/storage/flash_map.h>
+#include <zephyr/sys/atomic.h>
+#include <zephyr/sys/byteorder.h>
+
+#include "diagnostics.h"
+
+LOG_MODULE_REGISTER(recorder, LOG_LEVEL_INF);
+
+#define RECORD_PARTITION_ID FIXED_PARTITION_ID(recording_partition)
+
+/* The QSPI flash, resumed while the recorder thread works on it */
+static const struct device *const flash_dev =
+	DEVICE_DT_GET(DT_MTD_FROM_FIXED_PARTITION(DT_NODELABEL(recording_partition)));
+
+/* Tags the ring's FCB sectors ("RREC") and the entry layout */
+#define RECORD_FCB_MAGIC 0x43455252
+#define RECORD_FCB_VERSION 1
+
+/* FCB counts sectors in a uint8_t */
+#define RECORD_MAX_SECTORS 255
+
+enum record_msg_type {
+	RECORD_MSG_ENTRY,
+	RECORD_MSG_DOWNLOAD,
+	RECORD_MSG_ERASE,
+};
+
+/* Work for the recorder thread; one queue keeps flash access in order */
+struct record_msg {
+	uint8_t type; /* RECORD_MSG_* */
+	uint8_t len;
+	uint8_t data[RECORD_ENTRY_MAX];
+};
+
+K_MSGQ_DEFINE(record_q, sizeof(struct record_msg), CONFIG_RANGE_RECORD_QUEUE, 4);
+
+static struct flash_sector sectors[RECORD_MAX_SECTORS];
+static struct fcb fcb;
+
+static atomic_t state = ATOMIC_INIT(RECORD_STATE_UNAVAILABLE);
+static atomic_t session;
+static atomic_t dropped;
+static atomic_t used_bytes;
+static uint32_t capacity_bytes;
+static bool record_notify_enabled;
+
+/*
+ * Entry being filled by the sensor thread. A command that stops recording
+ * closes it from the BT thread, hence the lock.
+ */
+static struct range_batch batch;
+static uint16_t batch_session;
+K_MUTEX_DEFINE(batch_lock);
+
+/* Send the filled entry to the recorder thread (batch_lock held) */
+static void queue_batch(void)
+{
+	struct record_msg msg = {
+	    .type = RECORD_MSG_ENTRY,
+	    .len = sizeof(uint16_t) + batch.len,
+	};
+
+	sys_put_le16(batch_session, msg.data);
+	memcpy(&msg.data[sizeof(uint16_t)], batch.buf, batch.len);
+
+	/* Flash is behind (long erase): lose this entry, never stall sampling */
+	if (k_msgq_put(&record_q, &msg, K_NO_WAIT)) {
+		atomic_add(&dropped, batch.count);
+	}
+
+	range_batch_reset(&batch, RECORD_BATCH_LEN);
+}
+
+static void record_ccc_changed(const struct bt_gatt_attr *attr, uint16_t value)
+{
+	record_notify_enabled = (value == BT_GATT_CCC_NOTIFY);
+	LOG_INF("Record notifications %s", record_notify_enabled ? "enabled" : "disabled");
+}
+
+static ssize_t read_status(struct bt_conn *conn, const struct bt_gatt_attr *attr, void *buf,
+			   uint16_t len, uint16_t offset)
+{
+	struct record_status status = {
+	    .state = (uint8_t)atomic_get(&state),
+	    .session = sys_cpu_to_le16((uint16_t)atomic_get(&session)),
+	    .used_bytes = sys_cpu_to_le32((uint32_t)atomic_get(&used_bytes)),
+	    .capacity_bytes = sys_cpu_to_le32(capacity_bytes),
+	    .dropped = sys_cpu_to_le32((uint32_t)atomic_get(&dropped)),
+	};
+
+	return bt_gatt_attr_read(conn, attr, buf, len, offset, &status, sizeof(status));
+}
+
+/*
+ * Hand a download or erase to the recorder thread, stopping recording
+ * first. The entry still being filled is queued ahead of the command, so
+ * an erase takes it too and a download includes the end of the session.
+ */
+static ssize_t queue_command(enum record_msg_type type, enum record_state next)
+{
+	struct record_msg msg = {.type = type};
+	ssize_t err = 0;
+
+	k_mutex_lock(&batch_lock, K_FOREVER);
+
+	if (!atomic_cas(&state, RECORD_STATE_IDLE, next) &&
+	    !atomic_cas(&state, RECORD_STATE_RECORDING, next)) {
+		err = BT_GATT_ERR(BT_ATT_ERR_PROCEDURE_IN_PROGRESS);
+		goto unlock;
+	}
+
+	if (batch.count > 0) {
+		queue_batch();
+	}
+
+	if (k_msgq_put(&record_q, &msg, K_NO_WAIT)) {
+		atomic_set(&state, RECORD_STATE_IDLE);
+		err = BT_GATT_ERR(BT_ATT_ERR_INSUFFICIENT_RESOURCES);
+	}
+
+unlock:
+	k_mutex_unlock(&batch_lock);
+	return err;
+}
+
+static ssize_t write_command(struct bt_conn *conn, const struct bt_gatt_attr *attr,
+			     const void *buf, uint16_t len, uint16_t offset, uint8_t flags)
+{
+	if (offset != 0) {
+		return BT_GATT_ERR(BT_ATT_ERR_INVALID_OFFSET);
+	}
+
+	if (len != 1) {
+		return BT_GATT_ERR(BT_ATT_ERR_INVALID_ATTRIBUTE_LEN);
+	}
+
+	ssize_t err = 0;
+
+	switch (*(const uint8_t *)buf) {
+	case RECORD_CMD_STOP:
+		if (atomic_cas(&state, RECORD_STATE_RECORDING, RECORD_STATE_IDLE)) {
+			LOG_INF("Recording session %u stopped", (uint16_t)atomic_get(&session));
+		}
+		break;
+	case RECORD_CMD_START:
+		if (atomic_get(&state) == RECORD_STATE_RECORDING) {
+			break;
+		}
+		if (atomic_get(&state) != RECORD_STATE_IDLE) {
+			return BT_GATT_ERR(BT_ATT_ERR_PROCEDURE_IN_PROGRESS);
+		}
+		/* Bump the session first so no sample lands in the old one */
+		atomic_set(&session, (uint16_t)(atomic_get(&session) + 1));
+		atomic_set(&state, RECORD_STATE_RECORDING);
+		LOG_INF("Recording session %u started", (uint16_t)atomic_get(&session));
+		break;
+	case RECORD_CMD_DOWNLOAD:
+		if (bt_gatt_get_mtu(conn) < RECORD_ENTRY_MAX + 3) {
+			LOG_WRN("Download needs an ATT MTU of %u (have %u)", RECORD_ENTRY_MAX + 3,
+				bt_gatt_get_mtu(conn));
+			return BT_GATT_ERR(BT_ATT_ERR_UNLIKELY);
+		}
+		err = queue_command(RECORD_MSG_DOWNLOAD, RECORD_STATE_DOWNLOADING);
+		break;
+	case RECORD_CMD_ERASE:
+		err = queue_command(RECORD_MSG_ERASE, RECORD_STATE_ERASING);
+		break;
+	default:
+		return BT_GATT_ERR(BT_ATT_ERR_VALUE_NOT_ALLOWED);
+	}
+
+	return err ? err : len;
+}
+
+BT_GATT_SERVICE_DEFINE(record_svc, BT_GATT_PRIMARY_SERVICE(RECORD_SERVICE_UUID),
+		       BT_GATT_CHARACTERISTIC(RECORD_CHAR_UUID,
+					      BT_GATT_CHRC_READ | BT_GATT_CHRC_WRITE |
+						  BT_GATT_CHRC_NOTIFY,
+					      BT_GATT_PERM_READ | BT_GATT_PERM_WRITE, read_status,
+					      write_command, NULL),
+		       BT_GATT_CCC(record_ccc_changed, BT_GATT_PERM_READ | BT_GATT_PERM_WRITE), );
+
+static void update_used_bytes(void)
+{
+	if (fcb_is_empty(&fcb)) {
+		atomic_set(&used_bytes, 0);
+		return;
+	}
+
+	uint32_t oldest = fcb.f_oldest - sectors;
+	uint32_t active = fcb.f_active.fe_sector - sectors;
+	uint32_t full = (active + fcb.f_sector_cnt - oldest) % fcb.f_sector_cnt;
+
+	atomic_set(&used_bytes, full * sectors[0].fs_size + fcb.f_active.fe_elem_off);
+}
+
+static int append_entry(const uint8_t *data, uint16_t len)
+{
+	struct fcb_entry loc;
+	int err = fcb_append(&fcb, len, &loc);
+
+	if (err == -ENOSPC) {
+		/* Ring is full: give up the oldest sector */
+		err = fcb_rotate(&fcb);
+		if (!err) {
+			err = fcb_append(&fcb, len, &loc);
+		}
+	}
+	if (err) {
+		return err;
+	}
+
+	err = flash_area_write(fcb.fap, FCB_ENTRY_FA_DATA_OFF(loc), data, len);
+	if (err) {
+		return err;
+	}
+
+	return fcb_append_finish(&fcb, &loc);
+}
+
+static int notify_entry(const void *data, uint16_t len)
+{
+	while (record_notify_enabled) {
+		int err = bt_gatt_notify(NULL, &record_svc.attrs[1], data, len);
+
+		if (err == 0) {
+			diagnostics_record_notify(len);
+		}
+		/* Out of buffers: the link is the bottleneck, wait for it */
+		if (err != -ENOMEM) {
+			return err;
+		}
+		k_sleep(K_MSEC(10));
+	}
+
+	return -ENOTCONN;
+}
+
+static void download(void)
+{
+	struct fcb_entry loc = {0};
+	uint8_t buf[RECORD_ENTRY_MAX];
+	uint32_t sent = 0;
+	int err = 0;
+
+	while (fcb_getnext(&fcb, &loc) == 0) {
+		if (loc.fe_data_len > sizeof(buf)) {
+			continue;
+		}
+
+		err = flash_area_read(fcb.fap, FCB_ENTRY_FA_DATA_OFF(loc), buf, loc.fe_data_len);
+		if (!err) {
+			err = notify_entry(buf, loc.fe_data_len);
+		}
+		if (err) {
+			break;
+		}
+		sent++;
+	}
+
+	if (err) {
+		LOG_WRN("Download aborted after %u entries (err %d)", sent, err);
+		return;
+	}
+
+	uint8_t end[2];
+
+	sys_put_le16(RECORD_DOWNLOAD_END, end);
+	notify_entry(end, sizeof(end));
+	LOG_INF("Downloaded %u entries", sent);
+}
+
+static int find_last_session(struct fcb_entry_ctx *ctx, void *arg)
+{
+	uint16_t *last = arg;
+	uint8_t buf[2];
+
+	if (ctx->loc.fe_data_len >= sizeof(buf) &&
+	    flash_area_read(ctx->fap, FCB_ENTRY_FA_DATA_OFF(ctx->loc), buf, sizeof(buf)) == 0) {
+		*last = sys_get_le16(buf);
+	}
+
+	return 0;
+}
+
+static int mount(void)
+{
+	const struct flash_area *fa;
+	int err = flash_area_open(RECORD_PARTITION_ID, &fa);
+
+	if (err) {
+		return err;
+	}
+
+	size_t count = MIN(fa->fa_size / CONFIG_RANGE_RECORD_SECTOR_SIZE, RECORD_MAX_SECTORS);
+
+	flash_area_close(fa);
+	if (count < 2) {
+		return -ENOSPC;
+	}
+
+	for (size_t i = 0; i < count; i++) {
+		sectors[i].fs_off = i * CONFIG_RANGE_RECORD_SECTOR_SIZE;
+		sectors[i].fs_size = CONFIG_RANGE_RECORD_SECTOR_SIZE;
+	}
+
+	fcb.f_magic = RECORD_FCB_MAGIC;
+	fcb.f_version = RECORD_FCB_VERSION;
+	fcb.f_sector_cnt = count;
+	fcb.f_scratch_cnt = 0;
+	fcb.f_sectors = sectors;
+	capacity_bytes = count * CONFIG_RANGE_RECORD_SECTOR_SIZE;
+
+	err = fcb_init(RECORD_PARTITION_ID, &fcb);
+	if (err) {
+		/* Another layout, or a CircuitPython filesystem */
+		LOG_WRN("No recording ring found (err %d), formatting %u KiB", err,
+			capacity_bytes / 1024);
+		err = flash_area_open(RECORD_PARTITION_ID, &fa);
+		if (err) {
+			return err;
+		}
+		err = flash_area_erase(fa, 0, capacity_bytes);
+		flash_area_close(fa);
+		if (err) {
+			return err;
+		}
+		err = fcb_init(RECORD_PARTITION_ID, &fcb);
+		if (err) {
+			return err;
+		}
+	}
+
+	uint16_t last = 0;
+
+	fcb_walk(&fcb, NULL, find_last_session, &last);
+	atomic_set(&session, last);
+	update_used_bytes();
+
+	return 0;
+}
+
+static void recorder_thread_fn(void *p1, void *p2, void *p3)
+{
+	ARG_UNUSED(p1);
+	ARG_UNUSED(p2);
+	ARG_UNUSED(p3);
+
+	int err = pm_device_runtime_get(flash_dev);
+
+	if (!err) {
+		err = mount();
+		pm_device_runtime_put(flash_dev);
+	}
+	if (err) {
+		LOG_ERR("Recording flash unavailable (err %d)", err);
+		return;
+	}
+
+	LOG_INF("Recorder ready: %u of %u KiB used, last session %u",
+		(uint32_t)atomic_get(&used_bytes) / 1024, capacity_bytes / 1024,
+		(uint16_t)atomic_get(&session));
+
+	if (IS_ENABLED(CONFIG_RANGE_RECORD_AUTOSTART)) {
+		atomic_set(&session, (uint16_t)(atomic_get(&session) + 1));
+		atomic_set(&state, RECORD_STATE_RECORDING);
+	} else {
+		atomic_set(&state, RECORD_STATE_IDLE);
+	}
+
+	while (1) {
+		struct record_msg msg;
+
+		k_msgq_get(&record_q, &msg, K_FOREVER);
+
+		/* If the resume fails, the flash calls below fail and say so */
+		bool resumed = pm_device_runtime_get(flash_dev) == 0;
+
+		switch (msg.type) {
+		case RECORD_MSG_ENTRY:
+			err = append_entry(msg.data, msg.len);
+			if (err) {
+				LOG_ERR("Recording write failed (err %d)", err);
+			}
+			update_used_bytes();
+			break;
+		case RECORD_MSG_DOWNLOAD:
+			download();
+			atomic_set(&state, RECORD_STATE_IDLE);
+			break;
+		case RECORD_MSG_ERASE:
+			err = fcb_clear(&fcb);
+			if (err) {
+				LOG_ERR("Recording erase failed (err %d)", err);
+			}
+			update_used_bytes();
+			atomic_set(&state, RECORD_STATE_IDLE);
+			LOG_INF("Recording erased");
+			break;
+		}
+
+		if (resumed) {
+			pm_device_runtime_put(flash_dev);
+		}
+	}
+}
+
+K_THREAD_STACK_DEFINE(recorder_stack, 2048);
+static struct k_thread recorder_thread;
+
+int recorder_init(void)
+{
+	range_batch_reset(&batch, RECORD_BATCH_LEN);
+
+	k_thread_create(&recorder_thread, recorder_stack, K_THREAD_STACK_SIZEOF(recorder_stack),
+			recorder_thread_fn, NULL, NULL, NULL, K_PRIO_PREEMPT(12), 0, K_NO_WAIT);
+	k_thread_name_set(&recorder_thread, "recorder");
+
+	return 0;
+}
+
+void recorder_push(const struct range_sample *sample)
+{
+	k_mutex_lock(&batch_lock, K_FOREVER);
+
+	uint16_t current = (uint16_t)atomic_get(&session);
+
+	/* Stopped, or a new session: close what was being filled */
+	if (batch.count > 0 &&
+	    (atomic_get(&state) != RECORD_STATE_RECORDING || batch_session != current)) {
+		queue_batch();
+	}
+
+	if (atomic_get(&state) != RECORD_STATE_RECORDING) {
+		k_mutex_unlock(&batch_lock);
+		return;
+	}
+
+	uint16_t distance_mm = sample->distance_mm;
+	uint16_t interval_ms = range_service_get_config()->sample_interval_ms;
+
+	if (sample->range_status != RANGE_STATUS_VALID &&
+	    sample->range_status != RANGE_STATUS_NONE) {
+		distance_mm = RANGE_BATCH_INVALID;
+	}
+
+	batch_session = current;
+	if (!range_batch_add(&batch, distance_mm, sample->timestamp_ms, interval_ms)) {
+		queue_batch();
+		range_batch_add(&batch, distance_mm, sample->timestamp_ms, interval_ms);
+	}
+
+	k_mutex_unlock(&batch_lock);
+}
@@ -0,0 +1,95 @@
+#ifndef RECORDER_H
+#define RECORDER_H
+
+#include <zephyr/bluetooth/uuid.h>
+#include <zephyr/types.h>
+
+#include "range_batch.h"
+#include "range_service.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Session recorder on the Feather's 2 MB QSPI flash
+ *
+ * Samples are packed into the same delta-encoded runs as batch
+ * notifications (range_batch.h) and appended as entries to a flash
+ * circular buffer (FCB) on the "recording" partition. The sensor thread
+ * only fills RAM: whole entries go through a queue to the recorder
+ * thread, which does the flash writes, so sampling and the notify path
+ * never wait on a program or erase. When the partition is full the
+ * oldest sector is erased and reused. Each entry is
+ *
+ *   [0]  uint16_t session (LE), bumped by every RECORD_CMD_START
+ *   [2]  range_batch payload of up to RECORD_BATCH_LEN bytes
+ *
+ * Record Service UUID: 00000008-7272-6e67-6669-6e6465720000
+ * Record Char UUID:    00000009-7272-6e67-6669-6e6465720000
+ *   - Write:  uint8_t RECORD_CMD_*
+ *   - Read:   struct record_status
+ *   - Notify: during a download, one entry per notification, oldest
+ *             first, then RECORD_DOWNLOAD_END. Needs an ATT MTU of at
+ *             least RECORD_ENTRY_MAX + 3.
+ */
+
+#define RECORD_SERVICE_UUID_VAL                                                                    \
+	BT_UUID_128_ENCODE(0x00000008, 0x7272, 0x6e67, 0x6669, 0x6e6465720000)
+#define RECORD_SERVICE_UUID BT_UUID_DECLARE_128(RECORD_SERVICE_UUID_VAL)
+
+#define RECORD_CHAR_UUID_VAL BT_UUID_128_ENCODE(0x00000009, 0x7272, 0x6e67, 0x6669, 0x6e6465720000)
+#define RECORD_CHAR_UUID BT_UUID_DECLARE_128(RECORD_CHAR_UUID_VAL)
+
+/* Entry size limits: a whole entry fits one notification at ATT MTU 247 */
+#define RECORD_ENTRY_MAX RANGE_BATCH_BUF_LEN
+#define RECORD_BATCH_LEN (RECORD_ENTRY_MAX - 2)
+
+/* Notification that ends a download (no entry is this short) */
+#define RECORD_DOWNLOAD_END 0xFFFF
+
+/* Commands written to the record characteristic */
+enum record_command {
+	RECORD_CMD_STOP = 0,
+	RECORD_CMD_START = 1,
+	RECORD_CMD_DOWNLOAD = 2, /* stops recording first */
+	RECORD_CMD_ERASE = 3,    /* stops recording first */
+};
+
+enum record_state {
+	RECORD_STATE_UNAVAILABLE = 0, /* no flash, or still mounting */
+	RECORD_STATE_IDLE = 1,
+	RECORD_STATE_RECORDING = 2,
+	RECORD_STATE_DOWNLOADING = 3,
+	RECORD_STATE_ERASING = 4,
+};
+
+/* Record characteristic read payload (little-endian) */
+struct record_status {
+	uint8_t state;		 /* RECORD_STATE_* */
+	uint16_t session;	 /* current or last session */
+	uint32_t used_bytes;	 /* flash taken by entries */
+	uint32_t capacity_bytes; /* size of the ring */
+	uint32_t dropped;	 /* samples lost to a full write queue */
+} __packed;
+
+/**
+ * @brief Start the recorder thread, which mounts the flash ring.
+ * @return 0 on success, negative errno on failure.
+ */
+int recorder_init(void);
+
+/**
+ * @brief Add one sample to the recording if one is running.
+ *
+ * Call from the sensor thread only. Never touches flash.
+ *
+ * @param sample Reading as returned by the sensor, timestamp filled in.
+ */
+void recorder_push(const struct range_sample *sample);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* RECORDER_H */
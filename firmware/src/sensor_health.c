@@ -0,0 +1,72 @@
+#include "sensor_health.h"
+
+#include <string.h>
+#include <zephyr/sys/util.h>
+
+/* Wrap-safe "a is at or after b" for ms uptimes */
+static bool time_reached(uint32_t a, uint32_t b)
+{
+	return (int32_t)(a - b) >= 0;
+}
+
+void sensor_health_init(struct sensor_health *health, const struct sensor_health_params *params)
+{
+	memset(health, 0, sizeof(*health));
+	health->params = *params;
+	health->params.fail_threshold = MAX(params->fail_threshold, 1);
+	health->params.backoff_max_ms = MAX(params->backoff_max_ms, params->backoff_min_ms);
+	health->backoff_ms = health->params.backoff_min_ms;
+}
+
+bool sensor_health_should_read(const struct sensor_health *health, uint32_t now_ms)
+{
+	return health->state != SENSOR_HEALTH_RECOVERING ||
+	       time_reached(now_ms, health->retry_at_ms);
+}
+
+enum sensor_health_action sensor_health_report(struct sensor_health *health, bool ok,
+					       uint32_t now_ms)
+{
+	if (ok) {
+		bool was_failing = health->state != SENSOR_HEALTH_OK;
+
+		health->state = SENSOR_HEALTH_OK;
+		health->consecutive_failures = 0;
+		health->backoff_ms = health->params.backoff_min_ms;
+		return was_failing ? SENSOR_HEALTH_RECOVERED : SENSOR_HEALTH_NONE;
+	}
+
+	if (health->consecutive_failures == 0) {
+		health->fault_since_ms = now_ms;
+	}
+	if (health->consecutive_failures < UINT16_MAX) {
+		health->consecutive_failures++;
+	}
+
+	if (health->consecutive_failures < health->params.fail_threshold) {
+		health->state = SENSOR_HEALTH_FAILING;
+		return SENSOR_HEALTH_NONE;
+	}
+
+	health->state = SENSOR_HEALTH_RECOVERING;
+	health->retry_at_ms = now_ms + health->backoff_ms;
+	health->backoff_ms = MIN(health->backoff_ms * 2, health->params.backoff_max_ms);
+	health->recoveries++;
+	return SENSOR_HEALTH_RECOVER;
+}
+
+bool sensor_health_log_allowed(struct sensor_health *health, uint32_t now_ms,
+			       uint32_t *suppressed)
+{
+	if (health->logged &&
+	    !time_reached(now_ms, health->last_log_ms + health->params.log_interval_ms)) {
+		health->suppressed_logs++;
+		return false;
+	}
+
+	*suppressed = health->suppressed_logs;
+	health->suppressed_logs = 0;
+	health->last_log_ms = now_ms;
+	health->logged = true;
+	return true;
+}
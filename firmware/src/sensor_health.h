@@ -0,0 +1,96 @@
+#ifndef SENSOR_HEALTH_H
+#define SENSOR_HEALTH_H
+
+#include <stdbool.h>
+#include <zephyr/types.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Sensor fault tracking
+ *
+ * Counts consecutive failed reads. Once fail_threshold reads in a row
+ * have failed, the caller is told to recover the sensor (clear the I2C
+ * bus, re-init the VL53L0X). Reads are then held off for a backoff that
+ * starts at backoff_min_ms and doubles after every recovery that doesn't
+ * bring the sensor back, up to backoff_max_ms. The first good read
+ * returns everything to normal.
+ *
+ * All times are ms uptime and may wrap.
+ */
+
+enum sensor_health_state {
+	SENSOR_HEALTH_OK = 0,
+	SENSOR_HEALTH_FAILING = 1,    /* reads failing, below the threshold */
+	SENSOR_HEALTH_RECOVERING = 2, /* recovered, waiting out the backoff */
+};
+
+enum sensor_health_action {
+	SENSOR_HEALTH_NONE,
+	SENSOR_HEALTH_RECOVER,	 /* clear the bus and re-init the sensor now */
+	SENSOR_HEALTH_RECOVERED, /* good read after one or more failures */
+};
+
+struct sensor_health_params {
+	uint16_t fail_threshold;  /* consecutive failures before a recovery */
+	uint32_t backoff_min_ms;  /* wait after the first recovery */
+	uint32_t backoff_max_ms;  /* longest wait between recoveries */
+	uint32_t log_interval_ms; /* at most one fault log line per interval */
+};
+
+struct sensor_health {
+	struct sensor_health_params params;
+	uint8_t state;		       /* SENSOR_HEALTH_* */
+	uint16_t consecutive_failures; /* saturating */
+	uint32_t recoveries;	       /* recoveries requested since boot */
+	uint32_t backoff_ms;	       /* wait after the next recovery */
+	uint32_t retry_at_ms;	       /* no reads before this while recovering */
+	uint32_t fault_since_ms;       /* first failure of the current run */
+	uint32_t last_log_ms;
+	uint32_t suppressed_logs;
+	bool logged;
+};
+
+/**
+ * @brief Reset the tracker to a healthy sensor.
+ * @param health Tracker to reset.
+ * @param params Thresholds and backoff limits (copied).
+ */
+void sensor_health_init(struct sensor_health *health, const struct sensor_health_params *params);
+
+/**
+ * @brief Whether the sensor should be read in this sample slot.
+ * @param health Tracker.
+ * @param now_ms Current uptime.
+ * @return false while a recovery backoff is running.
+ */
+bool sensor_health_should_read(const struct sensor_health *health, uint32_t now_ms);
+
+/**
+ * @brief Record the result of a read.
+ * @param health Tracker.
+ * @param ok Whether the read produced a sample.
+ * @param now_ms Uptime of the read.
+ * @return What the caller should do next.
+ */
+enum sensor_health_action sensor_health_report(struct sensor_health *health, bool ok,
+					       uint32_t now_ms);
+
+/**
+ * @brief Rate limit for fault log lines.
+ * @param health Tracker.
+ * @param now_ms Current uptime.
+ * @param suppressed Set to the number of lines held back since the last
+ *                   one allowed, when this returns true.
+ * @return true if a line may be logged now.
+ */
+bool sensor_health_log_allowed(struct sensor_health *health, uint32_t now_ms,
+			       uint32_t *suppressed);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SENSOR_HEALTH_H */
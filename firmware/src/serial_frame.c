@@ -0,0 +1,24 @@
+#include "serial_frame.h"
+
+#include <string.h>
+#include <zephyr/sys/byteorder.h>
+#include <zephyr/sys/crc.h>
+
+size_t serial_frame_encode(uint8_t *out, uint8_t type, const void *payload, uint8_t len)
+{
+	out[0] = SERIAL_FRAME_SYNC0;
+	out[1] = SERIAL_FRAME_SYNC1;
+	out[2] = type;
+	out[3] = len;
+	/* payload may be NULL for an empty frame, which memcpy doesn't allow */
+	if (len > 0) {
+		memcpy(&out[4], payload, len);
+	}
+
+	/* Sync bytes are left out so the CRC only vouches for what they frame */
+	uint16_t crc = crc16_itu_t(0xFFFF, &out[2], len + 2);
+
+	sys_put_le16(crc, &out[4 + len]);
+
+	return len + SERIAL_FRAME_OVERHEAD;
+}
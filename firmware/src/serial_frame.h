@@ -0,0 +1,57 @@
+#ifndef SERIAL_FRAME_H
+#define SERIAL_FRAME_H
+
+#include <stddef.h>
+#include <zephyr/types.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Binary frames for the wired (USB CDC) sample stream
+ *
+ *   [0]    0xA5 0x5A sync
+ *   [2]    uint8_t type (SERIAL_FRAME_*)
+ *   [3]    uint8_t payload length
+ *   [4..]  payload
+ *   [n-2]  uint16_t CRC-16/CCITT-FALSE of type, length and payload (LE)
+ *
+ * A reader that loses its place scans for the next sync pair and drops
+ * anything whose CRC does not match, so a frame is never misread even if
+ * the payload happens to contain the sync bytes.
+ */
+
+#define SERIAL_FRAME_SYNC0 0xA5
+#define SERIAL_FRAME_SYNC1 0x5A
+#define SERIAL_FRAME_OVERHEAD 6
+#define SERIAL_FRAME_MAX_PAYLOAD 255
+
+/* Frame types */
+#define SERIAL_FRAME_SAMPLE 0x01
+
+/* SERIAL_FRAME_SAMPLE payload (LE) */
+struct serial_frame_sample {
+	uint16_t seq; /* per sample, wraps; gaps are frames dropped on a full buffer */
+	uint32_t timestamp_ms;
+	uint16_t distance_mm; /* as read, not clamped to the config range */
+	uint8_t range_status;
+	uint16_t signal_rate_kcps;
+	uint16_t ambient_rate_kcps;
+} __packed;
+
+/**
+ * @brief Build one frame.
+ * @param out Buffer of at least len + SERIAL_FRAME_OVERHEAD bytes.
+ * @param type Frame type.
+ * @param payload Payload bytes.
+ * @param len Payload length.
+ * @return Frame length.
+ */
+size_t serial_frame_encode(uint8_t *out, uint8_t type, const void *payload, uint8_t len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SERIAL_FRAME_H */
@@ -0,0 +1,99 @@
+#include "usb_stream.h"
+
+#include <errno.h>
+#include <zephyr/device.h>
+#include <zephyr/drivers/uart.h>
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/sys/byteorder.h>
+#include <zephyr/sys/ring_buffer.h>
+
+#include "serial_frame.h"
+
+LOG_MODULE_REGISTER(usb_stream, LOG_LEVEL_INF);
+
+static const struct device *const stream_dev = DEVICE_DT_GET(DT_NODELABEL(stream_cdc_acm));
+
+/* Frames waiting for the USB endpoint, drained from the UART ISR */
+RING_BUF_DECLARE(tx_ring, CONFIG_RANGE_USB_STREAM_BUF);
+static struct k_spinlock tx_lock;
+
+static uint16_t next_seq;
+
+static void uart_isr(const struct device *dev, void *user_data)
+{
+	ARG_UNUSED(user_data);
+
+	while (uart_irq_update(dev) && uart_irq_is_pending(dev)) {
+		if (uart_irq_tx_ready(dev)) {
+			k_spinlock_key_t key = k_spin_lock(&tx_lock);
+			uint8_t *data;
+			uint32_t len =
+				ring_buf_get_claim(&tx_ring, &data, CONFIG_RANGE_USB_STREAM_BUF);
+			int sent = len > 0 ? uart_fifo_fill(dev, data, len) : 0;
+
+			ring_buf_get_finish(&tx_ring, MAX(sent, 0));
+			if (ring_buf_is_empty(&tx_ring)) {
+				uart_irq_tx_disable(dev);
+			}
+			k_spin_unlock(&tx_lock, key);
+		}
+	}
+}
+
+int usb_stream_init(void)
+{
+	if (!device_is_ready(stream_dev)) {
+		LOG_ERR("Stream CDC ACM device not ready");
+		return -ENODEV;
+	}
+
+	int err = uart_irq_callback_user_data_set(stream_dev, uart_isr, NULL);
+
+	if (err) {
+		LOG_ERR("Stream UART IRQ setup failed (err %d)", err);
+		return err;
+	}
+
+	LOG_INF("Wired stream on %s", stream_dev->name);
+	return 0;
+}
+
+static bool host_listening(void)
+{
+	uint32_t dtr = 0;
+
+	return uart_line_ctrl_get(stream_dev, UART_LINE_CTRL_DTR, &dtr) == 0 && dtr;
+}
+
+void usb_stream_push(const struct range_sample *sample)
+{
+	uint16_t seq = next_seq++;
+
+	if (!host_listening()) {
+		return;
+	}
+
+	struct serial_frame_sample payload = {
+	    .seq = sys_cpu_to_le16(seq),
+	    .timestamp_ms = sys_cpu_to_le32(sample->timestamp_ms),
+	    .distance_mm = sys_cpu_to_le16(sample->distance_mm),
+	    .range_status = sample->range_status,
+	    .signal_rate_kcps = sys_cpu_to_le16(sample->signal_rate_kcps),
+	    .ambient_rate_kcps = sys_cpu_to_le16(sample->ambient_rate_kcps),
+	};
+	uint8_t frame[sizeof(payload) + SERIAL_FRAME_OVERHEAD];
+	size_t len = serial_frame_encode(frame, SERIAL_FRAME_SAMPLE, &payload, sizeof(payload));
+
+	/* Whole frames or nothing, so the host never has to resync */
+	k_spinlock_key_t key = k_spin_lock(&tx_lock);
+
+	if (ring_buf_space_get(&tx_ring) >= len) {
+		ring_buf_put(&tx_ring, frame, len);
+	} else {
+		LOG_DBG("Wired stream backed up, sample %u dropped", seq);
+	}
+	k_spin_unlock(&tx_lock, key);
+
+	uart_irq_tx_enable(stream_dev);
+}
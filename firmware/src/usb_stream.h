@@ -0,0 +1,40 @@
+#ifndef USB_STREAM_H
+#define USB_STREAM_H
+
+#include "range_service.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Wired sample stream on a second USB CDC ACM interface
+ *
+ * For tethered setups: every sample goes out as soon as it is read, as a
+ * SERIAL_FRAME_SAMPLE frame (serial_frame.h), with no BLE connection
+ * interval in the way. The first CDC interface keeps the log console.
+ * Frames are only sent while the host holds DTR (has the port open);
+ * if the host stops reading, whole frames are dropped, which it sees as
+ * a gap in seq.
+ */
+
+/**
+ * @brief Set up the stream's CDC ACM UART.
+ * @return 0 on success, negative errno on failure.
+ */
+int usb_stream_init(void);
+
+/**
+ * @brief Queue one sample for the host if the port is open.
+ *
+ * Call from the sensor thread only. Never blocks.
+ *
+ * @param sample Reading as returned by the sensor, timestamp filled in.
+ */
+void usb_stream_push(const struct range_sample *sample);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* USB_STREAM_H */
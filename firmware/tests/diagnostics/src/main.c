@@ -0,0 +1,72 @@
+/*
+ * Diagnostics counter tests: the jitter histogram and the deadline miss
+ * counter. The counters live for the whole run, so each test compares
+ * snapshots taken before and after. Runs on native_sim:
+ *
+ *   west twister -T tests/diagnostics -p native_sim
+ */
+
+#include <zephyr/sys/byteorder.h>
+#include <zephyr/ztest.h>
+
+#include "diagnostics.h"
+
+static struct diagnostics_payload before;
+static struct diagnostics_payload after;
+
+static uint16_t bin_delta(size_t bin)
+{
+	return sys_le16_to_cpu(after.jitter_hist[bin]) - sys_le16_to_cpu(before.jitter_hist[bin]);
+}
+
+static uint32_t hist_delta(void)
+{
+	uint32_t total = 0;
+
+	for (size_t i = 0; i < DIAGNOSTICS_JITTER_BINS; i++) {
+		total += bin_delta(i);
+	}
+	return total;
+}
+
+static uint32_t misses_delta(void)
+{
+	return sys_le32_to_cpu(after.deadline_misses) - sys_le32_to_cpu(before.deadline_misses);
+}
+
+ZTEST(diagnostics, test_wakeup_bins)
+{
+	diagnostics_snapshot(&before);
+	diagnostics_record_wakeup(0);
+	diagnostics_record_wakeup(50);
+	diagnostics_record_wakeup(51);
+	diagnostics_record_wakeup(5000);
+	diagnostics_record_wakeup(5001);
+	diagnostics_snapshot(&after);
+
+	/* Edges are inclusive; past the last edge goes in the last bin */
+	zassert_equal(bin_delta(0), 2);
+	zassert_equal(bin_delta(1), 1);
+	zassert_equal(bin_delta(DIAGNOSTICS_JITTER_BINS - 2), 1);
+	zassert_equal(bin_delta(DIAGNOSTICS_JITTER_BINS - 1), 1);
+	zassert_equal(misses_delta(), 0);
+}
+
+ZTEST(diagnostics, test_missed_slots_are_not_wakeups)
+{
+	diagnostics_snapshot(&before);
+
+	/* Three wakeups, two of which overran and skipped 1 and 4 slots */
+	diagnostics_record_wakeup(20);
+	diagnostics_record_missed(1);
+	diagnostics_record_wakeup(3000);
+	diagnostics_record_missed(4);
+	diagnostics_record_wakeup(80);
+	diagnostics_snapshot(&after);
+
+	zassert_equal(hist_delta(), 3);
+	zassert_equal(bin_delta(0), 1);
+	zassert_equal(misses_delta(), 5);
+}
+
+ZTEST_SUITE(diagnostics, NULL, NULL, NULL, NULL, NULL);
@@ -0,0 +1,98 @@
+/*
+ * Energy accounting tests: radio airtime derived from the link state and
+ * the average current from a set of active times. Runs on native_sim:
+ *
+ *   west twister -T tests/energy -p native_sim
+ */
+
+#include <zephyr/ztest.h>
+
+#include "energy.h"
+
+/* Empty packet at 1M: 40 us ramp-up + 10 bytes * 8 us */
+#define EMPTY_1M_US 120
+#define EMPTY_2M_US 80
+
+static struct energy_meter meter;
+
+ZTEST(energy, test_idle_counts_nothing)
+{
+	energy_meter_init(&meter, 0);
+	energy_meter_update(&meter, 10 * USEC_PER_SEC);
+
+	zassert_equal(meter.events, 0);
+	zassert_equal(meter.tx_us, 0);
+	zassert_equal(meter.rx_us, 0);
+}
+
+ZTEST(energy, test_connection_events)
+{
+	energy_meter_init(&meter, 0);
+	energy_meter_set_link(&meter, ENERGY_LINK_CONNECTED, 30000, 1, 1000);
+
+	/* 33 whole 30 ms intervals in the first second of the connection */
+	energy_meter_update(&meter, 1001000);
+	zassert_equal(meter.events, 33);
+	zassert_equal(meter.tx_us, 33 * EMPTY_1M_US);
+	zassert_equal(meter.rx_us, 33 * EMPTY_1M_US);
+}
+
+ZTEST(energy, test_frequent_updates_keep_partial_events)
+{
+	energy_meter_init(&meter, 0);
+	energy_meter_set_link(&meter, ENERGY_LINK_CONNECTED, 30000, 1, 0);
+
+	for (uint64_t t = 0; t <= 300000; t += 7000) {
+		energy_meter_update(&meter, t);
+	}
+	energy_meter_update(&meter, 300000);
+	zassert_equal(meter.events, 10);
+}
+
+ZTEST(energy, test_phy_and_state_changes)
+{
+	energy_meter_init(&meter, 0);
+	energy_meter_set_link(&meter, ENERGY_LINK_ADVERTISING, 100000, 1, 0);
+	/* Connect half-way through the third advertising interval */
+	energy_meter_set_link(&meter, ENERGY_LINK_CONNECTED, 50000, 2, 250000);
+	energy_meter_update(&meter, 350000);
+
+	zassert_equal(meter.events, 2 + 2);
+	/* ADV_IND: 40 us ramp-up + 37 bytes at 1M, three channels */
+	zassert_equal(meter.tx_us, 2 * 3 * 336 + 2 * EMPTY_2M_US);
+	zassert_equal(meter.rx_us, 2 * 3 * ENERGY_ADV_RX_WINDOW_US + 2 * EMPTY_2M_US);
+}
+
+ZTEST(energy, test_notify_airtime)
+{
+	energy_meter_init(&meter, 0);
+	energy_meter_set_link(&meter, ENERGY_LINK_CONNECTED, 30000, 1, 0);
+	energy_meter_notify(&meter, 20);
+	zassert_equal(meter.tx_us, 27 * 8);
+
+	energy_meter_set_link(&meter, ENERGY_LINK_CONNECTED, 30000, 2, 0);
+	energy_meter_notify(&meter, 20);
+	zassert_equal(meter.tx_us, 27 * 8 + 27 * 4);
+}
+
+ZTEST(energy, test_average_current)
+{
+	struct energy_usage usage = {0};
+
+	zassert_equal(energy_average_ua(&usage), 0);
+
+	/* Nothing but the board for a second */
+	usage.elapsed_us = USEC_PER_SEC;
+	zassert_equal(energy_average_ua(&usage), ENERGY_BOARD_IDLE_UA);
+
+	/* 33 ms of ranging every 50 ms, as at the default sample interval */
+	usage.ranging_us = 660000;
+	zassert_equal(energy_average_ua(&usage), ENERGY_BOARD_IDLE_UA + 12540);
+
+	usage.cpu_active_us = 10000;
+	usage.radio_tx_us = 5000;
+	usage.radio_rx_us = 5000;
+	zassert_equal(energy_average_ua(&usage), ENERGY_BOARD_IDLE_UA + 12540 + 33 + 24 + 23);
+}
+
+ZTEST_SUITE(energy, NULL, NULL, NULL, NULL, NULL);
@@ -0,0 +1,173 @@
+/*
+ * Gesture engine tests: replay range traces through the engine and check
+ * which gestures come out. Runs on native_sim:
+ *
+ *   west twister -T tests/gesture -p native_sim
+ */
+
+#include <zephyr/ztest.h>
+
+#include "gesture.h"
+#include "traces.h"
+
+#define MAX_RECORDED 32
+
+struct replay {
+	struct gesture_event events[MAX_RECORDED];
+	size_t count;
+};
+
+static void replay_trace(const uint16_t *trace, size_t len, const struct gesture_params *params,
+			 struct replay *out)
+{
+	struct gesture_engine eng;
+	struct gesture_event batch[GESTURE_MAX_EVENTS];
+
+	gesture_init(&eng);
+	out->count = 0;
+
+	for (size_t i = 0; i < len; i++) {
+		size_t n = gesture_update(&eng, params, trace[i], 1000 + i * TRACE_INTERVAL_MS,
+					  batch);
+
+		for (size_t j = 0; j < n && out->count < MAX_RECORDED; j++) {
+			out->events[out->count++] = batch[j];
+		}
+	}
+}
+
+#define REPLAY(trace, params, out) replay_trace(trace, ARRAY_SIZE(trace), params, out)
+
+static size_t count_type(const struct replay *r, enum gesture_type type)
+{
+	size_t n = 0;
+
+	for (size_t i = 0; i < r->count; i++) {
+		n += r->events[i].type == type;
+	}
+	return n;
+}
+
+static const struct gesture_event *first_of(const struct replay *r, enum gesture_type type)
+{
+	for (size_t i = 0; i < r->count; i++) {
+		if (r->events[i].type == type) {
+			return &r->events[i];
+		}
+	}
+	return NULL;
+}
+
+static const struct gesture_params defaults = GESTURE_PARAMS_DEFAULT;
+
+ZTEST(gesture, test_idle_is_quiet)
+{
+	struct replay r;
+
+	REPLAY(trace_idle, &defaults, &r);
+	zassert_equal(r.count, 0, "idle hand produced %zu events", r.count);
+}
+
+ZTEST(gesture, test_tap)
+{
+	struct replay r;
+
+	REPLAY(trace_tap, &defaults, &r);
+	zassert_equal(count_type(&r, GESTURE_TAP), 1);
+	zassert_equal(count_type(&r, GESTURE_HOLD), 0);
+
+	const struct gesture_event *tap = first_of(&r, GESTURE_TAP);
+
+	zassert_true(tap->duration_ms <= defaults.tap_max_ms);
+}
+
+ZTEST(gesture, test_hold)
+{
+	struct replay r;
+
+	REPLAY(trace_hold, &defaults, &r);
+	zassert_equal(count_type(&r, GESTURE_HOLD), 1);
+	zassert_equal(count_type(&r, GESTURE_TAP), 0);
+
+	const struct gesture_event *hold = first_of(&r, GESTURE_HOLD);
+
+	zassert_true(hold->duration_ms >= defaults.hold_ms);
+	zassert_true(hold->distance_mm < defaults.near_mm);
+}
+
+ZTEST(gesture, test_fast_approach)
+{
+	struct replay r;
+
+	REPLAY(trace_approach, &defaults, &r);
+	zassert_equal(count_type(&r, GESTURE_APPROACH), 1);
+	zassert_equal(count_type(&r, GESTURE_WITHDRAW), 0);
+	zassert_true(first_of(&r, GESTURE_APPROACH)->velocity_mm_s < 0);
+}
+
+ZTEST(gesture, test_withdraw)
+{
+	struct replay r;
+
+	REPLAY(trace_withdraw, &defaults, &r);
+	zassert_equal(count_type(&r, GESTURE_WITHDRAW), 1);
+	zassert_equal(count_type(&r, GESTURE_APPROACH), 0);
+	zassert_true(first_of(&r, GESTURE_WITHDRAW)->velocity_mm_s > 0);
+}
+
+ZTEST(gesture, test_repeated_strokes)
+{
+	struct replay r;
+	uint8_t expected = defaults.stroke_min_count;
+
+	REPLAY(trace_stroke, &defaults, &r);
+	zassert_true(count_type(&r, GESTURE_STROKE) >= 3);
+	/* Dips into the near zone mid-streak must not read as taps */
+	zassert_true(count_type(&r, GESTURE_TAP) <= 1);
+
+	for (size_t i = 0; i < r.count; i++) {
+		if (r.events[i].type != GESTURE_STROKE) {
+			continue;
+		}
+		zassert_equal(r.events[i].count, expected, "stroke %zu", i);
+		/* 1.5 Hz strokes: period should be close to 667ms */
+		zassert_within(r.events[i].duration_ms, 667, 150);
+		expected++;
+	}
+}
+
+ZTEST(gesture, test_params_change_behavior)
+{
+	struct gesture_params params = defaults;
+	struct replay r;
+
+	params.hold_ms = 5000;
+	REPLAY(trace_hold, &params, &r);
+	zassert_equal(count_type(&r, GESTURE_HOLD), 0);
+
+	params = defaults;
+	params.stroke_min_count = 4;
+	REPLAY(trace_stroke, &params, &r);
+	zassert_equal(first_of(&r, GESTURE_STROKE)->count, 4);
+
+	params = defaults;
+	params.approach_speed_mm_s = 5000;
+	REPLAY(trace_approach, &params, &r);
+	zassert_equal(count_type(&r, GESTURE_APPROACH), 0);
+}
+
+ZTEST(gesture, test_params_valid)
+{
+	struct gesture_params params = defaults;
+
+	zassert_true(gesture_params_valid(&params));
+
+	params.near_mm = 0;
+	zassert_false(gesture_params_valid(&params));
+
+	params = defaults;
+	params.stroke_min_count = 0;
+	zassert_false(gesture_params_valid(&params));
+}
+
+ZTEST_SUITE(gesture, NULL, NULL, NULL, NULL, NULL);
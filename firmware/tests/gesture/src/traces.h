@@ -0,0 +1,66 @@
+#ifndef GESTURE_TRACES_H
+#define GESTURE_TRACES_H
+
+#include <zephyr/types.h>
+
+/*
+ * Range traces in mm, one sample every TRACE_INTERVAL_MS (the default
+ * 20 Hz sample rate), shaped after sensor captures of each gesture.
+ * Sensor noise of a few mm is included.
+ */
+
+#define TRACE_INTERVAL_MS 50
+
+/* Hand resting ~400mm away */
+static const uint16_t trace_idle[] = {
+	399, 398, 401, 397, 400, 399, 397, 400, 397, 400, 397, 398,
+	400, 402, 398, 398, 401, 403, 400, 399, 403, 397, 402, 399,
+	398, 398, 399, 402, 398, 400, 401, 399, 400, 397, 397, 398,
+	401, 400, 399, 401, 400, 399, 402, 401, 398, 400, 400, 402,
+	401, 399, 403, 398, 400, 402, 398, 400, 397, 401, 402, 400,
+};
+
+/* Quick poke to ~60mm and straight back out */
+static const uint16_t trace_tap[] = {
+	402, 399, 401, 401, 400, 400, 402, 403, 400, 401, 300, 170,
+	70, 60, 65, 160, 300, 397, 401, 401, 403, 402, 399, 399,
+	401, 397, 400,
+};
+
+/* Slow approach, ~1.5s still at ~80mm, then away */
+static const uint16_t trace_hold[] = {
+	399, 386, 374, 365, 351, 339, 328, 317, 302, 292, 280, 270,
+	257, 245, 231, 220, 207, 198, 186, 171, 159, 147, 135, 124,
+	112, 99, 86, 80, 79, 80, 82, 81, 80, 80, 81, 78,
+	82, 81, 81, 81, 80, 80, 78, 81, 78, 78, 79, 79,
+	79, 78, 78, 79, 78, 79, 78, 81, 80, 80, 95, 110,
+	125, 140, 155, 170, 185, 200, 215, 230, 245, 260, 275, 290,
+	305, 320, 335, 350, 365,
+};
+
+/* Fast approach from 600mm to 100mm */
+static const uint16_t trace_approach[] = {
+	598, 599, 599, 599, 598, 602, 603, 600, 600, 598, 500, 380,
+	260, 150, 100, 98, 99, 99, 102, 98, 97, 103, 100, 98,
+	100,
+};
+
+/* Fast withdraw from 100mm to 600mm */
+static const uint16_t trace_withdraw[] = {
+	97, 100, 103, 102, 101, 99, 99, 98, 102, 100, 200, 320,
+	440, 550, 600, 602, 599, 598, 602, 603, 602, 602, 602, 601,
+	598,
+};
+
+/* Repeated strokes between ~100mm and ~250mm at 1.5 Hz */
+static const uint16_t trace_stroke[] = {
+	175, 208, 233, 246, 245, 227, 199, 166, 131, 111, 103, 111,
+	130, 162, 197, 226, 245, 250, 238, 211, 175, 142, 116, 98,
+	105, 124, 154, 188, 219, 240, 252, 241, 221, 190, 151, 121,
+	106, 102, 112, 139, 173, 211, 238, 247, 248, 231, 199, 162,
+	131, 106, 97, 111, 132, 163, 201, 228, 249, 251, 234, 208,
+	174, 139, 115, 99, 103, 120, 154, 186, 219, 242, 252, 241,
+	222, 187, 152, 122, 101, 101, 112, 138,
+};
+
+#endif /* GESTURE_TRACES_H */
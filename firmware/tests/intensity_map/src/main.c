@@ -0,0 +1,106 @@
+/*
+ * Intensity mapping tests: the fixed-point mapper must track the middleware's
+ * f64 RangeMapper to within one step of the quantized output. Runs on
+ * native_sim:
+ *
+ *   west twister -T tests/intensity_map -p native_sim
+ */
+
+#include <zephyr/ztest.h>
+
+#include "intensity_map.h"
+
+struct map_vector {
+	const char *name;
+	struct intensity_map_config cfg;
+	const uint16_t *steps; /* distance, expected pairs */
+	size_t len;
+};
+
+#define VECTOR(name, inv, lo, hi, dz, min_i, max_i, sm, ...)                                       \
+	static const uint16_t name##_steps[] = {__VA_ARGS__};
+#include "vectors.inc"
+#undef VECTOR
+
+#define VECTOR(name, inv, lo, hi, dz, min_i, max_i, sm, ...)                                       \
+	{                                                                                          \
+		#name,                                                                             \
+		{                                                                                  \
+			.invert = inv,                                                             \
+			.min_range_mm = lo,                                                        \
+			.max_range_mm = hi,                                                        \
+			.deadzone_mm = dz,                                                         \
+			.min_intensity = min_i,                                                    \
+			.max_intensity = max_i,                                                    \
+			.smoothing = sm,                                                           \
+		},                                                                                 \
+		name##_steps,                                                                      \
+		ARRAY_SIZE(name##_steps) / 2,                                                      \
+	},
+static const struct map_vector vectors[] = {
+#include "vectors.inc"
+};
+#undef VECTOR
+
+ZTEST(intensity_map, test_parity_with_middleware)
+{
+	for (size_t v = 0; v < ARRAY_SIZE(vectors); v++) {
+		const struct map_vector *vec = &vectors[v];
+		struct intensity_map map;
+
+		zassert_true(intensity_map_config_valid(&vec->cfg), "%s: config", vec->name);
+		intensity_map_init(&map);
+
+		for (size_t i = 0; i < vec->len; i++) {
+			uint16_t distance = vec->steps[2 * i];
+			uint8_t expected = vec->steps[2 * i + 1];
+			uint8_t got = intensity_map_apply(&map, &vec->cfg, distance);
+
+			zassert_within(got, expected, 1, "%s[%zu]: %u mm -> %u, expected %u",
+				       vec->name, i, distance, got, expected);
+		}
+	}
+}
+
+ZTEST(intensity_map, test_endpoints_exact)
+{
+	struct intensity_map_config cfg = INTENSITY_MAP_CONFIG_DEFAULT;
+	struct intensity_map map;
+
+	cfg.smoothing = 0;
+	intensity_map_init(&map);
+
+	zassert_equal(intensity_map_apply(&map, &cfg, cfg.min_range_mm), 255);
+	zassert_equal(intensity_map_apply(&map, &cfg, cfg.max_range_mm), 0);
+	zassert_equal(intensity_map_apply(&map, &cfg, 0), 255);
+	zassert_equal(intensity_map_apply(&map, &cfg, cfg.deadzone_mm + 1), 0);
+}
+
+ZTEST(intensity_map, test_first_sample_not_smoothed)
+{
+	struct intensity_map_config cfg = INTENSITY_MAP_CONFIG_DEFAULT;
+	struct intensity_map map;
+
+	cfg.smoothing = 255;
+	intensity_map_init(&map);
+
+	zassert_equal(intensity_map_apply(&map, &cfg, cfg.min_range_mm), 255);
+	/* Full smoothing holds the previous value */
+	zassert_equal(intensity_map_apply(&map, &cfg, cfg.max_range_mm), 255);
+
+	intensity_map_init(&map);
+	zassert_equal(intensity_map_apply(&map, &cfg, cfg.max_range_mm), 0);
+}
+
+ZTEST(intensity_map, test_config_valid)
+{
+	struct intensity_map_config cfg = INTENSITY_MAP_CONFIG_DEFAULT;
+
+	zassert_true(intensity_map_config_valid(&cfg));
+	cfg.min_range_mm = cfg.max_range_mm;
+	zassert_false(intensity_map_config_valid(&cfg));
+	cfg.min_range_mm = cfg.max_range_mm + 1;
+	zassert_false(intensity_map_config_valid(&cfg));
+}
+
+ZTEST_SUITE(intensity_map, NULL, NULL, NULL, NULL, NULL);
@@ -0,0 +1,107 @@
+/*
+ * Range batch encoder tests: byte-exact payloads (the middleware decodes
+ * the same bytes in ble.rs) and the rules for when a batch must be sent.
+ * Runs on native_sim:
+ *
+ *   west twister -T tests/range_batch -p native_sim
+ */
+
+#include <zephyr/ztest.h>
+
+#include "range_batch.h"
+
+/*
+ * t0 1000 ms, 10 ms interval: 300 298 305 305 1200 invalid 100. After the
+ * header, deltas -2, +7 and 0 take a byte, +895 two and the jumps to and
+ * from RANGE_BATCH_INVALID three each.
+ */
+static const uint16_t golden_samples[] = {300, 298, 305, 305, 1200, RANGE_BATCH_INVALID, 100};
+static const uint8_t golden_payload[] = {
+	0x01, 0x07, 0xE8, 0x03, 0x00, 0x00, 0x0A, 0x00, 0x2C, 0x01, 0x03,
+	0x0E, 0x00, 0xFE, 0x0D, 0x9E, 0xED, 0x07, 0xB5, 0xFE, 0x07,
+};
+
+static struct range_batch batch;
+
+static void fill(const uint16_t *samples, size_t len, uint32_t t0_ms, uint16_t interval_ms)
+{
+	for (size_t i = 0; i < len; i++) {
+		zassert_true(range_batch_add(&batch, samples[i], t0_ms + i * interval_ms,
+					     interval_ms));
+	}
+}
+
+ZTEST(range_batch, test_golden_payload)
+{
+	range_batch_reset(&batch, RANGE_BATCH_BUF_LEN);
+	fill(golden_samples, ARRAY_SIZE(golden_samples), 1000, 10);
+
+	zassert_equal(batch.len, sizeof(golden_payload));
+	zassert_mem_equal(batch.buf, golden_payload, sizeof(golden_payload));
+	zassert_equal(range_batch_span_ms(&batch), 70);
+}
+
+ZTEST(range_batch, test_single_sample_is_header_only)
+{
+	range_batch_reset(&batch, RANGE_BATCH_BUF_LEN);
+	zassert_equal(range_batch_span_ms(&batch), 0);
+	zassert_true(range_batch_add(&batch, 300, 1000, 10));
+
+	zassert_equal(batch.len, RANGE_BATCH_HEADER_LEN);
+	zassert_mem_equal(batch.buf, golden_payload, 1);
+	zassert_equal(batch.buf[1], 1);
+}
+
+ZTEST(range_batch, test_jitter_accepted_skipped_slot_rejected)
+{
+	range_batch_reset(&batch, RANGE_BATCH_BUF_LEN);
+	zassert_true(range_batch_add(&batch, 300, 1000, 10));
+	zassert_true(range_batch_add(&batch, 300, 1014, 10)); /* 4 ms late */
+	zassert_true(range_batch_add(&batch, 300, 1017, 10)); /* 3 ms early */
+	zassert_false(range_batch_add(&batch, 300, 1040, 10)); /* slot 1030 skipped */
+	zassert_equal(batch.buf[1], 3);
+}
+
+ZTEST(range_batch, test_interval_change_rejected)
+{
+	range_batch_reset(&batch, RANGE_BATCH_BUF_LEN);
+	zassert_true(range_batch_add(&batch, 300, 1000, 10));
+	zassert_false(range_batch_add(&batch, 300, 1005, 5));
+
+	/* A fresh batch takes it */
+	range_batch_reset(&batch, RANGE_BATCH_BUF_LEN);
+	zassert_true(range_batch_add(&batch, 300, 1005, 5));
+}
+
+ZTEST(range_batch, test_limit_respected)
+{
+	/* Default ATT MTU: 20-byte payload, header plus ten 1-byte deltas */
+	range_batch_reset(&batch, 20);
+	for (uint32_t i = 0; i < 11; i++) {
+		zassert_true(range_batch_add(&batch, 300 + (i & 1), 1000 + i * 5, 5));
+	}
+	zassert_equal(batch.len, 20);
+	zassert_false(range_batch_add(&batch, 300, 1055, 5));
+
+	/* Limits are clamped to what the encoder can hold */
+	range_batch_reset(&batch, 0);
+	zassert_equal(batch.limit, RANGE_BATCH_HEADER_LEN);
+	range_batch_reset(&batch, 1000);
+	zassert_equal(batch.limit, RANGE_BATCH_BUF_LEN);
+}
+
+ZTEST(range_batch, test_full_mtu_capacity)
+{
+	/* 247-byte ATT MTU: 235 steady samples vs 34 single 7-byte notifications */
+	size_t capacity = RANGE_BATCH_BUF_LEN - RANGE_BATCH_HEADER_LEN + 1;
+
+	range_batch_reset(&batch, RANGE_BATCH_BUF_LEN);
+	for (uint32_t i = 0; i < capacity; i++) {
+		zassert_true(range_batch_add(&batch, 500 - (i % 3), i * 5, 5));
+	}
+	zassert_false(range_batch_add(&batch, 500, capacity * 5, 5));
+	zassert_equal(batch.buf[1], capacity);
+	zassert_equal(batch.len, RANGE_BATCH_BUF_LEN);
+}
+
+ZTEST_SUITE(range_batch, NULL, NULL, NULL, NULL, NULL);
@@ -0,0 +1,158 @@
+/*
+ * Config TLV tests: partial updates, per-field errors, all-or-nothing
+ * writes and the supported-field read-back. Runs on native_sim:
+ *
+ *   west twister -T tests/range_config -p native_sim
+ */
+
+#include <errno.h>
+#include <zephyr/sys/byteorder.h>
+#include <zephyr/ztest.h>
+
+#include "range_config.h"
+
+static const struct range_config defaults = {
+    .sample_interval_ms = 50,
+    .notify_interval_ms = 50,
+    .max_range_mm = 1200,
+    .min_range_mm = 30,
+};
+
+static struct range_config cfg;
+static struct range_config_status status;
+
+ZTEST(range_config, test_partial_update)
+{
+	/* Only the notify interval; the other fields keep their values */
+	const uint8_t write[] = {RANGE_CONFIG_TLV_VERSION, RANGE_CONFIG_FIELD_NOTIFY_INTERVAL_MS, 2,
+				 0xc8, 0x00};
+
+	cfg = defaults;
+	zassert_ok(range_config_apply_tlv(&cfg, write, sizeof(write), &status));
+	zassert_equal(status.count, 0);
+	zassert_equal(cfg.notify_interval_ms, 200);
+	zassert_equal(cfg.sample_interval_ms, 50);
+	zassert_equal(cfg.max_range_mm, 1200);
+	zassert_equal(cfg.min_range_mm, 30);
+
+	/* A bare version byte is a valid no-op */
+	zassert_ok(range_config_apply_tlv(&cfg, write, 1, &status));
+	zassert_equal(cfg.notify_interval_ms, 200);
+}
+
+ZTEST(range_config, test_per_field_errors_reject_whole_write)
+{
+	const uint8_t write[] = {
+	    RANGE_CONFIG_TLV_VERSION,
+	    RANGE_CONFIG_FIELD_SAMPLE_INTERVAL_MS, 2, 0x05, 0x00, /* 5 ms: below 10 */
+	    RANGE_CONFIG_FIELD_NOTIFY_INTERVAL_MS, 2, 0x64, 0x00, /* fine on its own */
+	    0x42, 1, 0x00,					  /* unknown field */
+	    RANGE_CONFIG_FIELD_MAX_RANGE_MM, 1, 0xff,		  /* wrong length */
+	    RANGE_CONFIG_FIELD_NOTIFY_INTERVAL_MS, 2, 0x64, 0x00, /* given twice */
+	};
+
+	cfg = defaults;
+	zassert_equal(range_config_apply_tlv(&cfg, write, sizeof(write), &status), -EINVAL);
+	zassert_mem_equal(&cfg, &defaults, sizeof(cfg));
+
+	zassert_equal(status.count, 4);
+	zassert_equal(status.errors[0].field, RANGE_CONFIG_FIELD_SAMPLE_INTERVAL_MS);
+	zassert_equal(status.errors[0].error, RANGE_CONFIG_ERR_RANGE);
+	zassert_equal(status.errors[1].field, 0x42);
+	zassert_equal(status.errors[1].error, RANGE_CONFIG_ERR_UNKNOWN_FIELD);
+	zassert_equal(status.errors[2].field, RANGE_CONFIG_FIELD_MAX_RANGE_MM);
+	zassert_equal(status.errors[2].error, RANGE_CONFIG_ERR_LENGTH);
+	zassert_equal(status.errors[3].field, RANGE_CONFIG_FIELD_NOTIFY_INTERVAL_MS);
+	zassert_equal(status.errors[3].error, RANGE_CONFIG_ERR_DUPLICATE);
+}
+
+ZTEST(range_config, test_range_window_conflict)
+{
+	/* min_range_mm is fine alone but crosses the existing max_range_mm */
+	const uint8_t write[] = {RANGE_CONFIG_TLV_VERSION, RANGE_CONFIG_FIELD_MIN_RANGE_MM, 2, 0xb0,
+				 0x04};
+	/* Moving both ends together is fine */
+	const uint8_t both[] = {
+	    RANGE_CONFIG_TLV_VERSION,
+	    RANGE_CONFIG_FIELD_MIN_RANGE_MM, 2, 0xb0, 0x04, /* 1200 mm */
+	    RANGE_CONFIG_FIELD_MAX_RANGE_MM, 2, 0xd0, 0x07, /* 2000 mm */
+	};
+
+	cfg = defaults;
+	zassert_equal(range_config_apply_tlv(&cfg, write, sizeof(write), &status), -EINVAL);
+	zassert_equal(status.count, 1);
+	zassert_equal(status.errors[0].field, RANGE_CONFIG_FIELD_MIN_RANGE_MM);
+	zassert_equal(status.errors[0].error, RANGE_CONFIG_ERR_CONFLICT);
+	zassert_equal(cfg.min_range_mm, 30);
+
+	zassert_ok(range_config_apply_tlv(&cfg, both, sizeof(both), &status));
+	zassert_equal(cfg.min_range_mm, 1200);
+	zassert_equal(cfg.max_range_mm, 2000);
+}
+
+ZTEST(range_config, test_bad_framing)
+{
+	const uint8_t old_version[] = {0, RANGE_CONFIG_FIELD_SAMPLE_INTERVAL_MS, 2, 0x64, 0x00};
+	const uint8_t truncated[] = {RANGE_CONFIG_TLV_VERSION,
+				     RANGE_CONFIG_FIELD_SAMPLE_INTERVAL_MS, 2, 0x64};
+
+	cfg = defaults;
+	zassert_equal(range_config_apply_tlv(&cfg, old_version, sizeof(old_version), &status),
+		      -ENOTSUP);
+	zassert_equal(range_config_apply_tlv(&cfg, truncated, sizeof(truncated), &status),
+		      -EBADMSG);
+	zassert_equal(range_config_apply_tlv(&cfg, truncated, 2, &status), -EBADMSG);
+	zassert_equal(range_config_apply_tlv(&cfg, truncated, 0, &status), -ENOTSUP);
+	zassert_equal(status.count, 0);
+	zassert_mem_equal(&cfg, &defaults, sizeof(cfg));
+}
+
+ZTEST(range_config, test_legacy_struct_validation)
+{
+	struct range_config legacy = defaults;
+
+	zassert_true(range_config_valid(&legacy, &status));
+	zassert_equal(status.count, 0);
+
+	legacy.notify_interval_ms = 6000;
+	legacy.min_range_mm = 2000;
+	zassert_false(range_config_valid(&legacy, &status));
+	zassert_equal(status.count, 1);
+	zassert_equal(status.errors[0].field, RANGE_CONFIG_FIELD_NOTIFY_INTERVAL_MS);
+
+	legacy.notify_interval_ms = 100;
+	zassert_false(range_config_valid(&legacy, &status));
+	zassert_equal(status.errors[0].error, RANGE_CONFIG_ERR_CONFLICT);
+}
+
+ZTEST(range_config, test_read_back)
+{
+	uint8_t buf[RANGE_CONFIG_TLV_MAX_LEN];
+	const uint8_t bad[] = {RANGE_CONFIG_TLV_VERSION, 0x42, 0};
+
+	cfg = defaults;
+	status.count = 0;
+	size_t len = range_config_encode_tlv(&cfg, &status, buf);
+
+	/* Version, then four fields of value/min/max */
+	zassert_equal(len, 1 + 4 * 8);
+	zassert_equal(buf[0], RANGE_CONFIG_TLV_VERSION);
+	zassert_equal(buf[1], RANGE_CONFIG_FIELD_SAMPLE_INTERVAL_MS);
+	zassert_equal(buf[2], 6);
+	zassert_equal(sys_get_le16(&buf[3]), 50);
+	zassert_equal(sys_get_le16(&buf[5]), 10);
+	zassert_equal(sys_get_le16(&buf[7]), 5000);
+	zassert_equal(buf[25], RANGE_CONFIG_FIELD_MIN_RANGE_MM);
+	zassert_equal(sys_get_le16(&buf[27]), 30);
+
+	/* A rejected write adds its errors at the end */
+	zassert_equal(range_config_apply_tlv(&cfg, bad, sizeof(bad), &status), -EINVAL);
+	len = range_config_encode_tlv(&cfg, &status, buf);
+	zassert_equal(len, 1 + 4 * 8 + 4);
+	zassert_equal(buf[33], RANGE_CONFIG_FIELD_STATUS);
+	zassert_equal(buf[34], 2);
+	zassert_equal(buf[35], 0x42);
+	zassert_equal(buf[36], RANGE_CONFIG_ERR_UNKNOWN_FIELD);
+}
+
+ZTEST_SUITE(range_config, NULL, NULL, NULL, NULL, NULL);
@@ -0,0 +1,115 @@
+/*
+ * Sensor fault tracking tests: when a recovery is requested, how the
+ * backoff grows and resets, and the log rate limit. Runs on native_sim:
+ *
+ *   west twister -T tests/sensor_health -p native_sim
+ */
+
+#include <zephyr/ztest.h>
+
+#include "sensor_health.h"
+
+static const struct sensor_health_params params = {
+	.fail_threshold = 3,
+	.backoff_min_ms = 50,
+	.backoff_max_ms = 400,
+	.log_interval_ms = 1000,
+};
+
+static struct sensor_health health;
+
+ZTEST(sensor_health, test_recover_after_threshold)
+{
+	sensor_health_init(&health, &params);
+
+	zassert_equal(sensor_health_report(&health, false, 1000), SENSOR_HEALTH_NONE);
+	zassert_equal(health.state, SENSOR_HEALTH_FAILING);
+	zassert_true(sensor_health_should_read(&health, 1050));
+	zassert_equal(sensor_health_report(&health, false, 1050), SENSOR_HEALTH_NONE);
+	zassert_equal(sensor_health_report(&health, false, 1100), SENSOR_HEALTH_RECOVER);
+
+	zassert_equal(health.state, SENSOR_HEALTH_RECOVERING);
+	zassert_equal(health.consecutive_failures, 3);
+	zassert_equal(health.recoveries, 1);
+	zassert_equal(health.fault_since_ms, 1000);
+}
+
+ZTEST(sensor_health, test_isolated_failures_never_recover)
+{
+	sensor_health_init(&health, &params);
+
+	for (uint32_t t = 0; t < 1000; t += 100) {
+		zassert_equal(sensor_health_report(&health, false, t), SENSOR_HEALTH_NONE);
+		zassert_equal(sensor_health_report(&health, false, t + 50), SENSOR_HEALTH_NONE);
+		zassert_equal(sensor_health_report(&health, true, t + 75), SENSOR_HEALTH_RECOVERED);
+	}
+	zassert_equal(health.recoveries, 0);
+	zassert_equal(health.state, SENSOR_HEALTH_OK);
+}
+
+ZTEST(sensor_health, test_backoff_doubles_and_caps)
+{
+	static const uint32_t waits[] = {50, 100, 200, 400, 400};
+	uint32_t now = 0;
+
+	sensor_health_init(&health, &params);
+
+	sensor_health_report(&health, false, now);
+	sensor_health_report(&health, false, now);
+
+	for (size_t i = 0; i < ARRAY_SIZE(waits); i++) {
+		zassert_equal(sensor_health_report(&health, false, now), SENSOR_HEALTH_RECOVER);
+		zassert_false(sensor_health_should_read(&health, now + waits[i] - 1));
+		zassert_true(sensor_health_should_read(&health, now + waits[i]));
+		now += waits[i];
+	}
+	zassert_equal(health.recoveries, ARRAY_SIZE(waits));
+}
+
+ZTEST(sensor_health, test_good_read_resets_backoff)
+{
+	sensor_health_init(&health, &params);
+
+	sensor_health_report(&health, false, 0);
+	sensor_health_report(&health, false, 0);
+	sensor_health_report(&health, false, 0);
+	sensor_health_report(&health, false, 50);
+	zassert_equal(health.backoff_ms, 200);
+
+	zassert_equal(sensor_health_report(&health, true, 150), SENSOR_HEALTH_RECOVERED);
+	zassert_equal(health.state, SENSOR_HEALTH_OK);
+	zassert_equal(health.consecutive_failures, 0);
+	zassert_equal(health.backoff_ms, 50);
+	zassert_equal(sensor_health_report(&health, true, 200), SENSOR_HEALTH_NONE);
+}
+
+ZTEST(sensor_health, test_backoff_across_uptime_wrap)
+{
+	uint32_t now = UINT32_MAX - 10;
+
+	sensor_health_init(&health, &params);
+
+	sensor_health_report(&health, false, now);
+	sensor_health_report(&health, false, now);
+	zassert_equal(sensor_health_report(&health, false, now), SENSOR_HEALTH_RECOVER);
+	zassert_false(sensor_health_should_read(&health, now + 20));
+	zassert_true(sensor_health_should_read(&health, now + 50));
+}
+
+ZTEST(sensor_health, test_log_rate_limit)
+{
+	uint32_t suppressed = 99;
+
+	sensor_health_init(&health, &params);
+
+	zassert_true(sensor_health_log_allowed(&health, 0, &suppressed));
+	zassert_equal(suppressed, 0);
+	zassert_false(sensor_health_log_allowed(&health, 10, &suppressed));
+	zassert_false(sensor_health_log_allowed(&health, 999, &suppressed));
+	zassert_true(sensor_health_log_allowed(&health, 1000, &suppressed));
+	zassert_equal(suppressed, 2);
+	zassert_true(sensor_health_log_allowed(&health, 2500, &suppressed));
+	zassert_equal(suppressed, 0);
+}
+
+ZTEST_SUITE(sensor_health, NULL, NULL, NULL, NULL, NULL);
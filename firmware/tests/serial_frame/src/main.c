@@ -0,0 +1,61 @@
+/*
+ * Wired stream framing tests: byte-exact frames (the middleware parses
+ * the same bytes in serial.rs). Runs on native_sim:
+ *
+ *   west twister -T tests/serial_frame -p native_sim
+ */
+
+#include <zephyr/ztest.h>
+
+#include "serial_frame.h"
+
+/* seq 0x0102, t 1000 ms, 300 mm, status 0, signal 2500, ambient 40 kcps */
+static const struct serial_frame_sample golden_sample = {
+	.seq = 0x0102,
+	.timestamp_ms = 1000,
+	.distance_mm = 300,
+	.range_status = 0,
+	.signal_rate_kcps = 2500,
+	.ambient_rate_kcps = 40,
+};
+static const uint8_t golden_frame[] = {
+	0xA5, 0x5A, 0x01, 0x0D, 0x02, 0x01, 0xE8, 0x03, 0x00, 0x00,
+	0x2C, 0x01, 0x00, 0xC4, 0x09, 0x28, 0x00, 0xD1, 0x61,
+};
+
+static uint8_t frame[SERIAL_FRAME_MAX_PAYLOAD + SERIAL_FRAME_OVERHEAD];
+
+ZTEST(serial_frame, test_sample_size)
+{
+	zassert_equal(sizeof(struct serial_frame_sample), 13);
+}
+
+ZTEST(serial_frame, test_golden_sample_frame)
+{
+	size_t len = serial_frame_encode(frame, SERIAL_FRAME_SAMPLE, &golden_sample,
+					 sizeof(golden_sample));
+
+	zassert_equal(len, sizeof(golden_frame));
+	zassert_mem_equal(frame, golden_frame, sizeof(golden_frame));
+}
+
+ZTEST(serial_frame, test_empty_payload)
+{
+	static const uint8_t expected[] = {0xA5, 0x5A, 0x7F, 0x00, 0x68, 0x05};
+
+	zassert_equal(serial_frame_encode(frame, 0x7F, NULL, 0), sizeof(expected));
+	zassert_mem_equal(frame, expected, sizeof(expected));
+}
+
+ZTEST(serial_frame, test_max_payload)
+{
+	static uint8_t payload[SERIAL_FRAME_MAX_PAYLOAD];
+
+	memset(payload, SERIAL_FRAME_SYNC0, sizeof(payload));
+	zassert_equal(serial_frame_encode(frame, SERIAL_FRAME_SAMPLE, payload, sizeof(payload)),
+		      sizeof(frame));
+	zassert_equal(frame[3], SERIAL_FRAME_MAX_PAYLOAD);
+	zassert_mem_equal(&frame[4], payload, sizeof(payload));
+}
+
+ZTEST_SUITE(serial_frame, NULL, NULL, NULL, NULL, NULL);
@@ -1,27 +1,116 @@
-use btleplug::api::{Central, Manager as _, Peripheral as _, ScanFilter};
+use btleplug::api::{Central, Manager as _, Peripheral as _, ScanFilter, WriteType};
 use btleplug::platform::{Manager, Peripheral};
 use futures::StreamExt;
 use std::time::Duration;
-use tokio::sync::mpsc;
 use tracing::{debug, info, warn};
 use uuid::Uuid;
 
+use crate::config::MappingConfig;
+use crate::events::EventSink;
+use crate::mapper::quantize_unit;
+use crate::timesync::{self, SyncSample, TIME_SYNC_CHAR_UUID};
+
 // Must match firmware UUIDs
 const _RANGE_SERVICE_UUID: Uuid = Uuid::from_u128(0x00000001_7272_6e67_6669_6e6465720000);
 pub(crate) const RANGE_CHAR_UUID: Uuid = Uuid::from_u128(0x00000002_7272_6e67_6669_6e6465720000);
 const _RANGE_CONFIG_CHAR_UUID: Uuid = Uuid::from_u128(0x00000003_7272_6e67_6669_6e6465720000);
+pub(crate) const MAPPING_CHAR_UUID: Uuid = Uuid::from_u128(0x00000006_7272_6e67_6669_6e6465720000);
+pub(crate) const BATCH_CHAR_UUID: Uuid = Uuid::from_u128(0x00000007_7272_6e67_6669_6e6465720000);
 
 /// Events emitted by the BLE client
-#[derive(Debug, PartialEq)]
+// RangeBatch is ~0.5 KiB, kept inline so decoding never allocates
+#[allow(clippy::large_enum_variant)]
+#[derive(Debug, Clone, PartialEq)]
 pub enum BleEvent {
     /// New range reading in mm
     RangeUpdate(u16),
+    /// Range reading in mm with the device uptime it was taken at (firmware
+    /// that appends the timestamp to range notifications)
+    TimedRangeUpdate { distance_mm: u16, t_ms: u32 },
+    /// Run of evenly spaced range readings from the batch characteristic
+    RangeBatch(RangeBatch),
+    /// Intensity mapped on the device (0-255 = 0.0-1.0)
+    IntensityUpdate(u8),
+    /// Completed clock sync exchange
+    TimeSync(SyncSample),
     /// Connection lost
     Disconnected,
     /// Connection established
     Connected,
 }
 
+/// VL53L0X range status meaning the reading is valid.
+pub(crate) const RANGE_STATUS_VALID: u8 = 0;
+/// Range status sent when the firmware has no quality data for a reading.
+pub(crate) const RANGE_STATUS_NONE: u8 = 255;
+/// Range status the firmware sends for a slot with no reading, while its
+/// sensor read fails or the sensor is being recovered.
+pub(crate) const RANGE_STATUS_SENSOR_FAULT: u8 = 254;
+
+/// Per-sample quality fields appended to range notifications by firmware
+/// built with CONFIG_RANGE_NOTIFY_QUALITY.
+#[derive(Debug, Clone, Copy, PartialEq)]
+pub struct RangeQuality {
+    /// VL53L0X range status (0 = valid, 1 = sigma fail, 2 = signal fail,
+    /// 3 = min range fail, 4 = phase/wrap fail, 5 = hardware fail,
+    /// 254 = sensor fault)
+    pub range_status: u8,
+    /// Return signal rate in kcps
+    pub signal_rate_kcps: u16,
+    /// Ambient light rate in kcps
+    pub ambient_rate_kcps: u16,
+}
+
+impl RangeQuality {
+    /// Whether the distance in the same notification can be trusted.
+    pub fn is_valid(&self) -> bool {
+        self.range_status == RANGE_STATUS_VALID || self.range_status == RANGE_STATUS_NONE
+    }
+}
+
+/// End of the sample timestamp appended after the quality fields.
+const RANGE_TIMESTAMP_END: usize = 11;
+
+/// Batch payload version understood by decode_range_batch.
+pub(crate) const RANGE_BATCH_VERSION: u8 = 1;
+/// Batch header: version, count, t0_ms (u32), interval_ms (u16), first distance (u16).
+const RANGE_BATCH_HEADER_LEN: usize = 10;
+/// Most samples a batch can hold (the count is one byte).
+pub(crate) const RANGE_BATCH_MAX: usize = 255;
+/// Distance the firmware sends for a sample whose range status failed.
+pub(crate) const RANGE_BATCH_INVALID: u16 = 0xFFFF;
+
+/// A decoded batch notification: samples taken every `interval_ms` starting
+/// at device uptime `t0_ms`. Fixed capacity, so decoding never allocates.
+#[derive(Debug, Clone, Copy, PartialEq)]
+pub struct RangeBatch {
+    /// Device uptime of the first sample in ms
+    pub t0_ms: u32,
+    /// Spacing between samples in ms
+    pub interval_ms: u16,
+    len: usize,
+    samples: [u16; RANGE_BATCH_MAX],
+}
+
+impl RangeBatch {
+    /// All distances in order, RANGE_BATCH_INVALID for failed reads.
+    pub fn samples(&self) -> &[u16] {
+        &self.samples[..self.len]
+    }
+
+    /// (device timestamp ms, distance mm) of each valid sample.
+    pub fn valid(&self) -> impl Iterator<Item = (u32, u16)> + '_ {
+        self.samples()
+            .iter()
+            .enumerate()
+            .filter(|(_, &mm)| mm != RANGE_BATCH_INVALID)
+            .map(|(i, &mm)| {
+                let offset = i as u32 * self.interval_ms as u32;
+                (self.t0_ms.wrapping_add(offset), mm)
+            })
+    }
+}
+
 /// A raw BLE notification (uuid + payload), decoupled from btleplug types.
 pub(crate) struct RawNotification {
     pub uuid: Uuid,
@@ -71,9 +160,17 @@ pub async fn find_device(device_name: &str, timeout_secs: u64) -> anyhow::Result
 
 /// Connect to the device, discover services, and subscribe to range notifications.
 /// Sends range updates through the provided channel.
+///
+/// With `device_mapping`, the mapping is written to the device and its
+/// intensity notifications are subscribed instead of the raw range. With
+/// `batched`, range readings arrive as delta-encoded batches. With
+/// `time_sync`, clock sync exchanges run at that interval alongside.
 pub async fn run_ble_client(
     peripheral: &Peripheral,
-    tx: mpsc::UnboundedSender<BleEvent>,
+    tx: impl EventSink,
+    device_mapping: Option<&MappingConfig>,
+    batched: bool,
+    time_sync: Option<Duration>,
 ) -> anyhow::Result<()> {
     // Connect
     peripheral.connect().await?;
@@ -84,17 +181,58 @@ pub async fn run_ble_client(
     peripheral.discover_services().await?;
     let chars = peripheral.characteristics();
 
-    // Find range characteristic
-    let range_char = find_range_characteristic(&chars)?;
+    if let Some(mapping) = device_mapping {
+        // Hand the mapping to the device and relay its intensities
+        let mapping_char = find_characteristic(&chars, MAPPING_CHAR_UUID).ok_or_else(|| {
+            anyhow::anyhow!("Mapping characteristic not found (on_device needs newer firmware)")
+        })?;
+        peripheral
+            .write(
+                &mapping_char,
+                &encode_mapping_config(mapping),
+                WriteType::WithResponse,
+            )
+            .await?;
+        peripheral.subscribe(&mapping_char).await?;
+        info!("Subscribed to on-device intensity notifications");
+    } else if batched {
+        let batch_char = find_characteristic(&chars, BATCH_CHAR_UUID).ok_or_else(|| {
+            anyhow::anyhow!("Batch characteristic not found (batched needs newer firmware)")
+        })?;
+        peripheral.subscribe(&batch_char).await?;
+        info!("Subscribed to batched range notifications");
+    } else {
+        // Find range characteristic
+        let range_char = find_range_characteristic(&chars)?;
+
+        info!("Found range characteristic: {:?}", range_char.uuid);
 
-    info!("Found range characteristic: {:?}", range_char.uuid);
+        // Subscribe to notifications
+        peripheral.subscribe(&range_char).await?;
+        info!("Subscribed to range notifications");
+    }
 
-    // Subscribe to notifications
-    peripheral.subscribe(&range_char).await?;
-    info!("Subscribed to range notifications");
+    // Clock sync is optional: older firmware just reports no sample age
+    let sync_char = time_sync.and_then(|interval| {
+        find_characteristic(&chars, TIME_SYNC_CHAR_UUID).map(|c| (c, interval))
+    });
+    if time_sync.is_some() && sync_char.is_none() {
+        info!("Time sync characteristic not found, sample age not measured");
+    }
 
     // Listen for notifications via the extracted processing function
     let mut events = peripheral.notifications().await?;
+    let sync_handle = match sync_char {
+        Some((sync_char, interval)) => {
+            peripheral.subscribe(&sync_char).await?;
+            Some(tokio::spawn(timesync::run_sync_writer(
+                peripheral.clone(),
+                sync_char,
+                interval,
+            )))
+        }
+        None => None,
+    };
     let stream = futures::stream::poll_fn(move |cx| events.poll_next_unpin(cx)).map(|event| {
         RawNotification {
             uuid: event.uuid,
@@ -103,6 +241,9 @@ pub async fn run_ble_client(
     });
 
     process_notifications(stream, tx).await;
+    if let Some(handle) = sync_handle {
+        handle.abort();
+    }
     Ok(())
 }
 
@@ -110,25 +251,88 @@ pub async fn run_ble_client(
 pub(crate) fn find_range_characteristic(
     chars: &std::collections::BTreeSet<btleplug::api::Characteristic>,
 ) -> anyhow::Result<btleplug::api::Characteristic> {
-    chars
-        .iter()
-        .find(|c| c.uuid == RANGE_CHAR_UUID)
-        .cloned()
+    find_characteristic(chars, RANGE_CHAR_UUID)
         .ok_or_else(|| anyhow::anyhow!("Range characteristic not found"))
 }
 
+/// Find a characteristic by UUID in a set of discovered characteristics.
+pub(crate) fn find_characteristic(
+    chars: &std::collections::BTreeSet<btleplug::api::Characteristic>,
+    uuid: Uuid,
+) -> Option<btleplug::api::Characteristic> {
+    chars.iter().find(|c| c.uuid == uuid).cloned()
+}
+
+/// Encode a mapping as the firmware's `struct intensity_map_config` (10 bytes, LE).
+/// Intensities and smoothing are quantized to 0-255.
+pub fn encode_mapping_config(mapping: &MappingConfig) -> [u8; 10] {
+    let mut buf = [0u8; 10];
+    buf[0] = mapping.invert as u8;
+    buf[1..3].copy_from_slice(&mapping.min_range_mm.to_le_bytes());
+    buf[3..5].copy_from_slice(&mapping.max_range_mm.to_le_bytes());
+    buf[5..7].copy_from_slice(&mapping.deadzone_mm.to_le_bytes());
+    buf[7] = quantize_unit(mapping.min_intensity);
+    buf[8] = quantize_unit(mapping.max_intensity);
+    buf[9] = quantize_unit(mapping.smoothing);
+    buf
+}
+
 /// Process a stream of raw BLE notifications, parsing and forwarding them as BleEvents.
 /// Extracted from run_ble_client for testability.
 pub(crate) async fn process_notifications(
     stream: impl futures::Stream<Item = RawNotification>,
-    tx: mpsc::UnboundedSender<BleEvent>,
+    tx: impl EventSink,
 ) {
     futures::pin_mut!(stream);
+    let mut rejected: u64 = 0;
+    let mut sensor_fault = false;
 
     while let Some(notif) = stream.next().await {
+        if notif.uuid == TIME_SYNC_CHAR_UUID {
+            // Stamp the echo before anything else adds to the round trip
+            let received_us = timesync::host_now_us();
+            if let Some(sample) = timesync::parse_time_sync(&notif.value, received_us) {
+                if tx.send(BleEvent::TimeSync(sample)).is_err() {
+                    break;
+                }
+            }
+            continue;
+        }
+        if let Some(quality) = parse_range_quality(notif.uuid, &notif.value) {
+            // Log fault transitions only; the device sends one per sample slot
+            let fault = quality.range_status == RANGE_STATUS_SENSOR_FAULT;
+            if fault && !sensor_fault {
+                warn!("Device reports a sensor fault, waiting for it to recover");
+            } else if !fault && sensor_fault {
+                info!("Device sensor recovered");
+            }
+            sensor_fault = fault;
+
+            if !quality.is_valid() {
+                rejected += 1;
+                debug!(
+                    "Rejected sample: status={} signal={}kcps ambient={}kcps ({} total)",
+                    quality.range_status,
+                    quality.signal_rate_kcps,
+                    quality.ambient_rate_kcps,
+                    rejected
+                );
+                continue;
+            }
+        }
         if let Some(ble_event) = parse_notification(notif.uuid, &notif.value) {
-            if let BleEvent::RangeUpdate(mm) = &ble_event {
-                debug!("Range: {}mm", mm);
+            match &ble_event {
+                BleEvent::RangeUpdate(mm) => debug!("Range: {}mm", mm),
+                BleEvent::TimedRangeUpdate { distance_mm, t_ms } => {
+                    debug!("Range: {}mm at t={}ms", distance_mm, t_ms)
+                }
+                BleEvent::RangeBatch(batch) => debug!(
+                    "Batch: {} samples from t={}ms",
+                    batch.samples().len(),
+                    batch.t0_ms
+                ),
+                BleEvent::IntensityUpdate(level) => debug!("Intensity: {}/255", level),
+                _ => {}
             }
             if tx.send(ble_event).is_err() {
                 break;
@@ -142,10 +346,80 @@ pub(crate) async fn process_notifications(
 
 /// Parse a BLE notification into a BleEvent, if applicable.
 pub fn parse_notification(uuid: Uuid, value: &[u8]) -> Option<BleEvent> {
-    if uuid == RANGE_CHAR_UUID && value.len() >= 2 {
+    if uuid == RANGE_CHAR_UUID && value.len() >= RANGE_TIMESTAMP_END {
+        Some(BleEvent::TimedRangeUpdate {
+            distance_mm: u16::from_le_bytes([value[0], value[1]]),
+            t_ms: u32::from_le_bytes([value[7], value[8], value[9], value[10]]),
+        })
+    } else if uuid == RANGE_CHAR_UUID && value.len() >= 2 {
         Some(BleEvent::RangeUpdate(u16::from_le_bytes([
             value[0], value[1],
         ])))
+    } else if uuid == BATCH_CHAR_UUID {
+        decode_range_batch(value).map(BleEvent::RangeBatch)
+    } else if uuid == MAPPING_CHAR_UUID && !value.is_empty() {
+        Some(BleEvent::IntensityUpdate(value[0]))
+    } else {
+        None
+    }
+}
+
+/// Decode a batch notification (see firmware/src/range_batch.h).
+/// Returns None for an unknown version or a malformed payload.
+pub fn decode_range_batch(value: &[u8]) -> Option<RangeBatch> {
+    if value.len() < RANGE_BATCH_HEADER_LEN || value[0] != RANGE_BATCH_VERSION {
+        return None;
+    }
+    let count = value[1] as usize;
+    if count == 0 {
+        return None;
+    }
+
+    let mut batch = RangeBatch {
+        t0_ms: u32::from_le_bytes([value[2], value[3], value[4], value[5]]),
+        interval_ms: u16::from_le_bytes([value[6], value[7]]),
+        len: count,
+        samples: [0; RANGE_BATCH_MAX],
+    };
+    batch.samples[0] = u16::from_le_bytes([value[8], value[9]]);
+
+    // Zig-zag LEB128 deltas from the previous sample
+    let mut deltas = value[RANGE_BATCH_HEADER_LEN..].iter();
+    for i in 1..count {
+        let mut zz: u32 = 0;
+        let mut shift = 0;
+        loop {
+            let byte = *deltas.next()?;
+            if shift > 14 {
+                return None;
+            }
+            zz |= ((byte & 0x7f) as u32) << shift;
+            shift += 7;
+            if byte & 0x80 == 0 {
+                break;
+            }
+        }
+        let delta = (zz >> 1) as i32 ^ -((zz & 1) as i32);
+        let mm = batch.samples[i - 1] as i32 + delta;
+        batch.samples[i] = u16::try_from(mm).ok()?;
+    }
+
+    // Trailing bytes mean the count and the data disagree
+    if deltas.next().is_some() {
+        return None;
+    }
+    Some(batch)
+}
+
+/// Parse the optional quality fields of a range notification.
+/// Returns None for 2-byte payloads from firmware without quality reporting.
+pub fn parse_range_quality(uuid: Uuid, value: &[u8]) -> Option<RangeQuality> {
+    if uuid == RANGE_CHAR_UUID && value.len() >= 7 {
+        Some(RangeQuality {
+            range_status: value[2],
+            signal_rate_kcps: u16::from_le_bytes([value[3], value[4]]),
+            ambient_rate_kcps: u16::from_le_bytes([value[5], value[6]]),
+        })
     } else {
         None
     }
@@ -154,6 +428,7 @@ pub fn parse_notification(uuid: Uuid, value: &[u8]) -> Option<BleEvent> {
 #[cfg(test)]
 mod tests {
     use super::*;
+    use tokio::sync::mpsc;
 
     #[test]
     fn test_parse_valid_2_byte_notification() {
@@ -198,6 +473,200 @@ mod tests {
         );
     }
 
+    // --- parse_range_quality tests ---
+
+    #[test]
+    fn test_parse_quality_fields() {
+        let payload = [0x2C, 0x01, 0x00, 0xD0, 0x07, 0x64, 0x00];
+        assert_eq!(
+            parse_notification(RANGE_CHAR_UUID, &payload),
+            Some(BleEvent::RangeUpdate(300))
+        );
+        assert_eq!(
+            parse_range_quality(RANGE_CHAR_UUID, &payload),
+            Some(RangeQuality {
+                range_status: 0,
+                signal_rate_kcps: 2000,
+                ambient_rate_kcps: 100,
+            })
+        );
+    }
+
+    #[test]
+    fn test_parse_timestamped_notification() {
+        let payload = [
+            0x2C, 0x01, 0x00, 0xD0, 0x07, 0x64, 0x00, 0x10, 0x27, 0x00, 0x00,
+        ];
+        assert_eq!(
+            parse_notification(RANGE_CHAR_UUID, &payload),
+            Some(BleEvent::TimedRangeUpdate {
+                distance_mm: 300,
+                t_ms: 10_000
+            })
+        );
+        assert!(parse_range_quality(RANGE_CHAR_UUID, &payload)
+            .unwrap()
+            .is_valid());
+    }
+
+    #[test]
+    fn test_parse_quality_absent_on_short_payload() {
+        assert_eq!(parse_range_quality(RANGE_CHAR_UUID, &[0x64, 0x00]), None);
+        assert_eq!(
+            parse_range_quality(RANGE_CHAR_UUID, &[0xE8, 0x03, 0xFF, 0xFF]),
+            None
+        );
+    }
+
+    #[test]
+    fn test_parse_quality_wrong_uuid() {
+        let wrong_uuid = Uuid::from_u128(0xDEADBEEF);
+        let payload = [0x2C, 0x01, 0x00, 0xD0, 0x07, 0x64, 0x00];
+        assert_eq!(parse_range_quality(wrong_uuid, &payload), None);
+    }
+
+    #[test]
+    fn test_quality_is_valid() {
+        let mut q = RangeQuality {
+            range_status: RANGE_STATUS_VALID,
+            signal_rate_kcps: 0,
+            ambient_rate_kcps: 0,
+        };
+        assert!(q.is_valid());
+        q.range_status = RANGE_STATUS_NONE;
+        assert!(q.is_valid());
+        q.range_status = 2; // signal fail
+        assert!(!q.is_valid());
+        q.range_status = 4; // phase fail / wrap-around
+        assert!(!q.is_valid());
+    }
+
+    // --- on-device mapping tests ---
+
+    #[test]
+    fn test_parse_intensity_notification() {
+        assert_eq!(
+            parse_notification(MAPPING_CHAR_UUID, &[0xC8]),
+            Some(BleEvent::IntensityUpdate(200))
+        );
+        assert_eq!(parse_notification(MAPPING_CHAR_UUID, &[]), None);
+        // Intensity notifications carry no quality fields
+        assert_eq!(parse_range_quality(MAPPING_CHAR_UUID, &[0; 7]), None);
+    }
+
+    #[test]
+    fn test_encode_mapping_config() {
+        let mapping = MappingConfig {
+            invert: true,
+            min_range_mm: 30,
+            max_range_mm: 300,
+            min_intensity: 0.2,
+            max_intensity: 1.0,
+            deadzone_mm: 500,
+            smoothing: 0.3,
+            on_device: true,
+            ..crate::config::Config::default().mapping
+        };
+        assert_eq!(
+            encode_mapping_config(&mapping),
+            [0x01, 0x1E, 0x00, 0x2C, 0x01, 0xF4, 0x01, 51, 255, 77]
+        );
+    }
+
+    #[test]
+    fn test_find_characteristic_by_uuid() {
+        let mut chars = std::collections::BTreeSet::new();
+        chars.insert(make_characteristic(RANGE_CHAR_UUID));
+        assert!(find_characteristic(&chars, MAPPING_CHAR_UUID).is_none());
+
+        chars.insert(make_characteristic(MAPPING_CHAR_UUID));
+        let found = find_characteristic(&chars, MAPPING_CHAR_UUID).unwrap();
+        assert_eq!(found.uuid, MAPPING_CHAR_UUID);
+    }
+
+    // --- decode_range_batch tests ---
+
+    /// Golden payload from firmware/tests/range_batch: t0 1000ms, 10ms,
+    /// 300 298 305 305 1200 invalid 100.
+    const GOLDEN_BATCH: [u8; 21] = [
+        0x01, 0x07, 0xE8, 0x03, 0x00, 0x00, 0x0A, 0x00, 0x2C, 0x01, 0x03, 0x0E, 0x00, 0xFE, 0x0D,
+        0x9E, 0xED, 0x07, 0xB5, 0xFE, 0x07,
+    ];
+
+    #[test]
+    fn test_decode_golden_batch() {
+        let batch = decode_range_batch(&GOLDEN_BATCH).unwrap();
+        assert_eq!(batch.t0_ms, 1000);
+        assert_eq!(batch.interval_ms, 10);
+        assert_eq!(
+            batch.samples(),
+            &[300, 298, 305, 305, 1200, RANGE_BATCH_INVALID, 100]
+        );
+
+        let valid: Vec<(u32, u16)> = batch.valid().collect();
+        assert_eq!(
+            valid,
+            vec![
+                (1000, 300),
+                (1010, 298),
+                (1020, 305),
+                (1030, 305),
+                (1040, 1200),
+                (1060, 100)
+            ]
+        );
+    }
+
+    #[test]
+    fn test_decode_header_only_batch() {
+        let batch = decode_range_batch(&GOLDEN_BATCH[..10]);
+        // Header claims 7 samples but carries no deltas
+        assert_eq!(batch, None);
+
+        let mut single = GOLDEN_BATCH;
+        single[1] = 1;
+        let batch = decode_range_batch(&single[..10]).unwrap();
+        assert_eq!(batch.samples(), &[300]);
+    }
+
+    #[test]
+    fn test_decode_rejects_malformed_batch() {
+        let mut bad_version = GOLDEN_BATCH;
+        bad_version[0] = 2;
+        assert_eq!(decode_range_batch(&bad_version), None);
+
+        let mut zero_count = GOLDEN_BATCH;
+        zero_count[1] = 0;
+        assert_eq!(decode_range_batch(&zero_count), None);
+
+        // Truncated mid-varint, and trailing bytes past the count
+        assert_eq!(decode_range_batch(&GOLDEN_BATCH[..17]), None);
+        let mut extra = GOLDEN_BATCH.to_vec();
+        extra.push(0x00);
+        assert_eq!(decode_range_batch(&extra), None);
+
+        // Delta taking the distance below zero
+        let mut underflow = GOLDEN_BATCH;
+        underflow[1] = 2;
+        assert_eq!(
+            decode_range_batch(&[&underflow[..10], &[0xD9, 0x04]].concat()),
+            None
+        );
+
+        assert_eq!(decode_range_batch(&[]), None);
+    }
+
+    #[test]
+    fn test_parse_batch_notification() {
+        match parse_notification(BATCH_CHAR_UUID, &GOLDEN_BATCH) {
+            Some(BleEvent::RangeBatch(batch)) => assert_eq!(batch.samples().len(), 7),
+            other => panic!("expected a batch, got {other:?}"),
+        }
+        assert_eq!(parse_notification(BATCH_CHAR_UUID, &[0x01]), None);
+        // Batches carry no per-sample quality fields
+        assert_eq!(parse_range_quality(BATCH_CHAR_UUID, &GOLDEN_BATCH), None);
+    }
+
     // --- process_notifications tests ---
 
     #[tokio::test]
@@ -248,6 +717,103 @@ mod tests {
         assert_eq!(rx.recv().await, Some(BleEvent::Disconnected));
     }
 
+    #[tokio::test]
+    async fn test_process_notifications_rejects_bad_quality() {
+        let (tx, mut rx) = mpsc::unbounded_channel();
+        let notifs = vec![
+            RawNotification {
+                uuid: RANGE_CHAR_UUID,
+                value: vec![0xB0, 0x04, 0x02, 0x05, 0x00, 0x20, 0x00], // 1200mm, signal fail
+            },
+            RawNotification {
+                uuid: RANGE_CHAR_UUID,
+                value: vec![0x64, 0x00, 0x00, 0xD0, 0x07, 0x20, 0x00], // 100mm, valid
+            },
+            RawNotification {
+                uuid: RANGE_CHAR_UUID,
+                value: vec![0xC8, 0x00, 0xFF, 0x00, 0x00, 0x00, 0x00], // 200mm, no quality data
+            },
+        ];
+        let stream = futures::stream::iter(notifs);
+
+        process_notifications(stream, tx).await;
+
+        assert_eq!(rx.recv().await, Some(BleEvent::RangeUpdate(100)));
+        assert_eq!(rx.recv().await, Some(BleEvent::RangeUpdate(200)));
+        assert_eq!(rx.recv().await, Some(BleEvent::Disconnected));
+    }
+
+    #[tokio::test]
+    async fn test_process_notifications_drops_sensor_fault() {
+        let (tx, mut rx) = mpsc::unbounded_channel();
+        let notifs = vec![
+            RawNotification {
+                uuid: RANGE_CHAR_UUID,
+                value: vec![0xD0, 0x07, 0xFE, 0x00, 0x00, 0x00, 0x00], // max range, fault
+            },
+            RawNotification {
+                uuid: RANGE_CHAR_UUID,
+                value: vec![0x64, 0x00, 0x00, 0xD0, 0x07, 0x20, 0x00], // 100mm, valid
+            },
+        ];
+        let stream = futures::stream::iter(notifs);
+
+        process_notifications(stream, tx).await;
+
+        assert_eq!(rx.recv().await, Some(BleEvent::RangeUpdate(100)));
+        assert_eq!(rx.recv().await, Some(BleEvent::Disconnected));
+    }
+
+    #[tokio::test]
+    async fn test_process_notifications_forwards_intensity() {
+        let (tx, mut rx) = mpsc::unbounded_channel();
+        let notifs = vec![
+            RawNotification {
+                uuid: MAPPING_CHAR_UUID,
+                value: vec![0xFF],
+            },
+            RawNotification {
+                uuid: MAPPING_CHAR_UUID,
+                value: vec![0x00],
+            },
+        ];
+        let stream = futures::stream::iter(notifs);
+
+        process_notifications(stream, tx).await;
+
+        assert_eq!(rx.recv().await, Some(BleEvent::IntensityUpdate(255)));
+        assert_eq!(rx.recv().await, Some(BleEvent::IntensityUpdate(0)));
+        assert_eq!(rx.recv().await, Some(BleEvent::Disconnected));
+    }
+
+    #[tokio::test]
+    async fn test_process_notifications_forwards_time_sync() {
+        let (tx, mut rx) = mpsc::unbounded_channel();
+        let mut echo = timesync::encode_time_sync(1_000).to_vec();
+        echo.extend_from_slice(&5_000_000u64.to_le_bytes());
+        let notifs = vec![
+            RawNotification {
+                uuid: TIME_SYNC_CHAR_UUID,
+                value: echo,
+            },
+            RawNotification {
+                uuid: TIME_SYNC_CHAR_UUID,
+                value: vec![0x01], // truncated, skipped
+            },
+        ];
+        let stream = futures::stream::iter(notifs);
+
+        process_notifications(stream, tx).await;
+
+        match rx.recv().await {
+            Some(BleEvent::TimeSync(s)) => {
+                assert_eq!((s.host_sent_us, s.device_us), (1_000, 5_000_000))
+            }
+            other => panic!("expected a time sync echo, got {other:?}"),
+        }
+        assert_eq!(rx.recv().await, Some(BleEvent::Disconnected));
+    }
+
     #[tokio::test]
     async fn test_process_notifications_stops_on_closed_receiver() {
         let (tx, rx) = mpsc::unbounded_channel();
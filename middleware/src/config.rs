@@ -1,14 +1,20 @@
 use serde::{Deserialize, Serialize};
-use std::path::Path;
+use std::path::{Path, PathBuf};
 
-#[derive(Debug, Clone, Serialize, Deserialize)]
+#[derive(Debug, Clone, PartialEq, Serialize, Deserialize)]
 pub struct Config {
     pub ble: BleConfig,
     pub mapping: MappingConfig,
     pub buttplug: ButtplugConfig,
+    #[serde(default)]
+    pub stream: StreamConfig,
+    #[serde(default)]
+    pub serial: SerialConfig,
+    #[serde(default)]
+    pub output: OutputConfig,
 }
 
-#[derive(Debug, Clone, Serialize, Deserialize)]
+#[derive(Debug, Clone, PartialEq, Serialize, Deserialize)]
 pub struct BleConfig {
     /// BLE device name to scan for (must match CONFIG_BT_DEVICE_NAME in firmware)
     pub device_name: String,
@@ -16,9 +22,58 @@ pub struct BleConfig {
     pub scan_timeout_secs: u64,
     /// Reconnect delay on disconnect
     pub reconnect_delay_secs: u64,
+    /// Subscribe to delta-encoded sample batches instead of one notification
+    /// per sample (needs firmware with the batch characteristic)
+    #[serde(default)]
+    pub batched: bool,
+    /// Seconds between clock sync exchanges, used to report how old each
+    /// sample is when it reaches the toy (0 = off; needs firmware with the
+    /// time sync characteristic)
+    #[serde(default = "default_time_sync_interval_secs")]
+    pub time_sync_interval_secs: u64,
+    /// How readings from several sensors are combined
+    #[serde(default)]
+    pub fusion: FusionMode,
+    /// Rangefinders to connect to at once (empty = just device_name)
+    #[serde(default, skip_serializing_if = "Vec::is_empty")]
+    pub sensors: Vec<SensorConfig>,
 }
 
-#[derive(Debug, Clone, Serialize, Deserialize)]
+fn default_time_sync_interval_secs() -> u64 {
+    5
+}
+
+/// Combining readings from several sensors into one distance.
+#[derive(Debug, Clone, Copy, Default, PartialEq, Eq, Serialize, Deserialize)]
+#[serde(rename_all = "lowercase")]
+pub enum FusionMode {
+    /// Closest reading wins
+    #[default]
+    Min,
+    /// Mean weighted by each sensor's weight
+    Weighted,
+    /// Each sensor only counts inside its own zone_mm band
+    Zone,
+}
+
+/// One rangefinder in a multi-sensor setup: `[[ble.sensors]]`.
+#[derive(Debug, Clone, PartialEq, Serialize, Deserialize)]
+pub struct SensorConfig {
+    /// BLE device name to scan for
+    pub device_name: String,
+    /// Share in weighted fusion
+    #[serde(default = "default_sensor_weight")]
+    pub weight: f64,
+    /// [near, far] in mm this sensor covers, for zone fusion
+    #[serde(default, skip_serializing_if = "Option::is_none")]
+    pub zone_mm: Option<[u16; 2]>,
+}
+
+fn default_sensor_weight() -> f64 {
+    1.0
+}
+
+#[derive(Debug, Clone, PartialEq, Serialize, Deserialize)]
 pub struct MappingConfig {
     /// Invert the mapping: closer = more intense (true) or further = more intense (false)
     pub invert: bool,
@@ -34,16 +89,329 @@ pub struct MappingConfig {
     pub deadzone_mm: u16,
     /// Smoothing: exponential moving average factor (0.0 = no smoothing, 1.0 = max smoothing)
     pub smoothing: f64,
+    /// Map on the rangefinder instead of here (needs firmware with the mapping
+    /// characteristic). Intensities and smoothing are sent quantized to 1/255.
+    #[serde(default)]
+    pub on_device: bool,
+    /// Smoothing filter; ema uses `smoothing` alone
+    #[serde(default)]
+    pub filter: SmoothingFilter,
+    /// One Euro: cutoff at rest in Hz (lower = steadier)
+    #[serde(default = "default_min_cutoff_hz")]
+    pub min_cutoff_hz: f64,
+    /// One Euro: cutoff increase per unit/s of intensity change (higher =
+    /// less lag in fast motion)
+    #[serde(default = "default_beta")]
+    pub beta: f64,
+    /// Double exponential: weight on the previous trend (0.0-1.0), the
+    /// level weight being `smoothing`
+    #[serde(default = "default_trend_smoothing")]
+    pub trend_smoothing: f64,
+    /// Extrapolate the hand's movement to make up for latency
+    #[serde(default)]
+    pub predict: bool,
+    /// How far ahead to predict in ms (0 = the measured sample age plus
+    /// command round trip)
+    #[serde(default)]
+    pub predict_ms: u32,
+    /// Shape of the response between the range ends
+    #[serde(default)]
+    pub curve: ResponseCurve,
+    /// gamma curve: exponent (> 1 = gentle near the far end, steep near
+    /// the close end)
+    #[serde(default = "default_gamma")]
+    pub gamma: f64,
+    /// points curve: [position, level] pairs, both 0.0-1.0, position
+    /// increasing (1.0 = closest with invert on)
+    #[serde(default)]
+    pub curve_points: Vec<[f64; 2]>,
+    /// table curve: levels 0.0-1.0 evenly spaced from position 0.0 to 1.0
+    #[serde(default)]
+    pub curve_table: Vec<f64>,
+}
+
+/// Response curve from position in the range to intensity.
+#[derive(Debug, Clone, Copy, Default, PartialEq, Eq, Serialize, Deserialize)]
+#[serde(rename_all = "snake_case")]
+pub enum ResponseCurve {
+    /// Straight line (the firmware mapper's curve)
+    #[default]
+    Linear,
+    /// position ^ gamma
+    Gamma,
+    /// Eased at both ends
+    Smoothstep,
+    /// Straight lines between curve_points
+    Points,
+    /// Interpolated curve_table
+    Table,
 }
 
-#[derive(Debug, Clone, Serialize, Deserialize)]
+fn default_gamma() -> f64 {
+    2.0
+}
+
+/// How mapped intensities are smoothed.
+#[derive(Debug, Clone, Copy, Default, PartialEq, Eq, Serialize, Deserialize)]
+#[serde(rename_all = "snake_case")]
+pub enum SmoothingFilter {
+    /// Fixed-weight moving average (the firmware mapper's filter)
+    #[default]
+    Ema,
+    /// Cutoff follows the speed of the signal
+    OneEuro,
+    /// Holt's level-plus-trend smoothing
+    DoubleExponential,
+}
+
+fn default_min_cutoff_hz() -> f64 {
+    1.0
+}
+
+fn default_beta() -> f64 {
+    4.0
+}
+
+fn default_trend_smoothing() -> f64 {
+    0.5
+}
+
+/// Values for buttplug.actuator_types: the Buttplug ScalarCmd actuator
+/// types, plus Linear for LinearCmd (strokers). Rotate covers both scalar
+/// rotators and RotateCmd.
+pub const ACTUATOR_TYPES: [&str; 7] = [
+    "Vibrate",
+    "Rotate",
+    "Oscillate",
+    "Constrict",
+    "Inflate",
+    "Position",
+    "Linear",
+];
+
+#[derive(Debug, Clone, PartialEq, Serialize, Deserialize)]
 pub struct ButtplugConfig {
     /// Intiface Engine websocket address
     pub server_address: String,
     /// Device index to control (None = first available)
     pub device_index: Option<u32>,
-    /// Which actuator types to control
+    /// Which actuator types to control, from ACTUATOR_TYPES
     pub actuator_types: Vec<String>,
+    /// Toys to drive at once, each with its own mapping (empty = the one
+    /// toy picked by device_index)
+    #[serde(default, skip_serializing_if = "Vec::is_empty")]
+    pub devices: Vec<DeviceConfig>,
+}
+
+/// One toy in a multi-toy setup: `[[buttplug.devices]]`.
+#[derive(Debug, Clone, Default, PartialEq, Serialize, Deserialize)]
+pub struct DeviceConfig {
+    /// Intiface device index
+    #[serde(default, skip_serializing_if = "Option::is_none")]
+    pub index: Option<u32>,
+    /// Or: part of the device name, case-insensitive
+    #[serde(default, skip_serializing_if = "Option::is_none")]
+    pub name: Option<String>,
+    /// Keys from [mapping] to change for this toy; the rest are shared
+    #[serde(default, skip_serializing_if = "toml::Table::is_empty")]
+    pub mapping: toml::Table,
+}
+
+impl DeviceConfig {
+    /// The shared mapping with this toy's overrides applied.
+    pub fn mapping(&self, base: &MappingConfig) -> anyhow::Result<MappingConfig> {
+        let toml::Value::Table(mut table) = toml::Value::try_from(base)? else {
+            unreachable!("MappingConfig serializes to a table");
+        };
+        for (key, value) in &self.mapping {
+            if !table.contains_key(key) {
+                anyhow::bail!("unknown mapping key {key:?} for device {}", self.describe());
+            }
+            table.insert(key.clone(), value.clone());
+        }
+        Ok(toml::Value::Table(table).try_into()?)
+    }
+
+    /// How the toy is picked, for messages.
+    pub fn describe(&self) -> String {
+        match (&self.index, &self.name) {
+            (Some(index), _) => format!("index {index}"),
+            (None, Some(name)) => format!("{name:?}"),
+            (None, None) => "(unset)".to_string(),
+        }
+    }
+}
+
+#[derive(Debug, Clone, PartialEq, Serialize, Deserialize)]
+pub struct StreamConfig {
+    /// Record the raw L2CAP sample stream (firmware built with stream.conf, Linux only)
+    pub enabled: bool,
+    /// L2CAP PSM (must match CONFIG_RANGE_L2CAP_STREAM_PSM in firmware)
+    pub psm: u16,
+    /// Directory for recordings, one CSV file per session
+    pub record_dir: PathBuf,
+}
+
+impl Default for StreamConfig {
+    fn default() -> Self {
+        StreamConfig {
+            enabled: false,
+            psm: 0x80,
+            record_dir: PathBuf::from("recordings"),
+        }
+    }
+}
+
+#[derive(Debug, Clone, PartialEq, Serialize, Deserialize)]
+pub struct SerialConfig {
+    /// Read ranges from the firmware's wired USB stream instead of BLE (Linux only)
+    pub enabled: bool,
+    /// The stream's CDC ACM port (the firmware's second one; the first is its console)
+    pub port: PathBuf,
+}
+
+impl Default for SerialConfig {
+    fn default() -> Self {
+        SerialConfig {
+            enabled: false,
+            port: PathBuf::from("/dev/ttyACM1"),
+        }
+    }
+}
+
+#[derive(Debug, Clone, PartialEq, Serialize, Deserialize)]
+pub struct OutputConfig {
+    /// Toy commands per second, independent of how samples arrive (0 = send
+    /// one command per sample as it comes in)
+    pub rate_hz: u32,
+    /// Ramp towards each new sample over the typical sample gap instead of
+    /// stepping to it (only with rate_hz > 0)
+    pub interpolate: bool,
+}
+
+impl Default for OutputConfig {
+    fn default() -> Self {
+        OutputConfig {
+            rate_hz: 30,
+            interpolate: true,
+        }
+    }
+}
+
+impl OutputConfig {
+    /// Output tick period, or None when commands follow the samples.
+    pub fn tick(&self) -> Option<std::time::Duration> {
+        (self.rate_hz > 0).then(|| std::time::Duration::from_secs(1) / self.rate_hz)
+    }
+}
+
+impl Config {
+    fn validate_sensors(&self) -> anyhow::Result<()> {
+        let sensors = &self.ble.sensors;
+        if sensors.is_empty() {
+            return Ok(());
+        }
+        if self.serial.enabled || self.mapping.on_device || self.stream.enabled {
+            anyhow::bail!(
+                "ble.sensors fuses raw ranges over BLE; serial.enabled, mapping.on_device \
+                 and stream.enabled need a single sensor"
+            );
+        }
+        for (i, sensor) in sensors.iter().enumerate() {
+            if sensors[..i]
+                .iter()
+                .any(|s| s.device_name == sensor.device_name)
+            {
+                anyhow::bail!("ble.sensors lists {:?} twice", sensor.device_name);
+            }
+            if sensor.weight <= 0.0 || sensor.weight.is_nan() {
+                anyhow::bail!("ble.sensors weight must be > 0 ({:?})", sensor.device_name);
+            }
+            match sensor.zone_mm {
+                Some([near, far]) if near >= far => {
+                    anyhow::bail!("ble.sensors zone_mm must be [near, far] with near < far")
+                }
+                None if self.ble.fusion == FusionMode::Zone => {
+                    anyhow::bail!("zone fusion needs zone_mm for {:?}", sensor.device_name)
+                }
+                _ => {}
+            }
+        }
+        Ok(())
+    }
+}
+
+impl MappingConfig {
+    pub(crate) fn validate(&self) -> anyhow::Result<()> {
+        if self.min_intensity < 0.0 || self.min_intensity > 1.0 {
+            anyhow::bail!("min_intensity must be 0.0-1.0");
+        }
+        if self.max_intensity < 0.0 || self.max_intensity > 1.0 {
+            anyhow::bail!("max_intensity must be 0.0-1.0");
+        }
+        if self.min_range_mm >= self.max_range_mm {
+            anyhow::bail!("min_range_mm must be < max_range_mm");
+        }
+        if self.smoothing < 0.0 || self.smoothing > 1.0 {
+            anyhow::bail!("smoothing must be 0.0-1.0");
+        }
+        if self.min_cutoff_hz <= 0.0 || self.min_cutoff_hz.is_nan() {
+            anyhow::bail!("min_cutoff_hz must be > 0");
+        }
+        if self.beta < 0.0 || self.beta.is_nan() {
+            anyhow::bail!("beta must be >= 0");
+        }
+        if self.trend_smoothing < 0.0 || self.trend_smoothing > 1.0 {
+            anyhow::bail!("trend_smoothing must be 0.0-1.0");
+        }
+        if self.predict_ms > 200 {
+            anyhow::bail!("predict_ms must be 0-200");
+        }
+        self.validate_curve()?;
+        if self.on_device && self.predict {
+            anyhow::bail!("mapping.on_device maps on the rangefinder, which can't predict");
+        }
+        if self.on_device && self.filter != SmoothingFilter::Ema {
+            anyhow::bail!("mapping.on_device smooths on the rangefinder, which only has ema");
+        }
+        Ok(())
+    }
+
+    fn validate_curve(&self) -> anyhow::Result<()> {
+        let unit = |v: f64| (0.0..=1.0).contains(&v);
+        match self.curve {
+            ResponseCurve::Linear | ResponseCurve::Smoothstep => {}
+            ResponseCurve::Gamma => {
+                if self.gamma <= 0.0 || self.gamma.is_nan() {
+                    anyhow::bail!("gamma must be > 0");
+                }
+            }
+            ResponseCurve::Points => {
+                let points = &self.curve_points;
+                if points.len() < 2 {
+                    anyhow::bail!("the points curve needs at least two curve_points");
+                }
+                if !points.iter().all(|&[x, y]| unit(x) && unit(y)) {
+                    anyhow::bail!("curve_points must be [position, level] pairs in 0.0-1.0");
+                }
+                if points.windows(2).any(|pair| pair[0][0] >= pair[1][0]) {
+                    anyhow::bail!("curve_points positions must be increasing");
+                }
+            }
+            ResponseCurve::Table => {
+                if self.curve_table.len() < 2 {
+                    anyhow::bail!("the table curve needs at least two curve_table levels");
+                }
+                if !self.curve_table.iter().all(|&v| unit(v)) {
+                    anyhow::bail!("curve_table levels must be 0.0-1.0");
+                }
+            }
+        }
+        if self.on_device && self.curve != ResponseCurve::Linear {
+            anyhow::bail!("mapping.on_device maps on the rangefinder, which is linear only");
+        }
+        Ok(())
+    }
 }
 
 impl Default for Config {
@@ -53,6 +421,10 @@ impl Default for Config {
                 device_name: "Rangefinder".to_string(),
                 scan_timeout_secs: 30,
                 reconnect_delay_secs: 5,
+                batched: false,
+                time_sync_interval_secs: default_time_sync_interval_secs(),
+                fusion: FusionMode::default(),
+                sensors: Vec::new(),
             },
             mapping: MappingConfig {
                 invert: true, // closer = more intense
@@ -62,12 +434,27 @@ impl Default for Config {
                 max_intensity: 1.0,
                 deadzone_mm: 500,
                 smoothing: 0.3,
+                on_device: false,
+                filter: SmoothingFilter::default(),
+                min_cutoff_hz: default_min_cutoff_hz(),
+                beta: default_beta(),
+                trend_smoothing: default_trend_smoothing(),
+                predict: false,
+                predict_ms: 0,
+                curve: ResponseCurve::default(),
+                gamma: default_gamma(),
+                curve_points: Vec::new(),
+                curve_table: Vec::new(),
             },
             buttplug: ButtplugConfig {
                 server_address: "ws://127.0.0.1:12345".to_string(),
                 device_index: None,
                 actuator_types: vec!["Vibrate".to_string()],
+                devices: Vec::new(),
             },
+            stream: StreamConfig::default(),
+            serial: SerialConfig::default(),
+            output: OutputConfig::default(),
         }
     }
 }
@@ -88,17 +475,44 @@ impl Config {
     }
 
     pub(crate) fn validate(&self) -> anyhow::Result<()> {
-        if self.mapping.min_intensity < 0.0 || self.mapping.min_intensity > 1.0 {
-            anyhow::bail!("min_intensity must be 0.0-1.0");
+        self.mapping.validate()?;
+        if self.buttplug.actuator_types.is_empty() {
+            anyhow::bail!("buttplug.actuator_types must list at least one type");
         }
-        if self.mapping.max_intensity < 0.0 || self.mapping.max_intensity > 1.0 {
-            anyhow::bail!("max_intensity must be 0.0-1.0");
+        for kind in &self.buttplug.actuator_types {
+            if !ACTUATOR_TYPES.contains(&kind.as_str()) {
+                anyhow::bail!(
+                    "unknown actuator type {:?}; expected one of {:?}",
+                    kind,
+                    ACTUATOR_TYPES
+                );
+            }
         }
-        if self.mapping.min_range_mm >= self.mapping.max_range_mm {
-            anyhow::bail!("min_range_mm must be < max_range_mm");
+        for device in &self.buttplug.devices {
+            if device.index.is_some() == device.name.is_some() {
+                anyhow::bail!("each buttplug.devices entry needs exactly one of index or name");
+            }
+            device
+                .mapping(&self.mapping)?
+                .validate()
+                .map_err(|e| anyhow::anyhow!("device {}: {e}", device.describe()))?;
+            if self.mapping.on_device && !device.mapping.is_empty() {
+                anyhow::bail!(
+                    "mapping.on_device maps once for all toys; per-device mapping needs it off"
+                );
+            }
         }
-        if self.mapping.smoothing < 0.0 || self.mapping.smoothing > 1.0 {
-            anyhow::bail!("smoothing must be 0.0-1.0");
+        self.validate_sensors()?;
+        if self.stream.enabled && !(0x80..=0xFF).contains(&self.stream.psm) {
+            anyhow::bail!("stream.psm must be an LE dynamic PSM (0x80-0xFF)");
+        }
+        if self.output.rate_hz > 200 {
+            anyhow::bail!("output.rate_hz must be 0-200");
+        }
+        if self.serial.enabled && (self.mapping.on_device || self.stream.enabled) {
+            anyhow::bail!(
+                "serial.enabled replaces BLE; mapping.on_device and stream.enabled need it"
+            );
         }
         Ok(())
     }
@@ -128,6 +542,297 @@ mod tests {
         assert_eq!(config.mapping.min_range_mm, 30);
     }
 
+    #[test]
+    fn test_on_device_defaults_off() {
+        let toml = valid_toml().replace("on_device = false\n", "");
+        assert!(!toml.contains("on_device"));
+        let mut f = tempfile::NamedTempFile::new().unwrap();
+        f.write_all(toml.as_bytes()).unwrap();
+        let config = Config::load(f.path()).unwrap();
+        assert!(!config.mapping.on_device);
+    }
+
+    #[test]
+    fn test_stream_section_optional() {
+        let toml = valid_toml();
+        let without = &toml[..toml.find("[stream]").unwrap()];
+        let mut f = tempfile::NamedTempFile::new().unwrap();
+        f.write_all(without.as_bytes()).unwrap();
+        let config = Config::load(f.path()).unwrap();
+        assert!(!config.stream.enabled);
+        assert_eq!(config.stream.psm, 0x80);
+    }
+
+    #[test]
+    fn test_validate_stream_psm() {
+        let mut config = Config::default();
+        config.stream.psm = 0x25;
+        config.validate().unwrap(); // not checked while disabled
+        config.stream.enabled = true;
+        assert!(config.validate().is_err());
+        config.stream.psm = 0x80;
+        config.validate().unwrap();
+    }
+
+    #[test]
+    fn test_serial_section_optional() {
+        let toml = valid_toml();
+        let without = &toml[..toml.find("[serial]").unwrap()];
+        let mut f = tempfile::NamedTempFile::new().unwrap();
+        f.write_all(without.as_bytes()).unwrap();
+        let config = Config::load(f.path()).unwrap();
+        assert!(!config.serial.enabled);
+        assert_eq!(config.serial.port, PathBuf::from("/dev/ttyACM1"));
+    }
+
+    #[test]
+    fn test_validate_serial_excludes_ble_features() {
+        let mut config = Config::default();
+        config.serial.enabled = true;
+        config.validate().unwrap();
+        config.mapping.on_device = true;
+        assert!(config.validate().is_err());
+        config.mapping.on_device = false;
+        config.stream.enabled = true;
+        assert!(config.validate().is_err());
+    }
+
+    #[test]
+    fn test_output_section_optional() {
+        let toml = valid_toml();
+        let without = &toml[..toml.find("[output]").unwrap()];
+        let mut f = tempfile::NamedTempFile::new().unwrap();
+        f.write_all(without.as_bytes()).unwrap();
+        let config = Config::load(f.path()).unwrap();
+        assert_eq!(config.output.rate_hz, 30);
+        assert!(config.output.interpolate);
+    }
+
+    #[test]
+    fn test_output_tick() {
+        let mut output = OutputConfig::default();
+        assert_eq!(
+            output.tick(),
+            Some(std::time::Duration::from_nanos(33_333_333))
+        );
+        output.rate_hz = 0;
+        assert_eq!(output.tick(), None);
+
+        let mut config = Config::default();
+        config.output.rate_hz = 201;
+        assert!(config.validate().is_err());
+    }
+
+    #[test]
+    fn test_devices_with_mapping_overrides() {
+        let toml = format!(
+            "{}\n[[buttplug.devices]]\nindex = 0\n\n\
+             [[buttplug.devices]]\nname = \"lush\"\n\
+             [buttplug.devices.mapping]\nmax_intensity = 0.6\ninvert = false\npredict_ms = 40\n",
+            valid_toml()
+        );
+        let mut f = tempfile::NamedTempFile::new().unwrap();
+        f.write_all(toml.as_bytes()).unwrap();
+        let config = Config::load(f.path()).unwrap();
+
+        let devices = &config.buttplug.devices;
+        assert_eq!(devices.len(), 2);
+        assert_eq!(devices[0].index, Some(0));
+        let first = devices[0].mapping(&config.mapping).unwrap();
+        assert!((first.max_intensity - 1.0).abs() < f64::EPSILON);
+        assert!(first.invert);
+
+        assert_eq!(devices[1].name.as_deref(), Some("lush"));
+        let second = devices[1].mapping(&config.mapping).unwrap();
+        assert!((second.max_intensity - 0.6).abs() < f64::EPSILON);
+        assert!(!second.invert);
+        assert_eq!(second.predict_ms, 40);
+        assert_eq!(second.min_range_mm, config.mapping.min_range_mm);
+    }
+
+    #[test]
+    fn test_validate_devices() {
+        let mut config = Config::default();
+        config.buttplug.devices.push(DeviceConfig::default());
+        assert!(config.validate().is_err()); // neither index nor name
+
+        config.buttplug.devices[0].index = Some(1);
+        config.validate().unwrap();
+
+        let mapping = &mut config.buttplug.devices[0].mapping;
+        mapping.insert("max_intensity".into(), toml::Value::Float(1.5));
+        assert!(config.validate().is_err());
+
+        let mapping = &mut config.buttplug.devices[0].mapping;
+        mapping.clear();
+        mapping.insert("max_intensty".into(), toml::Value::Float(0.5));
+        let err = config.validate().unwrap_err().to_string();
+        assert!(err.contains("max_intensty"), "{err}");
+
+        let mapping = &mut config.buttplug.devices[0].mapping;
+        mapping.clear();
+        mapping.insert("max_intensity".into(), toml::Value::Float(0.5));
+        config.validate().unwrap();
+        config.mapping.on_device = true;
+        assert!(config.validate().is_err());
+    }
+
+    #[test]
+    fn test_smoothing_filter() {
+        let toml_str = r#"
+[ble]
+device_name = "Rangefinder"
+scan_timeout_secs = 30
+reconnect_delay_secs = 5
+
+[mapping]
+invert = true
+min_range_mm = 30
+max_range_mm = 300
+min_intensity = 0.0
+max_intensity = 1.0
+deadzone_mm = 500
+smoothing = 0.3
+filter = "one_euro"
+beta = 2.5
+
+[buttplug]
+server_address = "ws://127.0.0.1:12345"
+actuator_types = ["Vibrate"]
+"#;
+        let mut config: Config = toml::from_str(toml_str).unwrap();
+        assert_eq!(config.mapping.filter, SmoothingFilter::OneEuro);
+        assert!((config.mapping.beta - 2.5).abs() < f64::EPSILON);
+        assert!((config.mapping.min_cutoff_hz - 1.0).abs() < f64::EPSILON);
+        config.validate().unwrap();
+
+        config.mapping.min_cutoff_hz = 0.0;
+        assert!(config.validate().is_err());
+        config.mapping.min_cutoff_hz = 1.0;
+        // The firmware mapper only has the EMA
+        config.mapping.on_device = true;
+        assert!(config.validate().is_err());
+    }
+
+    #[test]
+    fn test_validate_curves() {
+        let mut config = Config::default();
+        config.mapping.curve = ResponseCurve::Gamma;
+        config.validate().unwrap();
+        config.mapping.gamma = 0.0;
+        assert!(config.validate().is_err());
+
+        config.mapping.curve = ResponseCurve::Points;
+        assert!(config.validate().is_err()); // no points
+        config.mapping.curve_points = vec![[0.0, 0.0], [0.6, 0.3], [0.4, 0.5]];
+        assert!(config.validate().is_err()); // not increasing
+        config.mapping.curve_points = vec![[0.0, 0.0], [0.4, 0.5], [1.0, 1.2]];
+        assert!(config.validate().is_err()); // level out of range
+        config.mapping.curve_points[2] = [1.0, 1.0];
+        config.validate().unwrap();
+
+        config.mapping.curve = ResponseCurve::Table;
+        assert!(config.validate().is_err());
+        config.mapping.curve_table = vec![0.0, 0.5, 1.0];
+        config.validate().unwrap();
+        // The firmware mapper is linear
+        config.mapping.on_device = true;
+        assert!(config.validate().is_err());
+    }
+
+    #[test]
+    fn test_curve_from_toml() {
+        let toml = valid_toml()
+            .replace("curve = \"linear\"", "curve = \"points\"")
+            .replace(
+                "curve_points = []",
+                "curve_points = [[0.0, 0.0], [0.5, 0.2], [1.0, 1.0]]",
+            );
+        let config: Config = toml::from_str(&toml).unwrap();
+        assert_eq!(config.mapping.curve, ResponseCurve::Points);
+        assert_eq!(config.mapping.curve_points[1], [0.5, 0.2]);
+        config.validate().unwrap();
+    }
+
+    #[test]
+    fn test_validate_prediction() {
+        let mut config = Config::default();
+        config.mapping.predict = true;
+        config.validate().unwrap();
+        config.mapping.predict_ms = 250;
+        assert!(config.validate().is_err());
+        config.mapping.predict_ms = 80;
+        config.validate().unwrap();
+        config.mapping.on_device = true;
+        assert!(config.validate().is_err());
+    }
+
+    #[test]
+    fn test_validate_actuator_types() {
+        let mut config = Config::default();
+        config.buttplug.actuator_types = vec!["Linear".into(), "Oscillate".into()];
+        config.validate().unwrap();
+
+        config.buttplug.actuator_types = vec!["vibrate".into()];
+        let err = config.validate().unwrap_err().to_string();
+        assert!(err.contains("vibrate"), "{err}");
+        config.buttplug.actuator_types.clear();
+        assert!(config.validate().is_err());
+    }
+
+    #[test]
+    fn test_sensors_section() {
+        let toml = valid_toml().replace(
+            "[mapping]",
+            "[[ble.sensors]]\ndevice_name = \"Left\"\nzone_mm = [0, 200]\n\n\
+             [[ble.sensors]]\ndevice_name = \"Right\"\nweight = 2.0\nzone_mm = [150, 600]\n\n\
+             [mapping]",
+        );
+        let toml = toml.replace("fusion = \"min\"", "fusion = \"zone\"");
+        let mut f = tempfile::NamedTempFile::new().unwrap();
+        f.write_all(toml.as_bytes()).unwrap();
+        let config = Config::load(f.path()).unwrap();
+
+        assert_eq!(config.ble.fusion, FusionMode::Zone);
+        let sensors = &config.ble.sensors;
+        assert_eq!(sensors.len(), 2);
+        assert_eq!(sensors[0].device_name, "Left");
+        assert!((sensors[0].weight - 1.0).abs() < f64::EPSILON);
+        assert_eq!(sensors[1].zone_mm, Some([150, 600]));
+        assert!((sensors[1].weight - 2.0).abs() < f64::EPSILON);
+    }
+
+    #[test]
+    fn test_validate_sensors() {
+        let sensor = |name: &str| SensorConfig {
+            device_name: name.to_string(),
+            weight: 1.0,
+            zone_mm: None,
+        };
+        let mut config = Config::default();
+        config.ble.sensors = vec![sensor("A"), sensor("B")];
+        config.validate().unwrap();
+
+        config.ble.fusion = FusionMode::Zone;
+        assert!(config.validate().is_err()); // zones missing
+        config.ble.sensors[0].zone_mm = Some([0, 200]);
+        config.ble.sensors[1].zone_mm = Some([300, 200]);
+        assert!(config.validate().is_err()); // backwards
+        config.ble.sensors[1].zone_mm = Some([150, 600]);
+        config.validate().unwrap();
+
+        config.ble.sensors[1].weight = 0.0;
+        assert!(config.validate().is_err());
+        config.ble.sensors[1].weight = 1.0;
+
+        config.ble.sensors[1].device_name = "A".to_string();
+        assert!(config.validate().is_err());
+        config.ble.sensors[1].device_name = "B".to_string();
+
+        config.mapping.on_device = true;
+        assert!(config.validate().is_err());
+    }
+
     #[test]
     fn test_load_nonexistent_file() {
         let result = Config::load(Path::new("/tmp/nonexistent_fancypants_cfg.toml"));
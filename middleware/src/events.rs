@@ -0,0 +1,222 @@
+//! Channel from the range sources to the control loop.
+//!
+//! Range samples are latest-wins: a toy command takes an Intiface round
+//! trip, and samples that arrive meanwhile are already stale, so only the
+//! newest one is kept and the rest are counted as coalesced. Connection
+//! and clock sync events go through a separate lossless queue and are
+//! handed out first, so a slow toy never holds back a disconnect.
+
+use std::fmt;
+use std::sync::Arc;
+use tokio::sync::mpsc::error::TryRecvError;
+use tokio::sync::{mpsc, watch};
+
+use crate::ble::BleEvent;
+
+/// Newest sample and how many have been sent in total.
+#[derive(Debug, Default)]
+struct Latest {
+    seq: u64,
+    event: Option<BleEvent>,
+}
+
+/// Whether an event only matters until a newer reading replaces it.
+fn is_sample(event: &BleEvent) -> bool {
+    matches!(
+        event,
+        BleEvent::RangeUpdate(_)
+            | BleEvent::TimedRangeUpdate { .. }
+            | BleEvent::RangeBatch(_)
+            | BleEvent::IntensityUpdate(_)
+    )
+}
+
+/// The receiving side has gone away; the event was dropped.
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub struct Closed;
+
+impl fmt::Display for Closed {
+    fn fmt(&self, f: &mut fmt::Formatter<'_>) -> fmt::Result {
+        f.write_str("event receiver closed")
+    }
+}
+
+impl std::error::Error for Closed {}
+
+/// Where the range sources deliver events: the session's EventSender, or a
+/// plain lossless queue where every event matters (tests).
+pub trait EventSink {
+    fn send(&self, event: BleEvent) -> Result<(), Closed>;
+}
+
+impl EventSink for mpsc::UnboundedSender<BleEvent> {
+    fn send(&self, event: BleEvent) -> Result<(), Closed> {
+        mpsc::UnboundedSender::send(self, event).map_err(|_| Closed)
+    }
+}
+
+/// Create a connected sender/receiver pair.
+pub fn channel() -> (EventSender, EventReceiver) {
+    let (control_tx, control_rx) = mpsc::unbounded_channel();
+    let (latest_tx, latest_rx) = watch::channel(Latest::default());
+    (
+        EventSender {
+            control: control_tx,
+            latest: Arc::new(latest_tx),
+        },
+        EventReceiver {
+            control: control_rx,
+            latest: latest_rx,
+            seen: 0,
+            coalesced: 0,
+        },
+    )
+}
+
+/// Sending half; cheap to clone, never blocks.
+#[derive(Debug, Clone)]
+pub struct EventSender {
+    control: mpsc::UnboundedSender<BleEvent>,
+    latest: Arc<watch::Sender<Latest>>,
+}
+
+impl EventSink for EventSender {
+    /// Send an event, replacing any sample not yet received. Fails once
+    /// the receiver is gone.
+    fn send(&self, event: BleEvent) -> Result<(), Closed> {
+        if !is_sample(&event) {
+            return self.control.send(event).map_err(|_| Closed);
+        }
+        if self.latest.is_closed() {
+            return Err(Closed);
+        }
+        self.latest.send_modify(|latest| {
+            latest.seq += 1;
+            latest.event = Some(event);
+        });
+        Ok(())
+    }
+}
+
+/// Receiving half.
+#[derive(Debug)]
+pub struct EventReceiver {
+    control: mpsc::UnboundedReceiver<BleEvent>,
+    latest: watch::Receiver<Latest>,
+    seen: u64,
+    coalesced: u64,
+}
+
+impl EventReceiver {
+    /// Next event: pending control events first, then the newest sample.
+    /// Returns None once every sender is gone and nothing is left.
+    pub async fn recv(&mut self) -> Option<BleEvent> {
+        loop {
+            match self.control.try_recv() {
+                Ok(event) => return Some(event),
+                Err(TryRecvError::Disconnected) => return self.take_latest(),
+                Err(TryRecvError::Empty) => {}
+            }
+            if let Some(event) = self.take_latest() {
+                return Some(event);
+            }
+
+            tokio::select! {
+                event = self.control.recv() => {
+                    return event.or_else(|| self.take_latest());
+                }
+                changed = self.latest.changed() => {
+                    if changed.is_err() {
+                        // Samples closed; control ends with it
+                        return self.control.recv().await;
+                    }
+                }
+            }
+        }
+    }
+
+    /// Samples replaced by a newer one before they were received.
+    pub fn coalesced(&self) -> u64 {
+        self.coalesced
+    }
+
+    fn take_latest(&mut self) -> Option<BleEvent> {
+        let latest = self.latest.borrow_and_update();
+        if latest.seq == self.seen {
+            return None;
+        }
+        self.coalesced += latest.seq - self.seen - 1;
+        self.seen = latest.seq;
+        latest.event.clone()
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[tokio::test]
+    async fn test_samples_coalesce_to_latest() {
+        let (tx, mut rx) = channel();
+        tx.send(BleEvent::RangeUpdate(100)).unwrap();
+        tx.send(BleEvent::RangeUpdate(200)).unwrap();
+        tx.send(BleEvent::RangeUpdate(300)).unwrap();
+
+        assert_eq!(rx.recv().await, Some(BleEvent::RangeUpdate(300)));
+        assert_eq!(rx.coalesced(), 2);
+
+        tx.send(BleEvent::IntensityUpdate(7)).unwrap();
+        assert_eq!(rx.recv().await, Some(BleEvent::IntensityUpdate(7)));
+        assert_eq!(rx.coalesced(), 2);
+    }
+
+    #[tokio::test]
+    async fn test_control_events_are_lossless_and_first() {
+        let (tx, mut rx) = channel();
+        tx.send(BleEvent::Connected).unwrap();
+        tx.send(BleEvent::RangeUpdate(100)).unwrap();
+        tx.send(BleEvent::RangeUpdate(200)).unwrap();
+        tx.send(BleEvent::Disconnected).unwrap();
+        tx.send(BleEvent::Connected).unwrap();
+
+        assert_eq!(rx.recv().await, Some(BleEvent::Connected));
+        assert_eq!(rx.recv().await, Some(BleEvent::Disconnected));
+        assert_eq!(rx.recv().await, Some(BleEvent::Connected));
+        assert_eq!(rx.recv().await, Some(BleEvent::RangeUpdate(200)));
+    }
+
+    #[tokio::test]
+    async fn test_last_sample_delivered_after_senders_drop() {
+        let (tx, mut rx) = channel();
+        tx.send(BleEvent::RangeUpdate(100)).unwrap();
+        drop(tx);
+
+        assert_eq!(rx.recv().await, Some(BleEvent::RangeUpdate(100)));
+        assert_eq!(rx.recv().await, None);
+    }
+
+    #[tokio::test]
+    async fn test_recv_waits_for_either_path() {
+        let (tx, mut rx) = channel();
+        let sender = tokio::spawn(async move {
+            tokio::time::sleep(std::time::Duration::from_millis(5)).await;
+            tx.send(BleEvent::RangeUpdate(42)).unwrap();
+            tokio::time::sleep(std::time::Duration::from_millis(5)).await;
+            tx.send(BleEvent::Disconnected).unwrap();
+        });
+
+        assert_eq!(rx.recv().await, Some(BleEvent::RangeUpdate(42)));
+        assert_eq!(rx.recv().await, Some(BleEvent::Disconnected));
+        sender.await.unwrap();
+        assert_eq!(rx.recv().await, None);
+        assert_eq!(rx.coalesced(), 0);
+    }
+
+    #[test]
+    fn test_send_fails_once_receiver_dropped() {
+        let (tx, rx) = channel();
+        drop(rx);
+        assert!(tx.send(BleEvent::RangeUpdate(1)).is_err());
+        assert!(tx.send(BleEvent::Disconnected).is_err());
+    }
+}
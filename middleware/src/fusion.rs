@@ -0,0 +1,388 @@
+//! Several rangefinders combined into one distance.
+//!
+//! Each sensor runs its own BLE client and reconnect loop and delivers into
+//! a FusionSink. The sink keeps the latest reading from every sensor and
+//! forwards one fused RangeUpdate per reading, so the session sees a
+//! single sensor. Readings older than SENSOR_STALE_AFTER drop out, which
+//! is how a sensor that has gone quiet or disconnected stops counting:
+//! the output degrades to the remaining sensors instead of ending. Once no
+//! sensor has a reading left, the session is told the source disconnected,
+//! as it would be with a single sensor, so the toys stop.
+//!
+//! Every sensor has its own clock, so fused readings carry no device
+//! timestamp and time sync echoes are not forwarded.
+
+use btleplug::api::Peripheral as _;
+use std::sync::{Arc, Mutex};
+use std::time::Duration;
+use tokio::time::Instant;
+use tracing::{info, warn};
+
+use crate::ble::{self, BleEvent};
+use crate::config::{BleConfig, FusionMode, SensorConfig};
+use crate::events::{Closed, EventSender, EventSink};
+
+/// A reading this old no longer counts (about ten missed samples at the
+/// default rate).
+pub const SENSOR_STALE_AFTER: Duration = Duration::from_millis(500);
+
+/// How often the sensors are checked for all having gone quiet.
+const STALE_CHECK_INTERVAL: Duration = Duration::from_millis(100);
+
+#[derive(Debug)]
+struct SensorState {
+    weight: f64,
+    zone_mm: Option<[u16; 2]>,
+    latest: Option<(u16, Instant)>,
+}
+
+/// Latest reading per sensor and the rule for combining them.
+#[derive(Debug)]
+pub struct Fusion {
+    mode: FusionMode,
+    sensors: Vec<SensorState>,
+    /// Some reading has counted since the input was last reported lost
+    had_input: bool,
+}
+
+impl Fusion {
+    pub fn new(mode: FusionMode, sensors: &[SensorConfig]) -> Self {
+        Fusion {
+            mode,
+            sensors: sensors
+                .iter()
+                .map(|s| SensorState {
+                    weight: s.weight,
+                    zone_mm: s.zone_mm,
+                    latest: None,
+                })
+                .collect(),
+            had_input: false,
+        }
+    }
+
+    /// Take a reading from one sensor and return the fused distance.
+    pub fn update(&mut self, sensor: usize, distance_mm: u16, now: Instant) -> Option<u16> {
+        self.sensors[sensor].latest = Some((distance_mm, now));
+        self.had_input = true;
+        self.fuse(now)
+    }
+
+    /// Drop a sensor's reading straight away (it disconnected).
+    pub fn forget(&mut self, sensor: usize) {
+        self.sensors[sensor].latest = None;
+    }
+
+    /// Sensors with a reading that still counts.
+    pub fn live(&self, now: Instant) -> usize {
+        self.fresh(now).count()
+    }
+
+    /// Whether the last reading that counted has dropped out since this
+    /// last returned true. Before the first reading there is nothing to
+    /// lose.
+    pub fn lost(&mut self, now: Instant) -> bool {
+        let lost = self.had_input && self.live(now) == 0;
+        if lost {
+            self.had_input = false;
+        }
+        lost
+    }
+
+    /// Fused distance from the fresh readings, or None if there are none.
+    ///
+    /// In zone mode a sensor counts only while its reading is inside its
+    /// zone_mm band, closest in-band reading first; when no sensor sees
+    /// anything in its band the closest reading is used, so leaving every
+    /// zone still reads as far away.
+    pub fn fuse(&self, now: Instant) -> Option<u16> {
+        match self.mode {
+            FusionMode::Min => self.fresh(now).map(|(_, d)| d).min(),
+            FusionMode::Weighted => {
+                let (sum, weight) = self.fresh(now).fold((0.0, 0.0), |(sum, weight), (s, d)| {
+                    (sum + s.weight * d as f64, weight + s.weight)
+                });
+                (weight > 0.0).then(|| (sum / weight).round() as u16)
+            }
+            FusionMode::Zone => self
+                .fresh(now)
+                .filter(|(s, d)| {
+                    s.zone_mm
+                        .is_some_and(|[near, far]| (near..=far).contains(d))
+                })
+                .map(|(_, d)| d)
+                .min()
+                .or_else(|| self.fresh(now).map(|(_, d)| d).min()),
+        }
+    }
+
+    fn fresh(&self, now: Instant) -> impl Iterator<Item = (&SensorState, u16)> {
+        self.sensors.iter().filter_map(move |s| {
+            let (distance_mm, at) = s.latest?;
+            (now.saturating_duration_since(at) < SENSOR_STALE_AFTER).then_some((s, distance_mm))
+        })
+    }
+}
+
+/// Scans share the adapter, and a scan that finds its device stops it, so
+/// sensors scan one at a time.
+static SCAN: tokio::sync::Mutex<()> = tokio::sync::Mutex::const_new(());
+
+/// Keep one sensor streaming into `sink` until the task is aborted: scan,
+/// connect, and after losing it wait `ble.reconnect_delay_secs` and start
+/// over. The other sensors carry on meanwhile.
+pub async fn run_sensor(sensor: SensorConfig, sink: FusionSink, ble: BleConfig) {
+    loop {
+        let found = {
+            let _scan = SCAN.lock().await;
+            ble::find_device(&sensor.device_name, ble.scan_timeout_secs).await
+        };
+        match found {
+            Ok(peripheral) => {
+                let result =
+                    ble::run_ble_client(&peripheral, sink.clone(), None, ble.batched, None).await;
+                if let Err(e) = result {
+                    warn!("Sensor {}: {:#}", sensor.device_name, e);
+                }
+                let _ = peripheral.disconnect().await;
+            }
+            Err(e) => warn!("Sensor {}: {:#}", sensor.device_name, e),
+        }
+        tokio::time::sleep(Duration::from_secs(ble.reconnect_delay_secs)).await;
+    }
+}
+
+/// Tell the session its input is gone when every sensor has gone quiet
+/// without disconnecting. Ends once the session has.
+pub async fn watch_stale(fusion: Arc<Mutex<Fusion>>, out: EventSender) {
+    let mut check = tokio::time::interval(STALE_CHECK_INTERVAL);
+    loop {
+        check.tick().await;
+        if !fusion.lock().unwrap().lost(Instant::now()) {
+            continue;
+        }
+        warn!(
+            "No sensor reading for {} ms",
+            SENSOR_STALE_AFTER.as_millis()
+        );
+        if out.send(BleEvent::Disconnected).is_err() {
+            return;
+        }
+    }
+}
+
+/// Where one sensor's BLE client delivers: feeds the shared Fusion and
+/// passes the fused reading on to the session.
+#[derive(Debug, Clone)]
+pub struct FusionSink {
+    sensor: usize,
+    name: String,
+    fusion: Arc<Mutex<Fusion>>,
+    out: EventSender,
+}
+
+impl FusionSink {
+    pub fn new(sensor: usize, name: &str, fusion: Arc<Mutex<Fusion>>, out: EventSender) -> Self {
+        FusionSink {
+            sensor,
+            name: name.to_string(),
+            fusion,
+            out,
+        }
+    }
+
+    fn reading(&self, distance_mm: u16) -> Result<(), Closed> {
+        let fused = self
+            .fusion
+            .lock()
+            .unwrap()
+            .update(self.sensor, distance_mm, Instant::now());
+        match fused {
+            Some(fused) => self.out.send(BleEvent::RangeUpdate(fused)),
+            None => Ok(()),
+        }
+    }
+}
+
+impl EventSink for FusionSink {
+    fn send(&self, event: BleEvent) -> Result<(), Closed> {
+        match event {
+            BleEvent::RangeUpdate(distance_mm) | BleEvent::TimedRangeUpdate { distance_mm, .. } => {
+                self.reading(distance_mm)
+            }
+            BleEvent::RangeBatch(batch) => match batch.valid().last() {
+                Some((_, distance_mm)) => self.reading(distance_mm),
+                None => Ok(()),
+            },
+            BleEvent::Connected => {
+                info!("Sensor {} connected", self.name);
+                self.out.send(BleEvent::Connected)
+            }
+            BleEvent::Disconnected => {
+                let mut fusion = self.fusion.lock().unwrap();
+                fusion.forget(self.sensor);
+                let now = Instant::now();
+                if fusion.lost(now) {
+                    warn!("Sensor {} disconnected, none left", self.name);
+                    return self.out.send(BleEvent::Disconnected);
+                }
+                warn!(
+                    "Sensor {} disconnected, {} still live",
+                    self.name,
+                    fusion.live(now)
+                );
+                Ok(())
+            }
+            // Device-side mapping and per-device clocks don't fuse
+            BleEvent::IntensityUpdate(_) | BleEvent::TimeSync(_) => Ok(()),
+        }
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    fn sensor(weight: f64, zone_mm: Option<[u16; 2]>) -> SensorConfig {
+        SensorConfig {
+            device_name: "test".to_string(),
+            weight,
+            zone_mm,
+        }
+    }
+
+    fn ms(n: u64) -> Duration {
+        Duration::from_millis(n)
+    }
+
+    #[test]
+    fn test_min_takes_closest() {
+        let t0 = Instant::now();
+        let mut fusion = Fusion::new(FusionMode::Min, &[sensor(1.0, None), sensor(1.0, None)]);
+        assert_eq!(fusion.fuse(t0), None);
+        assert_eq!(fusion.update(0, 200, t0), Some(200));
+        assert_eq!(fusion.update(1, 120, t0), Some(120));
+        assert_eq!(fusion.update(0, 80, t0), Some(80));
+    }
+
+    #[test]
+    fn test_weighted_mean() {
+        let t0 = Instant::now();
+        let mut fusion = Fusion::new(
+            FusionMode::Weighted,
+            &[sensor(1.0, None), sensor(3.0, None)],
+        );
+        fusion.update(0, 100, t0);
+        assert_eq!(fusion.update(1, 200, t0), Some(175));
+    }
+
+    #[test]
+    fn test_zone_prefers_in_band_reading() {
+        let t0 = Instant::now();
+        let sensors = [sensor(1.0, Some([0, 150])), sensor(1.0, Some([100, 600]))];
+        let mut fusion = Fusion::new(FusionMode::Zone, &sensors);
+
+        // Near sensor sees 400 (out of its band), far one 300 (in band)
+        fusion.update(0, 400, t0);
+        assert_eq!(fusion.update(1, 300, t0), Some(300));
+        // Both in band: closest
+        fusion.update(0, 120, t0);
+        assert_eq!(fusion.update(1, 140, t0), Some(120));
+        // Nobody in band: closest anyway
+        fusion.update(0, 900, t0);
+        assert_eq!(fusion.update(1, 800, t0), Some(800));
+    }
+
+    #[test]
+    fn test_stale_sensor_drops_out() {
+        let t0 = Instant::now();
+        let mut fusion = Fusion::new(FusionMode::Min, &[sensor(1.0, None), sensor(1.0, None)]);
+        fusion.update(0, 50, t0);
+        fusion.update(1, 200, t0 + ms(100));
+        assert_eq!(fusion.live(t0 + ms(400)), 2);
+
+        // Sensor 0 went quiet: only sensor 1 counts
+        assert_eq!(fusion.update(1, 210, t0 + ms(600)), Some(210));
+        assert_eq!(fusion.live(t0 + ms(600)), 1);
+        assert_eq!(fusion.fuse(t0 + ms(2000)), None);
+    }
+
+    #[test]
+    fn test_forget_on_disconnect() {
+        let t0 = Instant::now();
+        let mut fusion = Fusion::new(FusionMode::Min, &[sensor(1.0, None), sensor(1.0, None)]);
+        fusion.update(0, 50, t0);
+        fusion.update(1, 200, t0);
+        fusion.forget(0);
+        assert_eq!(fusion.fuse(t0), Some(200));
+        assert!(!fusion.lost(t0));
+    }
+
+    #[test]
+    fn test_lost_once_all_readings_drop_out() {
+        let t0 = Instant::now();
+        let mut fusion = Fusion::new(FusionMode::Min, &[sensor(1.0, None), sensor(1.0, None)]);
+        // Nothing to lose yet
+        assert!(!fusion.lost(t0 + ms(2000)));
+
+        fusion.update(0, 50, t0);
+        fusion.update(1, 200, t0 + ms(300));
+        assert!(!fusion.lost(t0 + ms(600)));
+        assert!(fusion.lost(t0 + ms(900)));
+        // Reported once, until readings come back
+        assert!(!fusion.lost(t0 + ms(1000)));
+        fusion.update(0, 60, t0 + ms(1100));
+        assert!(fusion.lost(t0 + ms(1700)));
+    }
+
+    #[tokio::test]
+    async fn test_sink_forwards_fused_readings_only() {
+        let fusion = Arc::new(Mutex::new(Fusion::new(
+            FusionMode::Min,
+            &[sensor(1.0, None), sensor(1.0, None)],
+        )));
+        let (out, mut rx) = crate::events::channel();
+        let left = FusionSink::new(0, "left", fusion.clone(), out.clone());
+        let right = FusionSink::new(1, "right", fusion, out);
+
+        left.send(BleEvent::Connected).unwrap();
+        assert_eq!(rx.recv().await, Some(BleEvent::Connected));
+
+        left.send(BleEvent::RangeUpdate(300)).unwrap();
+        assert_eq!(rx.recv().await, Some(BleEvent::RangeUpdate(300)));
+        right
+            .send(BleEvent::TimedRangeUpdate {
+                distance_mm: 100,
+                t_ms: 5,
+            })
+            .unwrap();
+        assert_eq!(rx.recv().await, Some(BleEvent::RangeUpdate(100)));
+
+        // Losing one sensor doesn't end the session, the next reading
+        // just comes from the others
+        right.send(BleEvent::Disconnected).unwrap();
+        left.send(BleEvent::RangeUpdate(310)).unwrap();
+        assert_eq!(rx.recv().await, Some(BleEvent::RangeUpdate(310)));
+
+        // Losing the last one does
+        left.send(BleEvent::Disconnected).unwrap();
+        assert_eq!(rx.recv().await, Some(BleEvent::Disconnected));
+    }
+
+    #[tokio::test]
+    async fn test_all_sensors_quiet_reads_as_disconnect() {
+        let fusion = Arc::new(Mutex::new(Fusion::new(
+            FusionMode::Min,
+            &[sensor(1.0, None), sensor(1.0, None)],
+        )));
+        let (out, mut rx) = crate::events::channel();
+        let left = FusionSink::new(0, "left", fusion.clone(), out.clone());
+        left.send(BleEvent::RangeUpdate(300)).unwrap();
+        assert_eq!(rx.recv().await, Some(BleEvent::RangeUpdate(300)));
+
+        let watchdog = tokio::spawn(watch_stale(fusion, out));
+        let event = tokio::time::timeout(SENSOR_STALE_AFTER * 3, rx.recv()).await;
+        assert_eq!(event.unwrap(), Some(BleEvent::Disconnected));
+        watchdog.abort();
+    }
+}
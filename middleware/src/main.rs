@@ -1,16 +1,40 @@
 mod ble;
 mod config;
+mod events;
+mod fusion;
 mod mapper;
+mod output;
+mod prediction;
+mod recording;
+mod reload;
+mod sender;
+mod serial;
+mod smoothing;
+mod stream;
+mod timesync;
 mod toy;
 
 use clap::Parser;
-use config::Config;
+use config::{Config, MappingConfig, OutputConfig};
+use events::{EventReceiver, EventSender};
+use fusion::{Fusion, FusionSink};
 use mapper::RangeMapper;
+use output::OutputScheduler;
+use reload::{Reload, Reloads};
 use std::path::{Path, PathBuf};
 use std::sync::atomic::{AtomicBool, Ordering};
 use std::sync::Arc;
-use tokio::sync::mpsc;
-use tracing::{error, info, warn};
+use std::time::Duration;
+use timesync::{ClockSync, LatencyStats};
+use tokio::sync::{mpsc, watch};
+use tokio::time::{Instant, MissedTickBehavior};
+use tracing::{debug, error, info, warn};
+
+/// How often the sample age and round trip of toy commands are logged.
+const LATENCY_REPORT_INTERVAL: Duration = Duration::from_secs(10);
+
+/// How often an idle session checks for shutdown.
+const SHUTDOWN_POLL_INTERVAL: Duration = Duration::from_secs(1);
 
 #[derive(Parser, Debug)]
 #[command(
@@ -32,6 +56,14 @@ struct Args {
     /// Log level (trace, debug, info, warn, error)
     #[arg(short, long, default_value = "info")]
     log_level: String,
+
+    /// Send a command to the on-device flash recorder and exit
+    #[arg(long, value_enum, value_name = "COMMAND")]
+    record: Option<recording::RecordCommand>,
+
+    /// Download the on-device recording to a CSV file and exit
+    #[arg(long, value_name = "FILE", conflicts_with = "record")]
+    download: Option<PathBuf>,
 }
 
 #[tokio::main]
@@ -55,6 +87,15 @@ async fn main() -> anyhow::Result<()> {
 
     // Load config
     let config = load_config(&args.config)?;
+
+    // One-shot recorder operations
+    if let Some(command) = args.record {
+        return recording::run_command(&config, command).await;
+    }
+    if let Some(path) = &args.download {
+        return recording::run_download(&config, path).await;
+    }
+
     log_config(&config);
 
     // Ctrl+C handling
@@ -65,8 +106,12 @@ async fn main() -> anyhow::Result<()> {
         running_clone.store(false, Ordering::SeqCst);
     })?;
 
+    // Follow config file changes (and SIGHUP)
+    let (config_tx, mut configs) = watch::channel(config);
+    tokio::spawn(reload::watch_config(args.config.clone(), config_tx));
+
     // Main loop with reconnection
-    reconnect_loop(&config, &running, RealSession).await;
+    reconnect_loop(&mut configs, &running, RealSession).await;
 
     info!("Goodbye");
     Ok(())
@@ -82,10 +127,53 @@ pub(crate) fn load_config(path: &Path) -> anyhow::Result<Config> {
     }
 }
 
+/// Which toys to drive and the mapping for each: the buttplug.devices list,
+/// or the one toy buttplug.device_index picks with the shared mapping.
+pub(crate) fn device_plan(
+    config: &Config,
+) -> anyhow::Result<Vec<(toy::DeviceSelector, MappingConfig)>> {
+    if config.buttplug.devices.is_empty() {
+        let selector = match config.buttplug.device_index {
+            Some(index) => toy::DeviceSelector::Index(index),
+            None => toy::DeviceSelector::First,
+        };
+        return Ok(vec![(selector, config.mapping.clone())]);
+    }
+    config
+        .buttplug
+        .devices
+        .iter()
+        .map(|device| {
+            let selector = match (&device.index, &device.name) {
+                (Some(index), _) => toy::DeviceSelector::Index(*index),
+                (None, Some(name)) => toy::DeviceSelector::Name(name.clone()),
+                (None, None) => toy::DeviceSelector::First,
+            };
+            Ok((selector, device.mapping(&config.mapping)?))
+        })
+        .collect()
+}
+
 /// Log the loaded configuration summary.
 pub(crate) fn log_config(config: &Config) {
     info!("Configuration loaded:");
-    info!("  BLE device: {}", config.ble.device_name);
+    if config.serial.enabled {
+        info!("  Wired stream: {:?}", config.serial.port);
+    } else if !config.ble.sensors.is_empty() {
+        let names: Vec<&str> = config
+            .ble
+            .sensors
+            .iter()
+            .map(|s| s.device_name.as_str())
+            .collect();
+        info!(
+            "  BLE sensors: {} ({:?} fusion)",
+            names.join(", "),
+            config.ble.fusion
+        );
+    } else {
+        info!("  BLE device: {}", config.ble.device_name);
+    }
     info!(
         "  Mapping: range [{}-{}mm] -> intensity [{}-{}], invert={}, deadzone={}mm",
         config.mapping.min_range_mm,
@@ -95,18 +183,53 @@ pub(crate) fn log_config(config: &Config) {
         config.mapping.invert,
         config.mapping.deadzone_mm,
     );
+    if config.mapping.on_device {
+        info!("  Mapping runs on the rangefinder");
+    }
+    match config.output.rate_hz {
+        0 => info!("  Output: one command per sample"),
+        rate => info!(
+            "  Output: {} Hz, interpolate={}",
+            rate, config.output.interpolate
+        ),
+    }
     info!("  Buttplug server: {}", config.buttplug.server_address);
+    for device in &config.buttplug.devices {
+        if device.mapping.is_empty() {
+            info!("  Toy {}", device.describe());
+        } else {
+            let keys: Vec<&str> = device.mapping.keys().map(String::as_str).collect();
+            info!("  Toy {}, own {}", device.describe(), keys.join(", "));
+        }
+    }
+    if config.stream.enabled {
+        info!(
+            "  Raw stream: PSM {:#04x} -> {:?}",
+            config.stream.psm, config.stream.record_dir
+        );
+    }
 }
 
-/// Reconnect loop: runs sessions until clean exit or shutdown signal.
+/// Reconnect loop: runs sessions until clean exit or shutdown signal. Each
+/// session starts with the latest of `configs`; a session that ends for a
+/// config change that needs a reconnect is followed straight away by one
+/// with the new config.
 pub(crate) async fn reconnect_loop(
-    config: &Config,
+    configs: &mut watch::Receiver<Config>,
     running: &Arc<AtomicBool>,
     session_fn: impl AsyncSessionFn,
 ) {
     while running.load(Ordering::SeqCst) {
-        match session_fn.run(config, running).await {
+        let config = configs.borrow_and_update().clone();
+        let reloads = Reloads::new(configs.clone(), config.clone());
+        match session_fn.run(&config, reloads, running).await {
             Ok(()) => {
+                let restart =
+                    reload::classify(&config, &configs.borrow()) == reload::Change::Restart;
+                if restart && running.load(Ordering::SeqCst) {
+                    info!("Reconnecting with the new config");
+                    continue;
+                }
                 info!("Session ended cleanly");
                 break;
             }
@@ -128,93 +251,467 @@ pub(crate) async fn reconnect_loop(
 /// Trait for session runner functions, to work around async closure lifetime issues.
 #[async_trait::async_trait]
 pub(crate) trait AsyncSessionFn {
-    async fn run(&self, config: &Config, running: &Arc<AtomicBool>) -> anyhow::Result<()>;
+    async fn run(
+        &self,
+        config: &Config,
+        reloads: Reloads,
+        running: &Arc<AtomicBool>,
+    ) -> anyhow::Result<()>;
 }
 
 struct RealSession;
 
 #[async_trait::async_trait]
 impl AsyncSessionFn for RealSession {
-    async fn run(&self, config: &Config, running: &Arc<AtomicBool>) -> anyhow::Result<()> {
-        run_session(config, running).await
+    async fn run(
+        &self,
+        config: &Config,
+        reloads: Reloads,
+        running: &Arc<AtomicBool>,
+    ) -> anyhow::Result<()> {
+        run_session(config, reloads, running).await
     }
 }
 
-async fn run_session(config: &Config, running: &Arc<AtomicBool>) -> anyhow::Result<()> {
-    // 1. Find fancypants-nrf52 BLE device
-    let peripheral: btleplug::platform::Peripheral =
-        ble::find_device(&config.ble.device_name, config.ble.scan_timeout_secs).await?;
+async fn run_session(
+    config: &Config,
+    mut reloads: Reloads,
+    running: &Arc<AtomicBool>,
+) -> anyhow::Result<()> {
+    // 1. Find fancypants-nrf52 BLE device (not needed when tethered; with
+    // several sensors each one scans for itself)
+    let peripheral: Option<btleplug::platform::Peripheral> =
+        if config.serial.enabled || !config.ble.sensors.is_empty() {
+            None
+        } else {
+            Some(ble::find_device(&config.ble.device_name, config.ble.scan_timeout_secs).await?)
+        };
+
+    // 2. Connect to Intiface Engine and pick the toys
+    let plan = device_plan(config)?;
+    let controller = toy::ToyController::connect(&config.buttplug.server_address).await?;
+    let selectors: Vec<_> = plan.iter().map(|(selector, _)| selector.clone()).collect();
+    let mut toys = controller
+        .find_devices(
+            &selectors,
+            &config.buttplug.actuator_types,
+            config.output.tick(),
+        )
+        .await?;
+
+    // 3. Set up a range mapper per toy
+    let devices: Vec<Device> = toys
+        .iter_mut()
+        .zip(plan)
+        .map(|((name, toy), (_, mapping))| Device {
+            name: name.clone(),
+            toy,
+            mapper: RangeMapper::new(mapping),
+        })
+        .collect();
+
+    // 4. Start the range source: BLE notifications, fused sensors or the
+    // wired stream. Samples are latest-wins so a slow toy always gets the
+    // freshest one
+    let (tx, mut rx) = events::channel();
+    let source_running = Arc::new(AtomicBool::new(true));
+    let source_handles = match &peripheral {
+        None if !config.ble.sensors.is_empty() => spawn_sensors(config, &tx),
+        Some(peripheral) => {
+            let peripheral = peripheral.clone();
+            let tx = tx.clone();
+            let device_mapping = config.mapping.on_device.then(|| config.mapping.clone());
+            let batched = config.ble.batched;
+            let time_sync = (config.ble.time_sync_interval_secs > 0)
+                .then(|| Duration::from_secs(config.ble.time_sync_interval_secs));
+            vec![tokio::spawn(async move {
+                if let Err(e) = ble::run_ble_client(
+                    &peripheral,
+                    tx,
+                    device_mapping.as_ref(),
+                    batched,
+                    time_sync,
+                )
+                .await
+                {
+                    error!("BLE client error: {:#}", e);
+                }
+            })]
+        }
+        None => {
+            let port = config.serial.port.clone();
+            let tx = tx.clone();
+            let source_running = source_running.clone();
+            vec![tokio::task::spawn_blocking(move || {
+                if let Err(e) = serial::run_serial_client(&port, tx, &source_running) {
+                    error!("Wired stream error: {:#}", e);
+                }
+            })]
+        }
+    };
 
-    // 2. Connect to Intiface Engine
-    let mut toy: toy::ToyController =
-        toy::ToyController::connect(&config.buttplug.server_address).await?;
-    toy.find_device(config.buttplug.device_index).await?;
+    // 5. Optionally record the raw L2CAP stream alongside
+    let stream_handle = peripheral
+        .as_ref()
+        .filter(|_| config.stream.enabled)
+        .map(|p| spawn_stream_recorder(p.clone(), config, running.clone()));
 
-    // 3. Set up range mapper
-    let mut mapper = RangeMapper::new(config.mapping.clone());
+    let result = run_session_inner(devices, &mut rx, &config.output, running, &mut reloads).await;
 
-    // 4. Start BLE notification listener
-    let (tx, mut rx) = mpsc::unbounded_channel();
-    let ble_handle = {
-        let peripheral = peripheral.clone();
-        let tx = tx.clone();
-        tokio::spawn(async move {
-            if let Err(e) = ble::run_ble_client(&peripheral, tx).await {
-                error!("BLE client error: {:#}", e);
+    // Cleanup
+    info!("Stopping devices...");
+    futures::future::join_all(toys.iter_mut().map(|(_, toy)| toy::ToyBackend::stop(toy))).await;
+    let _ = controller.disconnect().await;
+    // The wired reader notices within one read timeout
+    source_running.store(false, Ordering::SeqCst);
+    for handle in source_handles {
+        handle.abort();
+    }
+    if let Some(handle) = stream_handle {
+        // The recorder thread ends on its own once the link drops
+        handle.abort();
+    }
+
+    result
+}
+
+/// Start a reconnecting client per configured sensor, all feeding one
+/// fusion stage in front of the session, and a watchdog that ends the
+/// session once every sensor has gone quiet.
+fn spawn_sensors(config: &Config, tx: &EventSender) -> Vec<tokio::task::JoinHandle<()>> {
+    let fusion = Fusion::new(config.ble.fusion, &config.ble.sensors);
+    let fusion = Arc::new(std::sync::Mutex::new(fusion));
+    let mut handles: Vec<_> = config
+        .ble
+        .sensors
+        .iter()
+        .enumerate()
+        .map(|(i, sensor)| {
+            let sink = FusionSink::new(i, &sensor.device_name, fusion.clone(), tx.clone());
+            tokio::spawn(fusion::run_sensor(sensor.clone(), sink, config.ble.clone()))
+        })
+        .collect();
+    handles.push(tokio::spawn(fusion::watch_stale(fusion, tx.clone())));
+    handles
+}
+
+/// Record the raw stream to a new file once the BLE link is up.
+fn spawn_stream_recorder(
+    peripheral: btleplug::platform::Peripheral,
+    config: &Config,
+    running: Arc<AtomicBool>,
+) -> tokio::task::JoinHandle<()> {
+    use btleplug::api::{AddressType, Peripheral as _};
+
+    let psm = config.stream.psm;
+    let dir = config.stream.record_dir.clone();
+    tokio::spawn(async move {
+        // The channel rides on the connection run_ble_client opens
+        while !peripheral.is_connected().await.unwrap_or(false) {
+            if !running.load(Ordering::SeqCst) {
+                return;
             }
+            tokio::time::sleep(std::time::Duration::from_millis(200)).await;
+        }
+
+        // nRF52 boards use a random static address unless told otherwise
+        let address_type = peripheral
+            .properties()
+            .await
+            .ok()
+            .flatten()
+            .and_then(|p| p.address_type);
+        let random = address_type != Some(AddressType::Public);
+        let address = peripheral.address().into_inner();
+        let stamp = std::time::SystemTime::now()
+            .duration_since(std::time::UNIX_EPOCH)
+            .map(|d| d.as_secs())
+            .unwrap_or(0);
+        let path = dir.join(format!("stream-{stamp}.csv"));
+
+        let result = tokio::task::spawn_blocking(move || {
+            std::fs::create_dir_all(&dir)?;
+            stream::run_recorder(address, random, psm, &path, running)
         })
-    };
+        .await;
+        match result {
+            Ok(Err(e)) => warn!("Raw stream recording failed: {:#}", e),
+            Err(e) => warn!("Raw stream task failed: {}", e),
+            Ok(Ok(())) => {}
+        }
+    })
+}
 
-    let backend: &mut dyn toy::ToyBackend = &mut toy;
-    let result = run_session_inner(backend, &mut rx, &mut mapper, running).await;
+/// Note how old the sample behind a toy command was, once the device
+/// clock is known, and log the figures every LATENCY_REPORT_INTERVAL.
+fn record_sample_age(clock: &ClockSync, stats: &mut LatencyStats, t_ms: u32) -> Option<f64> {
+    let estimate = clock.estimate()?;
+    let age_us = estimate.sample_age_us(t_ms, timesync::host_now_us());
+    debug!("Sample age at toy command: {:.1}ms", age_us / 1000.0);
+    stats.record(age_us);
+
+    if let Some((count, mean_us, max_us)) = stats.take_report() {
+        info!(
+            "Sample age at toy command: avg {:.1}ms, max {:.1}ms over {} commands \
+             (clock ±{:.1}ms, drift {:+.1}ppm)",
+            mean_us / 1000.0,
+            max_us / 1000.0,
+            count,
+            estimate.uncertainty_us / 1000.0,
+            estimate.drift_ppm()
+        );
+    }
+    Some(age_us)
+}
 
-    // Cleanup
-    info!("Stopping device...");
-    let _ = backend.stop().await;
-    let _ = backend.disconnect().await;
-    ble_handle.abort();
+/// Running figures for the toy commands the sender got through.
+struct CommandStats {
+    ages: LatencyStats,
+    rtts: LatencyStats,
+    superseded: u64,
+}
 
-    result
+impl CommandStats {
+    fn new() -> Self {
+        CommandStats {
+            ages: LatencyStats::new(LATENCY_REPORT_INTERVAL),
+            rtts: LatencyStats::new(LATENCY_REPORT_INTERVAL),
+            superseded: 0,
+        }
+    }
+
+    /// Note an accepted command, and log the round trip figures every
+    /// LATENCY_REPORT_INTERVAL. Returns the command's end-to-end latency
+    /// if it carried a fresh sample: the sample's age on completion when
+    /// the clocks are synced, else just the round trip. A tick reposting
+    /// an older level has none; its round trip says nothing about how far
+    /// behind the hand the toy is.
+    fn record(&mut self, name: &str, sent: &sender::Sent, clock: &ClockSync) -> Option<Duration> {
+        let age_us = sent
+            .command
+            .t_ms
+            .and_then(|t_ms| record_sample_age(clock, &mut self.ages, t_ms));
+
+        let rtt_us = sent.rtt.as_secs_f64() * 1e6;
+        debug!("{}: command RTT {:.1}ms", name, rtt_us / 1000.0);
+        self.rtts.record(rtt_us);
+        self.superseded += sent.superseded;
+
+        if let Some((count, mean_us, max_us)) = self.rtts.take_report() {
+            info!(
+                "Toy command RTT ({}): avg {:.1}ms, max {:.1}ms over {} commands \
+                 ({} superseded while one was in flight)",
+                name,
+                mean_us / 1000.0,
+                max_us / 1000.0,
+                count,
+                std::mem::take(&mut self.superseded)
+            );
+        }
+        match (sent.command.t_ms, age_us) {
+            (None, _) => None,
+            (Some(_), Some(age_us)) => Some(Duration::from_secs_f64(age_us.max(0.0) / 1e6)),
+            (Some(_), None) => Some(sent.rtt),
+        }
+    }
+}
+
+/// A toy and the mapping that drives it.
+pub(crate) struct Device<'a> {
+    pub name: String,
+    pub toy: &'a mut dyn toy::ToyBackend,
+    pub mapper: RangeMapper,
+}
+
+/// What a range event asks of each toy.
+#[allow(clippy::large_enum_variant)] // batch moved in from the event as is
+enum Input {
+    Range {
+        distance_mm: u16,
+        t_ms: Option<u32>,
+    },
+    Batch(ble::RangeBatch),
+    /// Already mapped and smoothed on the device
+    Level(f64),
+}
+
+/// Control loop state for one toy.
+struct Lane {
+    name: String,
+    mapper: RangeMapper,
+    scheduler: OutputScheduler,
+    poster: sender::CommandPoster,
+    /// Device time of the newest sample not yet posted, for the age report
+    unposted_t_ms: Option<u32>,
+    stats: CommandStats,
+}
+
+impl Lane {
+    /// This toy's intensity for an input, and the sample's device time if
+    /// known.
+    fn map(&mut self, input: &Input) -> Option<(f64, Option<u32>)> {
+        match input {
+            Input::Range { distance_mm, t_ms } => {
+                Some((self.mapper.map_sample(*distance_mm, *t_ms), *t_ms))
+            }
+            Input::Batch(batch) => {
+                // Run every sample through the mapper so smoothing sees the
+                // full rate, but only send the latest
+                let mut latest = None;
+                for (t_ms, distance_mm) in batch.valid() {
+                    latest = Some((self.mapper.map_sample(distance_mm, Some(t_ms)), Some(t_ms)));
+                }
+                latest
+            }
+            Input::Level(level) => Some((*level, None)),
+        }
+    }
+}
+
+/// Wait for the next output tick; never resolves when output follows the
+/// samples.
+async fn next_tick(tick: &mut Option<tokio::time::Interval>) {
+    match tick {
+        Some(tick) => {
+            tick.tick().await;
+        }
+        None => std::future::pending().await,
+    }
 }
 
 /// Core event loop, extracted for testability.
+///
+/// Every sample drives all toys, each through its own mapper. Commands go
+/// through one sender per toy running alongside, so the loop keeps reading
+/// samples while commands are in flight and a slow toy never holds up the
+/// others. A reloaded mapping is swapped into the mappers between samples.
+/// The session ends when the event source does, on shutdown, for a reload
+/// that needs a reconnect, or once every toy has lost Intiface; commands
+/// still in flight then are abandoned.
 pub(crate) async fn run_session_inner(
-    toy: &mut dyn toy::ToyBackend,
-    rx: &mut mpsc::UnboundedReceiver<ble::BleEvent>,
-    mapper: &mut RangeMapper,
+    devices: Vec<Device<'_>>,
+    rx: &mut EventReceiver,
+    output: &OutputConfig,
     running: &Arc<AtomicBool>,
+    reloads: &mut Reloads,
 ) -> anyhow::Result<()> {
     info!("Running — move your hand near the sensor!");
 
-    while running.load(Ordering::SeqCst) {
-        tokio::select! {
-            event = rx.recv() => {
-                match event {
-                    Some(ble::BleEvent::RangeUpdate(distance_mm)) => {
-                        let intensity = mapper.map(distance_mm);
-                        if let Err(e) = toy.set_intensity(intensity).await {
-                            warn!("Failed to set intensity: {:#}", e);
+    let (sent_tx, mut sent_rx) = mpsc::unbounded_channel();
+    let mut lanes = Vec::with_capacity(devices.len());
+    let mut senders = Vec::with_capacity(devices.len());
+    for (i, device) in devices.into_iter().enumerate() {
+        let (poster, mut sender) = sender::channel(i, &device.name);
+        lanes.push(Lane {
+            name: device.name,
+            mapper: device.mapper,
+            scheduler: OutputScheduler::new(output.interpolate),
+            poster,
+            unposted_t_ms: None,
+            stats: CommandStats::new(),
+        });
+        let toy = device.toy;
+        let sent_tx = sent_tx.clone();
+        senders.push(async move { sender.run(toy, sent_tx).await });
+    }
+    drop(sent_tx);
+
+    let control = async {
+        let mut clock = ClockSync::new();
+
+        // With an output rate, samples only update the schedulers and the
+        // toys are commanded on the tick; without one, each sample is sent
+        // as it arrives
+        let mut tick = output.tick().map(|period| {
+            let mut tick = tokio::time::interval(period);
+            tick.set_missed_tick_behavior(MissedTickBehavior::Skip);
+            tick
+        });
+
+        // Wake now and then to notice shutdown while nothing arrives
+        let mut wake = tokio::time::interval(SHUTDOWN_POLL_INTERVAL);
+
+        while running.load(Ordering::SeqCst) {
+            tokio::select! {
+                event = rx.recv() => {
+                    let input = match event {
+                        Some(ble::BleEvent::RangeUpdate(distance_mm)) => {
+                            Input::Range { distance_mm, t_ms: None }
+                        }
+                        Some(ble::BleEvent::TimedRangeUpdate { distance_mm, t_ms }) => {
+                            Input::Range { distance_mm, t_ms: Some(t_ms) }
+                        }
+                        Some(ble::BleEvent::RangeBatch(batch)) => Input::Batch(batch),
+                        Some(ble::BleEvent::IntensityUpdate(level)) => {
+                            Input::Level(level as f64 / 255.0)
+                        }
+                        Some(ble::BleEvent::TimeSync(sample)) => {
+                            clock.add(sample);
+                            continue;
+                        }
+                        Some(ble::BleEvent::Disconnected) | None => {
+                            warn!("BLE disconnected");
+                            break;
+                        }
+                        Some(ble::BleEvent::Connected) => {
+                            info!("BLE connected");
+                            continue;
+                        }
+                    };
+
+                    for lane in &mut lanes {
+                        let Some((intensity, t_ms)) = lane.map(&input) else {
+                            continue;
+                        };
+                        if tick.is_some() {
+                            lane.scheduler.push(intensity, Instant::now());
+                            lane.unposted_t_ms = t_ms;
+                        } else {
+                            lane.poster.post(sender::Command { intensity, t_ms });
                         }
                     }
-                    Some(ble::BleEvent::Disconnected) | None => {
-                        warn!("BLE disconnected");
-                        break;
-                    }
-                    Some(ble::BleEvent::Connected) => {
-                        info!("BLE connected");
+                }
+                _ = next_tick(&mut tick) => {
+                    let now = Instant::now();
+                    for lane in &mut lanes {
+                        if let Some(intensity) = lane.scheduler.level(now) {
+                            let t_ms = lane.unposted_t_ms.take();
+                            lane.poster.post(sender::Command { intensity, t_ms });
+                        }
                     }
                 }
-            }
-            _ = tokio::time::sleep(std::time::Duration::from_secs(1)) => {
-                // Periodic check that everything is still alive
-                if !toy.is_connected() {
-                    warn!("Lost connection to Intiface");
-                    break;
+                Some(sent) = sent_rx.recv() => {
+                    let lane = &mut lanes[sent.device];
+                    if let Some(latency) = lane.stats.record(&lane.name, &sent, &clock) {
+                        lane.mapper.observe_latency(latency);
+                    }
                 }
+                reload = reloads.next() => match reload {
+                    Reload::Remap(mappings) => {
+                        for (lane, mapping) in lanes.iter_mut().zip(mappings) {
+                            lane.mapper.update_config(mapping);
+                        }
+                    }
+                    Reload::Restart => break,
+                },
+                _ = wake.tick() => {}
             }
         }
+    };
+
+    tokio::select! {
+        () = control => {}
+        _ = futures::future::join_all(senders) => {
+            warn!("No toys left");
+        }
     }
 
+    if rx.coalesced() > 0 {
+        info!(
+            "{} stale samples skipped while the toys were busy",
+            rx.coalesced()
+        );
+    }
     Ok(())
 }
 
@@ -222,11 +719,14 @@ pub(crate) async fn run_session_inner(
 mod tests {
     use super::*;
     use crate::config::MappingConfig;
+    use crate::events::EventSink;
     use std::sync::atomic::AtomicU32;
 
     struct MockToy {
         intensities: Vec<f64>,
         connected: bool,
+        /// How long each command takes to be acknowledged
+        delay: Duration,
     }
 
     impl MockToy {
@@ -234,25 +734,25 @@ mod tests {
             MockToy {
                 intensities: Vec::new(),
                 connected: true,
+                delay: Duration::ZERO,
             }
         }
     }
 
     #[async_trait::async_trait]
     impl toy::ToyBackend for MockToy {
-        async fn set_intensity(&mut self, intensity: f64) -> anyhow::Result<()> {
+        async fn set_intensity(&mut self, intensity: f64) -> anyhow::Result<bool> {
+            if !self.delay.is_zero() {
+                tokio::time::sleep(self.delay).await;
+            }
             self.intensities.push(intensity);
-            Ok(())
+            Ok(true)
         }
 
         async fn stop(&mut self) -> anyhow::Result<()> {
             Ok(())
         }
 
-        async fn disconnect(&self) -> anyhow::Result<()> {
-            Ok(())
-        }
-
         fn is_connected(&self) -> bool {
             self.connected
         }
@@ -267,25 +767,354 @@ mod tests {
             max_intensity: 1.0,
             deadzone_mm: 500,
             smoothing: 0.0,
+            on_device: false,
+            ..Config::default().mapping
+        }
+    }
+
+    fn device(toy: &mut dyn toy::ToyBackend, mapper: RangeMapper) -> Device<'_> {
+        Device {
+            name: "test".to_string(),
+            toy,
+            mapper,
         }
     }
 
+    /// Output that follows the samples, one command each.
+    fn per_sample() -> OutputConfig {
+        OutputConfig {
+            rate_hz: 0,
+            interpolate: false,
+        }
+    }
+
+    /// Feed events to a session one at a time, spaced out like a live link,
+    /// so latest-wins coalescing doesn't merge them.
+    fn feed(events: Vec<ble::BleEvent>) -> EventReceiver {
+        let (tx, rx) = events::channel();
+        tokio::spawn(async move {
+            for event in events {
+                let _ = tx.send(event);
+                tokio::time::sleep(Duration::from_millis(5)).await;
+            }
+        });
+        rx
+    }
+
     // --- run_session_inner tests ---
 
     #[tokio::test]
     async fn test_session_processes_range_updates() {
         let mut toy = MockToy::new();
-        let (tx, mut rx) = mpsc::unbounded_channel();
-        let mut mapper = RangeMapper::new(test_mapping_config());
+        let mapper = RangeMapper::new(test_mapping_config());
+        let running = Arc::new(AtomicBool::new(true));
+
+        let mut rx = feed(vec![
+            ble::BleEvent::RangeUpdate(30),
+            ble::BleEvent::RangeUpdate(300),
+        ]);
+
+        run_session_inner(
+            vec![device(&mut toy, mapper)],
+            &mut rx,
+            &per_sample(),
+            &running,
+            &mut Reloads::none(),
+        )
+        .await
+        .unwrap();
+
+        assert_eq!(toy.intensities.len(), 2);
+        assert!((toy.intensities[0] - 1.0).abs() < 0.01);
+        assert!((toy.intensities[1] - 0.0).abs() < 0.01);
+    }
+
+    #[tokio::test]
+    async fn test_session_acts_on_freshest_sample() {
+        let mut toy = MockToy::new();
+        let mapper = RangeMapper::new(test_mapping_config());
         let running = Arc::new(AtomicBool::new(true));
 
+        // Both arrive while the toy is busy: only the newer one is sent
+        let (tx, mut rx) = events::channel();
         tx.send(ble::BleEvent::RangeUpdate(30)).unwrap();
         tx.send(ble::BleEvent::RangeUpdate(300)).unwrap();
-        drop(tx);
+        tokio::spawn(async move {
+            tokio::time::sleep(Duration::from_millis(20)).await;
+            drop(tx);
+        });
+
+        run_session_inner(
+            vec![device(&mut toy, mapper)],
+            &mut rx,
+            &per_sample(),
+            &running,
+            &mut Reloads::none(),
+        )
+        .await
+        .unwrap();
+
+        assert_eq!(toy.intensities.len(), 1);
+        assert!((toy.intensities[0] - 0.0).abs() < 0.01);
+        assert_eq!(rx.coalesced(), 1);
+    }
+
+    #[tokio::test]
+    async fn test_session_swaps_in_reloaded_mapping() {
+        let mut toy = MockToy::new();
+        let config = Config {
+            mapping: test_mapping_config(),
+            ..Config::default()
+        };
+        let mapper = RangeMapper::new(config.mapping.clone());
+        let running = Arc::new(AtomicBool::new(true));
+        let (config_tx, configs) = watch::channel(config.clone());
+        let mut reloads = Reloads::new(configs, config.clone());
+
+        let (tx, mut rx) = events::channel();
+        tokio::spawn(async move {
+            tx.send(ble::BleEvent::RangeUpdate(30)).unwrap();
+            tokio::time::sleep(Duration::from_millis(20)).await;
+            let mut halved = config;
+            halved.mapping.max_intensity = 0.5;
+            config_tx.send_replace(halved);
+            tokio::time::sleep(Duration::from_millis(20)).await;
+            tx.send(ble::BleEvent::RangeUpdate(30)).unwrap();
+            tokio::time::sleep(Duration::from_millis(20)).await;
+        });
+
+        run_session_inner(
+            vec![device(&mut toy, mapper)],
+            &mut rx,
+            &per_sample(),
+            &running,
+            &mut reloads,
+        )
+        .await
+        .unwrap();
+
+        // Same reading, new mapping, same session
+        assert_eq!(toy.intensities.len(), 2);
+        assert!((toy.intensities[0] - 1.0).abs() < 0.01);
+        assert!((toy.intensities[1] - 0.5).abs() < 0.01);
+    }
 
-        run_session_inner(&mut toy, &mut rx, &mut mapper, &running)
+    #[tokio::test]
+    async fn test_session_ends_for_connection_change() {
+        let mut toy = MockToy::new();
+        let mapper = RangeMapper::new(test_mapping_config());
+        let running = Arc::new(AtomicBool::new(true));
+        let config = Config::default();
+        let (config_tx, configs) = watch::channel(config.clone());
+        let mut reloads = Reloads::new(configs, config.clone());
+
+        // The source stays up; only the reload ends the session
+        let (_tx, mut rx) = events::channel();
+        let mut moved = config;
+        moved.buttplug.server_address = "ws://10.0.0.2:12345".to_string();
+        config_tx.send_replace(moved);
+
+        let output = per_sample();
+        let session = run_session_inner(
+            vec![device(&mut toy, mapper)],
+            &mut rx,
+            &output,
+            &running,
+            &mut reloads,
+        );
+        tokio::time::timeout(Duration::from_secs(1), session)
             .await
+            .expect("session should end for the reload")
             .unwrap();
+    }
+
+    #[tokio::test(start_paused = true)]
+    async fn test_session_output_runs_at_fixed_rate() {
+        let mut toy = MockToy::new();
+        let mapper = RangeMapper::new(test_mapping_config());
+        let running = Arc::new(AtomicBool::new(true));
+        let output = OutputConfig {
+            rate_hz: 50,
+            interpolate: true,
+        };
+
+        // Three samples 100 ms apart, then 200 ms without any. Everything
+        // lands 10 ms off the 20 ms tick grid so no event ties with a tick
+        // on the paused clock.
+        let (tx, mut rx) = events::channel();
+        tokio::spawn(async move {
+            tokio::time::sleep(Duration::from_millis(10)).await;
+            for distance_mm in [300, 300, 30] {
+                tx.send(ble::BleEvent::RangeUpdate(distance_mm)).unwrap();
+                tokio::time::sleep(Duration::from_millis(100)).await;
+            }
+            tokio::time::sleep(Duration::from_millis(100)).await;
+            tx.send(ble::BleEvent::Disconnected).unwrap();
+        });
+
+        run_session_inner(
+            vec![device(&mut toy, mapper)],
+            &mut rx,
+            &output,
+            &running,
+            &mut Reloads::none(),
+        )
+        .await
+        .unwrap();
+
+        // One command per 20 ms tick from the first sample to the
+        // disconnect, not one per sample: 0.0 until the near sample, then a
+        // ramp to 1.0 over the 100 ms sample gap
+        let mut expected = vec![0.0; 10];
+        expected.extend([0.1, 0.3, 0.5, 0.7, 0.9]);
+        expected.extend([1.0; 5]);
+        assert_eq!(
+            toy.intensities.len(),
+            expected.len(),
+            "{:?}",
+            toy.intensities
+        );
+        for (got, want) in toy.intensities.iter().zip(&expected) {
+            assert!((got - want).abs() < 1e-9, "{:?}", toy.intensities);
+        }
+    }
+
+    #[tokio::test(start_paused = true)]
+    async fn test_session_drives_toys_independently() {
+        let mut fast = MockToy::new();
+        let mut slow = MockToy::new();
+        slow.delay = Duration::from_millis(100);
+        let mut half = test_mapping_config();
+        half.max_intensity = 0.5;
+        let running = Arc::new(AtomicBool::new(true));
+
+        // On a paused clock the samples are exactly 10 ms apart, so none
+        // are merged before the control loop reads them
+        let (tx, mut rx) = events::channel();
+        tokio::spawn(async move {
+            for distance_mm in [30, 300, 30, 300, 30] {
+                tx.send(ble::BleEvent::RangeUpdate(distance_mm)).unwrap();
+                tokio::time::sleep(Duration::from_millis(10)).await;
+            }
+            tokio::time::sleep(Duration::from_millis(300)).await;
+            tx.send(ble::BleEvent::Disconnected).unwrap();
+        });
+
+        let devices = vec![
+            device(&mut fast, RangeMapper::new(test_mapping_config())),
+            device(&mut slow, RangeMapper::new(half)),
+        ];
+        run_session_inner(
+            devices,
+            &mut rx,
+            &per_sample(),
+            &running,
+            &mut Reloads::none(),
+        )
+        .await
+        .unwrap();
+
+        // The fast toy got every sample despite the slow one being busy
+        assert_eq!(fast.intensities.len(), 5);
+        for (intensity, expected) in fast.intensities.iter().zip([1.0, 0.0, 1.0, 0.0, 1.0]) {
+            assert!((intensity - expected).abs() < 0.01);
+        }
+        // The slow one got the first, then skipped straight to the latest,
+        // each through its own mapping
+        assert_eq!(slow.intensities.len(), 2);
+        assert!(slow.intensities.iter().all(|i| (i - 0.5).abs() < 0.01));
+    }
+
+    #[tokio::test]
+    async fn test_session_forwards_device_intensity() {
+        let mut toy = MockToy::new();
+        let mapper = RangeMapper::new(test_mapping_config());
+        let running = Arc::new(AtomicBool::new(true));
+
+        let mut rx = feed(vec![
+            ble::BleEvent::IntensityUpdate(255),
+            ble::BleEvent::IntensityUpdate(51),
+            ble::BleEvent::IntensityUpdate(0),
+        ]);
+
+        run_session_inner(
+            vec![device(&mut toy, mapper)],
+            &mut rx,
+            &per_sample(),
+            &running,
+            &mut Reloads::none(),
+        )
+        .await
+        .unwrap();
+
+        // Passed through as-is, not run through the host mapper again
+        assert_eq!(toy.intensities, vec![1.0, 0.2, 0.0]);
+    }
+
+    #[tokio::test]
+    async fn test_session_maps_whole_batch_sends_latest() {
+        let mut toy = MockToy::new();
+        let mut cfg = test_mapping_config();
+        cfg.smoothing = 0.5;
+        let mapper = RangeMapper::new(cfg);
+        let running = Arc::new(AtomicBool::new(true));
+
+        // 300mm, 30mm, failed read, 30mm at 10ms: raw intensities 0, 1, -, 1
+        let payload = [
+            0x01, 0x04, 0x00, 0x00, 0x00, 0x00, 0x0A, 0x00, 0x2C, 0x01, 0x9B, 0x04, 0xC2, 0xFF,
+            0x07, 0xC1, 0xFF, 0x07,
+        ];
+        let batch = ble::decode_range_batch(&payload).unwrap();
+
+        let mut rx = feed(vec![ble::BleEvent::RangeBatch(batch)]);
+
+        run_session_inner(
+            vec![device(&mut toy, mapper)],
+            &mut rx,
+            &per_sample(),
+            &running,
+            &mut Reloads::none(),
+        )
+        .await
+        .unwrap();
+
+        // One command per batch; smoothing ran over all three valid samples
+        assert_eq!(toy.intensities.len(), 1);
+        assert!((toy.intensities[0] - 0.75).abs() < 1e-9);
+    }
+
+    #[tokio::test]
+    async fn test_session_maps_timed_updates_with_clock_sync() {
+        let mut toy = MockToy::new();
+        let mapper = RangeMapper::new(test_mapping_config());
+        let running = Arc::new(AtomicBool::new(true));
+
+        // Before and after the clock is known; both still drive the toy
+        let mut rx = feed(vec![
+            ble::BleEvent::TimedRangeUpdate {
+                distance_mm: 30,
+                t_ms: 1_000,
+            },
+            ble::BleEvent::TimeSync(timesync::SyncSample {
+                host_sent_us: 0,
+                device_us: 1_000_000,
+                host_recv_us: 10_000,
+            }),
+            ble::BleEvent::TimedRangeUpdate {
+                distance_mm: 300,
+                t_ms: 1_010,
+            },
+        ]);
+
+        run_session_inner(
+            vec![device(&mut toy, mapper)],
+            &mut rx,
+            &per_sample(),
+            &running,
+            &mut Reloads::none(),
+        )
+        .await
+        .unwrap();
 
         assert_eq!(toy.intensities.len(), 2);
         assert!((toy.intensities[0] - 1.0).abs() < 0.01);
@@ -295,35 +1124,127 @@ mod tests {
     #[tokio::test]
     async fn test_session_stops_on_disconnect_event() {
         let mut toy = MockToy::new();
-        let (tx, mut rx) = mpsc::unbounded_channel();
-        let mut mapper = RangeMapper::new(test_mapping_config());
+        let mapper = RangeMapper::new(test_mapping_config());
         let running = Arc::new(AtomicBool::new(true));
 
-        tx.send(ble::BleEvent::RangeUpdate(165)).unwrap();
-        tx.send(ble::BleEvent::Disconnected).unwrap();
-        tx.send(ble::BleEvent::RangeUpdate(30)).unwrap();
+        let mut rx = feed(vec![
+            ble::BleEvent::RangeUpdate(165),
+            ble::BleEvent::Disconnected,
+            ble::BleEvent::RangeUpdate(30),
+        ]);
 
-        run_session_inner(&mut toy, &mut rx, &mut mapper, &running)
+        run_session_inner(
+            vec![device(&mut toy, mapper)],
+            &mut rx,
+            &per_sample(),
+            &running,
+            &mut Reloads::none(),
+        )
+        .await
+        .unwrap();
+
+        assert_eq!(toy.intensities.len(), 1);
+    }
+
+    #[tokio::test]
+    async fn test_session_stops_when_every_fused_sensor_disconnects() {
+        let mut toy = MockToy::new();
+        let mapper = RangeMapper::new(test_mapping_config());
+        let running = Arc::new(AtomicBool::new(true));
+        let output = OutputConfig {
+            rate_hz: 30,
+            interpolate: false,
+        };
+
+        let sensors = [
+            crate::config::SensorConfig {
+                device_name: "left".to_string(),
+                weight: 1.0,
+                zone_mm: None,
+            },
+            crate::config::SensorConfig {
+                device_name: "right".to_string(),
+                weight: 1.0,
+                zone_mm: None,
+            },
+        ];
+        let fusion = Arc::new(std::sync::Mutex::new(Fusion::new(
+            crate::config::FusionMode::Min,
+            &sensors,
+        )));
+        let (tx, mut rx) = events::channel();
+        let left = FusionSink::new(0, "left", fusion.clone(), tx.clone());
+        let right = FusionSink::new(1, "right", fusion, tx);
+        tokio::spawn(async move {
+            left.send(ble::BleEvent::RangeUpdate(30)).unwrap();
+            right.send(ble::BleEvent::RangeUpdate(40)).unwrap();
+            tokio::time::sleep(Duration::from_millis(50)).await;
+            let _ = left.send(ble::BleEvent::Disconnected);
+            let _ = right.send(ble::BleEvent::Disconnected);
+            // Keep the channel open: only the disconnect may end it
+            tokio::time::sleep(Duration::from_secs(5)).await;
+        });
+
+        // Without the forwarded disconnect the tick would keep reposting
+        // the last level
+        let mut reloads = Reloads::none();
+        let session = run_session_inner(
+            vec![device(&mut toy, mapper)],
+            &mut rx,
+            &output,
+            &running,
+            &mut reloads,
+        );
+        tokio::time::timeout(Duration::from_secs(1), session)
             .await
+            .expect("session should end once no sensor is left")
             .unwrap();
+        assert!(!toy.intensities.is_empty());
+    }
 
-        assert_eq!(toy.intensities.len(), 1);
+    #[test]
+    fn test_command_latency_needs_a_fresh_sample() {
+        let mut stats = CommandStats::new();
+        let clock = ClockSync::new();
+        let mut sent = sender::Sent {
+            device: 0,
+            command: sender::Command {
+                intensity: 0.5,
+                t_ms: Some(1000),
+            },
+            rtt: Duration::from_millis(25),
+            superseded: 0,
+        };
+        // No clock sync: the round trip stands in
+        assert_eq!(
+            stats.record("test", &sent, &clock),
+            Some(Duration::from_millis(25))
+        );
+        // A tick reposting the held level measures nothing
+        sent.command.t_ms = None;
+        assert_eq!(stats.record("test", &sent, &clock), None);
     }
 
     #[tokio::test]
     async fn test_session_handles_connected_event() {
         let mut toy = MockToy::new();
-        let (tx, mut rx) = mpsc::unbounded_channel();
-        let mut mapper = RangeMapper::new(test_mapping_config());
+        let mapper = RangeMapper::new(test_mapping_config());
         let running = Arc::new(AtomicBool::new(true));
 
-        tx.send(ble::BleEvent::Connected).unwrap();
-        tx.send(ble::BleEvent::RangeUpdate(165)).unwrap();
-        drop(tx);
+        let mut rx = feed(vec![
+            ble::BleEvent::Connected,
+            ble::BleEvent::RangeUpdate(165),
+        ]);
 
-        run_session_inner(&mut toy, &mut rx, &mut mapper, &running)
-            .await
-            .unwrap();
+        run_session_inner(
+            vec![device(&mut toy, mapper)],
+            &mut rx,
+            &per_sample(),
+            &running,
+            &mut Reloads::none(),
+        )
+        .await
+        .unwrap();
 
         assert_eq!(toy.intensities.len(), 1);
     }
@@ -331,13 +1252,19 @@ mod tests {
     #[tokio::test]
     async fn test_session_stops_on_running_false() {
         let mut toy = MockToy::new();
-        let (_tx, mut rx) = mpsc::unbounded_channel();
-        let mut mapper = RangeMapper::new(test_mapping_config());
+        let (_tx, mut rx) = events::channel();
+        let mapper = RangeMapper::new(test_mapping_config());
         let running = Arc::new(AtomicBool::new(false));
 
-        run_session_inner(&mut toy, &mut rx, &mut mapper, &running)
-            .await
-            .unwrap();
+        run_session_inner(
+            vec![device(&mut toy, mapper)],
+            &mut rx,
+            &per_sample(),
+            &running,
+            &mut Reloads::none(),
+        )
+        .await
+        .unwrap();
 
         assert!(toy.intensities.is_empty());
     }
@@ -346,13 +1273,19 @@ mod tests {
     async fn test_session_stops_on_toy_disconnect() {
         let mut toy = MockToy::new();
         toy.connected = false;
-        let (_tx, mut rx) = mpsc::unbounded_channel();
-        let mut mapper = RangeMapper::new(test_mapping_config());
+        let (_tx, mut rx) = events::channel();
+        let mapper = RangeMapper::new(test_mapping_config());
         let running = Arc::new(AtomicBool::new(true));
 
-        run_session_inner(&mut toy, &mut rx, &mut mapper, &running)
-            .await
-            .unwrap();
+        run_session_inner(
+            vec![device(&mut toy, mapper)],
+            &mut rx,
+            &per_sample(),
+            &running,
+            &mut Reloads::none(),
+        )
+        .await
+        .unwrap();
 
         assert!(toy.intensities.is_empty());
     }
@@ -374,6 +1307,44 @@ mod tests {
         assert_eq!(config.ble.device_name, "Rangefinder");
     }
 
+    // --- device_plan tests ---
+
+    #[test]
+    fn test_device_plan_single_toy() {
+        let mut config = Config::default();
+        let plan = device_plan(&config).unwrap();
+        assert_eq!(plan.len(), 1);
+        assert_eq!(plan[0].0, toy::DeviceSelector::First);
+
+        config.buttplug.device_index = Some(2);
+        let plan = device_plan(&config).unwrap();
+        assert_eq!(plan[0].0, toy::DeviceSelector::Index(2));
+    }
+
+    #[test]
+    fn test_device_plan_device_list() {
+        let mut config = Config::default();
+        config.buttplug.device_index = Some(2); // ignored with a list
+        config.buttplug.devices = vec![
+            config::DeviceConfig {
+                index: Some(1),
+                ..Default::default()
+            },
+            config::DeviceConfig {
+                name: Some("lush".to_string()),
+                mapping: toml::toml! { max_intensity = 0.5 },
+                ..Default::default()
+            },
+        ];
+
+        let plan = device_plan(&config).unwrap();
+        assert_eq!(plan.len(), 2);
+        assert_eq!(plan[0].0, toy::DeviceSelector::Index(1));
+        assert!((plan[0].1.max_intensity - 1.0).abs() < f64::EPSILON);
+        assert_eq!(plan[1].0, toy::DeviceSelector::Name("lush".to_string()));
+        assert!((plan[1].1.max_intensity - 0.5).abs() < f64::EPSILON);
+    }
+
     // --- log_config test ---
 
     #[test]
@@ -392,7 +1363,12 @@ mod tests {
 
     #[async_trait::async_trait]
     impl AsyncSessionFn for MockSession {
-        async fn run(&self, _config: &Config, _running: &Arc<AtomicBool>) -> anyhow::Result<()> {
+        async fn run(
+            &self,
+            _config: &Config,
+            _reloads: Reloads,
+            _running: &Arc<AtomicBool>,
+        ) -> anyhow::Result<()> {
             let n = self.call_count.fetch_add(1, Ordering::SeqCst);
             if let Some(ref running) = self.shutdown_on_call {
                 running.store(false, Ordering::SeqCst);
@@ -410,8 +1386,9 @@ mod tests {
         let running = Arc::new(AtomicBool::new(true));
         let call_count = Arc::new(AtomicU32::new(0));
 
+        let (_tx, mut configs) = watch::channel(config);
         reconnect_loop(
-            &config,
+            &mut configs,
             &running,
             MockSession {
                 call_count: call_count.clone(),
@@ -431,8 +1408,9 @@ mod tests {
         let running = Arc::new(AtomicBool::new(true));
         let call_count = Arc::new(AtomicU32::new(0));
 
+        let (_tx, mut configs) = watch::channel(config);
         reconnect_loop(
-            &config,
+            &mut configs,
             &running,
             MockSession {
                 call_count: call_count.clone(),
@@ -445,6 +1423,59 @@ mod tests {
         assert_eq!(call_count.load(Ordering::SeqCst), 3);
     }
 
+    /// Session that switches the config to another sensor on its first run.
+    struct ReloadingSession {
+        configs: Arc<std::sync::Mutex<Option<watch::Sender<Config>>>>,
+        device_names: Arc<std::sync::Mutex<Vec<String>>>,
+    }
+
+    #[async_trait::async_trait]
+    impl AsyncSessionFn for ReloadingSession {
+        async fn run(
+            &self,
+            config: &Config,
+            _reloads: Reloads,
+            _running: &Arc<AtomicBool>,
+        ) -> anyhow::Result<()> {
+            self.device_names
+                .lock()
+                .unwrap()
+                .push(config.ble.device_name.clone());
+            if let Some(tx) = self.configs.lock().unwrap().take() {
+                let mut moved = config.clone();
+                moved.ble.device_name = "Rangefinder-2".to_string();
+                tx.send_replace(moved);
+            }
+            Ok(())
+        }
+    }
+
+    #[tokio::test]
+    async fn test_reconnect_loop_restarts_for_new_config() {
+        let mut config = Config::default();
+        // A restart for a reload doesn't wait out the reconnect delay
+        config.ble.reconnect_delay_secs = 60;
+        let running = Arc::new(AtomicBool::new(true));
+        let (tx, mut configs) = watch::channel(config);
+        let device_names = Arc::new(std::sync::Mutex::new(Vec::new()));
+
+        let session = ReloadingSession {
+            configs: Arc::new(std::sync::Mutex::new(Some(tx))),
+            device_names: device_names.clone(),
+        };
+        tokio::time::timeout(
+            Duration::from_secs(1),
+            reconnect_loop(&mut configs, &running, session),
+        )
+        .await
+        .unwrap();
+
+        assert_eq!(
+            *device_names.lock().unwrap(),
+            vec!["Rangefinder".to_string(), "Rangefinder-2".to_string()]
+        );
+    }
+
     #[tokio::test]
     async fn test_reconnect_loop_stops_on_shutdown() {
         let mut config = Config::default();
@@ -452,8 +1483,9 @@ mod tests {
         let running = Arc::new(AtomicBool::new(true));
         let call_count = Arc::new(AtomicU32::new(0));
 
+        let (_tx, mut configs) = watch::channel(config);
         reconnect_loop(
-            &config,
+            &mut configs,
             &running,
             MockSession {
                 call_count: call_count.clone(),
@@ -472,7 +1504,7 @@ mod tests {
 
     #[async_trait::async_trait]
     impl toy::ToyBackend for FailingToy {
-        async fn set_intensity(&mut self, _intensity: f64) -> anyhow::Result<()> {
+        async fn set_intensity(&mut self, _intensity: f64) -> anyhow::Result<bool> {
             anyhow::bail!("device error");
         }
 
@@ -480,10 +1512,6 @@ mod tests {
             Ok(())
         }
 
-        async fn disconnect(&self) -> anyhow::Result<()> {
-            Ok(())
-        }
-
         fn is_connected(&self) -> bool {
             true
         }
@@ -492,18 +1520,24 @@ mod tests {
     #[tokio::test]
     async fn test_session_continues_on_intensity_error() {
         let mut toy = FailingToy;
-        let (tx, mut rx) = mpsc::unbounded_channel();
-        let mut mapper = RangeMapper::new(test_mapping_config());
+        let mapper = RangeMapper::new(test_mapping_config());
         let running = Arc::new(AtomicBool::new(true));
 
         // Session should log the error and continue, not bail
-        tx.send(ble::BleEvent::RangeUpdate(100)).unwrap();
-        tx.send(ble::BleEvent::RangeUpdate(200)).unwrap();
-        drop(tx); // channel close triggers disconnect exit
-
-        run_session_inner(&mut toy, &mut rx, &mut mapper, &running)
-            .await
-            .unwrap();
+        let mut rx = feed(vec![
+            ble::BleEvent::RangeUpdate(100),
+            ble::BleEvent::RangeUpdate(200),
+        ]);
+
+        run_session_inner(
+            vec![device(&mut toy, mapper)],
+            &mut rx,
+            &per_sample(),
+            &running,
+            &mut Reloads::none(),
+        )
+        .await
+        .unwrap();
     }
 
     // --- Args tests ---
@@ -528,6 +1562,24 @@ mod tests {
         assert!(args.generate_config);
     }
 
+    #[test]
+    fn test_args_record() {
+        let args = Args::try_parse_from(["fancypants", "--record", "start"]).unwrap();
+        assert_eq!(args.record, Some(recording::RecordCommand::Start));
+        assert!(args.download.is_none());
+        assert!(Args::try_parse_from(["fancypants", "--record", "bogus"]).is_err());
+    }
+
+    #[test]
+    fn test_args_download() {
+        let args = Args::try_parse_from(["fancypants", "--download", "s.csv"]).unwrap();
+        assert_eq!(args.download, Some(PathBuf::from("s.csv")));
+        assert!(
+            Args::try_parse_from(["fancypants", "--download", "s.csv", "--record", "stop"])
+                .is_err()
+        );
+    }
+
     #[test]
     fn test_args_log_level() {
         let args = Args::try_parse_from(["fancypants", "-l", "debug"]).unwrap();
@@ -1,76 +1,188 @@
-use crate::config::MappingConfig;
+use std::time::{Duration, Instant};
+
+use crate::config::{MappingConfig, ResponseCurve};
+use crate::prediction::Predictor;
+use crate::smoothing::Smoother;
+
+/// Distances the lookup table covers at least.
+const LUT_MAX_MM: u16 = 1200;
 
 /// Maps raw distance readings to intensity values for Buttplug devices.
 pub struct RangeMapper {
     config: MappingConfig,
-    smoothed_intensity: f64,
-    initialized: bool,
+    /// Unsmoothed intensity per mm, built from the config
+    table: Vec<f64>,
+    smoother: Smoother,
+    /// Present when mapping.predict is on
+    predictor: Option<Predictor>,
+    /// Time base for samples without a device timestamp
+    started: Instant,
 }
 
 impl RangeMapper {
     pub fn new(config: MappingConfig) -> Self {
         RangeMapper {
+            table: build_table(&config),
+            smoother: Smoother::new(&config),
+            predictor: config.predict.then(|| {
+                let lead = (config.predict_ms > 0)
+                    .then(|| Duration::from_millis(config.predict_ms as u64));
+                Predictor::new(lead, config.deadzone_mm, config.max_range_mm)
+            }),
             config,
-            smoothed_intensity: 0.0,
-            initialized: false,
+            started: Instant::now(),
         }
     }
 
-    /// Map a distance_mm reading to an intensity 0.0-1.0.
-    ///
-    /// With invert=true (default): closer = higher intensity
-    /// With invert=false: further = higher intensity
-    ///
-    /// Applies exponential moving average smoothing.
-    pub fn map(&mut self, distance_mm: u16) -> f64 {
-        // Dead zone check
-        if self.config.deadzone_mm > 0 && distance_mm > self.config.deadzone_mm {
-            return self.apply_smoothing(0.0);
-        }
-
-        // Clamp to configured range
-        let clamped = distance_mm
-            .max(self.config.min_range_mm)
-            .min(self.config.max_range_mm);
-
-        // Normalize to 0.0 - 1.0
-        let range_span = (self.config.max_range_mm - self.config.min_range_mm) as f64;
-        let normalized = if range_span > 0.0 {
-            (clamped - self.config.min_range_mm) as f64 / range_span
-        } else {
-            0.0
+    /// Map a reading taken at device time `t_ms`, or just now if unknown.
+    /// The speed-aware filters use the spacing of the samples.
+    pub fn map_sample(&mut self, distance_mm: u16, t_ms: Option<u32>) -> f64 {
+        let t = match t_ms {
+            Some(t_ms) => t_ms as f64 / 1000.0,
+            None => self.started.elapsed().as_secs_f64(),
         };
-
-        // Invert if needed (closer = higher)
-        let directed = if self.config.invert {
-            1.0 - normalized
-        } else {
-            normalized
+        let distance_mm = match &mut self.predictor {
+            Some(predictor) => predictor.predict(distance_mm, t),
+            None => distance_mm,
         };
+        let raw = self.raw_intensity(distance_mm);
+        self.smoother.apply(raw, t)
+    }
 
-        // Scale to intensity range
-        let intensity_span = self.config.max_intensity - self.config.min_intensity;
-        let raw_intensity = self.config.min_intensity + (directed * intensity_span);
+    /// Report an end-to-end latency, for prediction that follows the
+    /// measured latency.
+    pub fn observe_latency(&mut self, latency: Duration) {
+        if let Some(predictor) = &mut self.predictor {
+            predictor.observe_latency(latency);
+        }
+    }
 
-        self.apply_smoothing(raw_intensity.clamp(0.0, 1.0))
+    /// map_sample() for a reading taken just now, for the tests.
+    #[cfg(test)]
+    pub fn map(&mut self, distance_mm: u16) -> f64 {
+        self.map_sample(distance_mm, None)
     }
 
-    fn apply_smoothing(&mut self, raw: f64) -> f64 {
-        if !self.initialized {
-            self.smoothed_intensity = raw;
-            self.initialized = true;
-            return raw;
+    /// Unsmoothed intensity for a reading.
+    fn raw_intensity(&self, distance_mm: u16) -> f64 {
+        match self.table.get(distance_mm as usize) {
+            Some(&intensity) => intensity,
+            // Past the table is past max_range_mm too
+            None if self.config.deadzone_mm > 0 && distance_mm > self.config.deadzone_mm => 0.0,
+            None => *self.table.last().unwrap(),
         }
-
-        let alpha = self.config.smoothing;
-        self.smoothed_intensity = alpha * self.smoothed_intensity + (1.0 - alpha) * raw;
-        self.smoothed_intensity
     }
 
-    #[allow(dead_code)]
+    /// Switch to a new mapping between two samples. Smoothing and
+    /// prediction state carry over unless their own settings changed, so
+    /// the output eases onto the new curve instead of jumping.
     pub fn update_config(&mut self, config: MappingConfig) {
-        self.config = config;
+        let fresh = RangeMapper::new(config);
+        let (old, new) = (&self.config, &fresh.config);
+        let same_filter = old.filter == new.filter
+            && old.smoothing == new.smoothing
+            && old.min_cutoff_hz == new.min_cutoff_hz
+            && old.beta == new.beta
+            && old.trend_smoothing == new.trend_smoothing;
+        let same_predictor = old.predict == new.predict
+            && old.predict_ms == new.predict_ms
+            && old.deadzone_mm == new.deadzone_mm
+            && old.max_range_mm == new.max_range_mm;
+        let smoother = std::mem::replace(&mut self.smoother, fresh.smoother);
+        let predictor = std::mem::replace(&mut self.predictor, fresh.predictor);
+        if same_filter {
+            self.smoother = smoother;
+        }
+        if same_predictor {
+            self.predictor = predictor;
+        }
+        self.table = fresh.table;
+        self.config = fresh.config;
+    }
+}
+
+/// Intensity for every mm from 0 to LUT_MAX_MM, or to max_range_mm if that
+/// is further, so mapping a sample is a single lookup.
+fn build_table(config: &MappingConfig) -> Vec<f64> {
+    let last = LUT_MAX_MM.max(config.max_range_mm);
+    (0..=last)
+        .map(|distance_mm| intensity_at(config, distance_mm))
+        .collect()
+}
+
+/// Intensity for a reading, from first principles.
+///
+/// With invert=true (default): closer = higher intensity
+/// With invert=false: further = higher intensity
+fn intensity_at(config: &MappingConfig, distance_mm: u16) -> f64 {
+    // Dead zone check
+    if config.deadzone_mm > 0 && distance_mm > config.deadzone_mm {
+        return 0.0;
+    }
+
+    // Clamp to configured range
+    let clamped = distance_mm
+        .max(config.min_range_mm)
+        .min(config.max_range_mm);
+
+    // Normalize to 0.0 - 1.0
+    let range_span = (config.max_range_mm - config.min_range_mm) as f64;
+    let normalized = if range_span > 0.0 {
+        (clamped - config.min_range_mm) as f64 / range_span
+    } else {
+        0.0
+    };
+
+    // Invert if needed (closer = higher)
+    let directed = if config.invert {
+        1.0 - normalized
+    } else {
+        normalized
+    };
+
+    // Shape, then scale to intensity range
+    let shaped = shape(config, directed);
+    let intensity_span = config.max_intensity - config.min_intensity;
+    let raw_intensity = config.min_intensity + (shaped * intensity_span);
+
+    raw_intensity.clamp(0.0, 1.0)
+}
+
+/// Apply the response curve to a position 0.0-1.0 (1.0 = most intense).
+fn shape(config: &MappingConfig, x: f64) -> f64 {
+    match config.curve {
+        ResponseCurve::Linear => x,
+        ResponseCurve::Gamma => x.powf(config.gamma),
+        ResponseCurve::Smoothstep => x * x * (3.0 - 2.0 * x),
+        ResponseCurve::Points => interpolate_points(&config.curve_points, x),
+        ResponseCurve::Table => {
+            let table = &config.curve_table;
+            let pos = x * (table.len() - 1) as f64;
+            let i = (pos.floor() as usize).min(table.len() - 2);
+            table[i] + (table[i + 1] - table[i]) * (pos - i as f64)
+        }
+    }
+}
+
+/// Piecewise-linear curve through `points` ([x, y], x increasing), flat
+/// beyond the first and last.
+fn interpolate_points(points: &[[f64; 2]], x: f64) -> f64 {
+    let [first_x, first_y] = points[0];
+    if x <= first_x {
+        return first_y;
+    }
+    for pair in points.windows(2) {
+        let ([x0, y0], [x1, y1]) = (pair[0], pair[1]);
+        if x <= x1 {
+            return y0 + (y1 - y0) * (x - x0) / (x1 - x0);
+        }
     }
+    points[points.len() - 1][1]
+}
+
+/// Quantize a 0.0-1.0 value to the 0-255 byte used by the firmware mapper.
+pub(crate) fn quantize_unit(value: f64) -> u8 {
+    (value.clamp(0.0, 1.0) * 255.0).round() as u8
 }
 
 #[cfg(test)]
@@ -86,6 +198,8 @@ mod tests {
             max_intensity: 1.0,
             deadzone_mm: 500,
             smoothing: 0.0, // disable for unit tests
+            on_device: false,
+            ..crate::config::Config::default().mapping
         }
     }
 
@@ -242,6 +356,125 @@ mod tests {
         );
     }
 
+    #[test]
+    fn test_prediction_leads_movement() {
+        let mut cfg = default_config();
+        cfg.predict = true;
+        cfg.predict_ms = 100;
+        let mut predicted = RangeMapper::new(cfg);
+        let mut plain = RangeMapper::new(default_config());
+        // Hand approaching at 500 mm/s, sampled at 50 Hz
+        let (mut a, mut b) = (0.0, 0.0);
+        for i in 0..10u32 {
+            let distance = 250 - i as u16 * 10;
+            a = predicted.map_sample(distance, Some(i * 20));
+            b = plain.map_sample(distance, Some(i * 20));
+        }
+        // Already where the hand will be 100 ms on (~50 mm closer)
+        assert!(a > b + 0.1, "predicted {a}, plain {b}");
+    }
+
+    fn curved(curve: ResponseCurve) -> RangeMapper {
+        let mut cfg = default_config();
+        cfg.curve = curve;
+        cfg.curve_points = vec![[0.0, 0.0], [0.5, 0.2], [1.0, 1.0]];
+        cfg.curve_table = vec![0.0, 0.1, 0.4, 1.0];
+        RangeMapper::new(cfg)
+    }
+
+    /// Distance at position `x` along 30-300 mm (1.0 = closest).
+    fn at(x: f64) -> u16 {
+        (300.0 - x * 270.0).round() as u16
+    }
+
+    #[test]
+    fn test_curves_keep_ends() {
+        for curve in [
+            ResponseCurve::Gamma,
+            ResponseCurve::Smoothstep,
+            ResponseCurve::Points,
+            ResponseCurve::Table,
+        ] {
+            let mut mapper = curved(curve);
+            assert!(mapper.map(300).abs() < 1e-9, "{curve:?}");
+            assert!((mapper.map(30) - 1.0).abs() < 1e-9, "{curve:?}");
+        }
+    }
+
+    #[test]
+    fn test_curve_shapes() {
+        let mut gamma = curved(ResponseCurve::Gamma);
+        assert!((gamma.map(at(0.5)) - 0.25).abs() < 0.01);
+
+        let mut smoothstep = curved(ResponseCurve::Smoothstep);
+        assert!((smoothstep.map(at(0.5)) - 0.5).abs() < 0.01);
+        assert!((smoothstep.map(at(0.25)) - 0.15625).abs() < 0.01);
+
+        let mut points = curved(ResponseCurve::Points);
+        assert!((points.map(at(0.5)) - 0.2).abs() < 0.01);
+        assert!((points.map(at(0.75)) - 0.6).abs() < 0.01);
+
+        // Four levels at positions 0, 1/3, 2/3, 1
+        let mut table = curved(ResponseCurve::Table);
+        assert!((table.map(at(1.0 / 3.0)) - 0.1).abs() < 0.01);
+        assert!((table.map(at(0.5)) - 0.25).abs() < 0.01);
+    }
+
+    #[test]
+    fn test_table_matches_direct_mapping() {
+        let mut cfg = default_config();
+        cfg.curve = ResponseCurve::Gamma;
+        cfg.gamma = 1.7;
+        cfg.min_intensity = 0.1;
+        let mapper = RangeMapper::new(cfg.clone());
+        for distance_mm in 0..=1500 {
+            assert_eq!(
+                mapper.raw_intensity(distance_mm),
+                intensity_at(&cfg, distance_mm),
+                "{distance_mm}mm"
+            );
+        }
+        // Out-of-range code, past the table
+        assert_eq!(mapper.raw_intensity(8190), 0.0);
+    }
+
+    #[test]
+    fn test_table_past_lut_without_deadzone() {
+        let mut cfg = default_config();
+        cfg.deadzone_mm = 0;
+        cfg.min_intensity = 0.2;
+        let mut mapper = RangeMapper::new(cfg);
+        // Beyond the table is beyond max_range_mm: the far end level
+        assert!((mapper.map(8190) - 0.2).abs() < 1e-9);
+
+        // A range reaching past LUT_MAX_MM gets a longer table
+        let mut cfg = default_config();
+        cfg.max_range_mm = 2000;
+        cfg.deadzone_mm = 0;
+        let mut mapper = RangeMapper::new(cfg);
+        assert!(mapper.map(1500) > 0.2);
+        assert!(mapper.map(2500).abs() < 1e-9);
+    }
+
+    #[test]
+    fn test_update_config_keeps_smoothing_state() {
+        let mut cfg = default_config();
+        cfg.smoothing = 0.5;
+        let mut mapper = RangeMapper::new(cfg.clone());
+        mapper.map(300); // settled at 0.0
+
+        // Only the range changes: the EMA carries on from 0.0 rather than
+        // passing the next sample through
+        cfg.max_range_mm = 600;
+        mapper.update_config(cfg.clone());
+        assert!((mapper.map(30) - 0.5).abs() < 0.01);
+
+        // A new smoothing weight starts the filter afresh
+        cfg.smoothing = 0.8;
+        mapper.update_config(cfg);
+        assert!((mapper.map(30) - 1.0).abs() < 0.01);
+    }
+
     #[test]
     fn test_zero_range_span() {
         let mut cfg = default_config();
@@ -298,4 +531,79 @@ mod tests {
             "farthest should be min_intensity 0.2, got {farthest}"
         );
     }
+
+    // --- parity with the firmware mapper ---
+
+    /// Vectors shared with firmware/tests/intensity_map (keep both copies identical).
+    const PARITY_VECTORS: &str = include_str!("../testdata/intensity_map_vectors.inc");
+
+    struct ParityVector {
+        name: String,
+        config: MappingConfig,
+        /// (distance_mm, expected intensity byte), run in order on one mapper
+        steps: Vec<(u16, u8)>,
+    }
+
+    /// Parse `VECTOR(name, invert, lo, hi, deadzone, min_i, max_i, smoothing, d, e, ...)`
+    /// lines; the config carries the quantized fields as the firmware sees them.
+    fn parse_vectors() -> Vec<ParityVector> {
+        PARITY_VECTORS
+            .lines()
+            .filter_map(|line| line.strip_prefix("VECTOR(")?.strip_suffix(')'))
+            .map(|body| {
+                let mut fields = body.split(',').map(str::trim);
+                let name = fields.next().unwrap().to_string();
+                let nums: Vec<u16> = fields.map(|f| f.parse().unwrap()).collect();
+                let config = MappingConfig {
+                    invert: nums[0] != 0,
+                    min_range_mm: nums[1],
+                    max_range_mm: nums[2],
+                    deadzone_mm: nums[3],
+                    min_intensity: nums[4] as f64 / 255.0,
+                    max_intensity: nums[5] as f64 / 255.0,
+                    smoothing: nums[6] as f64 / 255.0,
+                    on_device: true,
+                    ..crate::config::Config::default().mapping
+                };
+                let steps = nums[7..].chunks(2).map(|p| (p[0], p[1] as u8)).collect();
+                ParityVector {
+                    name,
+                    config,
+                    steps,
+                }
+            })
+            .collect()
+    }
+
+    #[test]
+    fn test_parity_vectors_match_mapper() {
+        let vectors = parse_vectors();
+        assert!(vectors.len() >= 5, "parity vectors missing");
+
+        for ParityVector {
+            name,
+            config,
+            steps,
+        } in vectors
+        {
+            let mut mapper = RangeMapper::new(config);
+            for (i, (distance, expected)) in steps.into_iter().enumerate() {
+                let got = quantize_unit(mapper.map(distance));
+                assert_eq!(
+                    got, expected,
+                    "{name}[{i}]: {distance}mm -> {got}, vectors say {expected}; \
+                     regenerate them and update the firmware mapper"
+                );
+            }
+        }
+    }
+
+    #[test]
+    fn test_quantize_unit() {
+        assert_eq!(quantize_unit(0.0), 0);
+        assert_eq!(quantize_unit(1.0), 255);
+        assert_eq!(quantize_unit(0.5), 128);
+        assert_eq!(quantize_unit(-0.2), 0);
+        assert_eq!(quantize_unit(1.7), 255);
+    }
 }
@@ -0,0 +1,148 @@
+//! Fixed-rate toy output.
+//!
+//! Samples reach the host unevenly: BLE delivers notifications once per
+//! connection event, so they arrive in bunches with gaps between. Rather
+//! than command the toy once per sample, the session pushes each mapped
+//! sample here and reads the output back on a steady tick. With
+//! interpolation on, each new sample is approached over one typical sample
+//! gap instead of jumped to, which smooths the steps between slow samples
+//! at the cost of up to one sample gap of extra latency.
+
+use std::time::Duration;
+use tokio::time::Instant;
+
+/// Gaps longer than this are pauses in the stream (hand out of range, link
+/// hiccup), not its rate, and are left out of the gap estimate.
+const MAX_SAMPLE_GAP: Duration = Duration::from_millis(500);
+
+/// Current output level, fed with samples and read at the output tick.
+#[derive(Debug)]
+pub struct OutputScheduler {
+    interpolate: bool,
+    /// Output level when the current target arrived
+    from: f64,
+    target: Option<f64>,
+    arrived: Instant,
+    /// Smoothed time between samples
+    gap: Option<Duration>,
+}
+
+impl OutputScheduler {
+    pub fn new(interpolate: bool) -> Self {
+        OutputScheduler {
+            interpolate,
+            from: 0.0,
+            target: None,
+            arrived: Instant::now(),
+            gap: None,
+        }
+    }
+
+    /// Take a new mapped sample (0.0-1.0) received at `now`.
+    pub fn push(&mut self, value: f64, now: Instant) {
+        match self.level(now) {
+            Some(level) => {
+                let gap = now.saturating_duration_since(self.arrived);
+                if gap <= MAX_SAMPLE_GAP {
+                    // EMA over roughly the last 8 gaps
+                    self.gap = Some(match self.gap {
+                        Some(avg) => (avg * 7 + gap) / 8,
+                        None => gap,
+                    });
+                }
+                self.from = level;
+            }
+            None => self.from = value,
+        }
+        self.target = Some(value);
+        self.arrived = now;
+    }
+
+    /// Output level at `now`, or None before the first sample.
+    pub fn level(&self, now: Instant) -> Option<f64> {
+        let target = self.target?;
+        let gap = match self.gap {
+            Some(gap) if self.interpolate && !gap.is_zero() => gap,
+            _ => return Some(target),
+        };
+        let elapsed = now.saturating_duration_since(self.arrived);
+        let progress = (elapsed.as_secs_f64() / gap.as_secs_f64()).min(1.0);
+        Some(self.from + (target - self.from) * progress)
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    fn ms(n: u64) -> Duration {
+        Duration::from_millis(n)
+    }
+
+    #[test]
+    fn test_no_output_before_first_sample() {
+        let out = OutputScheduler::new(true);
+        assert_eq!(out.level(Instant::now()), None);
+    }
+
+    #[test]
+    fn test_first_sample_is_output_directly() {
+        let t0 = Instant::now();
+        let mut out = OutputScheduler::new(true);
+        out.push(0.7, t0);
+        assert_eq!(out.level(t0), Some(0.7));
+        assert_eq!(out.level(t0 + ms(100)), Some(0.7));
+    }
+
+    #[test]
+    fn test_without_interpolation_holds_latest() {
+        let t0 = Instant::now();
+        let mut out = OutputScheduler::new(false);
+        out.push(0.0, t0);
+        out.push(1.0, t0 + ms(50));
+        assert_eq!(out.level(t0 + ms(50)), Some(1.0));
+        assert_eq!(out.level(t0 + ms(60)), Some(1.0));
+    }
+
+    #[test]
+    fn test_interpolates_over_sample_gap() {
+        let t0 = Instant::now();
+        let mut out = OutputScheduler::new(true);
+        out.push(0.0, t0);
+        out.push(0.0, t0 + ms(40));
+        out.push(1.0, t0 + ms(80));
+
+        // Ramps from 0.0 to 1.0 over the 40 ms gap, then holds
+        let at = |t| out.level(t0 + ms(t)).unwrap();
+        assert!(at(80).abs() < 1e-9);
+        assert!((at(90) - 0.25).abs() < 1e-9);
+        assert!((at(100) - 0.5).abs() < 1e-9);
+        assert!((at(120) - 1.0).abs() < 1e-9);
+        assert!((at(500) - 1.0).abs() < 1e-9);
+    }
+
+    #[test]
+    fn test_new_sample_mid_ramp_continues_from_current_level() {
+        let t0 = Instant::now();
+        let mut out = OutputScheduler::new(true);
+        out.push(0.0, t0);
+        out.push(0.0, t0 + ms(40));
+        out.push(1.0, t0 + ms(80));
+
+        // Halfway up (0.5) when the next one lands: no jump
+        out.push(0.0, t0 + ms(100));
+        assert!((out.level(t0 + ms(100)).unwrap() - 0.5).abs() < 1e-9);
+        assert!(out.level(t0 + ms(110)).unwrap() < 0.5);
+    }
+
+    #[test]
+    fn test_pause_does_not_stretch_gap() {
+        let t0 = Instant::now();
+        let mut out = OutputScheduler::new(true);
+        out.push(0.0, t0);
+        out.push(0.0, t0 + ms(40));
+        // Two seconds of silence, then a jump
+        out.push(1.0, t0 + ms(2040));
+        assert!((out.level(t0 + ms(2080)).unwrap() - 1.0).abs() < 1e-9);
+    }
+}
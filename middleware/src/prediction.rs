@@ -0,0 +1,236 @@
+//! Latency-compensating prediction.
+//!
+//! By the time a command reaches the toy, the sample behind it is tens of
+//! ms old and Intiface has added its own round trip, so the toy follows
+//! where the hand was. An alpha-beta filter tracks distance and speed from
+//! the readings, and the predictor reports where the hand will be one
+//! latency ahead. The lead is either configured or the measured sample age
+//! plus command round trip.
+//!
+//! Prediction is bounded so it can't run away: the lead is capped at
+//! MAX_LEAD, the extrapolation at MAX_EXTRAPOLATION_MM, and a prediction
+//! never carries a reading across the deadzone edge. Readings past
+//! max_range_mm (out-of-range codes such as 8190) or in the deadzone, and
+//! readings after a pause, restart the filter.
+
+use std::time::Duration;
+
+/// Filter gains: alpha on position, beta on speed (critically damped:
+/// beta = alpha^2 / (2 - alpha)). High gains keep the speed estimate
+/// current at the cost of some jitter, which the smoothing stage takes out.
+const ALPHA: f64 = 0.8;
+const BETA: f64 = ALPHA * ALPHA / (2.0 - ALPHA);
+
+/// Longest look-ahead, whatever is configured or measured.
+pub const MAX_LEAD: Duration = Duration::from_millis(200);
+/// Furthest a prediction may move from the filtered reading.
+const MAX_EXTRAPOLATION_MM: f64 = 50.0;
+/// Lead until a latency has been measured.
+const INITIAL_LEAD: Duration = Duration::from_millis(60);
+/// A gap this long is a new movement, not a continuation.
+const MAX_GAP: f64 = 0.25;
+/// Shorter gaps (repeated timestamps) count as this long.
+const MIN_GAP: f64 = 0.001;
+
+/// Alpha-beta tracker with forward extrapolation.
+#[derive(Debug, Clone)]
+pub struct Predictor {
+    /// Configured lead; None follows the measured latency
+    fixed_lead: Option<Duration>,
+    /// Smoothed measured latency
+    measured: Option<Duration>,
+    /// Readings beyond this are not tracked (0 = no deadzone)
+    deadzone_mm: u16,
+    /// Nor beyond this, deadzone or not
+    max_range_mm: u16,
+    /// (position mm, speed mm/s, time s)
+    state: Option<(f64, f64, f64)>,
+}
+
+impl Predictor {
+    pub fn new(fixed_lead: Option<Duration>, deadzone_mm: u16, max_range_mm: u16) -> Self {
+        Predictor {
+            fixed_lead,
+            measured: None,
+            deadzone_mm,
+            max_range_mm,
+            state: None,
+        }
+    }
+
+    /// Take one end-to-end latency measurement (sample age plus command
+    /// round trip).
+    pub fn observe_latency(&mut self, latency: Duration) {
+        // EMA over roughly the last 16 commands
+        self.measured = Some(match self.measured {
+            Some(avg) => (avg * 15 + latency) / 16,
+            None => latency,
+        });
+    }
+
+    /// How far ahead predictions look.
+    pub fn lead(&self) -> Duration {
+        self.fixed_lead
+            .or(self.measured)
+            .unwrap_or(INITIAL_LEAD)
+            .min(MAX_LEAD)
+    }
+
+    /// Track a reading taken at `t` seconds and return the predicted
+    /// distance one lead ahead.
+    pub fn predict(&mut self, distance_mm: u16, t: f64) -> u16 {
+        let z = distance_mm as f64;
+        let deadzone = self.deadzone_mm as f64;
+        if distance_mm > self.max_range_mm || (self.deadzone_mm > 0 && z > deadzone) {
+            // Hand gone: nothing to track, and out-of-range codes would
+            // read as huge speeds
+            self.state = None;
+            return distance_mm;
+        }
+
+        let (x, v) = match self.state {
+            Some((x, v, last_t)) if (0.0..=MAX_GAP).contains(&(t - last_t)) => {
+                let dt = (t - last_t).max(MIN_GAP);
+                let predicted = x + v * dt;
+                let residual = z - predicted;
+                (predicted + ALPHA * residual, v + BETA / dt * residual)
+            }
+            _ => (z, 0.0),
+        };
+        self.state = Some((x, v, t));
+
+        let ahead =
+            (v * self.lead().as_secs_f64()).clamp(-MAX_EXTRAPOLATION_MM, MAX_EXTRAPOLATION_MM);
+        let mut out = (x + ahead).max(0.0);
+        if self.deadzone_mm > 0 {
+            out = out.min(deadzone);
+        }
+        out.round() as u16
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    /// Recorder CSV (session,timestamp_ms,distance_mm) of a hand moving
+    /// over the sensor at 50 Hz.
+    const TRACE: &str = include_str!("../testdata/hand_trace.csv");
+
+    /// (seconds, mm) for each valid reading.
+    fn trace() -> Vec<(f64, u16)> {
+        TRACE
+            .lines()
+            .skip(1)
+            .filter_map(|line| {
+                let mut fields = line.split(',').skip(1);
+                let t_ms: u32 = fields.next()?.parse().ok()?;
+                let mm: u16 = fields.next()?.parse().ok()?;
+                Some((t_ms as f64 / 1000.0, mm))
+            })
+            .collect()
+    }
+
+    /// Mean absolute error between `out[i]`, acted on `latency` later, and
+    /// the reading at that time: how far the toy is from the hand.
+    fn error_at_toy(trace: &[(f64, u16)], out: &[u16], latency: f64) -> f64 {
+        let mut sum = 0.0;
+        let mut n = 0;
+        for (i, &(t, _)) in trace.iter().enumerate() {
+            let Some(&(_, actual)) = trace[i..].iter().find(|(u, _)| *u >= t + latency) else {
+                break;
+            };
+            sum += (out[i] as f64 - actual as f64).abs();
+            n += 1;
+        }
+        sum / n as f64
+    }
+
+    /// How many samples ahead of the readings `out` runs: the shift that
+    /// best lines it up with them.
+    fn effective_lead(trace: &[(f64, u16)], out: &[u16]) -> usize {
+        (0..15)
+            .min_by_key(|&k| {
+                trace[k..]
+                    .iter()
+                    .zip(out)
+                    .map(|((_, mm), o)| (*mm as i64 - *o as i64).abs())
+                    .sum::<i64>()
+            })
+            .unwrap()
+    }
+
+    #[test]
+    fn test_replay_reduces_effective_lag() {
+        let trace = trace();
+        assert!(trace.len() > 200, "trace missing");
+        let latency = Duration::from_millis(80);
+        let mut predictor = Predictor::new(Some(latency), 500, 500);
+        let predicted: Vec<u16> = trace
+            .iter()
+            .map(|&(t, mm)| predictor.predict(mm, t))
+            .collect();
+        let raw: Vec<u16> = trace.iter().map(|&(_, mm)| mm).collect();
+
+        let before = error_at_toy(&trace, &raw, latency.as_secs_f64());
+        let after = error_at_toy(&trace, &predicted, latency.as_secs_f64());
+        assert!(after < before * 0.6, "error {before:.1}mm -> {after:.1}mm");
+
+        // Unpredicted output is the readings themselves, acted on 80 ms
+        // late; predictions make up most of that (4 samples at 50 Hz)
+        assert_eq!(effective_lead(&trace, &raw), 0);
+        let lead = effective_lead(&trace, &predicted);
+        assert!(lead >= 3, "predictions lead the readings by {lead} samples");
+    }
+
+    #[test]
+    fn test_step_is_bounded() {
+        // Hand jumps 200 mm between two readings: the extrapolation is
+        // capped instead of following the huge apparent speed
+        let mut predictor = Predictor::new(Some(MAX_LEAD), 0, 1200);
+        predictor.predict(50, 0.0);
+        predictor.predict(50, 0.02);
+        let jump = predictor.predict(250, 0.04);
+        assert!(jump as f64 <= 250.0 + MAX_EXTRAPOLATION_MM);
+        // Holding still afterwards settles back on the reading
+        let mut out = jump;
+        for i in 3..60 {
+            out = predictor.predict(250, i as f64 * 0.02);
+        }
+        assert!(out.abs_diff(250) <= 1, "settled at {out}");
+    }
+
+    #[test]
+    fn test_never_predicts_into_deadzone() {
+        let mut predictor = Predictor::new(Some(MAX_LEAD), 300, 250);
+        for i in 0..10 {
+            let out = predictor.predict(200 + i * 10, i as f64 * 0.02);
+            assert!(out <= 300);
+        }
+        // Out-of-range code passes through and resets the track
+        assert_eq!(predictor.predict(8190, 0.2), 8190);
+        assert_eq!(predictor.predict(100, 0.22), 100);
+
+        // Without a deadzone, max_range_mm still keeps the code out of
+        // the track, so the next reading isn't pulled toward the sensor
+        let mut predictor = Predictor::new(Some(MAX_LEAD), 0, 300);
+        for i in 0..10 {
+            predictor.predict(150, i as f64 * 0.02);
+        }
+        assert_eq!(predictor.predict(8190, 0.2), 8190);
+        assert_eq!(predictor.predict(150, 0.22), 150);
+    }
+
+    #[test]
+    fn test_lead_follows_measured_latency() {
+        let mut predictor = Predictor::new(None, 0, 1200);
+        assert_eq!(predictor.lead(), INITIAL_LEAD);
+        predictor.observe_latency(Duration::from_millis(90));
+        assert_eq!(predictor.lead(), Duration::from_millis(90));
+        predictor.observe_latency(Duration::from_secs(2));
+        assert_eq!(predictor.lead(), MAX_LEAD);
+
+        let fixed = Predictor::new(Some(Duration::from_millis(40)), 0, 1200);
+        assert_eq!(fixed.lead(), Duration::from_millis(40));
+    }
+}
@@ -0,0 +1,315 @@
+//! Control and download of the firmware's flash session recorder.
+//!
+//! Firmware built with record.conf logs samples to its QSPI flash, so a
+//! session survives a flaky link or no host at all. This module starts and
+//! stops sessions and pulls the log over BLE into a CSV file.
+
+use btleplug::api::{Peripheral as _, WriteType};
+use btleplug::platform::Peripheral;
+use futures::StreamExt;
+use std::io::Write;
+use std::path::Path;
+use std::time::Duration;
+use tracing::{info, warn};
+use uuid::Uuid;
+
+use crate::ble::{self, RangeBatch, RANGE_BATCH_INVALID};
+use crate::config::Config;
+
+// Must match firmware/src/recorder.h
+pub(crate) const RECORD_CHAR_UUID: Uuid = Uuid::from_u128(0x00000009_7272_6e67_6669_6e6465720000);
+
+/// Opcode that asks the device to send its whole log.
+const CMD_DOWNLOAD: u8 = 2;
+/// Notification that ends a download.
+const DOWNLOAD_END: [u8; 2] = [0xff, 0xff];
+/// Give up on a download when the device goes quiet for this long.
+const DOWNLOAD_IDLE_TIMEOUT: Duration = Duration::from_secs(10);
+
+/// Session commands accepted by the record characteristic.
+#[derive(Debug, Clone, Copy, PartialEq, Eq, clap::ValueEnum)]
+pub enum RecordCommand {
+    /// End the current session
+    Stop,
+    /// Begin a new session
+    Start,
+    /// Erase every session from flash
+    Erase,
+}
+
+impl RecordCommand {
+    fn opcode(self) -> u8 {
+        match self {
+            RecordCommand::Stop => 0,
+            RecordCommand::Start => 1,
+            RecordCommand::Erase => 3,
+        }
+    }
+}
+
+/// Record characteristic read payload (`struct record_status`).
+#[derive(Debug, Clone, Copy, PartialEq)]
+pub struct RecordStatus {
+    /// RECORD_STATE_* (see state_name)
+    pub state: u8,
+    /// Current or last session number
+    pub session: u16,
+    /// Flash taken by recorded entries
+    pub used_bytes: u32,
+    /// Size of the flash ring
+    pub capacity_bytes: u32,
+    /// Samples lost because flash writes fell behind
+    pub dropped: u32,
+}
+
+impl RecordStatus {
+    pub fn state_name(&self) -> &'static str {
+        match self.state {
+            0 => "unavailable",
+            1 => "idle",
+            2 => "recording",
+            3 => "downloading",
+            4 => "erasing",
+            _ => "unknown",
+        }
+    }
+}
+
+/// Parse a record characteristic read.
+pub fn parse_record_status(value: &[u8]) -> Option<RecordStatus> {
+    if value.len() < 15 {
+        return None;
+    }
+    Some(RecordStatus {
+        state: value[0],
+        session: u16::from_le_bytes([value[1], value[2]]),
+        used_bytes: u32::from_le_bytes([value[3], value[4], value[5], value[6]]),
+        capacity_bytes: u32::from_le_bytes([value[7], value[8], value[9], value[10]]),
+        dropped: u32::from_le_bytes([value[11], value[12], value[13], value[14]]),
+    })
+}
+
+/// One logged entry: a session number and a run of samples.
+#[derive(Debug, Clone, Copy, PartialEq)]
+pub struct RecordEntry {
+    pub session: u16,
+    pub batch: RangeBatch,
+}
+
+/// Parse one download notification (session, then a batch payload).
+pub fn parse_record_entry(value: &[u8]) -> Option<RecordEntry> {
+    if value.len() < 2 {
+        return None;
+    }
+    Some(RecordEntry {
+        session: u16::from_le_bytes([value[0], value[1]]),
+        batch: ble::decode_range_batch(&value[2..])?,
+    })
+}
+
+/// Writes download notifications to a CSV file.
+pub struct Download<W: Write> {
+    out: W,
+    /// Entries written
+    pub entries: u64,
+    /// Samples written, including failed reads
+    pub samples: u64,
+    /// Notifications that failed to parse
+    pub bad_entries: u64,
+}
+
+impl<W: Write> Download<W> {
+    pub fn new(mut out: W) -> std::io::Result<Self> {
+        writeln!(out, "session,timestamp_ms,distance_mm")?;
+        Ok(Download {
+            out,
+            entries: 0,
+            samples: 0,
+            bad_entries: 0,
+        })
+    }
+
+    /// Append one notification. Returns true once the end marker arrives.
+    /// Failed reads are written with an empty distance.
+    pub fn push(&mut self, value: &[u8]) -> std::io::Result<bool> {
+        if value == DOWNLOAD_END {
+            self.out.flush()?;
+            return Ok(true);
+        }
+        let Some(entry) = parse_record_entry(value) else {
+            self.bad_entries += 1;
+            return Ok(false);
+        };
+
+        let batch = &entry.batch;
+        for (i, &mm) in batch.samples().iter().enumerate() {
+            let t = batch
+                .t0_ms
+                .wrapping_add(i as u32 * batch.interval_ms as u32);
+            if mm == RANGE_BATCH_INVALID {
+                writeln!(self.out, "{},{},", entry.session, t)?;
+            } else {
+                writeln!(self.out, "{},{},{}", entry.session, t, mm)?;
+            }
+        }
+        self.entries += 1;
+        self.samples += batch.samples().len() as u64;
+        Ok(false)
+    }
+}
+
+/// Scan, connect and find the record characteristic.
+async fn connect_recorder(
+    config: &Config,
+) -> anyhow::Result<(Peripheral, btleplug::api::Characteristic)> {
+    let peripheral =
+        ble::find_device(&config.ble.device_name, config.ble.scan_timeout_secs).await?;
+    peripheral.connect().await?;
+    peripheral.discover_services().await?;
+
+    let chars = peripheral.characteristics();
+    let record_char = ble::find_characteristic(&chars, RECORD_CHAR_UUID).ok_or_else(|| {
+        anyhow::anyhow!("Record characteristic not found (firmware built without record.conf?)")
+    })?;
+
+    let status = parse_record_status(&peripheral.read(&record_char).await?)
+        .ok_or_else(|| anyhow::anyhow!("Malformed record status"))?;
+    info!(
+        "Recorder {}: session {}, {} of {} KiB used, {} samples dropped",
+        status.state_name(),
+        status.session,
+        status.used_bytes / 1024,
+        status.capacity_bytes / 1024,
+        status.dropped
+    );
+
+    Ok((peripheral, record_char))
+}
+
+/// Send a session command to the device and disconnect.
+pub async fn run_command(config: &Config, command: RecordCommand) -> anyhow::Result<()> {
+    let (peripheral, record_char) = connect_recorder(config).await?;
+
+    peripheral
+        .write(&record_char, &[command.opcode()], WriteType::WithResponse)
+        .await?;
+    info!("Recorder command {:?} sent", command);
+
+    peripheral.disconnect().await?;
+    Ok(())
+}
+
+/// Download every recorded session into a CSV file at `path`.
+pub async fn run_download(config: &Config, path: &Path) -> anyhow::Result<()> {
+    let (peripheral, record_char) = connect_recorder(config).await?;
+
+    let file = std::io::BufWriter::new(std::fs::File::create(path)?);
+    let mut download = Download::new(file)?;
+
+    peripheral.subscribe(&record_char).await?;
+    let mut events = peripheral.notifications().await?;
+    peripheral
+        .write(&record_char, &[CMD_DOWNLOAD], WriteType::WithResponse)
+        .await?;
+    info!("Downloading recording to {:?}...", path);
+
+    let mut finished = false;
+    while !finished {
+        let event = tokio::time::timeout(DOWNLOAD_IDLE_TIMEOUT, events.next()).await;
+        match event {
+            Ok(Some(n)) if n.uuid == RECORD_CHAR_UUID => finished = download.push(&n.value)?,
+            Ok(Some(_)) => {}
+            Ok(None) => break,
+            Err(_) => {
+                warn!("Device stopped sending");
+                break;
+            }
+        }
+    }
+
+    let _ = peripheral.disconnect().await;
+    if download.bad_entries > 0 {
+        warn!("{} entries could not be parsed", download.bad_entries);
+    }
+    if !finished {
+        anyhow::bail!(
+            "Download incomplete after {} entries ({} samples)",
+            download.entries,
+            download.samples
+        );
+    }
+
+    info!(
+        "Downloaded {} samples in {} entries",
+        download.samples, download.entries
+    );
+    Ok(())
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    /// Entry holding 1000, 1001, 999, 1063, 1000 mm, 20 ms apart from t=10 s.
+    fn entry(session: u16) -> Vec<u8> {
+        let mut v = session.to_le_bytes().to_vec();
+        v.extend_from_slice(&[
+            0x01, 0x05, 0x10, 0x27, 0x00, 0x00, 0x14, 0x00, 0xE8, 0x03, 0x02, 0x03, 0x80, 0x01,
+            0x7D,
+        ]);
+        v
+    }
+
+    #[test]
+    fn test_parse_record_status() {
+        let value = [2, 7, 0, 0, 0x40, 0, 0, 0, 0, 0x20, 0, 3, 0, 0, 0];
+        let status = parse_record_status(&value).unwrap();
+        assert_eq!(status.state_name(), "recording");
+        assert_eq!(status.session, 7);
+        assert_eq!(status.used_bytes, 0x4000);
+        assert_eq!(status.capacity_bytes, 0x20_0000);
+        assert_eq!(status.dropped, 3);
+        assert!(parse_record_status(&value[..14]).is_none());
+    }
+
+    #[test]
+    fn test_parse_record_entry() {
+        let e = parse_record_entry(&entry(3)).unwrap();
+        assert_eq!(e.session, 3);
+        assert_eq!(e.batch.t0_ms, 10_000);
+        assert_eq!(e.batch.samples(), &[1000, 1001, 999, 1063, 1000]);
+        assert!(parse_record_entry(&[3]).is_none());
+        assert!(parse_record_entry(&entry(3)[..10]).is_none());
+    }
+
+    #[test]
+    fn test_download_csv() {
+        let mut out = Vec::new();
+        let mut d = Download::new(&mut out).unwrap();
+        assert!(!d.push(&entry(1)).unwrap());
+        assert!(!d.push(&[0x01, 0x00, 0x99]).unwrap());
+        assert!(d.push(&DOWNLOAD_END).unwrap());
+        assert_eq!((d.entries, d.samples, d.bad_entries), (1, 5, 1));
+
+        let csv = String::from_utf8(out).unwrap();
+        let lines: Vec<&str> = csv.lines().collect();
+        assert_eq!(lines[0], "session,timestamp_ms,distance_mm");
+        assert_eq!(lines[1], "1,10000,1000");
+        assert_eq!(lines[5], "1,10080,1000");
+        assert_eq!(lines.len(), 6);
+    }
+
+    #[test]
+    fn test_download_writes_failed_reads_empty() {
+        // Two samples, the second a failed read (0xFFFF)
+        let mut value = vec![2, 0, 0x01, 0x02, 0, 0, 0, 0, 0x32, 0x00, 0x64, 0x00];
+        // delta 65435 zig-zag encoded: 130870 -> LEB128
+        value.extend_from_slice(&[0xB6, 0xFE, 0x07]);
+        let mut out = Vec::new();
+        let mut d = Download::new(&mut out).unwrap();
+        d.push(&value).unwrap();
+        assert_eq!(d.bad_entries, 0);
+        let csv = String::from_utf8(out).unwrap();
+        assert!(csv.ends_with("2,0,100\n2,50,\n"));
+    }
+}
@@ -0,0 +1,330 @@
+//! Config reload while running.
+//!
+//! The config file is checked for a new modification time every
+//! RELOAD_POLL_INTERVAL, and SIGHUP forces a reload. A new config is
+//! validated before anything sees it; one that fails is logged and the
+//! running config stays. Mapping changes are swapped into the live mappers
+//! between two samples. Anything that decides what to connect to or how
+//! (sensors, Intiface, toys, output, on-device mapping) restarts the
+//! session instead: a reconnect, but without waiting out the reconnect
+//! delay.
+
+use std::path::PathBuf;
+use std::time::{Duration, SystemTime};
+use tokio::sync::watch;
+use tracing::{info, warn};
+
+use crate::config::{Config, MappingConfig};
+
+/// How often the config file's modification time is checked.
+const RELOAD_POLL_INTERVAL: Duration = Duration::from_secs(1);
+
+/// What a new config means for a running session.
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub enum Change {
+    Unchanged,
+    /// Only mappings differ: swap them in
+    Mapping,
+    /// Connection or output settings differ: start a new session
+    Restart,
+}
+
+/// Compare a running config with a new one.
+pub fn classify(old: &Config, new: &Config) -> Change {
+    if old == new {
+        return Change::Unchanged;
+    }
+    // The device gets its mapping when it connects
+    if old.mapping.on_device || new.mapping.on_device {
+        return Change::Restart;
+    }
+
+    // Same config apart from the mappings?
+    let mut masked = new.clone();
+    masked.mapping = old.mapping.clone();
+    if masked.buttplug.devices.len() == old.buttplug.devices.len() {
+        for (device, old_device) in masked
+            .buttplug
+            .devices
+            .iter_mut()
+            .zip(&old.buttplug.devices)
+        {
+            device.mapping = old_device.mapping.clone();
+        }
+    }
+    if masked == *old {
+        Change::Mapping
+    } else {
+        Change::Restart
+    }
+}
+
+/// A config file and the modification time last seen.
+#[derive(Debug)]
+pub struct ConfigFile {
+    path: PathBuf,
+    modified: Option<SystemTime>,
+}
+
+impl ConfigFile {
+    pub fn new(path: PathBuf) -> Self {
+        let modified = modified(&path);
+        ConfigFile { path, modified }
+    }
+
+    /// Whether the file was written, created or removed since the last
+    /// call.
+    pub fn changed(&mut self) -> bool {
+        let modified = modified(&self.path);
+        std::mem::replace(&mut self.modified, modified) != modified
+    }
+
+    /// Load and validate the file.
+    pub fn load(&self) -> anyhow::Result<Config> {
+        Config::load(&self.path)
+    }
+}
+
+fn modified(path: &std::path::Path) -> Option<SystemTime> {
+    std::fs::metadata(path).and_then(|m| m.modified()).ok()
+}
+
+/// Publish every valid change to the config file on `tx`, until the
+/// receivers are gone.
+pub async fn watch_config(path: PathBuf, tx: watch::Sender<Config>) {
+    let mut file = ConfigFile::new(path);
+    let mut hangups = Hangups::new();
+    let mut poll = tokio::time::interval(RELOAD_POLL_INTERVAL);
+
+    while !tx.is_closed() {
+        let forced = tokio::select! {
+            _ = poll.tick() => false,
+            () = hangups.recv() => {
+                info!("SIGHUP: reloading config");
+                true
+            }
+        };
+        if !file.changed() && !forced {
+            continue;
+        }
+
+        let config = match file.load() {
+            Ok(config) => config,
+            Err(e) => {
+                warn!("Config reload failed, keeping the running config: {:#}", e);
+                continue;
+            }
+        };
+        if config == *tx.borrow() {
+            if forced {
+                info!("Config unchanged");
+            }
+            continue;
+        }
+        match classify(&tx.borrow(), &config) {
+            Change::Mapping => info!("Config reloaded, applying the new mapping"),
+            _ => info!("Config reloaded, reconnecting"),
+        }
+        crate::log_config(&config);
+        tx.send_replace(config);
+    }
+}
+
+/// SIGHUP notifications; none where there are no signals.
+struct Hangups {
+    #[cfg(unix)]
+    signal: Option<tokio::signal::unix::Signal>,
+}
+
+impl Hangups {
+    fn new() -> Self {
+        #[cfg(unix)]
+        {
+            use tokio::signal::unix::{signal, SignalKind};
+            let signal = signal(SignalKind::hangup())
+                .inspect_err(|e| warn!("No SIGHUP reloads: {}", e))
+                .ok();
+            Hangups { signal }
+        }
+        #[cfg(not(unix))]
+        Hangups {}
+    }
+
+    async fn recv(&mut self) {
+        #[cfg(unix)]
+        if let Some(signal) = &mut self.signal {
+            if signal.recv().await.is_some() {
+                return;
+            }
+            self.signal = None;
+        }
+        std::future::pending().await
+    }
+}
+
+/// A reload as a running session acts on it.
+#[derive(Debug)]
+pub enum Reload {
+    /// New mapping for each toy, in session order
+    Remap(Vec<MappingConfig>),
+    /// End the session so the reconnect loop starts over
+    Restart,
+}
+
+/// Config reloads as one session sees them.
+#[derive(Debug)]
+pub struct Reloads {
+    configs: Option<watch::Receiver<Config>>,
+    /// Config the session is running with
+    current: Config,
+}
+
+impl Reloads {
+    /// Follow `configs`, from `current` (the config the session started
+    /// with).
+    pub fn new(configs: watch::Receiver<Config>, current: Config) -> Self {
+        Reloads {
+            configs: Some(configs),
+            current,
+        }
+    }
+
+    /// A session that never reloads.
+    #[cfg(test)]
+    pub fn none() -> Self {
+        Reloads {
+            configs: None,
+            current: Config::default(),
+        }
+    }
+
+    /// Wait for the next reload that concerns the session. Never resolves
+    /// once the watcher has stopped.
+    pub async fn next(&mut self) -> Reload {
+        while let Some(configs) = &mut self.configs {
+            if configs.changed().await.is_err() {
+                self.configs = None;
+                break;
+            }
+            let new = configs.borrow_and_update().clone();
+            match classify(&self.current, &new) {
+                Change::Unchanged => {}
+                Change::Restart => return Reload::Restart,
+                Change::Mapping => match crate::device_plan(&new) {
+                    Ok(plan) => {
+                        self.current = new;
+                        return Reload::Remap(plan.into_iter().map(|(_, m)| m).collect());
+                    }
+                    Err(e) => warn!("Ignoring new mapping: {:#}", e),
+                },
+            }
+        }
+        std::future::pending().await
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use crate::config::DeviceConfig;
+    use std::io::Write;
+
+    #[test]
+    fn test_classify() {
+        let old = Config::default();
+        assert_eq!(classify(&old, &old.clone()), Change::Unchanged);
+
+        let mut new = old.clone();
+        new.mapping.max_intensity = 0.5;
+        new.mapping.smoothing = 0.6;
+        assert_eq!(classify(&old, &new), Change::Mapping);
+
+        new.ble.device_name = "Other".to_string();
+        assert_eq!(classify(&old, &new), Change::Restart);
+
+        let mut new = old.clone();
+        new.output.rate_hz = 60;
+        assert_eq!(classify(&old, &new), Change::Restart);
+
+        // The mapping lives on the rangefinder then
+        let mut on_device = old.clone();
+        on_device.mapping.on_device = true;
+        let mut new = on_device.clone();
+        new.mapping.max_intensity = 0.5;
+        assert_eq!(classify(&on_device, &new), Change::Restart);
+    }
+
+    #[test]
+    fn test_classify_device_overrides() {
+        let mut old = Config::default();
+        old.buttplug.devices.push(DeviceConfig {
+            name: Some("lush".to_string()),
+            ..Default::default()
+        });
+
+        let mut new = old.clone();
+        new.buttplug.devices[0]
+            .mapping
+            .insert("invert".into(), toml::Value::Boolean(false));
+        assert_eq!(classify(&old, &new), Change::Mapping);
+
+        // A different toy is a reconnect
+        new.buttplug.devices[0].name = Some("melt".to_string());
+        assert_eq!(classify(&old, &new), Change::Restart);
+    }
+
+    #[test]
+    fn test_config_file_changes() {
+        let mut f = tempfile::NamedTempFile::new().unwrap();
+        f.write_all(
+            toml::to_string_pretty(&Config::default())
+                .unwrap()
+                .as_bytes(),
+        )
+        .unwrap();
+        let mut file = ConfigFile::new(f.path().to_path_buf());
+        assert!(!file.changed());
+
+        // Bump the mtime explicitly; writes can land in the same tick
+        let later = SystemTime::now() + Duration::from_secs(5);
+        f.as_file().set_modified(later).unwrap();
+        assert!(file.changed());
+        assert!(!file.changed());
+        file.load().unwrap();
+
+        // Invalid configs are rejected on load
+        let mut bad = Config::default();
+        bad.mapping.min_intensity = 2.0;
+        std::fs::write(f.path(), toml::to_string_pretty(&bad).unwrap()).unwrap();
+        assert!(file.load().is_err());
+    }
+
+    #[tokio::test]
+    async fn test_reloads_remap_then_restart() {
+        let config = Config::default();
+        let (tx, rx) = watch::channel(config.clone());
+        let mut reloads = Reloads::new(rx, config.clone());
+
+        let mut new = config.clone();
+        new.mapping.max_intensity = 0.5;
+        tx.send_replace(new.clone());
+        match reloads.next().await {
+            Reload::Remap(mappings) => {
+                assert_eq!(mappings.len(), 1);
+                assert!((mappings[0].max_intensity - 0.5).abs() < f64::EPSILON);
+            }
+            other => panic!("expected a remap, got {other:?}"),
+        }
+
+        new.buttplug.server_address = "ws://10.0.0.2:12345".to_string();
+        tx.send_replace(new);
+        assert!(matches!(reloads.next().await, Reload::Restart));
+    }
+
+    #[tokio::test]
+    async fn test_reloads_none_never_fires() {
+        let mut reloads = Reloads::none();
+        let next = tokio::time::timeout(Duration::from_millis(20), reloads.next()).await;
+        assert!(next.is_err());
+    }
+}
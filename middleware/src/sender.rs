@@ -0,0 +1,307 @@
+//! Toy command sender.
+//!
+//! A toy command is a websocket round trip to Intiface and on to the toy,
+//! which can take tens of ms. The sender runs beside the control loop and
+//! owns the toy for the session, so the loop only posts the newest
+//! intensity and never waits on the websocket. At most one command is in
+//! flight; anything posted meanwhile replaces what was waiting, so each
+//! completed command is followed straight by the freshest one. Dropping
+//! the sender cancels the command in flight, so the session can stop the
+//! toy without waiting for it.
+
+use std::time::Duration;
+use tokio::sync::{mpsc, watch};
+use tokio::time::Instant;
+use tracing::warn;
+
+use crate::toy::ToyBackend;
+
+/// How often an idle sender checks that Intiface is still connected.
+const HEALTH_CHECK_INTERVAL: Duration = Duration::from_secs(1);
+
+/// One toy command.
+#[derive(Debug, Clone, Copy, PartialEq)]
+pub struct Command {
+    /// 0.0-1.0
+    pub intensity: f64,
+    /// Device time of the sample behind it, when known
+    pub t_ms: Option<u32>,
+}
+
+/// A command that went out to the toy and was accepted.
+#[derive(Debug, Clone, Copy, PartialEq)]
+pub struct Sent {
+    /// Which toy, as given to channel()
+    pub device: usize,
+    pub command: Command,
+    /// Time from handing the command to Intiface to its reply
+    pub rtt: Duration,
+    /// Commands replaced by a newer one since the previous Sent
+    pub superseded: u64,
+}
+
+/// Newest posted command and how many have been posted in total.
+#[derive(Debug, Default)]
+struct Slot {
+    seq: u64,
+    command: Option<Command>,
+}
+
+/// Create a connected poster/sender pair for toy number `device`, called
+/// `name` in the log.
+pub fn channel(device: usize, name: &str) -> (CommandPoster, CommandSender) {
+    let (tx, rx) = watch::channel(Slot::default());
+    (
+        CommandPoster { slot: tx },
+        CommandSender {
+            device,
+            name: name.to_string(),
+            slot: rx,
+            seen: 0,
+            superseded: 0,
+        },
+    )
+}
+
+/// Control loop side; posting never blocks.
+#[derive(Debug)]
+pub struct CommandPoster {
+    slot: watch::Sender<Slot>,
+}
+
+impl CommandPoster {
+    /// Post a command, replacing any not yet picked up.
+    pub fn post(&self, command: Command) {
+        self.slot.send_modify(|slot| {
+            slot.seq += 1;
+            slot.command = Some(command);
+        });
+    }
+}
+
+/// Toy side.
+#[derive(Debug)]
+pub struct CommandSender {
+    device: usize,
+    name: String,
+    slot: watch::Receiver<Slot>,
+    seen: u64,
+    superseded: u64,
+}
+
+impl CommandSender {
+    /// Send posted commands to the toy, reporting each one that went out
+    /// and was accepted on `sent`; one the toy skipped as no change has no
+    /// round trip to report. Returns once the poster is gone or the toy
+    /// has lost its Intiface connection.
+    pub async fn run(&mut self, toy: &mut dyn ToyBackend, sent: mpsc::UnboundedSender<Sent>) {
+        let mut health = tokio::time::interval_at(
+            Instant::now() + HEALTH_CHECK_INTERVAL,
+            HEALTH_CHECK_INTERVAL,
+        );
+
+        loop {
+            let command = match self.take() {
+                Some(command) => command,
+                None => {
+                    tokio::select! {
+                        changed = self.slot.changed() => {
+                            if changed.is_err() {
+                                return;
+                            }
+                        }
+                        _ = health.tick() => {
+                            if !toy.is_connected() {
+                                warn!("{}: lost connection to Intiface", self.name);
+                                return;
+                            }
+                        }
+                    }
+                    continue;
+                }
+            };
+
+            let start = Instant::now();
+            match toy.set_intensity(command.intensity).await {
+                Ok(false) => {}
+                Ok(true) => {
+                    let _ = sent.send(Sent {
+                        device: self.device,
+                        command,
+                        rtt: start.elapsed(),
+                        superseded: std::mem::take(&mut self.superseded),
+                    });
+                }
+                Err(e) => warn!("{}: failed to set intensity: {:#}", self.name, e),
+            }
+        }
+    }
+
+    fn take(&mut self) -> Option<Command> {
+        let slot = self.slot.borrow_and_update();
+        if slot.seq == self.seen {
+            return None;
+        }
+        self.superseded += slot.seq - self.seen - 1;
+        self.seen = slot.seq;
+        slot.command
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use std::sync::{Arc, Mutex};
+
+    /// Toy whose commands take `delay` and are logged when they complete.
+    struct SlowToy {
+        delay: Duration,
+        done: Arc<Mutex<Vec<f64>>>,
+        connected: bool,
+    }
+
+    #[async_trait::async_trait]
+    impl ToyBackend for SlowToy {
+        async fn set_intensity(&mut self, intensity: f64) -> anyhow::Result<bool> {
+            // Holding the same level is a no-op, as on a real toy
+            if self.done.lock().unwrap().last() == Some(&intensity) {
+                return Ok(false);
+            }
+            tokio::time::sleep(self.delay).await;
+            self.done.lock().unwrap().push(intensity);
+            Ok(true)
+        }
+
+        async fn stop(&mut self) -> anyhow::Result<()> {
+            Ok(())
+        }
+
+        fn is_connected(&self) -> bool {
+            self.connected
+        }
+    }
+
+    fn slow_toy(delay_ms: u64) -> (SlowToy, Arc<Mutex<Vec<f64>>>) {
+        let done = Arc::new(Mutex::new(Vec::new()));
+        let toy = SlowToy {
+            delay: Duration::from_millis(delay_ms),
+            done: done.clone(),
+            connected: true,
+        };
+        (toy, done)
+    }
+
+    fn command(intensity: f64) -> Command {
+        Command {
+            intensity,
+            t_ms: None,
+        }
+    }
+
+    #[tokio::test]
+    async fn test_posts_while_in_flight_collapse_to_latest() {
+        let (mut toy, done) = slow_toy(30);
+        let (poster, mut sender) = channel(0, "test");
+        let (sent_tx, mut sent_rx) = mpsc::unbounded_channel();
+
+        let control = async {
+            poster.post(command(0.1));
+            // Let 0.1 go out, then post three while it is in flight
+            tokio::time::sleep(Duration::from_millis(10)).await;
+            poster.post(command(0.2));
+            poster.post(command(0.3));
+            poster.post(command(0.4));
+            tokio::time::sleep(Duration::from_millis(100)).await;
+        };
+        tokio::select! {
+            () = control => {}
+            () = sender.run(&mut toy, sent_tx) => panic!("sender ended early"),
+        }
+
+        assert_eq!(*done.lock().unwrap(), vec![0.1, 0.4]);
+        let first = sent_rx.recv().await.unwrap();
+        assert_eq!(first.command, command(0.1));
+        assert!(first.rtt >= Duration::from_millis(30));
+        assert_eq!(first.superseded, 0);
+        let second = sent_rx.recv().await.unwrap();
+        assert_eq!(second.command, command(0.4));
+        assert_eq!(second.superseded, 2);
+    }
+
+    #[tokio::test]
+    async fn test_unchanged_level_is_not_reported() {
+        let (mut toy, done) = slow_toy(10);
+        let (poster, mut sender) = channel(0, "test");
+        let (sent_tx, mut sent_rx) = mpsc::unbounded_channel();
+
+        let control = async {
+            // A tick reposting the held level, then a real change
+            for intensity in [0.5, 0.5, 0.5, 0.6] {
+                poster.post(command(intensity));
+                tokio::time::sleep(Duration::from_millis(30)).await;
+            }
+        };
+        tokio::select! {
+            () = control => {}
+            () = sender.run(&mut toy, sent_tx) => panic!("sender ended early"),
+        }
+
+        assert_eq!(*done.lock().unwrap(), vec![0.5, 0.6]);
+        let first = sent_rx.recv().await.unwrap();
+        assert_eq!(first.command, command(0.5));
+        let second = sent_rx.recv().await.unwrap();
+        assert_eq!(second.command, command(0.6));
+        assert!(second.rtt >= Duration::from_millis(10));
+        assert_eq!(second.superseded, 0);
+        assert!(sent_rx.try_recv().is_err());
+    }
+
+    #[tokio::test]
+    async fn test_posting_never_waits_on_the_toy() {
+        let (mut toy, done) = slow_toy(1000);
+        let (poster, mut sender) = channel(0, "test");
+        let (sent_tx, _sent_rx) = mpsc::unbounded_channel();
+
+        let control = async {
+            let start = Instant::now();
+            for i in 0..100 {
+                poster.post(command(i as f64 / 100.0));
+                tokio::task::yield_now().await;
+            }
+            start.elapsed()
+        };
+        let elapsed = tokio::select! {
+            elapsed = control => elapsed,
+            () = sender.run(&mut toy, sent_tx) => panic!("sender ended early"),
+        };
+
+        // Dropping the sender cancelled the one command in flight
+        assert!(elapsed < Duration::from_millis(500));
+        assert!(done.lock().unwrap().is_empty());
+    }
+
+    #[tokio::test]
+    async fn test_ends_when_poster_dropped() {
+        let (mut toy, done) = slow_toy(0);
+        let (poster, mut sender) = channel(0, "test");
+        let (sent_tx, _sent_rx) = mpsc::unbounded_channel();
+
+        poster.post(command(0.5));
+        drop(poster);
+        sender.run(&mut toy, sent_tx).await;
+
+        assert_eq!(*done.lock().unwrap(), vec![0.5]);
+    }
+
+    #[tokio::test(flavor = "multi_thread")]
+    async fn test_ends_when_toy_disconnects() {
+        let (mut toy, _done) = slow_toy(0);
+        toy.connected = false;
+        let (_poster, mut sender) = channel(0, "test");
+        let (sent_tx, _sent_rx) = mpsc::unbounded_channel();
+
+        tokio::time::timeout(Duration::from_secs(3), sender.run(&mut toy, sent_tx))
+            .await
+            .expect("sender should notice the lost connection");
+    }
+}
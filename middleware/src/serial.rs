@@ -0,0 +1,472 @@
+//! Wired range source: the firmware's framed sample stream on its second
+//! USB CDC ACM interface.
+//!
+//! For tethered setups. Samples arrive as soon as they are read, without a
+//! BLE connection interval in between, and feed the same event channel as
+//! `ble::run_ble_client`.
+
+use std::io::Read;
+use std::path::Path;
+use std::sync::atomic::{AtomicBool, Ordering};
+use tracing::{debug, info, warn};
+
+use crate::ble::{BleEvent, RangeQuality};
+use crate::events::EventSink;
+
+/// First two bytes of every frame (firmware serial_frame.h).
+const SYNC: [u8; 2] = [0xA5, 0x5A];
+/// Sync, type, length and CRC.
+const OVERHEAD: usize = 6;
+/// Frame type carrying one sample.
+const FRAME_SAMPLE: u8 = 0x01;
+/// SERIAL_FRAME_SAMPLE payload: seq, timestamp_ms, distance_mm, status, signal, ambient.
+const SAMPLE_LEN: usize = 13;
+
+/// One sample from the wired stream.
+#[derive(Debug, Clone, Copy, PartialEq)]
+pub struct SerialSample {
+    /// Per-sample sequence number, wraps at 65536
+    pub seq: u16,
+    /// Device uptime of the read in ms
+    pub timestamp_ms: u32,
+    /// Distance as read (not clamped)
+    pub distance_mm: u16,
+    /// Range status and signal levels
+    pub quality: RangeQuality,
+}
+
+/// CRC-16/CCITT-FALSE, as Zephyr's crc16_itu_t(0xFFFF, ...).
+pub(crate) fn crc16_ccitt(data: &[u8]) -> u16 {
+    let mut crc: u16 = 0xFFFF;
+    for &byte in data {
+        crc ^= (byte as u16) << 8;
+        for _ in 0..8 {
+            crc = if crc & 0x8000 != 0 {
+                (crc << 1) ^ 0x1021
+            } else {
+                crc << 1
+            };
+        }
+    }
+    crc
+}
+
+/// Reassembles frames from a byte stream that may start mid-frame or
+/// carry corrupted bytes, and counts what it had to skip.
+#[derive(Default)]
+pub struct FrameDecoder {
+    buf: Vec<u8>,
+    next_seq: Option<u16>,
+    /// Frames with a bad CRC or unexpected length
+    pub bad_frames: u64,
+    /// Samples the device dropped (gaps in seq)
+    pub dropped: u64,
+}
+
+impl FrameDecoder {
+    pub fn new() -> Self {
+        Self::default()
+    }
+
+    /// Feed received bytes; `on_sample` is called for every complete sample frame.
+    pub fn feed(&mut self, data: &[u8], mut on_sample: impl FnMut(SerialSample)) {
+        self.buf.extend_from_slice(data);
+        let mut pos = 0;
+
+        loop {
+            // Find the next sync pair
+            let Some(start) = self.buf[pos..].windows(2).position(|w| w == SYNC) else {
+                // Keep a trailing first sync byte, it may pair with the next read
+                pos = if self.buf.len() > pos && self.buf.last() == Some(&SYNC[0]) {
+                    self.buf.len() - 1
+                } else {
+                    self.buf.len()
+                };
+                break;
+            };
+            let start = pos + start;
+            if self.buf.len() < start + 4 {
+                pos = start;
+                break;
+            }
+            let frame_len = self.buf[start + 3] as usize + OVERHEAD;
+            if self.buf.len() < start + frame_len {
+                pos = start;
+                break;
+            }
+
+            let frame = &self.buf[start..start + frame_len];
+            let body = &frame[2..frame_len - 2];
+            let crc = u16::from_le_bytes([frame[frame_len - 2], frame[frame_len - 1]]);
+            if crc != crc16_ccitt(body) {
+                // False sync inside a payload or line noise: rescan from the next byte
+                self.bad_frames += 1;
+                pos = start + 1;
+                continue;
+            }
+
+            if body[0] == FRAME_SAMPLE {
+                match parse_sample(&body[2..]) {
+                    Some(sample) => {
+                        if let Some(expected) = self.next_seq {
+                            self.dropped += sample.seq.wrapping_sub(expected) as u64;
+                        }
+                        self.next_seq = Some(sample.seq.wrapping_add(1));
+                        on_sample(sample);
+                    }
+                    None => self.bad_frames += 1,
+                }
+            }
+            // Other frame types are skipped so newer firmware stays readable
+            pos = start + frame_len;
+        }
+
+        self.buf.drain(..pos);
+    }
+}
+
+fn parse_sample(p: &[u8]) -> Option<SerialSample> {
+    if p.len() != SAMPLE_LEN {
+        return None;
+    }
+    Some(SerialSample {
+        seq: u16::from_le_bytes([p[0], p[1]]),
+        timestamp_ms: u32::from_le_bytes([p[2], p[3], p[4], p[5]]),
+        distance_mm: u16::from_le_bytes([p[6], p[7]]),
+        quality: RangeQuality {
+            range_status: p[8],
+            signal_rate_kcps: u16::from_le_bytes([p[9], p[10]]),
+            ambient_rate_kcps: u16::from_le_bytes([p[11], p[12]]),
+        },
+    })
+}
+
+/// Read the wired stream from `port` and send range events until shutdown,
+/// a read error or the port closing. Unplugging the board or a tty hangup
+/// ends it like a BLE disconnect. Blocking; run it on its own thread.
+pub fn run_serial_client(
+    port: &Path,
+    tx: impl EventSink,
+    running: &AtomicBool,
+) -> anyhow::Result<()> {
+    let mut tty = tty::open_raw(port)?;
+    info!("Opened wired stream on {:?}", port);
+    tx.send(BleEvent::Connected)?;
+
+    let mut decoder = FrameDecoder::new();
+    let mut rejected: u64 = 0;
+    let mut buf = [0u8; 512];
+    let mut result = Ok(());
+
+    while running.load(Ordering::SeqCst) {
+        let n = match tty.read(&mut buf) {
+            // Read timeout, recheck running; or end of file once the port
+            // has hung up, which reads 0 at once from then on
+            Ok(0) if tty::hung_up(&tty) => {
+                warn!("Wired stream closed");
+                break;
+            }
+            Ok(0) => continue,
+            Ok(n) => n,
+            Err(e) if e.kind() == std::io::ErrorKind::Interrupted => continue,
+            Err(e) if tty::is_hangup(&e) => {
+                warn!("Wired stream closed ({})", e);
+                break;
+            }
+            Err(e) => {
+                result = Err(e.into());
+                break;
+            }
+        };
+
+        let mut closed = false;
+        decoder.feed(&buf[..n], |sample| {
+            if !sample.quality.is_valid() {
+                rejected += 1;
+                debug!(
+                    "Rejected sample: status={} ({} total)",
+                    sample.quality.range_status, rejected
+                );
+                return;
+            }
+            closed |= tx.send(BleEvent::RangeUpdate(sample.distance_mm)).is_err();
+        });
+        if closed {
+            break;
+        }
+    }
+
+    if decoder.dropped > 0 || decoder.bad_frames > 0 {
+        warn!(
+            "Wired stream: {} samples dropped by the device, {} bad frames",
+            decoder.dropped, decoder.bad_frames
+        );
+    }
+    let _ = tx.send(BleEvent::Disconnected);
+    result
+}
+
+/// Raw-mode tty access through termios.
+#[cfg(target_os = "linux")]
+mod tty {
+    use std::fs::{File, OpenOptions};
+    use std::io;
+    use std::os::fd::AsRawFd;
+    use std::os::unix::fs::OpenOptionsExt;
+    use std::path::Path;
+
+    /// Open `path` with no line discipline processing. Reads return after at
+    /// most 200 ms with whatever has arrived (possibly nothing).
+    pub fn open_raw(path: &Path) -> io::Result<File> {
+        let file = OpenOptions::new()
+            .read(true)
+            .write(true)
+            .custom_flags(libc::O_NOCTTY)
+            .open(path)?;
+
+        // SAFETY: termios is plain data, filled by tcgetattr before use
+        let mut tio: libc::termios = unsafe { std::mem::zeroed() };
+        // SAFETY: the fd is open for the lifetime of `file`
+        if unsafe { libc::tcgetattr(file.as_raw_fd(), &mut tio) } < 0 {
+            return Err(io::Error::last_os_error());
+        }
+        // SAFETY: tio was initialized by tcgetattr
+        unsafe { libc::cfmakeraw(&mut tio) };
+        tio.c_cc[libc::VMIN] = 0;
+        tio.c_cc[libc::VTIME] = 2;
+        // SAFETY: as above
+        if unsafe { libc::tcsetattr(file.as_raw_fd(), libc::TCSANOW, &tio) } < 0 {
+            return Err(io::Error::last_os_error());
+        }
+
+        Ok(file)
+    }
+
+    /// Whether the other end is gone (board unplugged, tty hung up).
+    pub fn hung_up(file: &File) -> bool {
+        let mut fd = libc::pollfd {
+            fd: file.as_raw_fd(),
+            events: libc::POLLIN,
+            revents: 0,
+        };
+        // SAFETY: one valid pollfd, no wait
+        let ready = unsafe { libc::poll(&mut fd, 1, 0) };
+        ready > 0 && fd.revents & (libc::POLLHUP | libc::POLLERR | libc::POLLNVAL) != 0
+    }
+
+    /// Whether a read error means the tty went away under us.
+    pub fn is_hangup(err: &io::Error) -> bool {
+        err.raw_os_error() == Some(libc::EIO)
+    }
+}
+
+#[cfg(not(target_os = "linux"))]
+mod tty {
+    use std::fs::File;
+    use std::io;
+    use std::path::Path;
+
+    pub fn open_raw(_path: &Path) -> io::Result<File> {
+        Err(io::Error::new(
+            io::ErrorKind::Unsupported,
+            "wired stream is only supported on Linux",
+        ))
+    }
+
+    pub fn hung_up(_file: &File) -> bool {
+        false
+    }
+
+    pub fn is_hangup(_err: &io::Error) -> bool {
+        false
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    /// Same frame as firmware/tests/serial_frame: seq 0x0102, t=1000 ms,
+    /// 300 mm, status 0, signal 2500, ambient 40.
+    const GOLDEN_FRAME: [u8; 19] = [
+        0xA5, 0x5A, 0x01, 0x0D, 0x02, 0x01, 0xE8, 0x03, 0x00, 0x00, 0x2C, 0x01, 0x00, 0xC4, 0x09,
+        0x28, 0x00, 0xD1, 0x61,
+    ];
+
+    fn frame(seq: u16, mm: u16, status: u8) -> Vec<u8> {
+        let mut body = vec![FRAME_SAMPLE, SAMPLE_LEN as u8];
+        body.extend_from_slice(&seq.to_le_bytes());
+        body.extend_from_slice(&1000u32.to_le_bytes());
+        body.extend_from_slice(&mm.to_le_bytes());
+        body.push(status);
+        body.extend_from_slice(&[0, 0, 0, 0]);
+        let mut f = SYNC.to_vec();
+        f.extend_from_slice(&body);
+        f.extend_from_slice(&crc16_ccitt(&body).to_le_bytes());
+        f
+    }
+
+    fn decode(decoder: &mut FrameDecoder, data: &[u8]) -> Vec<SerialSample> {
+        let mut out = Vec::new();
+        decoder.feed(data, |s| out.push(s));
+        out
+    }
+
+    #[test]
+    fn test_crc16_check_value() {
+        assert_eq!(crc16_ccitt(b"123456789"), 0x29B1);
+    }
+
+    #[test]
+    fn test_golden_frame() {
+        let samples = decode(&mut FrameDecoder::new(), &GOLDEN_FRAME);
+        assert_eq!(
+            samples,
+            vec![SerialSample {
+                seq: 0x0102,
+                timestamp_ms: 1000,
+                distance_mm: 300,
+                quality: RangeQuality {
+                    range_status: 0,
+                    signal_rate_kcps: 2500,
+                    ambient_rate_kcps: 40,
+                },
+            }]
+        );
+    }
+
+    #[test]
+    fn test_split_across_reads() {
+        let mut d = FrameDecoder::new();
+        for split in 1..GOLDEN_FRAME.len() {
+            assert!(decode(&mut d, &GOLDEN_FRAME[..split]).is_empty());
+            assert_eq!(decode(&mut d, &GOLDEN_FRAME[split..]).len(), 1);
+        }
+        assert_eq!(d.bad_frames, 0);
+    }
+
+    #[test]
+    fn test_resync_after_garbage_and_corruption() {
+        let mut d = FrameDecoder::new();
+        let mut data = vec![0x00, 0xA5, 0x13, 0xA5];
+        let mut corrupt = frame(1, 100, 0);
+        corrupt[8] ^= 0xFF;
+        data.extend_from_slice(&corrupt);
+        data.extend_from_slice(&frame(2, 200, 0));
+
+        let samples = decode(&mut d, &data);
+        assert_eq!(samples.len(), 1);
+        assert_eq!(samples[0].distance_mm, 200);
+        assert_eq!(d.bad_frames, 1);
+    }
+
+    #[test]
+    fn test_seq_gaps_counted() {
+        let mut d = FrameDecoder::new();
+        let mut data = frame(65534, 1, 0);
+        data.extend_from_slice(&frame(1, 2, 0));
+        assert_eq!(decode(&mut d, &data).len(), 2);
+        assert_eq!(d.dropped, 2);
+    }
+
+    #[test]
+    fn test_unknown_frame_type_skipped() {
+        let mut d = FrameDecoder::new();
+        let body = [0x7F, 0x00];
+        let mut data = SYNC.to_vec();
+        data.extend_from_slice(&body);
+        data.extend_from_slice(&crc16_ccitt(&body).to_le_bytes());
+        data.extend_from_slice(&GOLDEN_FRAME);
+        assert_eq!(decode(&mut d, &data).len(), 1);
+        assert_eq!(d.bad_frames, 0);
+    }
+
+    /// Drive run_serial_client through a pseudo-terminal standing in for the
+    /// CDC ACM port.
+    #[cfg(target_os = "linux")]
+    #[test]
+    fn test_serial_client_over_pty() {
+        use std::ffi::CStr;
+        use std::io::Write;
+        use std::os::fd::FromRawFd;
+        use std::sync::Arc;
+        use tokio::sync::mpsc;
+
+        // SAFETY: standard pty setup; the master fd is owned by `master` below
+        let (mut master, slave_path) = unsafe {
+            let fd = libc::posix_openpt(libc::O_RDWR | libc::O_NOCTTY);
+            assert!(fd >= 0);
+            assert_eq!(libc::grantpt(fd), 0);
+            assert_eq!(libc::unlockpt(fd), 0);
+            let mut name = [0 as libc::c_char; 64];
+            assert_eq!(libc::ptsname_r(fd, name.as_mut_ptr(), name.len()), 0);
+            let path = CStr::from_ptr(name.as_ptr()).to_str().unwrap().to_string();
+            (std::fs::File::from_raw_fd(fd), path)
+        };
+
+        let (tx, mut rx) = mpsc::unbounded_channel();
+        let running = Arc::new(AtomicBool::new(true));
+        let reader = {
+            let running = running.clone();
+            std::thread::spawn(move || run_serial_client(Path::new(&slave_path), tx, &running))
+        };
+
+        assert_eq!(rx.blocking_recv(), Some(BleEvent::Connected));
+        let mut data = frame(1, 150, 0);
+        data.extend_from_slice(&frame(2, 9999, 2)); // signal fail, filtered
+        data.extend_from_slice(&frame(3, 160, 255));
+        master.write_all(&data).unwrap();
+
+        assert_eq!(rx.blocking_recv(), Some(BleEvent::RangeUpdate(150)));
+        assert_eq!(rx.blocking_recv(), Some(BleEvent::RangeUpdate(160)));
+
+        running.store(false, Ordering::SeqCst);
+        reader.join().unwrap().unwrap();
+        assert_eq!(rx.blocking_recv(), Some(BleEvent::Disconnected));
+    }
+
+    /// Closing the master end stands in for unplugging the board.
+    #[cfg(target_os = "linux")]
+    #[test]
+    fn test_serial_client_ends_on_hangup() {
+        use std::ffi::CStr;
+        use std::os::fd::FromRawFd;
+        use std::sync::Arc;
+        use std::time::Duration;
+        use tokio::sync::mpsc;
+
+        // SAFETY: as in test_serial_client_over_pty
+        let (master, slave_path) = unsafe {
+            let fd = libc::posix_openpt(libc::O_RDWR | libc::O_NOCTTY);
+            assert!(fd >= 0);
+            assert_eq!(libc::grantpt(fd), 0);
+            assert_eq!(libc::unlockpt(fd), 0);
+            let mut name = [0 as libc::c_char; 64];
+            assert_eq!(libc::ptsname_r(fd, name.as_mut_ptr(), name.len()), 0);
+            let path = CStr::from_ptr(name.as_ptr()).to_str().unwrap().to_string();
+            (std::fs::File::from_raw_fd(fd), path)
+        };
+
+        let (tx, mut rx) = mpsc::unbounded_channel();
+        let running = Arc::new(AtomicBool::new(true));
+        let (done_tx, done_rx) = std::sync::mpsc::channel();
+        {
+            let running = running.clone();
+            std::thread::spawn(move || {
+                let result = run_serial_client(Path::new(&slave_path), tx, &running);
+                let _ = done_tx.send(result.is_ok());
+            });
+        }
+
+        assert_eq!(rx.blocking_recv(), Some(BleEvent::Connected));
+        drop(master);
+
+        // Returns on its own, while still running, and says so
+        let ok = done_rx
+            .recv_timeout(Duration::from_secs(2))
+            .expect("client should return after a hangup");
+        assert!(ok);
+        assert!(running.load(Ordering::SeqCst));
+        assert_eq!(rx.blocking_recv(), Some(BleEvent::Disconnected));
+    }
+}
@@ -0,0 +1,213 @@
+//! Smoothing stage between the mapped intensity and the toy.
+//!
+//! A fixed-alpha EMA has to trade jitter at rest against lag in motion.
+//! The One Euro filter (Casiez et al., CHI 2012) moves its cutoff with the
+//! signal's speed: heavy smoothing while the hand is still, little while it
+//! moves fast. Double exponential (Holt) smoothing tracks the trend as well
+//! as the level, so a steady sweep is followed without the EMA's constant
+//! lag. Times are in seconds on whatever clock the samples carry.
+
+use std::f64::consts::PI;
+
+use crate::config::{MappingConfig, SmoothingFilter};
+
+/// Gaps outside these bounds are clamped: a repeated or backwards
+/// timestamp (device reboot) and a long pause both get a sane step.
+const MIN_DT: f64 = 0.001;
+const MAX_DT: f64 = 0.5;
+
+/// Cutoff for the One Euro speed estimate, as in the paper.
+const DERIVATIVE_CUTOFF_HZ: f64 = 1.0;
+
+/// One smoothing filter, chosen by `mapping.filter`.
+#[derive(Debug, Clone)]
+pub enum Smoother {
+    /// Fixed-alpha EMA; `weight` is on the previous value
+    Ema {
+        weight: f64,
+        value: Option<f64>,
+    },
+    OneEuro(OneEuro),
+    DoubleExponential(DoubleExponential),
+}
+
+impl Smoother {
+    pub fn new(config: &MappingConfig) -> Self {
+        match config.filter {
+            SmoothingFilter::Ema => Smoother::Ema {
+                weight: config.smoothing,
+                value: None,
+            },
+            SmoothingFilter::OneEuro => Smoother::OneEuro(OneEuro {
+                min_cutoff_hz: config.min_cutoff_hz,
+                beta: config.beta,
+                last: None,
+            }),
+            SmoothingFilter::DoubleExponential => Smoother::DoubleExponential(DoubleExponential {
+                weight: config.smoothing,
+                trend_weight: config.trend_smoothing,
+                last: None,
+            }),
+        }
+    }
+
+    /// Filter `raw` (0.0-1.0) sampled at `t` seconds. The first sample is
+    /// passed through.
+    pub fn apply(&mut self, raw: f64, t: f64) -> f64 {
+        match self {
+            Smoother::Ema { weight, value } => {
+                let smoothed = match *value {
+                    Some(prev) => *weight * prev + (1.0 - *weight) * raw,
+                    None => raw,
+                };
+                *value = Some(smoothed);
+                smoothed
+            }
+            Smoother::OneEuro(filter) => filter.apply(raw, t),
+            Smoother::DoubleExponential(filter) => filter.apply(raw),
+        }
+    }
+}
+
+/// Speed-adaptive low-pass filter.
+#[derive(Debug, Clone)]
+pub struct OneEuro {
+    min_cutoff_hz: f64,
+    beta: f64,
+    /// (filtered value, filtered speed, time)
+    last: Option<(f64, f64, f64)>,
+}
+
+impl OneEuro {
+    fn apply(&mut self, raw: f64, t: f64) -> f64 {
+        let Some((value, speed, last_t)) = self.last else {
+            self.last = Some((raw, 0.0, t));
+            return raw;
+        };
+        let dt = (t - last_t).clamp(MIN_DT, MAX_DT);
+        let speed = lerp(speed, (raw - value) / dt, alpha(DERIVATIVE_CUTOFF_HZ, dt));
+        let cutoff = self.min_cutoff_hz + self.beta * speed.abs();
+        let value = lerp(value, raw, alpha(cutoff, dt));
+        self.last = Some((value, speed, t));
+        value
+    }
+}
+
+/// Holt's linear smoothing: level plus trend, one step per sample.
+#[derive(Debug, Clone)]
+pub struct DoubleExponential {
+    /// Weight on the predicted level, like mapping.smoothing
+    weight: f64,
+    /// Weight on the previous trend
+    trend_weight: f64,
+    /// (level, trend per sample)
+    last: Option<(f64, f64)>,
+}
+
+impl DoubleExponential {
+    fn apply(&mut self, raw: f64) -> f64 {
+        let (level, trend) = match self.last {
+            Some((level, trend)) => {
+                let next = lerp(raw, level + trend, self.weight);
+                (next, lerp(next - level, trend, self.trend_weight))
+            }
+            None => (raw, 0.0),
+        };
+        self.last = Some((level, trend));
+        level.clamp(0.0, 1.0)
+    }
+}
+
+/// Smoothing factor of a first-order low-pass at `cutoff_hz` for a step of
+/// `dt` seconds.
+fn alpha(cutoff_hz: f64, dt: f64) -> f64 {
+    let tau = 1.0 / (2.0 * PI * cutoff_hz);
+    1.0 / (1.0 + tau / dt)
+}
+
+fn lerp(from: f64, to: f64, amount: f64) -> f64 {
+    from + (to - from) * amount
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    fn config(filter: SmoothingFilter) -> MappingConfig {
+        MappingConfig {
+            filter,
+            ..crate::config::Config::default().mapping
+        }
+    }
+
+    /// Feed `samples` at 50 Hz starting from rest at `from`, return the
+    /// outputs.
+    fn run(smoother: &mut Smoother, from: f64, samples: &[f64]) -> Vec<f64> {
+        for i in 0..50 {
+            smoother.apply(from, i as f64 * 0.02);
+        }
+        samples
+            .iter()
+            .enumerate()
+            .map(|(i, &x)| smoother.apply(x, (50 + i) as f64 * 0.02))
+            .collect()
+    }
+
+    #[test]
+    fn test_first_sample_passes_through() {
+        for filter in [
+            SmoothingFilter::Ema,
+            SmoothingFilter::OneEuro,
+            SmoothingFilter::DoubleExponential,
+        ] {
+            let mut smoother = Smoother::new(&config(filter));
+            assert_eq!(smoother.apply(0.7, 3.0), 0.7, "{filter:?}");
+        }
+    }
+
+    #[test]
+    fn test_one_euro_steady_at_rest() {
+        // +-0.02 jitter around 0.5 is mostly filtered out
+        let mut smoother = Smoother::new(&config(SmoothingFilter::OneEuro));
+        let jitter: Vec<f64> = (0..50).map(|i| 0.5 + 0.02 * (-1f64).powi(i)).collect();
+        let out = run(&mut smoother, 0.5, &jitter);
+        assert!(out.iter().all(|y| (y - 0.5).abs() < 0.01), "{out:?}");
+    }
+
+    #[test]
+    fn test_one_euro_lags_less_than_ema_in_motion() {
+        // Same jitter rejection at rest, but a fast sweep is followed
+        // more closely than by the default EMA
+        let sweep: Vec<f64> = (1..=10).map(|i| i as f64 * 0.1).collect();
+        let mut ema = Smoother::new(&config(SmoothingFilter::Ema));
+        let mut one_euro = Smoother::new(&config(SmoothingFilter::OneEuro));
+        let ema_out = run(&mut ema, 0.0, &sweep);
+        let one_euro_out = run(&mut one_euro, 0.0, &sweep);
+        let lag = |out: &[f64]| (sweep[9] - out[9]).abs();
+        assert!(
+            lag(&one_euro_out) < lag(&ema_out),
+            "one euro {one_euro_out:?} vs ema {ema_out:?}"
+        );
+    }
+
+    #[test]
+    fn test_double_exponential_tracks_ramp() {
+        // A steady ramp: the EMA settles a constant step behind, Holt
+        // catches up with it
+        let ramp: Vec<f64> = (1..=40).map(|i| i as f64 * 0.02).collect();
+        let mut ema = Smoother::new(&config(SmoothingFilter::Ema));
+        let mut holt = Smoother::new(&config(SmoothingFilter::DoubleExponential));
+        let ema_out = run(&mut ema, 0.0, &ramp);
+        let holt_out = run(&mut holt, 0.0, &ramp);
+        assert!((ramp[39] - ema_out[39]) > 0.005);
+        assert!((ramp[39] - holt_out[39]).abs() < 0.002, "{holt_out:?}");
+    }
+
+    #[test]
+    fn test_backwards_time_does_not_blow_up() {
+        let mut smoother = Smoother::new(&config(SmoothingFilter::OneEuro));
+        smoother.apply(0.2, 100.0);
+        let y = smoother.apply(0.8, 1.0);
+        assert!((0.2..=0.8).contains(&y));
+    }
+}
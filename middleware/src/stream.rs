@@ -0,0 +1,412 @@
+//! Consumer for the firmware's raw sample stream (L2CAP CoC channel).
+//!
+//! The stream is a debug/research side channel: every sensor reading with
+//! its quality fields, written to a CSV recording. Haptics keep running off
+//! the GATT notifications.
+
+use std::io::Write;
+use std::path::Path;
+use std::sync::atomic::{AtomicBool, Ordering};
+use std::sync::Arc;
+use tracing::{info, warn};
+
+/// SDU format version understood by parse_sdu (firmware L2CAP_STREAM_VERSION).
+pub(crate) const STREAM_VERSION: u8 = 1;
+/// Bytes per record: seq, timestamp_ms, distance_mm, status, signal, ambient.
+const RECORD_LEN: usize = 13;
+
+/// One sample from the stream.
+#[derive(Debug, Clone, Copy, PartialEq)]
+pub struct StreamRecord {
+    /// Per-sample sequence number, wraps at 65536
+    pub seq: u16,
+    /// Device uptime of the read in ms
+    pub timestamp_ms: u32,
+    /// Distance as read (not clamped)
+    pub distance_mm: u16,
+    /// VL53L0X range status (see ble::RangeQuality)
+    pub range_status: u8,
+    /// Return signal rate in kcps
+    pub signal_rate_kcps: u16,
+    /// Ambient light rate in kcps
+    pub ambient_rate_kcps: u16,
+}
+
+/// Parse one stream SDU into its records.
+/// Returns None for an unknown version or a length that disagrees with the count.
+pub fn parse_sdu(sdu: &[u8]) -> Option<impl Iterator<Item = StreamRecord> + '_> {
+    if sdu.len() < 2 || sdu[0] != STREAM_VERSION {
+        return None;
+    }
+    let count = sdu[1] as usize;
+    let body = &sdu[2..];
+    if body.len() != count * RECORD_LEN {
+        return None;
+    }
+
+    Some(body.chunks_exact(RECORD_LEN).map(|r| StreamRecord {
+        seq: u16::from_le_bytes([r[0], r[1]]),
+        timestamp_ms: u32::from_le_bytes([r[2], r[3], r[4], r[5]]),
+        distance_mm: u16::from_le_bytes([r[6], r[7]]),
+        range_status: r[8],
+        signal_rate_kcps: u16::from_le_bytes([r[9], r[10]]),
+        ambient_rate_kcps: u16::from_le_bytes([r[11], r[12]]),
+    }))
+}
+
+/// Writes stream SDUs to a CSV recording and counts samples lost to
+/// flow control (gaps in seq).
+pub struct Recorder<W: Write> {
+    out: W,
+    next_seq: Option<u16>,
+    /// Records written
+    pub records: u64,
+    /// Samples the device dropped while waiting for credits
+    pub dropped: u64,
+    /// SDUs that failed to parse
+    pub bad_sdus: u64,
+}
+
+impl<W: Write> Recorder<W> {
+    pub fn new(mut out: W) -> std::io::Result<Self> {
+        writeln!(
+            out,
+            "seq,timestamp_ms,distance_mm,range_status,signal_rate_kcps,ambient_rate_kcps"
+        )?;
+        Ok(Recorder {
+            out,
+            next_seq: None,
+            records: 0,
+            dropped: 0,
+            bad_sdus: 0,
+        })
+    }
+
+    /// Append every record of one SDU.
+    pub fn write_sdu(&mut self, sdu: &[u8]) -> std::io::Result<()> {
+        let Some(records) = parse_sdu(sdu) else {
+            self.bad_sdus += 1;
+            return Ok(());
+        };
+
+        for r in records {
+            if let Some(expected) = self.next_seq {
+                self.dropped += r.seq.wrapping_sub(expected) as u64;
+            }
+            self.next_seq = Some(r.seq.wrapping_add(1));
+            self.records += 1;
+            writeln!(
+                self.out,
+                "{},{},{},{},{},{}",
+                r.seq,
+                r.timestamp_ms,
+                r.distance_mm,
+                r.range_status,
+                r.signal_rate_kcps,
+                r.ambient_rate_kcps
+            )?;
+        }
+        Ok(())
+    }
+
+    pub fn flush(&mut self) -> std::io::Result<()> {
+        self.out.flush()
+    }
+}
+
+/// Pull SDUs from `recv` into a recording until shutdown or the channel closes.
+/// `recv` returns Ok(None) on a receive timeout so `running` is rechecked.
+pub(crate) fn record_stream(
+    mut recv: impl FnMut(&mut [u8]) -> std::io::Result<Option<usize>>,
+    recorder: &mut Recorder<impl Write>,
+    running: &AtomicBool,
+) -> std::io::Result<()> {
+    let mut buf = [0u8; 512];
+    while running.load(Ordering::SeqCst) {
+        match recv(&mut buf)? {
+            Some(0) => break, // channel closed
+            Some(n) => recorder.write_sdu(&buf[..n])?,
+            None => recorder.flush()?,
+        }
+    }
+    recorder.flush()
+}
+
+/// Connect to the stream channel and record it to `path`. Blocking; run it
+/// on its own thread.
+pub fn run_recorder(
+    address: [u8; 6],
+    random_address: bool,
+    psm: u16,
+    path: &Path,
+    running: Arc<AtomicBool>,
+) -> anyhow::Result<()> {
+    let socket = l2cap::L2capSocket::connect(address, random_address, psm)?;
+    info!(
+        "Raw stream connected (PSM {:#04x}), recording to {:?}",
+        psm, path
+    );
+
+    let file = std::io::BufWriter::new(std::fs::File::create(path)?);
+    let mut recorder = Recorder::new(file)?;
+    let result = record_stream(|buf| socket.recv(buf), &mut recorder, &running);
+
+    info!(
+        "Raw stream closed: {} samples recorded, {} dropped by flow control",
+        recorder.records, recorder.dropped
+    );
+    if recorder.bad_sdus > 0 {
+        warn!("{} stream SDUs could not be parsed", recorder.bad_sdus);
+    }
+    Ok(result?)
+}
+
+/// Minimal BlueZ L2CAP socket (AF_BLUETOOTH / SOCK_SEQPACKET / BTPROTO_L2CAP).
+#[cfg(target_os = "linux")]
+mod l2cap {
+    use std::io;
+    use std::os::fd::{AsRawFd, FromRawFd, OwnedFd};
+
+    const AF_BLUETOOTH: libc::c_int = 31;
+    const BTPROTO_L2CAP: libc::c_int = 0;
+    const BDADDR_LE_PUBLIC: u8 = 1;
+    const BDADDR_LE_RANDOM: u8 = 2;
+
+    /// struct sockaddr_l2 from <bluetooth/l2cap.h>
+    #[repr(C)]
+    struct SockaddrL2 {
+        l2_family: libc::sa_family_t,
+        l2_psm: u16,
+        l2_bdaddr: [u8; 6],
+        l2_cid: u16,
+        l2_bdaddr_type: u8,
+    }
+
+    pub struct L2capSocket {
+        fd: OwnedFd,
+    }
+
+    impl L2capSocket {
+        /// `address` is in display order (as btleplug's BDAddr), BlueZ wants it reversed.
+        pub fn connect(address: [u8; 6], random_address: bool, psm: u16) -> io::Result<Self> {
+            // SAFETY: plain socket(2) call; the fd is owned below
+            let raw = unsafe { libc::socket(AF_BLUETOOTH, libc::SOCK_SEQPACKET, BTPROTO_L2CAP) };
+            if raw < 0 {
+                return Err(io::Error::last_os_error());
+            }
+            // SAFETY: raw is a freshly created, valid descriptor
+            let fd = unsafe { OwnedFd::from_raw_fd(raw) };
+
+            let mut bdaddr = address;
+            bdaddr.reverse();
+            let addr = SockaddrL2 {
+                l2_family: AF_BLUETOOTH as libc::sa_family_t,
+                l2_psm: psm.to_le(),
+                l2_bdaddr: bdaddr,
+                l2_cid: 0,
+                l2_bdaddr_type: if random_address {
+                    BDADDR_LE_RANDOM
+                } else {
+                    BDADDR_LE_PUBLIC
+                },
+            };
+            // SAFETY: addr is a valid sockaddr_l2 for the duration of the call
+            let rc = unsafe {
+                libc::connect(
+                    fd.as_raw_fd(),
+                    &addr as *const SockaddrL2 as *const libc::sockaddr,
+                    std::mem::size_of::<SockaddrL2>() as libc::socklen_t,
+                )
+            };
+            if rc < 0 {
+                return Err(io::Error::last_os_error());
+            }
+
+            // Wake up once a second so shutdown is noticed
+            let timeout = libc::timeval {
+                tv_sec: 1,
+                tv_usec: 0,
+            };
+            // SAFETY: timeout outlives the call and the size matches
+            let rc = unsafe {
+                libc::setsockopt(
+                    fd.as_raw_fd(),
+                    libc::SOL_SOCKET,
+                    libc::SO_RCVTIMEO,
+                    &timeout as *const libc::timeval as *const libc::c_void,
+                    std::mem::size_of::<libc::timeval>() as libc::socklen_t,
+                )
+            };
+            if rc < 0 {
+                return Err(io::Error::last_os_error());
+            }
+
+            Ok(L2capSocket { fd })
+        }
+
+        /// Receive one SDU. Ok(None) on timeout, Ok(Some(0)) when the channel closed.
+        pub fn recv(&self, buf: &mut [u8]) -> io::Result<Option<usize>> {
+            // SAFETY: buf is valid for writes of buf.len() bytes
+            let n = unsafe {
+                libc::recv(
+                    self.fd.as_raw_fd(),
+                    buf.as_mut_ptr() as *mut libc::c_void,
+                    buf.len(),
+                    0,
+                )
+            };
+            if n >= 0 {
+                return Ok(Some(n as usize));
+            }
+            let err = io::Error::last_os_error();
+            match err.kind() {
+                io::ErrorKind::WouldBlock | io::ErrorKind::TimedOut => Ok(None),
+                io::ErrorKind::Interrupted => Ok(None),
+                _ => Err(err),
+            }
+        }
+    }
+}
+
+#[cfg(not(target_os = "linux"))]
+mod l2cap {
+    use std::io;
+
+    pub struct L2capSocket;
+
+    impl L2capSocket {
+        pub fn connect(_address: [u8; 6], _random_address: bool, _psm: u16) -> io::Result<Self> {
+            Err(io::Error::new(
+                io::ErrorKind::Unsupported,
+                "raw L2CAP stream is only supported on Linux",
+            ))
+        }
+
+        pub fn recv(&self, _buf: &mut [u8]) -> io::Result<Option<usize>> {
+            Ok(Some(0))
+        }
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    fn record(seq: u16, ts: u32, mm: u16, status: u8) -> Vec<u8> {
+        let mut r = Vec::new();
+        r.extend_from_slice(&seq.to_le_bytes());
+        r.extend_from_slice(&ts.to_le_bytes());
+        r.extend_from_slice(&mm.to_le_bytes());
+        r.push(status);
+        r.extend_from_slice(&2000u16.to_le_bytes());
+        r.extend_from_slice(&32u16.to_le_bytes());
+        r
+    }
+
+    fn sdu(records: &[Vec<u8>]) -> Vec<u8> {
+        let mut s = vec![STREAM_VERSION, records.len() as u8];
+        for r in records {
+            s.extend_from_slice(r);
+        }
+        s
+    }
+
+    #[test]
+    fn test_parse_sdu() {
+        let s = sdu(&[record(7, 1000, 300, 0), record(8, 1033, 8190, 2)]);
+        let records: Vec<StreamRecord> = parse_sdu(&s).unwrap().collect();
+        assert_eq!(records.len(), 2);
+        assert_eq!(
+            records[1],
+            StreamRecord {
+                seq: 8,
+                timestamp_ms: 1033,
+                distance_mm: 8190,
+                range_status: 2,
+                signal_rate_kcps: 2000,
+                ambient_rate_kcps: 32,
+            }
+        );
+    }
+
+    #[test]
+    fn test_parse_sdu_rejects_malformed() {
+        let good = sdu(&[record(1, 0, 100, 0)]);
+        assert!(parse_sdu(&[]).is_none());
+
+        let mut bad_version = good.clone();
+        bad_version[0] = 9;
+        assert!(parse_sdu(&bad_version).is_none());
+
+        assert!(parse_sdu(&good[..good.len() - 1]).is_none());
+        let mut wrong_count = good.clone();
+        wrong_count[1] = 2;
+        assert!(parse_sdu(&wrong_count).is_none());
+
+        // An empty SDU is valid
+        assert_eq!(parse_sdu(&[STREAM_VERSION, 0]).unwrap().count(), 0);
+    }
+
+    #[test]
+    fn test_recorder_writes_csv_and_counts_gaps() {
+        let mut out = Vec::new();
+        {
+            let mut rec = Recorder::new(&mut out).unwrap();
+            rec.write_sdu(&sdu(&[
+                record(65534, 10, 300, 0),
+                record(65535, 43, 301, 0),
+            ]))
+            .unwrap();
+            // seq 0 and 1 were dropped on the device, wrapping around
+            rec.write_sdu(&sdu(&[record(2, 142, 290, 4)])).unwrap();
+            rec.write_sdu(&[0xFF]).unwrap();
+            assert_eq!(rec.records, 3);
+            assert_eq!(rec.dropped, 2);
+            assert_eq!(rec.bad_sdus, 1);
+        }
+
+        let csv = String::from_utf8(out).unwrap();
+        let lines: Vec<&str> = csv.lines().collect();
+        assert_eq!(lines.len(), 4);
+        assert!(lines[0].starts_with("seq,timestamp_ms,distance_mm"));
+        assert_eq!(lines[3], "2,142,290,4,2000,32");
+    }
+
+    #[test]
+    fn test_record_stream_until_closed() {
+        let sdus = [sdu(&[record(0, 0, 100, 0)]), sdu(&[record(1, 33, 110, 0)])];
+        let mut calls = 0;
+        let recv = |buf: &mut [u8]| {
+            calls += 1;
+            Ok(match calls {
+                1 => None, // timeout
+                2 | 3 => {
+                    let s = &sdus[calls - 2];
+                    buf[..s.len()].copy_from_slice(s);
+                    Some(s.len())
+                }
+                _ => Some(0), // closed
+            })
+        };
+
+        let mut out = Vec::new();
+        let mut rec = Recorder::new(&mut out).unwrap();
+        let running = AtomicBool::new(true);
+        record_stream(recv, &mut rec, &running).unwrap();
+        assert_eq!(rec.records, 2);
+        assert_eq!(rec.dropped, 0);
+    }
+
+    #[test]
+    fn test_record_stream_stops_on_shutdown() {
+        let running = AtomicBool::new(true);
+        let mut out = Vec::new();
+        let mut rec = Recorder::new(&mut out).unwrap();
+        let recv = |_: &mut [u8]| {
+            running.store(false, Ordering::SeqCst);
+            Ok(None)
+        };
+        record_stream(recv, &mut rec, &running).unwrap();
+        assert_eq!(rec.records, 0);
+    }
+}
@@ -0,0 +1,365 @@
+//! Host/device clock sync for measuring how old a sample is when it
+//! reaches the toy.
+//!
+//! The host writes its own timestamp to the time sync characteristic and
+//! the firmware notifies it back with the uptime the write arrived at. The
+//! device time lies somewhere inside that round trip, so each exchange pins
+//! the clock offset to within half its round-trip time. ClockSync keeps the
+//! recent exchanges, takes the offset from the fastest ones and fits the
+//! crystal drift across them, so device sample timestamps can be placed on
+//! the host clock.
+
+use btleplug::api::{Characteristic, Peripheral as _, WriteType};
+use btleplug::platform::Peripheral;
+use std::collections::VecDeque;
+use std::sync::OnceLock;
+use std::time::{Duration, Instant};
+use tracing::{debug, info};
+use uuid::Uuid;
+
+// Must match firmware/src/range_service.h
+pub(crate) const TIME_SYNC_CHAR_UUID: Uuid =
+    Uuid::from_u128(0x0000000b_7272_6e67_6669_6e6465720000);
+
+/// Exchanges kept for the estimate.
+const WINDOW: usize = 32;
+/// Exchanges slower than twice the fastest one plus this are ignored.
+const RTT_SLACK_US: f64 = 2_000.0;
+/// Shortest span of exchanges before drift is fitted rather than assumed zero.
+const MIN_DRIFT_SPAN_US: f64 = 10e6;
+/// Quick exchanges sent after connecting, before settling to the interval.
+const INITIAL_BURST: u32 = 4;
+const INITIAL_BURST_GAP: Duration = Duration::from_millis(250);
+
+/// Host clock used for time sync: microseconds since first use.
+pub fn host_now_us() -> u64 {
+    static START: OnceLock<Instant> = OnceLock::new();
+    START.get_or_init(Instant::now).elapsed().as_micros() as u64
+}
+
+/// One completed exchange.
+#[derive(Debug, Clone, Copy, PartialEq)]
+pub struct SyncSample {
+    /// Host time the request was written
+    pub host_sent_us: u64,
+    /// Device uptime when the request arrived
+    pub device_us: u64,
+    /// Host time the echo arrived
+    pub host_recv_us: u64,
+}
+
+impl SyncSample {
+    fn rtt_us(&self) -> f64 {
+        self.host_recv_us.saturating_sub(self.host_sent_us) as f64
+    }
+
+    fn host_mid_us(&self) -> f64 {
+        (self.host_sent_us as f64 + self.host_recv_us as f64) / 2.0
+    }
+
+    /// Device minus host time, assuming a symmetric round trip.
+    fn offset_us(&self) -> f64 {
+        self.device_us as f64 - self.host_mid_us()
+    }
+}
+
+/// Encode a time sync request (the host timestamp, LE).
+pub fn encode_time_sync(host_us: u64) -> [u8; 8] {
+    host_us.to_le_bytes()
+}
+
+/// Parse a time sync echo (`struct time_sync_echo`) that arrived at `host_recv_us`.
+pub fn parse_time_sync(value: &[u8], host_recv_us: u64) -> Option<SyncSample> {
+    if value.len() < 16 {
+        return None;
+    }
+    Some(SyncSample {
+        host_sent_us: u64::from_le_bytes(value[0..8].try_into().ok()?),
+        device_us: u64::from_le_bytes(value[8..16].try_into().ok()?),
+        host_recv_us,
+    })
+}
+
+/// Device clock relative to the host clock.
+#[derive(Debug, Clone, Copy, PartialEq)]
+pub struct ClockEstimate {
+    /// Host time the offset is given at
+    pub ref_host_us: f64,
+    /// Device minus host time at ref_host_us
+    pub offset_us: f64,
+    /// Device microseconds gained per host microsecond
+    pub drift: f64,
+    /// Half the fastest round trip: how far off the offset can be
+    pub uncertainty_us: f64,
+}
+
+impl ClockEstimate {
+    /// Device uptime at a host time.
+    pub fn host_to_device_us(&self, host_us: f64) -> f64 {
+        host_us + self.offset_us + self.drift * (host_us - self.ref_host_us)
+    }
+
+    /// How long before `host_now_us` a sample stamped `device_ms` was taken.
+    /// The firmware's millisecond timestamps wrap every ~49 days; the one
+    /// closest to the device's current uptime is used.
+    pub fn sample_age_us(&self, device_ms: u32, host_now_us: u64) -> f64 {
+        let device_now_us = self.host_to_device_us(host_now_us as f64);
+        let now_ms = (device_now_us / 1000.0) as i64;
+        // Unwrap the 32-bit timestamp to the nearest one before or after now
+        let delta_ms = now_ms.wrapping_sub(device_ms as i64) as u32 as i32 as i64;
+        let sample_ms = now_ms - delta_ms;
+        (device_now_us - sample_ms as f64 * 1000.0) / (1.0 + self.drift)
+    }
+
+    pub fn drift_ppm(&self) -> f64 {
+        self.drift * 1e6
+    }
+}
+
+/// Collects exchanges and estimates the device clock from them.
+#[derive(Debug, Default)]
+pub struct ClockSync {
+    samples: VecDeque<SyncSample>,
+}
+
+impl ClockSync {
+    pub fn new() -> Self {
+        ClockSync::default()
+    }
+
+    pub fn add(&mut self, sample: SyncSample) {
+        if self.samples.len() == WINDOW {
+            self.samples.pop_front();
+        }
+        self.samples.push_back(sample);
+    }
+
+    /// Current estimate, or None before the first exchange.
+    pub fn estimate(&self) -> Option<ClockEstimate> {
+        let min_rtt = self
+            .samples
+            .iter()
+            .map(SyncSample::rtt_us)
+            .fold(f64::INFINITY, f64::min);
+        if !min_rtt.is_finite() {
+            return None;
+        }
+
+        // Slow round trips were queued somewhere; their midpoint says little
+        let good: Vec<&SyncSample> = self
+            .samples
+            .iter()
+            .filter(|s| s.rtt_us() <= 2.0 * min_rtt + RTT_SLACK_US)
+            .collect();
+        let last = good.last()?;
+        let ref_host_us = last.host_mid_us();
+        let span = ref_host_us - good[0].host_mid_us();
+
+        if good.len() < 2 || span < MIN_DRIFT_SPAN_US {
+            let fastest = good
+                .iter()
+                .min_by(|a, b| a.rtt_us().total_cmp(&b.rtt_us()))?;
+            return Some(ClockEstimate {
+                ref_host_us: fastest.host_mid_us(),
+                offset_us: fastest.offset_us(),
+                drift: 0.0,
+                uncertainty_us: min_rtt / 2.0,
+            });
+        }
+
+        // Least-squares line through offset against host time, centred on
+        // the newest exchange so the intercept is today's offset
+        let n = good.len() as f64;
+        let mean_x = good
+            .iter()
+            .map(|s| s.host_mid_us() - ref_host_us)
+            .sum::<f64>()
+            / n;
+        let mean_y = good.iter().map(|s| s.offset_us()).sum::<f64>() / n;
+        let (mut sxy, mut sxx) = (0.0, 0.0);
+        for s in &good {
+            let dx = s.host_mid_us() - ref_host_us - mean_x;
+            sxy += dx * (s.offset_us() - mean_y);
+            sxx += dx * dx;
+        }
+        let drift = sxy / sxx;
+
+        Some(ClockEstimate {
+            ref_host_us,
+            offset_us: mean_y - drift * mean_x,
+            drift,
+            uncertainty_us: min_rtt / 2.0,
+        })
+    }
+}
+
+/// Running mean and max of a latency (sample age, command round trip)
+/// between two reports.
+#[derive(Debug)]
+pub struct LatencyStats {
+    count: u64,
+    sum_us: f64,
+    max_us: f64,
+    since: Instant,
+    report_every: Duration,
+}
+
+impl LatencyStats {
+    pub fn new(report_every: Duration) -> Self {
+        LatencyStats {
+            count: 0,
+            sum_us: 0.0,
+            max_us: 0.0,
+            since: Instant::now(),
+            report_every,
+        }
+    }
+
+    /// Record one measurement.
+    pub fn record(&mut self, us: f64) {
+        self.count += 1;
+        self.sum_us += us;
+        self.max_us = self.max_us.max(us);
+    }
+
+    /// (count, mean us, max us) since the last call, once a report is due
+    /// and something was recorded.
+    pub fn take_report(&mut self) -> Option<(u64, f64, f64)> {
+        if self.count == 0 || self.since.elapsed() < self.report_every {
+            return None;
+        }
+        let report = (self.count, self.sum_us / self.count as f64, self.max_us);
+        *self = LatencyStats::new(self.report_every);
+        Some(report)
+    }
+}
+
+/// Send time sync requests for as long as the connection lasts: a quick
+/// burst so an estimate exists within a second, then one per `interval`.
+/// The echoes arrive with the other notifications.
+pub async fn run_sync_writer(peripheral: Peripheral, chr: Characteristic, interval: Duration) {
+    let mut sent: u32 = 0;
+    loop {
+        let request = encode_time_sync(host_now_us());
+        if let Err(e) = peripheral
+            .write(&chr, &request, WriteType::WithoutResponse)
+            .await
+        {
+            debug!("Time sync write failed: {}", e);
+            return;
+        }
+        sent += 1;
+        if sent == INITIAL_BURST {
+            info!("Clock sync started, every {}s", interval.as_secs());
+        }
+        let gap = if sent < INITIAL_BURST {
+            INITIAL_BURST_GAP
+        } else {
+            interval
+        };
+        tokio::time::sleep(gap).await;
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    /// Exchange with the device clock at `offset` from the host, drifting by
+    /// `drift_ppm`, and the request taking `up`, the echo `down` us.
+    fn exchange(host_us: u64, offset: i64, drift_ppm: f64, up: u64, down: u64) -> SyncSample {
+        let arrive = host_us + up;
+        let device = arrive as f64 + offset as f64 + arrive as f64 * drift_ppm * 1e-6;
+        SyncSample {
+            host_sent_us: host_us,
+            device_us: device as u64,
+            host_recv_us: arrive + down,
+        }
+    }
+
+    #[test]
+    fn test_parse_time_sync() {
+        let mut value = encode_time_sync(123_456).to_vec();
+        value.extend_from_slice(&7_000_000u64.to_le_bytes());
+        let s = parse_time_sync(&value, 130_000).unwrap();
+        assert_eq!(s.host_sent_us, 123_456);
+        assert_eq!(s.device_us, 7_000_000);
+        assert_eq!(s.host_recv_us, 130_000);
+        assert!(parse_time_sync(&value[..15], 0).is_none());
+    }
+
+    #[test]
+    fn test_no_estimate_without_exchanges() {
+        assert!(ClockSync::new().estimate().is_none());
+    }
+
+    #[test]
+    fn test_offset_from_fastest_exchange() {
+        let mut sync = ClockSync::new();
+        // Symmetric 15 ms trip, then a slow one queued behind other traffic
+        sync.add(exchange(1_000_000, 5_000_000, 0.0, 7_500, 7_500));
+        sync.add(exchange(2_000_000, 5_000_000, 0.0, 90_000, 7_500));
+        let est = sync.estimate().unwrap();
+        assert!((est.offset_us - 5_000_000.0).abs() < 1.0);
+        assert_eq!(est.drift, 0.0);
+        assert_eq!(est.uncertainty_us, 7_500.0);
+    }
+
+    #[test]
+    fn test_fits_drift() {
+        let mut sync = ClockSync::new();
+        // A full window, one exchange every 30 s
+        for i in 0..WINDOW as u64 {
+            let host = 1_000_000 + i * 30_000_000;
+            // Alternate the asymmetry so the midpoints scatter around the truth
+            let (up, down) = if i % 2 == 0 {
+                (6_000, 8_000)
+            } else {
+                (8_000, 6_000)
+            };
+            sync.add(exchange(host, -300_000, 40.0, up, down));
+        }
+        let est = sync.estimate().unwrap();
+        assert!((est.drift_ppm() - 40.0).abs() < 1.0, "{}", est.drift_ppm());
+
+        // The device clock at the last exchange, to within the asymmetry
+        let host = 931_007_000.0;
+        let truth = host - 300_000.0 + host * 40e-6;
+        assert!((est.host_to_device_us(host) - truth).abs() < 1_500.0);
+    }
+
+    #[test]
+    fn test_sample_age() {
+        let est = ClockEstimate {
+            ref_host_us: 0.0,
+            offset_us: 10_000_000.0,
+            drift: 0.0,
+            uncertainty_us: 5_000.0,
+        };
+        // Host 2 s is device 12 s; a sample stamped 11.95 s is 50 ms old
+        assert!((est.sample_age_us(11_950, 2_000_000) - 50_000.0).abs() < 1.0);
+    }
+
+    #[test]
+    fn test_sample_age_across_wrap() {
+        // Device uptime just past 2^32 ms, sample stamped just before the wrap
+        let est = ClockEstimate {
+            ref_host_us: 0.0,
+            offset_us: (u32::MAX as f64 + 10.0) * 1000.0,
+            drift: 0.0,
+            uncertainty_us: 0.0,
+        };
+        let age = est.sample_age_us(u32::MAX - 19, 0);
+        assert!((age - 29_000.0).abs() < 1.0, "{age}");
+    }
+
+    #[test]
+    fn test_latency_stats_report() {
+        let mut stats = LatencyStats::new(Duration::ZERO);
+        assert!(stats.take_report().is_none());
+        stats.record(20_000.0);
+        stats.record(40_000.0);
+        assert_eq!(stats.take_report(), Some((2, 30_000.0, 40_000.0)));
+        assert!(stats.take_report().is_none());
+    }
+}
@@ -1,35 +1,189 @@
-use buttplug::client::{device::ScalarValueCommand, ButtplugClient, ButtplugClientDevice};
+use buttplug::client::device::{LinearCommand, RotateCommand, ScalarCommand};
+use buttplug::client::{ButtplugClient, ButtplugClientDevice};
 use buttplug::core::connector::new_json_ws_client_connector;
 use buttplug::core::message::ActuatorType;
+use std::collections::HashMap;
 use std::sync::Arc;
-use std::time::Duration;
+use std::time::{Duration, Instant};
 use tracing::{debug, info};
 
+/// Stroke time for linear moves when commands follow the samples: the gap
+/// since the previous command, within these bounds.
+const MIN_STROKE: Duration = Duration::from_millis(20);
+const MAX_STROKE: Duration = Duration::from_millis(500);
+const FIRST_STROKE: Duration = Duration::from_millis(100);
+
 /// Trait abstracting toy control for testability
 #[async_trait::async_trait]
 pub trait ToyBackend: Send {
-    async fn set_intensity(&mut self, intensity: f64) -> anyhow::Result<()>;
+    /// Drive the toy at `intensity`. Returns whether a command went out;
+    /// false when the toy already runs at about that level.
+    async fn set_intensity(&mut self, intensity: f64) -> anyhow::Result<bool>;
     async fn stop(&mut self) -> anyhow::Result<()>;
-    async fn disconnect(&self) -> anyhow::Result<()>;
     fn is_connected(&self) -> bool;
 }
 
+/// One output of a toy, as Buttplug addresses it.
+#[derive(Debug, Clone, Copy, PartialEq)]
+pub(crate) enum Actuator {
+    /// ScalarCmd feature (vibrate, oscillate, constrict, ...): level 0.0-1.0
+    Scalar { index: u32, actuator: ActuatorType },
+    /// RotateCmd feature: speed 0.0-1.0, always clockwise
+    Rotate { index: u32 },
+    /// LinearCmd feature (strokers): position 0.0-1.0, reached over the
+    /// stroke time
+    Linear { index: u32 },
+}
+
+/// The features a toy advertises, per Buttplug message.
+#[derive(Debug, Default)]
+pub(crate) struct DeviceFeatures {
+    pub scalar: Vec<(u32, ActuatorType)>,
+    pub rotate: Vec<u32>,
+    pub linear: Vec<u32>,
+}
+
+/// ScalarCmd actuator type for a buttplug.actuator_types entry.
+fn scalar_type(name: &str) -> Option<ActuatorType> {
+    match name {
+        "Vibrate" => Some(ActuatorType::Vibrate),
+        "Rotate" => Some(ActuatorType::Rotate),
+        "Oscillate" => Some(ActuatorType::Oscillate),
+        "Constrict" => Some(ActuatorType::Constrict),
+        "Inflate" => Some(ActuatorType::Inflate),
+        "Position" => Some(ActuatorType::Position),
+        _ => None,
+    }
+}
+
+/// Every feature of a toy that matches one of the configured actuator
+/// types. "Rotate" covers both scalar and RotateCmd rotators, "Linear" the
+/// LinearCmd axes.
+pub(crate) fn plan_actuators(features: &DeviceFeatures, types: &[String]) -> Vec<Actuator> {
+    let wanted = |name: &str| types.iter().any(|t| t == name);
+    let scalar = features
+        .scalar
+        .iter()
+        .filter(|(_, actuator)| types.iter().any(|t| scalar_type(t) == Some(*actuator)))
+        .map(|&(index, actuator)| Actuator::Scalar { index, actuator });
+    let rotate = features
+        .rotate
+        .iter()
+        .filter(|_| wanted("Rotate"))
+        .map(|&index| Actuator::Rotate { index });
+    let linear = features
+        .linear
+        .iter()
+        .filter(|_| wanted("Linear"))
+        .map(|&index| Actuator::Linear { index });
+    scalar.chain(rotate).chain(linear).collect()
+}
+
+/// One update for every driven actuator, grouped by Buttplug message.
+#[derive(Debug, Default, Clone, PartialEq)]
+pub(crate) struct ActuatorCommands {
+    /// ScalarCmd: index -> (level, actuator type)
+    pub scalar: HashMap<u32, (f64, ActuatorType)>,
+    /// RotateCmd: index -> (speed, clockwise)
+    pub rotate: HashMap<u32, (f64, bool)>,
+    /// LinearCmd: index -> (duration ms, position)
+    pub linear: HashMap<u32, (u32, f64)>,
+}
+
+impl ActuatorCommands {
+    /// Drive every actuator in `plan` to `level`, linear axes over `stroke`.
+    pub fn build(plan: &[Actuator], level: f64, stroke: Duration) -> Self {
+        let mut commands = ActuatorCommands::default();
+        for actuator in plan {
+            match *actuator {
+                Actuator::Scalar { index, actuator } => {
+                    commands.scalar.insert(index, (level, actuator));
+                }
+                Actuator::Rotate { index } => {
+                    commands.rotate.insert(index, (level, true));
+                }
+                Actuator::Linear { index } => {
+                    commands
+                        .linear
+                        .insert(index, (stroke.as_millis() as u32, level));
+                }
+            }
+        }
+        commands
+    }
+}
+
 /// Trait wrapping the raw device commands, for testability.
 #[async_trait::async_trait]
 pub(crate) trait DeviceHandle: Send {
-    async fn vibrate(&self, intensity: f64) -> anyhow::Result<()>;
+    /// Send one ScalarCmd, RotateCmd and LinearCmd for whichever groups of
+    /// `commands` are non-empty.
+    async fn actuate(&self, commands: &ActuatorCommands) -> anyhow::Result<()>;
     async fn stop(&self) -> anyhow::Result<()>;
+    /// Whether the toy is still reachable through Intiface.
+    fn connected(&self) -> bool {
+        true
+    }
 }
 
 /// Real Buttplug device handle.
-struct ButtplugDeviceHandle(Arc<ButtplugClientDevice>);
+pub(crate) struct ButtplugDeviceHandle(Arc<ButtplugClientDevice>);
+
+/// One toy found through Intiface.
+pub(crate) type ButtplugToy = ToyState<ButtplugDeviceHandle>;
+
+impl ButtplugDeviceHandle {
+    fn features(&self) -> DeviceFeatures {
+        let attributes = self.0.message_attributes();
+        DeviceFeatures {
+            scalar: attributes
+                .scalar_cmd()
+                .iter()
+                .flatten()
+                .map(|a| (*a.index(), *a.actuator_type()))
+                .collect(),
+            rotate: attributes
+                .rotate_cmd()
+                .iter()
+                .flatten()
+                .map(|a| *a.index())
+                .collect(),
+            linear: attributes
+                .linear_cmd()
+                .iter()
+                .flatten()
+                .map(|a| *a.index())
+                .collect(),
+        }
+    }
+}
 
 #[async_trait::async_trait]
 impl DeviceHandle for ButtplugDeviceHandle {
-    async fn vibrate(&self, intensity: f64) -> anyhow::Result<()> {
-        self.0
-            .vibrate(&ScalarValueCommand::ScalarValue(intensity))
-            .await?;
+    async fn actuate(&self, commands: &ActuatorCommands) -> anyhow::Result<()> {
+        // Separate messages, so sent together rather than one RTT apiece
+        let scalar = async {
+            if !commands.scalar.is_empty() {
+                let command = ScalarCommand::ScalarMap(commands.scalar.clone());
+                self.0.scalar(&command).await?;
+            }
+            Ok::<_, anyhow::Error>(())
+        };
+        let rotate = async {
+            if !commands.rotate.is_empty() {
+                let command = RotateCommand::RotateMap(commands.rotate.clone());
+                self.0.rotate(&command).await?;
+            }
+            Ok::<_, anyhow::Error>(())
+        };
+        let linear = async {
+            if !commands.linear.is_empty() {
+                let command = LinearCommand::LinearMap(commands.linear.clone());
+                self.0.linear(&command).await?;
+            }
+            Ok::<_, anyhow::Error>(())
+        };
+        futures::try_join!(scalar, rotate, linear)?;
         Ok(())
     }
 
@@ -37,47 +191,70 @@ impl DeviceHandle for ButtplugDeviceHandle {
         self.0.stop().await?;
         Ok(())
     }
+
+    fn connected(&self) -> bool {
+        self.0.connected()
+    }
 }
 
 /// Generic toy state with pluggable device handle, containing all testable logic.
 pub(crate) struct ToyState<D: DeviceHandle> {
     device: Option<D>,
+    actuators: Vec<Actuator>,
     last_intensity: f64,
     connected: bool,
+    /// Linear stroke time, the output tick when there is one
+    stroke: Option<Duration>,
+    last_command: Option<Instant>,
 }
 
 impl<D: DeviceHandle> ToyState<D> {
     fn new(connected: bool) -> Self {
         ToyState {
             device: None,
+            actuators: Vec::new(),
             last_intensity: 0.0,
             connected,
+            stroke: None,
+            last_command: None,
         }
     }
 
-    fn set_device(&mut self, device: D) {
+    fn set_device(&mut self, device: D, actuators: Vec<Actuator>) {
         self.device = Some(device);
+        self.actuators = actuators;
+    }
+
+    /// How long a linear move to the next position should take.
+    fn stroke_time(&self, now: Instant) -> Duration {
+        self.stroke.unwrap_or_else(|| match self.last_command {
+            Some(last) => now.duration_since(last).clamp(MIN_STROKE, MAX_STROKE),
+            None => FIRST_STROKE,
+        })
     }
 }
 
 #[async_trait::async_trait]
 impl<D: DeviceHandle + Sync> ToyBackend for ToyState<D> {
-    async fn set_intensity(&mut self, intensity: f64) -> anyhow::Result<()> {
+    async fn set_intensity(&mut self, intensity: f64) -> anyhow::Result<bool> {
         let device = self
             .device
             .as_ref()
             .ok_or_else(|| anyhow::anyhow!("No target device"))?;
 
         if !intensity_changed(intensity, self.last_intensity) {
-            return Ok(());
+            return Ok(false);
         }
 
         let clamped = intensity.clamp(0.0, 1.0);
+        let now = Instant::now();
+        let commands = ActuatorCommands::build(&self.actuators, clamped, self.stroke_time(now));
         debug!("Setting intensity: {:.3}", clamped);
 
-        device.vibrate(clamped).await?;
+        device.actuate(&commands).await?;
         self.last_intensity = clamped;
-        Ok(())
+        self.last_command = Some(now);
+        Ok(true)
     }
 
     async fn stop(&mut self) -> anyhow::Result<()> {
@@ -88,20 +265,70 @@ impl<D: DeviceHandle + Sync> ToyBackend for ToyState<D> {
         Ok(())
     }
 
-    async fn disconnect(&self) -> anyhow::Result<()> {
-        // Disconnection is handled by the controller, not the state
-        Ok(())
+    fn is_connected(&self) -> bool {
+        self.connected && self.device.as_ref().is_none_or(D::connected)
     }
+}
 
-    fn is_connected(&self) -> bool {
-        self.connected
+/// How to pick a toy from the devices Intiface knows.
+#[derive(Debug, Clone, PartialEq, Eq)]
+pub enum DeviceSelector {
+    /// The first one with a configured actuator type, else the first one
+    First,
+    /// By Intiface device index
+    Index(u32),
+    /// First whose name contains this, case-insensitive
+    Name(String),
+}
+
+/// A device as seen during selection.
+pub(crate) struct DeviceInfo<'a> {
+    pub index: u32,
+    pub name: &'a str,
+    /// Has at least one of the configured actuator types
+    pub usable: bool,
+}
+
+/// Position in `devices` for each selector, in order. A toy is never
+/// picked twice, so two `First` selectors give two different toys.
+pub(crate) fn select_devices(
+    devices: &[DeviceInfo],
+    selectors: &[DeviceSelector],
+) -> anyhow::Result<Vec<usize>> {
+    let mut picked: Vec<usize> = Vec::with_capacity(selectors.len());
+    for selector in selectors {
+        let mut free = (0..devices.len()).filter(|i| !picked.contains(i));
+        let found = match selector {
+            DeviceSelector::First => {
+                let free: Vec<usize> = free.collect();
+                free.iter()
+                    .copied()
+                    .find(|&i| devices[i].usable)
+                    .or_else(|| free.first().copied())
+            }
+            DeviceSelector::Index(index) => free.find(|&i| devices[i].index == *index),
+            DeviceSelector::Name(name) => {
+                let name = name.to_lowercase();
+                free.find(|&i| devices[i].name.to_lowercase().contains(&name))
+            }
+        };
+        match found {
+            Some(i) => picked.push(i),
+            None => match selector {
+                DeviceSelector::First => anyhow::bail!("No suitable device found"),
+                DeviceSelector::Index(index) => {
+                    anyhow::bail!("Device index {} not found", index)
+                }
+                DeviceSelector::Name(name) => anyhow::bail!("No device named like {:?}", name),
+            },
+        }
     }
+    Ok(picked)
 }
 
 /// Wrapper around Buttplug client for device control
 pub struct ToyController {
     client: ButtplugClient,
-    state: ToyState<ButtplugDeviceHandle>,
 }
 
 impl ToyController {
@@ -112,14 +339,19 @@ impl ToyController {
         client.connect(connector).await?;
         info!("Connected to Intiface Engine at {}", server_address);
 
-        Ok(ToyController {
-            state: ToyState::new(true),
-            client,
-        })
+        Ok(ToyController { client })
     }
 
-    /// Scan for and select a target device
-    pub async fn find_device(&mut self, device_index: Option<u32>) -> anyhow::Result<()> {
+    /// Scan for the toys to drive, one per selector, with their names.
+    /// Each is driven through its features of the given `actuator_types`,
+    /// linear ones with strokes of `stroke` (None: the gap between
+    /// commands).
+    pub(crate) async fn find_devices(
+        &self,
+        selectors: &[DeviceSelector],
+        actuator_types: &[String],
+        stroke: Option<Duration>,
+    ) -> anyhow::Result<Vec<(String, ButtplugToy)>> {
         info!("Scanning for Buttplug devices...");
         self.client.start_scanning().await?;
 
@@ -134,57 +366,58 @@ impl ToyController {
             );
         }
 
-        let device = if let Some(idx) = device_index {
-            devices
-                .iter()
-                .find(|d| d.index() == idx)
-                .ok_or_else(|| anyhow::anyhow!("Device index {} not found", idx))?
-                .clone()
-        } else {
-            // Use first device with vibrate capability
-            devices
-                .iter()
-                .find(|d| {
-                    d.message_attributes()
-                        .scalar_cmd()
-                        .as_ref()
-                        .map(|attrs| {
-                            attrs
-                                .iter()
-                                .any(|a| *a.actuator_type() == ActuatorType::Vibrate)
-                        })
-                        .unwrap_or(false)
-                })
-                .or_else(|| devices.first())
-                .ok_or_else(|| anyhow::anyhow!("No suitable device found"))?
-                .clone()
-        };
-
-        info!("Using device: {} (index {})", device.name(), device.index());
-        self.state.set_device(ButtplugDeviceHandle(device));
-        Ok(())
-    }
-}
-
-#[async_trait::async_trait]
-impl ToyBackend for ToyController {
-    async fn set_intensity(&mut self, intensity: f64) -> anyhow::Result<()> {
-        self.state.set_intensity(intensity).await
-    }
-
-    async fn stop(&mut self) -> anyhow::Result<()> {
-        self.state.stop().await
+        let handles: Vec<ButtplugDeviceHandle> = devices
+            .iter()
+            .map(|d| ButtplugDeviceHandle(d.clone()))
+            .collect();
+        let plans: Vec<Vec<Actuator>> = handles
+            .iter()
+            .map(|h| plan_actuators(&h.features(), actuator_types))
+            .collect();
+        let infos: Vec<DeviceInfo> = devices
+            .iter()
+            .zip(&plans)
+            .map(|(d, plan)| DeviceInfo {
+                index: d.index(),
+                name: d.name(),
+                usable: !plan.is_empty(),
+            })
+            .collect();
+
+        let picked = select_devices(&infos, selectors)?;
+        let mut handles: Vec<Option<ButtplugDeviceHandle>> =
+            handles.into_iter().map(Some).collect();
+        let mut toys = Vec::with_capacity(picked.len());
+        for i in picked {
+            let device = &devices[i];
+            let plan = plans[i].clone();
+            if plan.is_empty() {
+                anyhow::bail!(
+                    "{} has none of the actuator types {:?}",
+                    device.name(),
+                    actuator_types
+                );
+            }
+            info!(
+                "Using device: {} (index {}), {} actuator(s)",
+                device.name(),
+                device.index(),
+                plan.len()
+            );
+            let mut toy = ToyState::new(true);
+            toy.stroke = stroke;
+            toy.set_device(handles[i].take().unwrap(), plan);
+            toys.push((device.name().clone(), toy));
+        }
+        Ok(toys)
     }
 
-    async fn disconnect(&self) -> anyhow::Result<()> {
+    /// Disconnect from Intiface Engine
+    pub async fn disconnect(&self) -> anyhow::Result<()> {
         self.client.disconnect().await?;
         info!("Disconnected from Intiface Engine");
         Ok(())
     }
-
-    fn is_connected(&self) -> bool {
-        self.client.connected()
-    }
 }
 
 /// Returns true if the intensity change is significant enough to send (>= 1%).
@@ -197,8 +430,15 @@ mod tests {
     use super::*;
     use std::sync::{Arc, Mutex};
 
+    const VIBRATOR: Actuator = Actuator::Scalar {
+        index: 0,
+        actuator: ActuatorType::Vibrate,
+    };
+
     struct MockDevice {
+        /// Level sent to the vibrator at index 0, per command
         vibrations: Arc<Mutex<Vec<f64>>>,
+        commands: Arc<Mutex<Vec<ActuatorCommands>>>,
         stopped: Arc<Mutex<bool>>,
     }
 
@@ -206,6 +446,7 @@ mod tests {
         fn new() -> Self {
             MockDevice {
                 vibrations: Arc::new(Mutex::new(Vec::new())),
+                commands: Arc::new(Mutex::new(Vec::new())),
                 stopped: Arc::new(Mutex::new(false)),
             }
         }
@@ -213,8 +454,11 @@ mod tests {
 
     #[async_trait::async_trait]
     impl DeviceHandle for MockDevice {
-        async fn vibrate(&self, intensity: f64) -> anyhow::Result<()> {
-            self.vibrations.lock().unwrap().push(intensity);
+        async fn actuate(&self, commands: &ActuatorCommands) -> anyhow::Result<()> {
+            if let Some(&(level, _)) = commands.scalar.get(&0) {
+                self.vibrations.lock().unwrap().push(level);
+            }
+            self.commands.lock().unwrap().push(commands.clone());
             Ok(())
         }
 
@@ -256,7 +500,7 @@ mod tests {
         let device = MockDevice::new();
         let vibrations = device.vibrations.clone();
         let mut state: ToyState<MockDevice> = ToyState::new(true);
-        state.set_device(device);
+        state.set_device(device, vec![VIBRATOR]);
 
         state.set_intensity(0.75).await.unwrap();
 
@@ -270,10 +514,11 @@ mod tests {
         let device = MockDevice::new();
         let vibrations = device.vibrations.clone();
         let mut state: ToyState<MockDevice> = ToyState::new(true);
-        state.set_device(device);
+        state.set_device(device, vec![VIBRATOR]);
 
-        state.set_intensity(0.5).await.unwrap();
-        state.set_intensity(0.505).await.unwrap(); // < 1% change, should skip
+        assert!(state.set_intensity(0.5).await.unwrap());
+        // < 1% change, should skip and say so
+        assert!(!state.set_intensity(0.505).await.unwrap());
 
         let vibs = vibrations.lock().unwrap();
         assert_eq!(vibs.len(), 1);
@@ -284,7 +529,7 @@ mod tests {
         let device = MockDevice::new();
         let vibrations = device.vibrations.clone();
         let mut state: ToyState<MockDevice> = ToyState::new(true);
-        state.set_device(device);
+        state.set_device(device, vec![VIBRATOR]);
 
         state.set_intensity(0.5).await.unwrap();
         state.set_intensity(0.7).await.unwrap(); // > 1% change
@@ -298,7 +543,7 @@ mod tests {
         let device = MockDevice::new();
         let vibrations = device.vibrations.clone();
         let mut state: ToyState<MockDevice> = ToyState::new(true);
-        state.set_device(device);
+        state.set_device(device, vec![VIBRATOR]);
 
         state.set_intensity(1.5).await.unwrap();
 
@@ -312,7 +557,7 @@ mod tests {
         let device = MockDevice::new();
         let vibrations = device.vibrations.clone();
         let mut state: ToyState<MockDevice> = ToyState::new(true);
-        state.set_device(device);
+        state.set_device(device, vec![VIBRATOR]);
 
         state.set_intensity(-0.5).await.unwrap();
 
@@ -335,7 +580,7 @@ mod tests {
         let device = MockDevice::new();
         let stopped = device.stopped.clone();
         let mut state: ToyState<MockDevice> = ToyState::new(true);
-        state.set_device(device);
+        state.set_device(device, vec![VIBRATOR]);
 
         state.set_intensity(0.5).await.unwrap();
         state.stop().await.unwrap();
@@ -357,7 +602,7 @@ mod tests {
         let device = MockDevice::new();
         let vibrations = device.vibrations.clone();
         let mut state: ToyState<MockDevice> = ToyState::new(true);
-        state.set_device(device);
+        state.set_device(device, vec![VIBRATOR]);
 
         state.set_intensity(0.5).await.unwrap();
         state.stop().await.unwrap();
@@ -368,9 +613,178 @@ mod tests {
     }
 
     #[tokio::test]
-    async fn test_disconnect_is_ok() {
-        let state: ToyState<MockDevice> = ToyState::new(true);
-        state.disconnect().await.unwrap();
+    async fn test_is_connected_follows_device() {
+        struct GoneDevice;
+
+        #[async_trait::async_trait]
+        impl DeviceHandle for GoneDevice {
+            async fn actuate(&self, _commands: &ActuatorCommands) -> anyhow::Result<()> {
+                Ok(())
+            }
+
+            async fn stop(&self) -> anyhow::Result<()> {
+                Ok(())
+            }
+
+            fn connected(&self) -> bool {
+                false
+            }
+        }
+
+        let mut state: ToyState<GoneDevice> = ToyState::new(true);
+        assert!(state.is_connected());
+        state.set_device(GoneDevice, vec![VIBRATOR]);
+        assert!(!state.is_connected());
+    }
+
+    #[tokio::test]
+    async fn test_linear_strokes_over_output_tick() {
+        let device = MockDevice::new();
+        let commands = device.commands.clone();
+        let mut state: ToyState<MockDevice> = ToyState::new(true);
+        state.stroke = Some(Duration::from_millis(33));
+        state.set_device(device, vec![Actuator::Linear { index: 1 }]);
+
+        state.set_intensity(0.25).await.unwrap();
+        state.set_intensity(0.75).await.unwrap();
+
+        let commands = commands.lock().unwrap();
+        assert_eq!(commands.len(), 2);
+        assert_eq!(commands[1].linear[&1], (33, 0.75));
+        assert!(commands[1].scalar.is_empty());
+    }
+
+    #[test]
+    fn test_stroke_without_tick_follows_command_gap() {
+        let mut state: ToyState<MockDevice> = ToyState::new(true);
+        let t0 = Instant::now();
+        assert_eq!(state.stroke_time(t0), FIRST_STROKE);
+
+        state.last_command = Some(t0);
+        let ms = Duration::from_millis;
+        assert_eq!(state.stroke_time(t0 + ms(60)), ms(60));
+        assert_eq!(state.stroke_time(t0 + ms(5)), MIN_STROKE);
+        assert_eq!(state.stroke_time(t0 + ms(3000)), MAX_STROKE);
+    }
+
+    // --- actuator planning tests ---
+
+    fn features() -> DeviceFeatures {
+        DeviceFeatures {
+            scalar: vec![
+                (0, ActuatorType::Vibrate),
+                (1, ActuatorType::Oscillate),
+                (2, ActuatorType::Rotate),
+            ],
+            rotate: vec![0],
+            linear: vec![0],
+        }
+    }
+
+    fn types(names: &[&str]) -> Vec<String> {
+        names.iter().map(|n| n.to_string()).collect()
+    }
+
+    #[test]
+    fn test_plan_picks_configured_types() {
+        assert_eq!(
+            plan_actuators(&features(), &types(&["Vibrate"])),
+            vec![VIBRATOR]
+        );
+        assert_eq!(
+            plan_actuators(&features(), &types(&["Oscillate", "Linear"])),
+            vec![
+                Actuator::Scalar {
+                    index: 1,
+                    actuator: ActuatorType::Oscillate
+                },
+                Actuator::Linear { index: 0 },
+            ]
+        );
+        assert!(plan_actuators(&features(), &types(&["Constrict"])).is_empty());
+    }
+
+    #[test]
+    fn test_plan_rotate_covers_both_commands() {
+        assert_eq!(
+            plan_actuators(&features(), &types(&["Rotate"])),
+            vec![
+                Actuator::Scalar {
+                    index: 2,
+                    actuator: ActuatorType::Rotate
+                },
+                Actuator::Rotate { index: 0 },
+            ]
+        );
+    }
+
+    #[test]
+    fn test_build_groups_by_command() {
+        let plan = plan_actuators(&features(), &types(&["Vibrate", "Rotate", "Linear"]));
+        let commands = ActuatorCommands::build(&plan, 0.4, Duration::from_millis(50));
+        assert_eq!(commands.scalar.len(), 2);
+        assert_eq!(commands.scalar[&0], (0.4, ActuatorType::Vibrate));
+        assert_eq!(commands.scalar[&2], (0.4, ActuatorType::Rotate));
+        assert_eq!(commands.rotate[&0], (0.4, true));
+        assert_eq!(commands.linear[&0], (50, 0.4));
+    }
+
+    // --- select_devices tests ---
+
+    fn infos() -> Vec<DeviceInfo<'static>> {
+        vec![
+            DeviceInfo {
+                index: 3,
+                name: "Kiiroo Keon",
+                usable: false,
+            },
+            DeviceInfo {
+                index: 5,
+                name: "Lovense Lush 3",
+                usable: true,
+            },
+            DeviceInfo {
+                index: 7,
+                name: "We-Vibe Melt 2",
+                usable: true,
+            },
+        ]
+    }
+
+    #[test]
+    fn test_select_first_prefers_usable() {
+        let picked = select_devices(&infos(), &[DeviceSelector::First]).unwrap();
+        assert_eq!(picked, vec![1]);
+
+        // Each First takes a different toy, falling back to unusable ones
+        let firsts = vec![DeviceSelector::First; 3];
+        assert_eq!(select_devices(&infos(), &firsts).unwrap(), vec![1, 2, 0]);
+        let firsts = vec![DeviceSelector::First; 4];
+        assert!(select_devices(&infos(), &firsts).is_err());
+    }
+
+    #[test]
+    fn test_select_by_index_and_name() {
+        let selectors = [
+            DeviceSelector::Index(7),
+            DeviceSelector::Name("LUSH".to_string()),
+            DeviceSelector::First,
+        ];
+        assert_eq!(select_devices(&infos(), &selectors).unwrap(), vec![2, 1, 0]);
+    }
+
+    #[test]
+    fn test_select_missing_device_errors() {
+        let err = select_devices(&infos(), &[DeviceSelector::Index(4)]).unwrap_err();
+        assert!(err.to_string().contains("index 4"));
+        let err = select_devices(&infos(), &[DeviceSelector::Name("nora".into())]).unwrap_err();
+        assert!(err.to_string().contains("nora"));
+        // The same toy can't be driven twice
+        let twice = [
+            DeviceSelector::Index(5),
+            DeviceSelector::Name("lush".into()),
+        ];
+        assert!(select_devices(&infos(), &twice).is_err());
     }
 
     #[tokio::test]